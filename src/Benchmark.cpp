@@ -0,0 +1,271 @@
+#include "Benchmark.h"
+#include "Simulation.h"
+#include "Parser.h"
+#include "Road.h"
+#include "VehicleGenerator.h"
+#include "BusStop.h"
+#include "Intersection.h"
+#include "DesignByContract.h"
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double secondsSince(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+/**
+ * @brief Returns the peak resident set size of this process in KiB, or 0 if unknown.
+ */
+long peakRssKb() {
+#if defined(__APPLE__)
+    struct rusage usage {};
+    getrusage(RUSAGE_SELF, &usage);
+    return static_cast<long>(usage.ru_maxrss / 1024);  // bytes on macOS
+#elif defined(__unix__)
+    struct rusage usage {};
+    getrusage(RUSAGE_SELF, &usage);
+    return static_cast<long>(usage.ru_maxrss);          // KiB on Linux
+#else
+    return 0;
+#endif
+}
+
+/**
+ * @brief Counts the vehicles that the next step will update.
+ */
+long long countVehicles(const Simulation& sim) {
+    long long count = 0;
+    for (const Road* road : sim.getRoads())
+        count += static_cast<long long>(road->getVehicles().size());
+    return count;
+}
+
+bool allRoadsEmpty(const Simulation& sim) {
+    for (const Road* road : sim.getRoads()) {
+        if (!road->getVehicles().empty())
+            return false;
+    }
+    return true;
+}
+
+std::string jsonEscape(const std::string& text) {
+    std::string escaped;
+    for (char c : text) {
+        if (c == '"' || c == '\\')
+            escaped += '\\';
+        escaped += c;
+    }
+    return escaped;
+}
+
+} // namespace
+
+/**
+ * @brief Creates a benchmark driver with the given step budget.
+ *
+ * @param maxSteps Maximum number of measured steps per scenario (must be positive).
+ * @param warmupSteps Number of steps run before measuring (must be non-negative).
+ * @param threads Number of road update threads (must be at least 1).
+ */
+Benchmark::Benchmark(int maxSteps, int warmupSteps, int threads)
+    : maxSteps(maxSteps), warmupSteps(warmupSteps), threads(threads)
+{
+    REQUIRE(maxSteps > 0, "maxSteps must be positive");
+    REQUIRE(warmupSteps >= 0, "warmupSteps must be non-negative");
+    REQUIRE(threads >= 1, "threads must be at least 1");
+}
+
+/**
+ * @brief Loads a scenario and measures how fast Simulation::runStep advances it.
+ *
+ * Phases are timed separately: parsing the XML, building the Simulation,
+ * warming up and the measured steps themselves, which are further broken down
+ * using the simulation's own per-phase counters.
+ *
+ * @param filename Path to the scenario XML file.
+ * @return Result The measurements for this scenario.
+ */
+Benchmark::Result Benchmark::runScenario(const std::string& filename) const {
+    Result result;
+    result.scenario = filename;
+
+    Clock::time_point startupStart = Clock::now();
+
+    std::vector<Road*> roads;
+    std::vector<VehicleGenerator*> generators;
+    std::vector<BusStop*> busStops;
+    std::vector<Intersection*> intersections;
+    Parser::parseFile(filename, roads, generators, busStops, intersections);
+    double parseSeconds = secondsSince(startupStart);
+
+    Clock::time_point setupStart = Clock::now();
+    Simulation sim;
+    sim.addScenario(roads, generators, busStops, intersections);
+    sim.setThreadCount(threads);
+    double setupSeconds = secondsSince(setupStart);
+    result.startupSeconds = secondsSince(startupStart);
+
+    Clock::time_point warmupStart = Clock::now();
+    for (int i = 0; i < warmupSteps && !allRoadsEmpty(sim); i++)
+        sim.runStep();
+    double warmupSeconds = secondsSince(warmupStart);
+    sim.resetStats();
+
+    Clock::time_point runStart = Clock::now();
+    while (result.steps < maxSteps && !allRoadsEmpty(sim)) {
+        result.vehicleUpdates += countVehicles(sim);
+        sim.runStep();
+        result.steps++;
+    }
+    result.runSeconds = secondsSince(runStart);
+    result.counters = sim.getStats();
+
+    if (result.runSeconds > 0) {
+        result.stepsPerSecond = result.steps / result.runSeconds;
+        result.vehicleUpdatesPerSecond = result.vehicleUpdates / result.runSeconds;
+    }
+    result.peakRssKb = peakRssKb();
+    result.phases = {
+        {"parse", parseSeconds},
+        {"setup", setupSeconds},
+        {"warmup", warmupSeconds},
+        {"steps", result.runSeconds},
+    };
+    for (int phase = 0; phase < SimulationStats::PHASE_COUNT; phase++) {
+        auto p = static_cast<SimulationStats::Phase>(phase);
+        result.phases.emplace_back(std::string("steps.") + SimulationStats::phaseName(p),
+                                   result.counters.phaseSeconds[p]);
+    }
+
+    ENSURE(result.steps <= maxSteps, "measured steps must not exceed the budget");
+    return result;
+}
+
+/**
+ * @brief Serializes benchmark results to JSON.
+ *
+ * @param out Output stream.
+ * @param results Results to write.
+ */
+void Benchmark::writeJson(std::ostream& out, const std::vector<Result>& results) {
+    out << std::setprecision(10);
+    out << "{\n  \"scenarios\": [";
+    for (size_t i = 0; i < results.size(); i++) {
+        const Result& r = results[i];
+        out << (i == 0 ? "\n" : ",\n");
+        out << "    {\n"
+            << "      \"name\": \"" << jsonEscape(r.scenario) << "\",\n"
+            << "      \"steps\": " << r.steps << ",\n"
+            << "      \"vehicle_updates\": " << r.vehicleUpdates << ",\n"
+            << "      \"startup_seconds\": " << r.startupSeconds << ",\n"
+            << "      \"run_seconds\": " << r.runSeconds << ",\n"
+            << "      \"steps_per_second\": " << r.stepsPerSecond << ",\n"
+            << "      \"vehicle_updates_per_second\": " << r.vehicleUpdatesPerSecond << ",\n"
+            << "      \"peak_rss_kb\": " << r.peakRssKb << ",\n"
+            << "      \"phases\": {";
+        for (size_t p = 0; p < r.phases.size(); p++) {
+            out << (p == 0 ? "" : ", ")
+                << "\"" << jsonEscape(r.phases[p].first) << "\": " << r.phases[p].second;
+        }
+        const SimulationStats& c = r.counters;
+        out << "},\n"
+            << "      \"counters\": {"
+            << "\"vehicles_spawned\": " << c.vehiclesSpawned
+            << ", \"vehicles_exited\": " << c.vehiclesExited
+            << ", \"vehicles_transferred\": " << c.vehiclesTransferred
+            << ", \"leader_lookups\": " << c.leaderLookups
+            << ", \"light_switches\": " << c.lightSwitches
+            << ", \"spawns_blocked\": " << c.spawnsBlocked
+            << ", \"lane_changes\": " << c.laneChanges
+            << ", \"bus_dwell_seconds\": " << c.busDwellSeconds
+            << "}\n    }";
+    }
+    out << "\n  ]\n}\n";
+}
+
+/**
+ * @brief Extracts the per-scenario steps/s figures from a results file.
+ *
+ * Only the "name" and "steps_per_second" keys are needed, so the file is scanned
+ * for them in order instead of being parsed as general JSON.
+ *
+ * @param filename Path to a file previously written by writeJson().
+ * @return Map from scenario name to steps per second.
+ */
+std::map<std::string, double> Benchmark::readBaseline(const std::string& filename) {
+    std::ifstream file(filename);
+    if (!file) {
+        throw std::runtime_error("Failed to open baseline file: " + filename);
+    }
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    const std::string text = buffer.str();
+
+    std::map<std::string, double> baseline;
+    const std::string nameKey = "\"name\": \"";
+    const std::string rateKey = "\"steps_per_second\": ";
+
+    size_t pos = 0;
+    while ((pos = text.find(nameKey, pos)) != std::string::npos) {
+        pos += nameKey.size();
+        std::string name;
+        while (pos < text.size() && text[pos] != '"') {
+            if (text[pos] == '\\' && pos + 1 < text.size())
+                pos++;
+            name += text[pos++];
+        }
+
+        size_t ratePos = text.find(rateKey, pos);
+        if (ratePos == std::string::npos)
+            break;
+        baseline[name] = std::stod(text.substr(ratePos + rateKey.size()));
+        pos = ratePos;
+    }
+    return baseline;
+}
+
+/**
+ * @brief Checks the results against a baseline and prints one line per scenario.
+ *
+ * @param results Current results.
+ * @param baseline Baseline steps per second per scenario.
+ * @param threshold Allowed relative slowdown (must be non-negative).
+ * @param report Stream for the comparison report.
+ * @return true if all scenarios are within the threshold.
+ */
+bool Benchmark::compareToBaseline(const std::vector<Result>& results,
+                                  const std::map<std::string, double>& baseline,
+                                  double threshold,
+                                  std::ostream& report) {
+    REQUIRE(threshold >= 0, "threshold must be non-negative");
+
+    bool ok = true;
+    for (const Result& r : results) {
+        auto it = baseline.find(r.scenario);
+        if (it == baseline.end() || it->second <= 0) {
+            report << r.scenario << ": no baseline\n";
+            continue;
+        }
+
+        double change = (r.stepsPerSecond - it->second) / it->second;
+        bool regressed = change < -threshold;
+        report << r.scenario << ": " << r.stepsPerSecond << " steps/s vs baseline "
+               << it->second << " (" << std::showpos << std::fixed << std::setprecision(1)
+               << change * 100 << "%" << std::noshowpos << std::defaultfloat << std::setprecision(6)
+               << (regressed ? ", REGRESSION" : "") << ")\n";
+        if (regressed)
+            ok = false;
+    }
+    return ok;
+}
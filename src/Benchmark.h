@@ -0,0 +1,96 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <iosfwd>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+#include "SimulationStats.h"
+
+/**
+ * @class Benchmark
+ * @brief End-to-end macro benchmark driver for whole simulation scenarios.
+ *
+ * Loads a scenario, then drives Simulation::runStep directly (so no console output
+ * is produced or measured) and reports throughput, startup time, peak memory, a
+ * per-phase time breakdown and the simulation counters of the measured steps.
+ * Results can be written as JSON and compared against a previously stored
+ * baseline file.
+ */
+class Benchmark {
+public:
+    /**
+     * @brief Measurements for one benchmarked scenario.
+     */
+    struct Result {
+        std::string scenario;                                ///< Path of the scenario file.
+        int steps = 0;                                       ///< Measured steps (excluding warmup).
+        long long vehicleUpdates = 0;                        ///< Vehicle updates performed during measured steps.
+        double startupSeconds = 0;                           ///< Parsing and setup time.
+        double runSeconds = 0;                               ///< Wall time of the measured steps.
+        double stepsPerSecond = 0;                           ///< steps / runSeconds.
+        double vehicleUpdatesPerSecond = 0;                  ///< vehicleUpdates / runSeconds.
+        long peakRssKb = 0;                                  ///< Peak resident set size of the process (KiB).
+        std::vector<std::pair<std::string, double>> phases; ///< Per-phase wall time in seconds.
+        SimulationStats counters;                            ///< Simulation counters of the measured steps.
+    };
+
+    /**
+     * @brief Creates a benchmark driver.
+     * @param maxSteps Maximum number of measured steps per scenario.
+     * @param warmupSteps Number of unmeasured steps run before measuring.
+     * @param threads Number of threads that update the roads.
+     * @pre maxSteps > 0
+     * @pre warmupSteps >= 0
+     * @pre threads >= 1
+     */
+    Benchmark(int maxSteps, int warmupSteps, int threads = 1);
+
+    /**
+     * @brief Loads and runs one scenario with output disabled.
+     * The run stops after maxSteps measured steps or when all roads are empty.
+     * @param filename Path to the scenario XML file.
+     * @return Result The measurements for this scenario.
+     * @throws std::runtime_error if the scenario cannot be parsed.
+     */
+    Result runScenario(const std::string& filename) const;
+
+    /**
+     * @brief Writes benchmark results as a JSON document.
+     * @param out Stream to write to.
+     * @param results Results to serialize.
+     */
+    static void writeJson(std::ostream& out, const std::vector<Result>& results);
+
+    /**
+     * @brief Reads the steps/s figures from a JSON file written by writeJson().
+     * @param filename Path of the baseline file.
+     * @return Map from scenario name to baseline steps per second.
+     * @throws std::runtime_error if the file cannot be opened.
+     */
+    static std::map<std::string, double> readBaseline(const std::string& filename);
+
+    /**
+     * @brief Compares results with a baseline and reports regressions.
+     * A scenario regresses when its throughput drops more than threshold (a fraction)
+     * below the baseline. Scenarios missing from the baseline are reported but never fail.
+     * @param results Current results.
+     * @param baseline Baseline steps per second per scenario.
+     * @param threshold Allowed relative slowdown, e.g. 0.10 for 10%.
+     * @param report Stream receiving a human readable comparison.
+     * @return true if no scenario regressed past the threshold.
+     * @pre threshold >= 0
+     */
+    static bool compareToBaseline(const std::vector<Result>& results,
+                                  const std::map<std::string, double>& baseline,
+                                  double threshold,
+                                  std::ostream& report);
+
+private:
+    int maxSteps;
+    int warmupSteps;
+    int threads;
+};
+
+#endif // BENCHMARK_H
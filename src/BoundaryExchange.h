@@ -0,0 +1,67 @@
+#ifndef BOUNDARYEXCHANGE_H
+#define BOUNDARYEXCHANGE_H
+
+#include <vector>
+
+class Road;
+class Vehicle;
+
+/**
+ * @class BoundaryExchange
+ * @brief Connects a Simulation that steps only part of the roads to the rest of the network.
+ *
+ * A Simulation with a boundary exchange only updates the roads it owns. Roads
+ * interact across a partition boundary only through successor links, which the
+ * step already handles in two phases: tails are captured before any road moves,
+ * and vehicles that drive off a road are transferred after all roads moved. The
+ * exchange sends and receives exactly that information, so every partition sees
+ * the same inputs as in a single-process run.
+ */
+class BoundaryExchange {
+public:
+    virtual ~BoundaryExchange() = default;
+
+    /**
+     * @brief Checks whether this partition steps a road.
+     * @param road The road.
+     * @return true if the road is owned here.
+     */
+    virtual bool ownsRoad(const Road* road) const = 0;
+
+    /**
+     * @brief Sends the tails of owned roads that foreign roads follow, and installs
+     * the tails of foreign successors of owned roads.
+     * Called after the owned tails were captured and before any road is updated.
+     * @param roads All roads of the simulation, in registration order.
+     */
+    virtual void exchangeTails(const std::vector<Road*>& roads) = 0;
+
+    /**
+     * @brief Hands a vehicle to the partition that owns its next road.
+     * The vehicle keeps its id, lane, speed, destination, route and bus stop
+     * state there. The Simulation deletes the vehicle afterwards.
+     * @param vehicle The vehicle that drove off an owned road.
+     * @param successor Foreign road it continues on.
+     * @param position Its position on the successor.
+     */
+    virtual void sendVehicle(const Vehicle* vehicle, Road* successor, double position) = 0;
+
+    /**
+     * @brief Finishes the step's transfers and receives the vehicles sent by other partitions.
+     * Called after all owned roads transferred their exited vehicles.
+     * @return The received vehicles, already added to their roads and carrying
+     *         their ids, but not registered. The caller takes ownership.
+     */
+    virtual std::vector<Vehicle*> receiveVehicles() = 0;
+
+    /**
+     * @brief Tells every partition which generators spawned a vehicle this step.
+     * A single-process step numbers new vehicles in generator order, so each
+     * partition needs the spawns of the others to give its own ones the same ids.
+     * @param spawned Indices of the owned generators that spawned, ascending.
+     * @return Indices of all generators that spawned, ascending.
+     */
+    virtual std::vector<int> exchangeSpawns(const std::vector<int>& spawned) = 0;
+};
+
+#endif // BOUNDARYEXCHANGE_H
@@ -0,0 +1,78 @@
+#ifndef CLONEMAP_H
+#define CLONEMAP_H
+
+#include "DesignByContract.h"
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+class Road;
+
+/**
+ * @class CloneMap
+ * @brief Maps the entities of a simulation to their copies while it is cloned.
+ *
+ * Simulation::clone() first copies every entity, which leaves the copies
+ * pointing at the originals, and then lets each copy replace its pointers
+ * through this map.
+ */
+class CloneMap {
+public:
+    /**
+     * @brief Records the copy of an entity.
+     * @param original The entity of the source simulation.
+     * @param copy Its copy.
+     */
+    template <class T>
+    void add(const T* original, T* copy) {
+        copies[original] = copy;
+    }
+
+    /**
+     * @brief Returns the copy of an entity.
+     * @param original The entity, or nullptr.
+     * @return Its copy, or nullptr for nullptr.
+     * @pre original is nullptr or was added
+     */
+    template <class T>
+    T* operator()(const T* original) const {
+        if (original == nullptr)
+            return nullptr;
+        auto it = copies.find(original);
+        REQUIRE(it != copies.end(), "Every referenced entity must belong to the cloned simulation");
+        return static_cast<T*>(it->second);
+    }
+
+    /**
+     * @brief Replaces every pointer in a vector by its copy.
+     * @param entities The pointers.
+     */
+    template <class T>
+    void remap(std::vector<T*>& entities) const {
+        for (T*& entity : entities)
+            entity = (*this)(entity);
+    }
+
+    /**
+     * @brief Returns the copy of a route; vehicles that shared a route share its copy.
+     * @param route The route, or nullptr.
+     * @return The copied route.
+     */
+    std::shared_ptr<const std::vector<Road*>> route(const std::shared_ptr<const std::vector<Road*>>& route) const {
+        if (!route)
+            return nullptr;
+        auto it = routes.find(route.get());
+        if (it != routes.end())
+            return it->second;
+        auto copy = std::make_shared<std::vector<Road*>>(*route);
+        remap(*copy);
+        routes[route.get()] = copy;
+        return copy;
+    }
+
+private:
+    std::unordered_map<const void*, void*> copies;
+    mutable std::unordered_map<const void*, std::shared_ptr<const std::vector<Road*>>> routes;
+};
+
+#endif // CLONEMAP_H
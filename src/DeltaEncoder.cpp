@@ -0,0 +1,176 @@
+#include "DeltaEncoder.h"
+#include "DesignByContract.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+template <class T>
+void putLittleEndian(std::vector<std::uint8_t>& out, T value) {
+    for (std::size_t i = 0; i < sizeof(T); i++)
+        out.push_back(static_cast<std::uint8_t>(value >> (8 * i)));
+}
+
+template <class T>
+void putAt(std::vector<std::uint8_t>& out, std::size_t offset, T value) {
+    for (std::size_t i = 0; i < sizeof(T); i++)
+        out[offset + i] = static_cast<std::uint8_t>(value >> (8 * i));
+}
+
+void putFloat(std::vector<std::uint8_t>& out, float value) {
+    std::uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    putLittleEndian(out, bits);
+}
+
+/**
+ * @brief Returns whether a value moved at least one step away from what was sent.
+ */
+bool changed(double sent, float now, double step) {
+    double difference = std::abs(static_cast<double>(now) - sent);
+    return difference > 0 && difference >= step;
+}
+
+} // namespace
+
+/**
+ * @brief Creates an encoder that sends everything in its first message.
+ * @param positionStep Position quantization in metres.
+ * @param speedStep Speed quantization in m/s.
+ * @param extrapolate Whether unsent positions advance at the sent speed.
+ */
+DeltaEncoder::DeltaEncoder(double positionStep, double speedStep, bool extrapolate)
+    : positionStep(positionStep), speedStep(speedStep), extrapolate(extrapolate), full(true), generation(0)
+{
+    REQUIRE(positionStep >= 0 && speedStep >= 0, "Quantization steps must not be negative");
+}
+
+/**
+ * @brief Replaces the subscription and forgets what was sent.
+ * @param roads Road indices, or empty for every road.
+ */
+void DeltaEncoder::subscribe(const std::vector<int>& roads) {
+    subscription = roads;
+    std::sort(subscription.begin(), subscription.end());
+    full = true;
+}
+
+/**
+ * @brief Returns the subscription.
+ * @return Sorted road indices, or empty for every road.
+ */
+const std::vector<int>& DeltaEncoder::getSubscription() const {
+    return subscription;
+}
+
+/**
+ * @brief Writes the changed vehicles, the removals and the toggled lights.
+ *
+ * Vehicles are visited in snapshot order, so the cost is linear in the vehicles
+ * on the subscribed roads plus the vehicles that were sent before.
+ *
+ * @param snapshot The newest snapshot.
+ * @param frame Number written in the header.
+ * @return The message.
+ */
+std::vector<std::uint8_t> DeltaEncoder::encode(const FrameSnapshot& snapshot, std::uint32_t frame) {
+    REQUIRE(snapshot.getRoads().size() <= 0x10000u, "Road numbers must fit in 16 bits");
+
+    bool fullState = full || lights.size() != snapshot.getLights().size();
+    if (fullState) {
+        vehicles.clear();
+        lights.assign(snapshot.getLights().size(), 2);
+        full = false;
+    }
+    generation++;
+
+    std::vector<std::uint8_t> out(HEADER_SIZE);
+    std::uint32_t vehicleCount = 0;
+    double time = snapshot.getTime();
+    const std::vector<FrameSnapshot::RoadEntry>& roads = snapshot.getRoads();
+    const std::vector<std::uint32_t>& lanes = snapshot.getLanes();
+    const std::vector<FrameSnapshot::VehicleEntry>& entries = snapshot.getVehicles();
+    for (std::size_t road = 0; road < roads.size(); road++) {
+        if (!subscribed(road))
+            continue;
+        REQUIRE(roads[road].laneCount <= 0x100u && roads[road].lightCount <= 0x10000u,
+                "Lane and light numbers must fit in 8 and 16 bits");
+        for (std::uint32_t lane = 0; lane < roads[road].laneCount; lane++) {
+            for (std::uint32_t i = lanes[roads[road].firstLane + lane]; i < lanes[roads[road].firstLane + lane + 1]; i++) {
+                const FrameSnapshot::VehicleEntry& vehicle = entries[i];
+                auto it = vehicles.find(vehicle.id);
+                if (it != vehicles.end() && it->second.road == road && it->second.lane == lane) {
+                    const Sent& sent = it->second;
+                    double expected = sent.position;
+                    if (extrapolate)
+                        expected += static_cast<double>(sent.speed) * (time - sent.time);
+                    if (!changed(expected, vehicle.position, positionStep)
+                        && !changed(sent.speed, vehicle.speed, speedStep)) {
+                        it->second.generation = generation;
+                        continue;
+                    }
+                }
+                vehicles[vehicle.id] = Sent{vehicle.position, vehicle.speed, time, static_cast<std::uint16_t>(road),
+                                            static_cast<std::uint8_t>(lane), generation};
+                putLittleEndian(out, vehicle.id);
+                putLittleEndian(out, static_cast<std::uint16_t>(road));
+                putLittleEndian(out, static_cast<std::uint8_t>(lane));
+                putLittleEndian(out, static_cast<std::uint8_t>(vehicle.type));
+                putFloat(out, vehicle.position);
+                putFloat(out, vehicle.speed);
+                vehicleCount++;
+            }
+        }
+    }
+
+    std::uint32_t removalCount = 0;
+    for (auto it = vehicles.begin(); it != vehicles.end(); ) {
+        if (it->second.generation == generation) {
+            ++it;
+            continue;
+        }
+        putLittleEndian(out, it->first);
+        removalCount++;
+        it = vehicles.erase(it);
+    }
+
+    std::uint32_t lightCount = 0;
+    for (std::size_t road = 0; road < roads.size(); road++) {
+        if (!subscribed(road))
+            continue;
+        for (std::uint32_t i = 0; i < roads[road].lightCount; i++) {
+            std::uint8_t green = snapshot.getLights()[roads[road].firstLight + i].green ? 1 : 0;
+            std::uint8_t& sent = lights[roads[road].firstLight + i];
+            if (sent == green)
+                continue;
+            sent = green;
+            putLittleEndian(out, static_cast<std::uint16_t>(road));
+            putLittleEndian(out, static_cast<std::uint16_t>(i));
+            putLittleEndian(out, green);
+            lightCount++;
+        }
+    }
+
+    putAt(out, 0, frame);
+    std::uint64_t timeBits;
+    std::memcpy(&timeBits, &time, sizeof(timeBits));
+    putAt(out, 4, timeBits);
+    out[12] = static_cast<std::uint8_t>((fullState ? 1 : 0) | (extrapolate ? 2 : 0));
+    putAt(out, 13, vehicleCount);
+    putAt(out, 17, removalCount);
+    putAt(out, 21, lightCount);
+
+    ENSURE(out.size() == HEADER_SIZE + vehicleCount * VEHICLE_SIZE + removalCount * REMOVAL_SIZE
+                         + lightCount * LIGHT_SIZE, "Message size must match its counts");
+    return out;
+}
+
+/**
+ * @brief Checks whether a road is subscribed.
+ * @param road Road index.
+ * @return true if the road is encoded.
+ */
+bool DeltaEncoder::subscribed(std::size_t road) const {
+    return subscription.empty() || std::binary_search(subscription.begin(), subscription.end(), static_cast<int>(road));
+}
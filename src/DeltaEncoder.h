@@ -0,0 +1,100 @@
+#ifndef DELTAENCODER_H
+#define DELTAENCODER_H
+
+#include "FrameSnapshot.h"
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @class DeltaEncoder
+ * @brief Encodes the changes between snapshots that one telemetry client has not seen yet.
+ *
+ * The encoder remembers what it last sent for every vehicle and light. A
+ * vehicle is sent again only when it changed road or lane, or its position or
+ * speed moved at least one quantization step away from the sent value; a light
+ * only when it toggled. Vehicles that left the subscribed roads are sent as
+ * removals. Only subscribed roads are encoded, so a client's bandwidth follows
+ * what it watches.
+ *
+ * An extrapolating encoder compares the position with where the vehicle would
+ * be had it kept its sent speed since it was sent, and the decoder moves the
+ * vehicle on the same way. A vehicle that drives at a constant speed, as most
+ * do between lights, then costs nothing until it brakes or accelerates.
+ *
+ * Message layout, little-endian:
+ * - header: u32 frame, f64 time, u8 flags (bit 0: full state, the client drops
+ *   what it had; bit 1: extrapolated), u32 vehicle count, u32 removal count, u32 light count
+ * - vehicle: u32 id, u16 road, u8 lane, u8 type, f32 position, f32 speed
+ * - removal: u32 id
+ * - light: u16 road, u16 light index on the road, u8 green
+ *
+ * Roads are numbered in the order of the snapshot. The fields limit a snapshot
+ * to 65536 roads, 256 lanes per road and 65536 lights per road.
+ */
+class DeltaEncoder {
+public:
+    /** @brief Size of the message header in bytes. */
+    static constexpr std::size_t HEADER_SIZE = 25;
+    /** @brief Size of a vehicle record in bytes. */
+    static constexpr std::size_t VEHICLE_SIZE = 16;
+    /** @brief Size of a removal record in bytes. */
+    static constexpr std::size_t REMOVAL_SIZE = 4;
+    /** @brief Size of a light record in bytes. */
+    static constexpr std::size_t LIGHT_SIZE = 5;
+
+    /**
+     * @brief Creates an encoder subscribed to every road.
+     * @param positionStep Change in position, in metres, that is sent.
+     * @param speedStep Change in speed, in m/s, that is sent.
+     * @param extrapolate Whether positions advance at the sent speed between messages.
+     * @pre positionStep >= 0 && speedStep >= 0
+     */
+    DeltaEncoder(double positionStep = 0.5, double speedStep = 0.5, bool extrapolate = false);
+
+    /**
+     * @brief Restricts the encoded roads; the next message is a full state.
+     * @param roads Indices of the roads in the snapshot; empty subscribes to every road.
+     */
+    void subscribe(const std::vector<int>& roads);
+
+    /**
+     * @brief Returns the subscribed road indices.
+     * @return The indices, or an empty vector for every road.
+     */
+    const std::vector<int>& getSubscription() const;
+
+    /**
+     * @brief Encodes what changed since the last message and remembers it as sent.
+     * @param snapshot The newest snapshot.
+     * @param frame Number of the message.
+     * @return The message.
+     * @pre snapshot.getRoads().size() <= 65536
+     * @pre every road has at most 256 lanes and 65536 lights
+     */
+    std::vector<std::uint8_t> encode(const FrameSnapshot& snapshot, std::uint32_t frame);
+
+private:
+    struct Sent {
+        float position;
+        float speed;
+        double time;                ///< Snapshot time of the sent values.
+        std::uint16_t road;
+        std::uint8_t lane;
+        std::uint32_t generation;   ///< Last encode() in which the vehicle was on a subscribed road.
+    };
+
+    bool subscribed(std::size_t road) const;
+
+    double positionStep;
+    double speedStep;
+    bool extrapolate;
+    std::vector<int> subscription;
+    bool full;
+    std::uint32_t generation;
+    std::unordered_map<std::uint32_t, Sent> vehicles;
+    std::vector<std::uint8_t> lights;   ///< Sent state per light of the snapshot; 2 if not sent.
+};
+
+#endif // DELTAENCODER_H
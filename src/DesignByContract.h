@@ -6,10 +6,109 @@
 // Description : Declarations for design by contract in C++
 //============================================================================
 
-#include <assert.h>
+#ifndef DESIGNBYCONTRACT_H
+#define DESIGNBYCONTRACT_H
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+
+// Contract levels, selected with CONTRACT_LEVEL (see the TRAFFICSIM_CONTRACTS CMake option):
+//   0  off    REQUIRE, ENSURE and CONTRACT_OLD snapshots are not evaluated; their
+//             operands stay referenced, so variables that only feed contracts
+//             do not warn
+//   1  cheap  REQUIRE is always checked; ENSURE, CONTRACT_OLD snapshots and
+//             Simulation invariants only run on audited steps (see contracts::setAuditRate)
+//   2  full   every contract is checked on every step
+#ifndef CONTRACT_LEVEL
+#define CONTRACT_LEVEL 2
+#endif
+
+namespace contracts {
+
+/**
+ * @brief Reports a violated contract and aborts, in the format of assert().
+ */
+[[noreturn]] inline void violation(const char* what, const char* file, int line) {
+    std::fprintf(stderr, "%s:%d: Assertion `%s' failed.\n", file, line, what);
+    std::abort();
+}
+
+/// Fraction of steps audited at level 1, shared by all threads.
+inline std::atomic<double> auditRate{0};
+
+/// Whether the step this thread works on is audited. Per thread, so simulations
+/// running side by side on different threads each audit their own steps.
+inline thread_local bool auditStep = false;
+
+/**
+ * @brief Returns whether postconditions and invariants are checked right now.
+ */
+inline bool auditing() {
+#if CONTRACT_LEVEL >= 2
+    return true;
+#elif CONTRACT_LEVEL == 1
+    return auditStep;
+#else
+    return false;
+#endif
+}
+
+/**
+ * @brief Sets the fraction of steps on which the full contracts run at level 1.
+ * @param fraction Value in [0, 1]; 0 disables auditing, 1 audits every step.
+ */
+inline void setAuditRate(double fraction) {
+    auditRate.store(fraction < 0 ? 0 : (fraction > 1 ? 1 : fraction), std::memory_order_relaxed);
+}
+
+/**
+ * @brief Decides whether the given step is audited.
+ * Audited steps are spread evenly: step n is audited when floor((n + 1) * rate) > floor(n * rate).
+ */
+inline void beginStep(long step) {
+    double rate = auditRate.load(std::memory_order_relaxed);
+    auditStep = static_cast<long>((step + 1) * rate) > static_cast<long>(step * rate);
+}
+
+/**
+ * @brief Gives a worker thread the audit decision of the step it helps with, and
+ * restores the thread's own decision afterwards.
+ */
+class AuditScope {
+public:
+    explicit AuditScope(bool audit) : previous(auditStep) { auditStep = audit; }
+    ~AuditScope() { auditStep = previous; }
+
+    AuditScope(const AuditScope&) = delete;
+    AuditScope& operator=(const AuditScope&) = delete;
+
+private:
+    bool previous;
+};
+
+} // namespace contracts
+
+#if CONTRACT_LEVEL <= 0
+
+// The operands sit behind a constant false, so they are never evaluated but still referenced.
+#define REQUIRE(assertion, what) ((void)(false && (assertion)))
+#define ENSURE(assertion, what) ((void)(false && (assertion)))
+#define CONTRACT_OLD(type, name, expression) \
+        const type name = false ? static_cast<type>(expression) : type()
+
+#else
 
 #define REQUIRE(assertion, what) \
-        if (!(assertion)) __assert (what, __FILE__, __LINE__)
+        do { if (!(assertion)) contracts::violation(what, __FILE__, __LINE__); } while (0)
 
 #define ENSURE(assertion, what) \
-        if (!(assertion)) __assert (what, __FILE__, __LINE__)
\ No newline at end of file
+        do { if (contracts::auditing() && !(assertion)) contracts::violation(what, __FILE__, __LINE__); } while (0)
+
+// Declares a snapshot used only by ENSURE; it is not computed when postconditions are skipped.
+#define CONTRACT_OLD(type, name, expression) \
+        const type name = contracts::auditing() ? static_cast<type>(expression) : type()
+
+#endif
+
+#endif // DESIGNBYCONTRACT_H
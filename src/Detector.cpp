@@ -0,0 +1,165 @@
+#include "Detector.h"
+#include "Road.h"
+#include "Vehicle.h"
+#include "CloneMap.h"
+#include "DesignByContract.h"
+#include <algorithm>
+
+/**
+ * @brief Creates a detector whose first interval starts at time 0.
+ *
+ * @param road The road.
+ * @param position Position on the road.
+ * @param interval Aggregation interval in seconds.
+ * @param name Name used in the output.
+ */
+Detector::Detector(Road* road, double position, double interval, const std::string& name)
+    : road(road), position(position), interval(interval), name(name),
+      stepStart(0), intervalStart(0), crossings(0), inverseSpeeds(0), occupied(0)
+{
+    REQUIRE(road != nullptr, "Detector must be on a road");
+    REQUIRE(position >= 0, "Detector position must be non-negative");
+    REQUIRE(interval > 0, "Detector interval must be positive");
+    REQUIRE(!name.empty(), "Detector must have a name");
+}
+
+/**
+ * @brief Returns the road.
+ * @return Road of the detector.
+ */
+Road* Detector::getRoad() const {
+    return road;
+}
+
+/**
+ * @brief Returns the position.
+ * @return Position on the road.
+ */
+double Detector::getPosition() const {
+    return position;
+}
+
+/**
+ * @brief Returns the aggregation interval.
+ * @return Seconds per interval.
+ */
+double Detector::getInterval() const {
+    return interval;
+}
+
+/**
+ * @brief Returns the name.
+ * @return Name of the detector.
+ */
+const std::string& Detector::getName() const {
+    return name;
+}
+
+/**
+ * @brief Restarts the measurements at a given time.
+ * @param time Current simulation time.
+ */
+void Detector::start(double time) {
+    stepStart = intervalStart = time;
+    crossings = 0;
+    inverseSpeeds = 0;
+    occupied = 0;
+    occupants.clear();
+    intervals.clear();
+    ENSURE(getIntervals().empty(), "A started detector has no intervals");
+}
+
+/**
+ * @brief Detects the front and rear of a vehicle passing the detector.
+ *
+ * The crossing time is interpolated linearly within the step, and the crossing
+ * speed is the distance driven over the step length.
+ *
+ * @param vehicle The vehicle.
+ * @param from Position before the step.
+ * @param to Position after the step.
+ * @param dt Length of the step.
+ */
+void Detector::recordMove(const Vehicle* vehicle, double from, double to, double dt) {
+    REQUIRE(from < to, "A move must go forward");
+
+    if (from < position && position <= to) {
+        crossings++;
+        inverseSpeeds += dt / (to - from);
+        occupants.emplace_back(vehicle, stepStart + dt * (position - from) / (to - from));
+    }
+    double rear = position + vehicle->getLength();
+    if (from < rear && rear <= to)
+        release(vehicle, dt * (rear - from) / (to - from));
+}
+
+/**
+ * @brief Closes the occupation of a vehicle, if it occupied the detector.
+ * @param vehicle The vehicle.
+ * @param offset Time since the start of the step at which the vehicle left.
+ */
+void Detector::release(const Vehicle* vehicle, double offset) {
+    auto it = std::find_if(occupants.begin(), occupants.end(),
+                           [vehicle](const std::pair<const Vehicle*, double>& o) { return o.first == vehicle; });
+    if (it == occupants.end())
+        return;
+    addOccupation(it->second, stepStart + offset);
+    occupants.erase(it);
+}
+
+/**
+ * @brief Closes the open interval if the step ended at or after its nominal end.
+ * @param time Simulation time after the step.
+ * @return Whether an interval was closed.
+ */
+bool Detector::advance(double time) {
+    REQUIRE(time >= stepStart, "Time must not go backwards");
+    stepStart = time;
+    if (time < intervalStart + interval - 1e-9)
+        return false;
+
+    for (const auto& occupant : occupants)
+        addOccupation(occupant.second, time);
+
+    Interval closed;
+    closed.start = intervalStart;
+    closed.end = time;
+    closed.crossings = crossings;
+    closed.flow = crossings * 3600.0 / (time - intervalStart);
+    closed.occupancy = occupied / ((time - intervalStart) * road->getLaneCount());
+    closed.harmonicSpeed = crossings > 0 ? crossings / inverseSpeeds : 0;
+    intervals.push_back(closed);
+
+    intervalStart = time;
+    crossings = 0;
+    inverseSpeeds = 0;
+    occupied = 0;
+    return true;
+}
+
+/**
+ * @brief Returns the closed intervals.
+ * @return Intervals in time order.
+ */
+const std::vector<Detector::Interval>& Detector::getIntervals() const {
+    return intervals;
+}
+
+/**
+ * @brief Replaces the road and occupants of a copied detector by their copies.
+ * @param map Originals to copies.
+ */
+void Detector::rebind(const CloneMap& map) {
+    road = map(road);
+    for (auto& occupant : occupants)
+        occupant.first = map(occupant.first);
+}
+
+/**
+ * @brief Adds the part of an occupation that falls in the open interval.
+ * @param since Time the vehicle arrived.
+ * @param time Time up to which it is counted.
+ */
+void Detector::addOccupation(double since, double time) {
+    occupied += std::max(0.0, time - std::max(since, intervalStart));
+}
@@ -0,0 +1,123 @@
+#ifndef DETECTOR_H
+#define DETECTOR_H
+
+#include <string>
+#include <utility>
+#include <vector>
+
+class Road;
+class Vehicle;
+class CloneMap;
+
+/**
+ * @class Detector
+ * @brief Virtual loop detector across all lanes of a road at one position.
+ *
+ * The road reports every vehicle move that passes the detector with the
+ * positions before and after the step, so the detector only works when a
+ * crossing happens. The crossing time within the step is interpolated from the
+ * positions. A vehicle occupies the detector from the moment its front passes
+ * until its rear passes or it leaves the road.
+ *
+ * Measurements are aggregated per interval. Intervals end on the first step
+ * boundary at or after their nominal length, so every event of a step belongs
+ * to one interval and the recorded start and end times are exact.
+ */
+class Detector {
+public:
+    /**
+     * @brief Aggregate of one closed interval.
+     */
+    struct Interval {
+        double start = 0;          ///< Simulation time at the start.
+        double end = 0;            ///< Simulation time at the end.
+        int crossings = 0;         ///< Vehicles whose front passed the detector.
+        double flow = 0;           ///< Crossings per hour.
+        double occupancy = 0;      ///< Fraction of the time a lane was occupied, averaged over the lanes.
+        double harmonicSpeed = 0;  ///< Harmonic mean crossing speed, or 0 without crossings.
+    };
+
+    /**
+     * @brief Creates a detector on a road.
+     * @param road The road.
+     * @param position Position on the road.
+     * @param interval Aggregation interval in seconds.
+     * @param name Name used in the output.
+     * @pre road != nullptr
+     * @pre position >= 0
+     * @pre interval > 0
+     * @pre !name.empty()
+     */
+    Detector(Road* road, double position, double interval, const std::string& name);
+
+    /** @brief Returns the road of the detector. */
+    Road* getRoad() const;
+
+    /** @brief Returns the position on the road. */
+    double getPosition() const;
+
+    /** @brief Returns the aggregation interval in seconds. */
+    double getInterval() const;
+
+    /** @brief Returns the name of the detector. */
+    const std::string& getName() const;
+
+    /**
+     * @brief Starts the first interval at the given time, discarding any measurements.
+     * @param time Current simulation time.
+     * @post getIntervals().empty()
+     */
+    void start(double time);
+
+    /**
+     * @brief Records the move of a vehicle during the current step.
+     * @param vehicle The vehicle.
+     * @param from Position before the step.
+     * @param to Position after the step.
+     * @param dt Length of the step.
+     * @pre from < to
+     */
+    void recordMove(const Vehicle* vehicle, double from, double to, double dt);
+
+    /**
+     * @brief Ends the occupation of a vehicle that left the road during the current step.
+     * @param vehicle The vehicle.
+     * @param offset Time since the start of the step at which it left.
+     */
+    void release(const Vehicle* vehicle, double offset);
+
+    /**
+     * @brief Moves the detector to the end of a step and closes the interval if it is over.
+     * @param time Simulation time after the step.
+     * @return Whether an interval was closed.
+     */
+    bool advance(double time);
+
+    /** @brief Returns the closed intervals, oldest first. */
+    const std::vector<Interval>& getIntervals() const;
+
+    /**
+     * @brief Points a copied detector at the copies of its road and occupying vehicles.
+     * @param map Originals to copies.
+     */
+    void rebind(const CloneMap& map);
+
+private:
+    /** @brief Adds the occupation of a vehicle up to time to the open interval. */
+    void addOccupation(double since, double time);
+
+    Road* road;
+    double position;
+    double interval;
+    std::string name;
+
+    double stepStart;       ///< Simulation time at the start of the current step.
+    double intervalStart;   ///< Start of the open interval.
+    int crossings;
+    double inverseSpeeds;   ///< Sum of 1 / crossing speed.
+    double occupied;        ///< Vehicle-seconds of occupation in the open interval.
+    std::vector<std::pair<const Vehicle*, double>> occupants;  ///< Vehicles over the detector and when they arrived.
+    std::vector<Interval> intervals;
+};
+
+#endif // DETECTOR_H
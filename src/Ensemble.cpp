@@ -0,0 +1,231 @@
+#include "Ensemble.h"
+#include "Simulation.h"
+#include "Parser.h"
+#include "Road.h"
+#include "Vehicle.h"
+#include "VehicleGenerator.h"
+#include "BusStop.h"
+#include "Intersection.h"
+#include "WorkerPool.h"
+#include "DesignByContract.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <iomanip>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <random>
+#include <unordered_set>
+
+namespace {
+
+void writeEstimate(std::ostream& out, const char* name, const Ensemble::Estimate& estimate, double z) {
+    out << "\"" << name << "\": {"
+        << "\"mean\": " << estimate.stats.getMean()
+        << ", \"stddev\": " << estimate.stats.getStandardDeviation()
+        << ", \"ci_half_width\": " << (estimate.stats.getCount() < 2 ? 0 : estimate.stats.getHalfWidth(z))
+        << ", \"min\": " << estimate.stats.getMin()
+        << ", \"median\": " << estimate.median.getValue()
+        << ", \"p90\": " << estimate.p90.getValue()
+        << ", \"max\": " << estimate.stats.getMax()
+        << "}";
+}
+
+std::string jsonEscape(const std::string& text) {
+    std::string escaped;
+    for (char c : text) {
+        if (c == '"' || c == '\\')
+            escaped += '\\';
+        escaped += c;
+    }
+    return escaped;
+}
+
+} // namespace
+
+/**
+ * @brief Adds one replica's value to all estimators.
+ * @param x The value.
+ */
+void Ensemble::Estimate::add(double x) {
+    stats.add(x);
+    median.add(x);
+    p90.add(x);
+}
+
+/**
+ * @brief Compares the confidence half-width with the mean.
+ * A metric that never varied has half-width 0 and has converged, also at mean 0.
+ *
+ * @param z Normal quantile of the confidence level.
+ * @param relativeTolerance Allowed half-width as a fraction of the mean.
+ * @return Whether the estimate is precise enough.
+ */
+bool Ensemble::Estimate::converged(double z, double relativeTolerance) const {
+    return stats.getHalfWidth(z) <= relativeTolerance * std::fabs(stats.getMean());
+}
+
+/**
+ * @brief Parses the scenario once into the base simulation.
+ *
+ * @param filename Path to the scenario XML file.
+ * @param options Settings of the run.
+ */
+Ensemble::Ensemble(const std::string& filename, const Options& options)
+    : filename(filename), base(std::make_unique<Simulation>()), options(options)
+{
+    REQUIRE(options.steps > 0, "steps must be positive");
+    REQUIRE(options.minReplicas >= 2, "Confidence intervals need at least two replicas");
+    REQUIRE(options.minReplicas <= options.maxReplicas, "minReplicas cannot exceed maxReplicas");
+    REQUIRE(options.threads >= 1, "threads must be at least 1");
+    REQUIRE(options.relativeTolerance >= 0, "relativeTolerance must be non-negative");
+
+    std::vector<Road*> roads;
+    std::vector<VehicleGenerator*> generators;
+    std::vector<BusStop*> busStops;
+    std::vector<Intersection*> intersections;
+    Parser::parseFile(filename, roads, generators, busStops, intersections);
+    base->addScenario(roads, generators, busStops, intersections);
+}
+
+Ensemble::~Ensemble() = default;
+
+/**
+ * @brief Runs replicas on a pool and folds their samples in replica order.
+ *
+ * Workers take the next replica number until the ensemble has converged. Samples
+ * that finish out of order wait until all lower replicas are folded, and
+ * replicas beyond the convergence point are discarded, so the summary is the
+ * same for every thread count.
+ *
+ * @return The summary.
+ */
+Ensemble::Summary Ensemble::run() const {
+    Summary summary;
+    summary.scenario = filename;
+    summary.z = options.z;
+    for (const Road* road : base->getRoads()) {
+        summary.roads.emplace_back();
+        summary.roads.back().road = road->getName();
+    }
+
+    std::atomic<int> next(0);
+    std::mutex mutex;
+    std::map<int, std::vector<RoadSample>> pending;
+    bool done = false;
+
+    auto fold = [&](const std::vector<RoadSample>& samples) {
+        for (std::size_t i = 0; i < samples.size(); i++) {
+            summary.roads[i].throughput.add(samples[i].throughput);
+            summary.roads[i].vehicles.add(samples[i].vehicles);
+            summary.roads[i].speed.add(samples[i].speed);
+        }
+        summary.replicas++;
+        if (summary.replicas < options.minReplicas)
+            return;
+        summary.converged = true;
+        for (const RoadSummary& road : summary.roads) {
+            if (!road.throughput.converged(options.z, options.relativeTolerance) ||
+                !road.vehicles.converged(options.z, options.relativeTolerance) ||
+                !road.speed.converged(options.z, options.relativeTolerance)) {
+                summary.converged = false;
+                break;
+            }
+        }
+        done = summary.converged || summary.replicas == options.maxReplicas;
+    };
+
+    WorkerPool pool(std::min(options.threads, options.maxReplicas));
+    pool.run([&](int) {
+        while (true) {
+            int replica = next++;
+            if (replica >= options.maxReplicas)
+                return;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (done)
+                    return;
+            }
+            std::vector<RoadSample> samples = runReplica(replica);
+
+            std::lock_guard<std::mutex> lock(mutex);
+            pending.emplace(replica, std::move(samples));
+            while (!done && !pending.empty() && pending.begin()->first == summary.replicas) {
+                fold(pending.begin()->second);
+                pending.erase(pending.begin());
+            }
+        }
+    });
+
+    ENSURE(summary.replicas >= options.minReplicas && summary.replicas <= options.maxReplicas,
+           "The ensemble must run between minReplicas and maxReplicas replicas");
+    return summary;
+}
+
+/**
+ * @brief Clones the base simulation, seeds it for the replica and measures every road.
+ *
+ * @param replica Replica number.
+ * @return Metrics of every road.
+ */
+std::vector<Ensemble::RoadSample> Ensemble::runReplica(int replica) const {
+    REQUIRE(replica >= 0, "replica must be non-negative");
+
+    std::unique_ptr<Simulation> sim = base->clone();
+    std::seed_seq sequence{options.seed, static_cast<std::uint32_t>(replica)};
+    std::uint32_t seed;
+    sequence.generate(&seed, &seed + 1);
+    sim->seed(seed);
+
+    const std::vector<Road*>& simRoads = sim->getRoads();
+    std::vector<RoadSample> samples(simRoads.size());
+    std::vector<std::unordered_set<std::uint32_t>> seen(simRoads.size());
+    std::vector<long> vehicleSteps(simRoads.size(), 0);
+    for (int step = 0; step < options.steps; step++) {
+        for (std::size_t i = 0; i < simRoads.size(); i++) {
+            for (const Vehicle* vehicle : simRoads[i]->getVehicles()) {
+                seen[i].insert(vehicle->getId());
+                samples[i].speed += vehicle->getSpeed();
+            }
+            vehicleSteps[i] += static_cast<long>(simRoads[i]->getVehicles().size());
+        }
+        sim->runStep();
+    }
+
+    for (std::size_t i = 0; i < samples.size(); i++) {
+        samples[i].throughput = static_cast<double>(seen[i].size());
+        samples[i].vehicles = static_cast<double>(vehicleSteps[i]) / options.steps;
+        samples[i].speed = vehicleSteps[i] > 0 ? samples[i].speed / vehicleSteps[i] : 0;
+    }
+    ENSURE(samples.size() == base->getRoads().size(), "Every road must have a sample");
+    return samples;
+}
+
+/**
+ * @brief Serializes a summary to JSON.
+ *
+ * @param out Output stream.
+ * @param summary Summary to write.
+ */
+void Ensemble::writeJson(std::ostream& out, const Summary& summary) {
+    const double z = summary.z;
+    out << std::setprecision(10);
+    out << "{\n"
+        << "  \"scenario\": \"" << jsonEscape(summary.scenario) << "\",\n"
+        << "  \"replicas\": " << summary.replicas << ",\n"
+        << "  \"converged\": " << (summary.converged ? "true" : "false") << ",\n"
+        << "  \"roads\": [";
+    for (std::size_t i = 0; i < summary.roads.size(); i++) {
+        const RoadSummary& road = summary.roads[i];
+        out << (i == 0 ? "\n" : ",\n")
+            << "    {\"name\": \"" << jsonEscape(road.road) << "\", ";
+        writeEstimate(out, "throughput", road.throughput, z);
+        out << ", ";
+        writeEstimate(out, "vehicles", road.vehicles, z);
+        out << ", ";
+        writeEstimate(out, "speed", road.speed, z);
+        out << "}";
+    }
+    out << "\n  ]\n}\n";
+}
@@ -0,0 +1,130 @@
+#ifndef ENSEMBLE_H
+#define ENSEMBLE_H
+
+#include "StreamingStats.h"
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+#include <string>
+#include <vector>
+
+class Simulation;
+
+/**
+ * @class Ensemble
+ * @brief Runs many seeded replicas of a scenario and summarizes them per road.
+ *
+ * The scenario file is parsed once into a base simulation; every replica runs
+ * on its own clone of it, because roads and vehicles change while stepping,
+ * and seeds it from the ensemble seed and its replica number.
+ * Replicas run in parallel on a WorkerPool. Their per-road metrics are folded
+ * into streaming estimators in replica order, so the summary depends only on
+ * the options and not on the thread count or timing. The ensemble stops once
+ * every metric's confidence interval is narrow enough, or after maxReplicas.
+ */
+class Ensemble {
+public:
+    /**
+     * @brief Settings of an ensemble run.
+     */
+    struct Options {
+        int steps = 3600;                ///< Steps per replica.
+        int minReplicas = 10;            ///< Replicas before convergence is checked.
+        int maxReplicas = 100;           ///< Upper bound on the replicas.
+        int threads = 1;                 ///< Replicas run at the same time.
+        double relativeTolerance = 0.05; ///< Allowed confidence half-width relative to the mean.
+        double z = 1.96;                 ///< Normal quantile of the confidence level.
+        std::uint32_t seed = 1;          ///< Seed of the whole ensemble.
+    };
+
+    /**
+     * @brief Metrics of one road in one replica.
+     */
+    struct RoadSample {
+        double throughput = 0;   ///< Distinct vehicles that drove on the road.
+        double vehicles = 0;     ///< Time-averaged number of vehicles on the road.
+        double speed = 0;        ///< Average speed over all vehicle steps, or 0 without vehicles.
+    };
+
+    /**
+     * @brief Streaming estimate of one metric over the replicas.
+     */
+    struct Estimate {
+        RunningStats stats;
+        QuantileEstimator median{0.5};
+        QuantileEstimator p90{0.9};
+
+        /** @brief Adds the value of one replica. */
+        void add(double x);
+
+        /** @brief Checks whether the confidence half-width is within tolerance of the mean. */
+        bool converged(double z, double relativeTolerance) const;
+    };
+
+    /**
+     * @brief Estimates of the metrics of one road.
+     */
+    struct RoadSummary {
+        std::string road;
+        Estimate throughput;
+        Estimate vehicles;
+        Estimate speed;
+    };
+
+    /**
+     * @brief Result of an ensemble run.
+     */
+    struct Summary {
+        std::string scenario;            ///< Path of the scenario file.
+        int replicas = 0;                ///< Replicas folded into the estimates.
+        bool converged = false;          ///< Whether the run stopped on convergence.
+        double z = 1.96;                 ///< Normal quantile of the reported confidence intervals.
+        std::vector<RoadSummary> roads;  ///< One entry per road, in scenario order.
+    };
+
+    /**
+     * @brief Parses a scenario into the base simulation of the replicas.
+     * @param filename Path to the scenario XML file.
+     * @param options Settings of the run.
+     * @throws std::runtime_error if the file cannot be read or parsed.
+     * @pre options.steps > 0
+     * @pre 2 <= options.minReplicas <= options.maxReplicas
+     * @pre options.threads >= 1
+     * @pre options.relativeTolerance >= 0
+     */
+    Ensemble(const std::string& filename, const Options& options);
+
+    ~Ensemble();
+
+    Ensemble(const Ensemble&) = delete;
+    Ensemble& operator=(const Ensemble&) = delete;
+
+    /**
+     * @brief Runs replicas until the estimates converge or maxReplicas is reached.
+     * @return The summary.
+     * @post minReplicas <= replicas <= maxReplicas
+     */
+    Summary run() const;
+
+    /**
+     * @brief Runs one replica on the calling thread.
+     * @param replica Replica number; equal numbers give equal samples.
+     * @return Metrics of every road, in scenario order.
+     * @pre replica >= 0
+     */
+    std::vector<RoadSample> runReplica(int replica) const;
+
+    /**
+     * @brief Writes a summary as a JSON document.
+     * @param out Stream to write to.
+     * @param summary Summary to serialize.
+     */
+    static void writeJson(std::ostream& out, const Summary& summary);
+
+private:
+    std::string filename;
+    std::unique_ptr<Simulation> base; ///< Parsed scenario every replica is cloned from; never stepped.
+    Options options;
+};
+
+#endif // ENSEMBLE_H
@@ -0,0 +1,120 @@
+#include "FrameSnapshot.h"
+#include "Road.h"
+#include "Vehicle.h"
+#include "TrafficLight.h"
+#include "DesignByContract.h"
+
+/**
+ * @brief Fills the arrays from the roads, keeping their capacity.
+ * @param roads Roads in layout order.
+ * @param time Simulation time.
+ */
+void FrameSnapshot::capture(const std::vector<Road*>& roads, double time) {
+    capture(roads, time, std::vector<bool>());
+}
+
+/**
+ * @brief Fills the arrays, skipping the vehicles of roads that are not selected.
+ * @param roads Roads in layout order.
+ * @param time Simulation time.
+ * @param selected Per road whether its vehicles are copied, or empty for all.
+ */
+void FrameSnapshot::capture(const std::vector<Road*>& roads, double time, const std::vector<bool>& selected) {
+    REQUIRE(selected.empty() || selected.size() == roads.size(), "Every road must be selected or not");
+
+    this->time = time;
+    this->roads.clear();
+    lanes.clear();
+    vehicles.clear();
+    lights.clear();
+
+    for (std::size_t r = 0; r < roads.size(); r++) {
+        const Road* road = roads[r];
+        bool withVehicles = selected.empty() || selected[r];
+        RoadEntry entry;
+        entry.length = static_cast<float>(road->getLength());
+        entry.firstLane = static_cast<std::uint32_t>(lanes.size());
+        entry.laneCount = static_cast<std::uint32_t>(road->getLaneCount());
+        entry.firstLight = static_cast<std::uint32_t>(lights.size());
+        entry.lightCount = static_cast<std::uint32_t>(road->getTrafficLights().size());
+        this->roads.push_back(entry);
+
+        for (int lane = 0; lane < road->getLaneCount(); lane++) {
+            lanes.push_back(static_cast<std::uint32_t>(vehicles.size()));
+            if (!withVehicles)
+                continue;
+            for (const Vehicle* vehicle : road->getLaneVehicles(lane)) {
+                VehicleEntry v;
+                v.id = vehicle->getId();
+                v.position = static_cast<float>(vehicle->getPosition());
+                v.speed = static_cast<float>(vehicle->getSpeed());
+                v.maxSpeed = static_cast<float>(vehicle->getMaxSpeed());
+                v.length = static_cast<float>(vehicle->getLength());
+                v.type = typeCode(vehicle->getType());
+                vehicles.push_back(v);
+            }
+        }
+        for (const TrafficLight* light : road->getTrafficLights())
+            lights.push_back(LightEntry{static_cast<float>(light->getPosition()), light->isGreen()});
+    }
+    lanes.push_back(static_cast<std::uint32_t>(vehicles.size()));
+
+    ENSURE(this->roads.size() == roads.size(), "Every road must be captured");
+}
+
+/**
+ * @brief Returns the time of the capture.
+ * @return Simulation time in seconds.
+ */
+double FrameSnapshot::getTime() const {
+    return time;
+}
+
+/**
+ * @brief Returns the roads.
+ * @return Road entries in layout order.
+ */
+const std::vector<FrameSnapshot::RoadEntry>& FrameSnapshot::getRoads() const {
+    return roads;
+}
+
+/**
+ * @brief Returns the lane offsets.
+ * @return Start of every lane in getVehicles(), followed by the number of vehicles.
+ */
+const std::vector<std::uint32_t>& FrameSnapshot::getLanes() const {
+    return lanes;
+}
+
+/**
+ * @brief Returns the vehicles.
+ * @return Vehicles ordered by road, lane and position.
+ */
+const std::vector<FrameSnapshot::VehicleEntry>& FrameSnapshot::getVehicles() const {
+    return vehicles;
+}
+
+/**
+ * @brief Returns the lights.
+ * @return Lights ordered by road.
+ */
+const std::vector<FrameSnapshot::LightEntry>& FrameSnapshot::getLights() const {
+    return lights;
+}
+
+/**
+ * @brief Maps a type name to its code.
+ * @param type Vehicle type name.
+ * @return The code.
+ */
+FrameSnapshot::VehicleType FrameSnapshot::typeCode(const std::string& type) {
+    if (type == "bus")
+        return BUS;
+    if (type == "politiecombi")
+        return POLITIECOMBI;
+    if (type == "ziekenwagen")
+        return ZIEKENWAGEN;
+    if (type == "brandweerwagen")
+        return BRANDWEERWAGEN;
+    return AUTO;
+}
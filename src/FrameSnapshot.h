@@ -0,0 +1,111 @@
+#ifndef FRAMESNAPSHOT_H
+#define FRAMESNAPSHOT_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class Road;
+
+/**
+ * @class FrameSnapshot
+ * @brief Compact copy of what is drawn of the simulation at one moment.
+ *
+ * The simulation thread captures the roads into a snapshot and another thread
+ * draws it, so the drawing never touches live vehicles. Everything is kept in
+ * flat arrays: roads in the order given, the lanes of each road, and the
+ * vehicles of each lane in position order. capture() reuses the arrays, so a
+ * snapshot that is captured repeatedly stops allocating.
+ */
+class FrameSnapshot {
+public:
+    /**
+     * @brief Vehicle types, in the order of their colours.
+     */
+    enum VehicleType : std::uint8_t { AUTO, BUS, POLITIECOMBI, ZIEKENWAGEN, BRANDWEERWAGEN };
+
+    /**
+     * @brief One road and where its lanes and lights are stored.
+     */
+    struct RoadEntry {
+        float length = 0;
+        std::uint32_t firstLane = 0;   ///< Index in getLanes() of lane 0.
+        std::uint32_t laneCount = 0;
+        std::uint32_t firstLight = 0;  ///< Index in getLights() of the first light.
+        std::uint32_t lightCount = 0;
+    };
+
+    /**
+     * @brief One vehicle.
+     */
+    struct VehicleEntry {
+        std::uint32_t id = 0;
+        float position = 0;
+        float speed = 0;
+        float maxSpeed = 0;
+        float length = 0;
+        VehicleType type = AUTO;
+    };
+
+    /**
+     * @brief One traffic light.
+     */
+    struct LightEntry {
+        float position = 0;
+        bool green = false;
+    };
+
+    /**
+     * @brief Copies the state of the roads, their vehicles and their lights.
+     * @param roads Roads in layout order.
+     * @param time Simulation time.
+     * @post getRoads().size() == roads.size()
+     */
+    void capture(const std::vector<Road*>& roads, double time);
+
+    /**
+     * @brief Copies the roads and lights, but the vehicles of selected roads only.
+     * The other roads keep their number and get empty lanes.
+     * @param roads Roads in layout order.
+     * @param time Simulation time.
+     * @param selected Whether the vehicles of each road are copied; empty selects every road.
+     * @pre selected is empty or selected.size() == roads.size()
+     * @post getRoads().size() == roads.size()
+     */
+    void capture(const std::vector<Road*>& roads, double time, const std::vector<bool>& selected);
+
+    /** @brief Returns the simulation time of the capture. */
+    double getTime() const;
+
+    /** @brief Returns the captured roads. */
+    const std::vector<RoadEntry>& getRoads() const;
+
+    /**
+     * @brief Returns the vehicle index at which each lane starts.
+     * The vehicles of lane i are [getLanes()[i], getLanes()[i + 1]), so there is
+     * one more entry than there are lanes.
+     */
+    const std::vector<std::uint32_t>& getLanes() const;
+
+    /** @brief Returns the captured vehicles, lane by lane. */
+    const std::vector<VehicleEntry>& getVehicles() const;
+
+    /** @brief Returns the captured lights, road by road. */
+    const std::vector<LightEntry>& getLights() const;
+
+    /**
+     * @brief Returns the type code of a vehicle type name.
+     * @param type Name as returned by Vehicle::getType().
+     * @return The code; unknown names are AUTO.
+     */
+    static VehicleType typeCode(const std::string& type);
+
+private:
+    double time = 0;
+    std::vector<RoadEntry> roads;
+    std::vector<std::uint32_t> lanes;
+    std::vector<VehicleEntry> vehicles;
+    std::vector<LightEntry> lights;
+};
+
+#endif // FRAMESNAPSHOT_H
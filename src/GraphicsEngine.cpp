@@ -1,45 +1,354 @@
 #include "GraphicsEngine.h"
 #include "Road.h"
 #include "Vehicle.h"
-#include "TrafficLight.h"
 #include "DesignByContract.h"
-#include <iostream>
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <fstream>
+#include <stdexcept>
+
+namespace {
+
+const GraphicsEngine::Color BACKGROUND{24, 48, 24};
+const GraphicsEngine::Color ASPHALT{80, 80, 80};
+const GraphicsEngine::Color GREEN{0, 220, 0};
+const GraphicsEngine::Color RED{230, 0, 0};
 
 /**
- * @brief Renders the current simulation frame by printing details about roads, vehicles, and traffic lights.
- *
- * This function outputs to standard console:
- * - Number of roads present.
- * - Each vehicle's type, position (in meters), and speed (m/s).
- * - Each traffic light's position and whether it is green or red.
- *
- * @param roads Vector of pointers to Road objects in the simulation.
- * @param vehicles Vector of pointers to Vehicle objects currently on roads.
- * @param lights Vector of pointers to TrafficLight objects controlling traffic flow.
+ * @brief Returns the CRC-32 of a PNG chunk type and data.
+ */
+std::uint32_t crc32(const std::uint8_t* data, std::size_t size, std::uint32_t crc = 0) {
+    static const std::array<std::uint32_t, 256> table = [] {
+        std::array<std::uint32_t, 256> t{};
+        for (std::uint32_t n = 0; n < 256; n++) {
+            std::uint32_t c = n;
+            for (int k = 0; k < 8; k++)
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            t[n] = c;
+        }
+        return t;
+    }();
+    crc = ~crc;
+    for (std::size_t i = 0; i < size; i++)
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+void putBigEndian(std::vector<std::uint8_t>& out, std::uint32_t value) {
+    for (int shift = 24; shift >= 0; shift -= 8)
+        out.push_back(static_cast<std::uint8_t>(value >> shift));
+}
+
+/**
+ * @brief Appends a PNG chunk with its length and checksum.
+ */
+void putChunk(std::vector<std::uint8_t>& out, const char* type, const std::vector<std::uint8_t>& data) {
+    putBigEndian(out, static_cast<std::uint32_t>(data.size()));
+    std::size_t start = out.size();
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), data.begin(), data.end());
+    putBigEndian(out, crc32(out.data() + start, out.size() - start));
+}
+
+void writeFile(const std::string& filename, const std::vector<std::uint8_t>& bytes) {
+    std::ofstream out(filename, std::ios::binary);
+    if (!out || !out.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()))) {
+        throw std::runtime_error("Failed to write image: " + filename);
+    }
+}
+
+} // namespace
+
+/**
+ * @brief Creates an engine whose viewport maps one metre onto one pixel.
+ * @param width Width of the frame in pixels.
+ * @param height Height of the frame in pixels.
+ */
+GraphicsEngine::GraphicsEngine(int width, int height)
+    : width(width), height(height)
+{
+    REQUIRE(width > 0 && height > 0, "The frame must have pixels");
+    viewport.width = width;
+    viewport.height = height;
+    pixels.assign(static_cast<std::size_t>(width) * height * 3, 0);
+}
+
+/**
+ * @brief Returns the frame width.
+ * @return Width in pixels.
+ */
+int GraphicsEngine::getWidth() const {
+    return width;
+}
+
+/**
+ * @brief Returns the frame height.
+ * @return Height in pixels.
+ */
+int GraphicsEngine::getHeight() const {
+    return height;
+}
+
+/**
+ * @brief Sets the drawn rectangle of the layout.
+ * @param viewport The rectangle, in metres.
+ */
+void GraphicsEngine::setViewport(const Viewport& viewport) {
+    REQUIRE(viewport.width > 0 && viewport.height > 0, "The viewport must not be empty");
+    this->viewport = viewport;
+}
+
+/**
+ * @brief Returns the drawn rectangle of the layout.
+ * @return The viewport.
  */
-void GraphicsEngine::render(const std::vector<Road*>& roads,
-                            const std::vector<Vehicle*>& vehicles,
-                            const std::vector<TrafficLight*>& lights) const {
+const GraphicsEngine::Viewport& GraphicsEngine::getViewport() const {
+    return viewport;
+}
+
+/**
+ * @brief Covers the longest road and all rows, widening one side to the frame's aspect ratio.
+ * @param roads Roads in layout order.
+ */
+void GraphicsEngine::fitViewport(const std::vector<Road*>& roads) {
+    double longest = 1;
+    double rows = ROAD_GAP;
+    for (const Road* road : roads) {
+        longest = std::max(longest, static_cast<double>(road->getLength()));
+        rows += road->getLaneCount() * LANE_WIDTH + ROAD_GAP;
+    }
+    double scale = std::max(longest / width, rows / height);
+    viewport.x = 0;
+    viewport.y = 0;
+    viewport.width = scale * width;
+    viewport.height = scale * height;
+}
+
+/**
+ * @brief Captures the roads and draws the capture.
+ * @param roads Roads in layout order.
+ */
+void GraphicsEngine::render(const std::vector<Road*>& roads) {
     for (const Road* road : roads) {
         REQUIRE(road != nullptr, "roads vector must not contain null pointers");
     }
-    for (const Vehicle* vehicle : vehicles) {
-        REQUIRE(vehicle != nullptr, "vehicles vector must not contain null pointers");
+    scratch.capture(roads, 0);
+    render(scratch);
+}
+
+/**
+ * @brief Rasterizes the visible roads, vehicles and lights of a snapshot.
+ *
+ * Road i starts ROAD_GAP metres below road i - 1 and lane 0 is its top row.
+ * A vehicle covers its length behind its position.
+ *
+ * @param snapshot The captured state.
+ */
+void GraphicsEngine::render(const FrameSnapshot& snapshot) {
+    for (std::size_t i = 0; i < pixels.size(); i += 3) {
+        pixels[i] = BACKGROUND.r;
+        pixels[i + 1] = BACKGROUND.g;
+        pixels[i + 2] = BACKGROUND.b;
     }
-    for (const TrafficLight* light : lights) {
-        REQUIRE(light != nullptr, "lights vector must not contain null pointers");
+    stats = FrameStats();
+
+    const std::vector<FrameSnapshot::VehicleEntry>& vehicles = snapshot.getVehicles();
+    const std::vector<std::uint32_t>& lanes = snapshot.getLanes();
+    const double left = viewport.x;
+    const double right = viewport.x + viewport.width;
+    const double bottom = viewport.y + viewport.height;
+    double top = ROAD_GAP;
+    for (const FrameSnapshot::RoadEntry& road : snapshot.getRoads()) {
+        double rowTop = top;
+        double rowBottom = rowTop + road.laneCount * LANE_WIDTH;
+        top = rowBottom + ROAD_GAP;
+        if (rowTop >= bottom)
+            break;  // rows only move down
+        if (rowBottom <= viewport.y || road.length <= left)
+            continue;
+
+        stats.roads++;
+        fill(0, rowTop, road.length, rowBottom, ASPHALT);
+
+        for (std::uint32_t lane = 0; lane < road.laneCount; lane++) {
+            double laneTop = rowTop + lane * LANE_WIDTH;
+            if (laneTop + LANE_WIDTH <= viewport.y || laneTop >= bottom)
+                continue;
+            auto begin = vehicles.begin() + lanes[road.firstLane + lane];
+            auto end = vehicles.begin() + lanes[road.firstLane + lane + 1];
+            auto first = std::lower_bound(begin, end, left,
+                                          [](const FrameSnapshot::VehicleEntry& v, double x) { return v.position < x; });
+            for (auto it = first; it != end; ++it) {
+                double back = it->position - it->length;
+                if (back >= right)
+                    break;
+                stats.vehicles++;
+                fill(back, laneTop + 0.5, it->position, laneTop + LANE_WIDTH - 0.5, vehicleColor(*it));
+            }
+        }
+
+        for (std::uint32_t i = 0; i < road.lightCount; i++) {
+            const FrameSnapshot::LightEntry& light = snapshot.getLights()[road.firstLight + i];
+            if (light.position + 1 <= left || light.position >= right)
+                continue;
+            stats.lights++;
+            fill(light.position, rowTop, light.position + 1, rowBottom, light.green ? GREEN : RED);
+        }
     }
+}
+
+/**
+ * @brief Returns the pixels of the frame.
+ * @return RGB bytes, row by row.
+ */
+const std::vector<std::uint8_t>& GraphicsEngine::getFramebuffer() const {
+    return pixels;
+}
+
+/**
+ * @brief Returns the colour of a pixel.
+ * @param x Column.
+ * @param y Row.
+ * @return The colour.
+ */
+GraphicsEngine::Color GraphicsEngine::getPixel(int x, int y) const {
+    REQUIRE(x >= 0 && x < width && y >= 0 && y < height, "Pixel must be in the frame");
+    std::size_t i = (static_cast<std::size_t>(y) * width + x) * 3;
+    return Color{pixels[i], pixels[i + 1], pixels[i + 2]};
+}
+
+/**
+ * @brief Returns what the last frame drew.
+ * @return Counts of roads, vehicles and lights.
+ */
+const GraphicsEngine::FrameStats& GraphicsEngine::getFrameStats() const {
+    return stats;
+}
+
+/**
+ * @brief Returns the colour of a live vehicle.
+ * @param vehicle The vehicle.
+ * @return The colour.
+ */
+GraphicsEngine::Color GraphicsEngine::vehicleColor(const Vehicle* vehicle) {
+    FrameSnapshot::VehicleEntry entry;
+    entry.speed = static_cast<float>(vehicle->getSpeed());
+    entry.maxSpeed = static_cast<float>(vehicle->getMaxSpeed());
+    entry.type = FrameSnapshot::typeCode(vehicle->getType());
+    return vehicleColor(entry);
+}
+
+/**
+ * @brief Picks a colour per type and scales it from 40% at standstill to full at maximum speed.
+ * @param vehicle The captured vehicle.
+ * @return The colour.
+ */
+GraphicsEngine::Color GraphicsEngine::vehicleColor(const FrameSnapshot::VehicleEntry& vehicle) {
+    static const Color colors[] = {
+        Color{70, 130, 230},   // auto
+        Color{250, 200, 40},   // bus
+        Color{40, 220, 230},   // politiecombi
+        Color{245, 245, 245},  // ziekenwagen
+        Color{255, 90, 30},    // brandweerwagen
+    };
+    const Color& base = colors[vehicle.type];
+    double brightness = 0.4 + 0.6 * std::min(1.0, static_cast<double>(vehicle.speed / vehicle.maxSpeed));
+    return Color{static_cast<std::uint8_t>(base.r * brightness),
+                 static_cast<std::uint8_t>(base.g * brightness),
+                 static_cast<std::uint8_t>(base.b * brightness)};
+}
 
-    std::cout << "[GraphicsEngine] frame - " << roads.size() << " roads\n";
+/**
+ * @brief Saves the frame in the binary PPM format.
+ * @param filename Path of the image.
+ */
+void GraphicsEngine::writePpm(const std::string& filename) const {
+    std::string header = "P6\n" + std::to_string(width) + " " + std::to_string(height) + "\n255\n";
+    std::vector<std::uint8_t> bytes(header.begin(), header.end());
+    bytes.insert(bytes.end(), pixels.begin(), pixels.end());
+    writeFile(filename, bytes);
+}
 
-    for (const auto& vehicle : vehicles) {
-        std::cout << "Vehicle [" << vehicle->getType() << "] at "
-                  << vehicle->getPosition() << " m, speed: "
-                  << vehicle->getSpeed() << " m/s\n";
+/**
+ * @brief Saves the frame as a PNG with stored (uncompressed) deflate blocks.
+ *
+ * Every row gets filter type 0, so no compression library is needed.
+ *
+ * @param filename Path of the image.
+ */
+void GraphicsEngine::writePng(const std::string& filename) const {
+    std::vector<std::uint8_t> raw;
+    std::size_t stride = static_cast<std::size_t>(width) * 3;
+    raw.reserve((stride + 1) * height);
+    for (int y = 0; y < height; y++) {
+        raw.push_back(0);
+        raw.insert(raw.end(), pixels.begin() + y * stride, pixels.begin() + (y + 1) * stride);
+    }
+
+    std::vector<std::uint8_t> zlib = {0x78, 0x01};
+    for (std::size_t offset = 0; offset < raw.size() || offset == 0; ) {
+        std::size_t size = std::min<std::size_t>(65535, raw.size() - offset);
+        bool last = offset + size == raw.size();
+        zlib.push_back(last ? 1 : 0);
+        zlib.push_back(static_cast<std::uint8_t>(size));
+        zlib.push_back(static_cast<std::uint8_t>(size >> 8));
+        zlib.push_back(static_cast<std::uint8_t>(~size));
+        zlib.push_back(static_cast<std::uint8_t>(~size >> 8));
+        zlib.insert(zlib.end(), raw.begin() + offset, raw.begin() + offset + size);
+        offset += size;
+        if (last)
+            break;
     }
+    std::uint32_t a = 1, b = 0;
+    for (std::uint8_t byte : raw) {
+        a = (a + byte) % 65521;
+        b = (b + a) % 65521;
+    }
+    putBigEndian(zlib, (b << 16) | a);
+
+    std::vector<std::uint8_t> header;
+    putBigEndian(header, static_cast<std::uint32_t>(width));
+    putBigEndian(header, static_cast<std::uint32_t>(height));
+    header.insert(header.end(), {8, 2, 0, 0, 0});  // 8-bit RGB, no interlace
+
+    std::vector<std::uint8_t> png = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    putChunk(png, "IHDR", header);
+    putChunk(png, "IDAT", zlib);
+    putChunk(png, "IEND", {});
+    writeFile(filename, png);
+}
+
+/**
+ * @brief Maps a rectangle of the layout to pixels and fills them.
+ * @param x0 Left edge in metres.
+ * @param y0 Top edge in metres.
+ * @param x1 Right edge in metres.
+ * @param y1 Bottom edge in metres.
+ * @param color Fill colour.
+ */
+void GraphicsEngine::fill(double x0, double y0, double x1, double y1, Color color) {
+    if (x1 <= viewport.x || y1 <= viewport.y
+        || x0 >= viewport.x + viewport.width || y0 >= viewport.y + viewport.height)
+        return;
+
+    double sx = width / viewport.width;
+    double sy = height / viewport.height;
+    int px0 = static_cast<int>(std::floor((x0 - viewport.x) * sx));
+    int py0 = static_cast<int>(std::floor((y0 - viewport.y) * sy));
+    int px1 = std::max(px0 + 1, static_cast<int>(std::ceil((x1 - viewport.x) * sx)));
+    int py1 = std::max(py0 + 1, static_cast<int>(std::ceil((y1 - viewport.y) * sy)));
+    px0 = std::max(px0, 0);
+    py0 = std::max(py0, 0);
+    px1 = std::min(px1, width);
+    py1 = std::min(py1, height);
 
-    for (const auto& light : lights) {
-        std::cout << "TrafficLight at " << light->getPosition()
-                  << " is " << (light->isGreen() ? "Green" : "Red") << "\n";
+    for (int y = py0; y < py1; y++) {
+        std::uint8_t* row = pixels.data() + (static_cast<std::size_t>(y) * width + px0) * 3;
+        for (int x = px0; x < px1; x++) {
+            *row++ = color.r;
+            *row++ = color.g;
+            *row++ = color.b;
+        }
     }
 }
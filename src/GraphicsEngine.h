@@ -1,31 +1,166 @@
 #ifndef GRAPHICSENGINE_H
 #define GRAPHICSENGINE_H
 
+#include "FrameSnapshot.h"
+#include <cstdint>
+#include <string>
 #include <vector>
 
 class Road;
 class Vehicle;
-class TrafficLight;
 
 /**
- * @brief The GraphicsEngine class handles rendering of the simulation's graphical state.
+ * @brief The GraphicsEngine class rasterizes the simulation into an RGB framebuffer.
  *
- * Currently, rendering outputs text information to the console about roads, vehicles, and traffic lights.
+ * Roads have no geometry of their own, so they are laid out as horizontal
+ * strips in the order given: x is the position along the road in metres and
+ * every lane is LANE_WIDTH metres high, with ROAD_GAP metres between roads.
+ * Vehicles are drawn in their lane, coloured by type and brighter the faster
+ * they drive; lights are bars across the road in their current colour.
+ *
+ * The viewport selects the part of this layout that fills the frame. Roads and
+ * lanes outside it are skipped, and since lanes are ordered by position the
+ * visible vehicles of a lane are found by binary search, so the cost of a frame
+ * follows what is visible rather than the size of the network.
+ *
+ * Frames are drawn from a FrameSnapshot, so a renderer on another thread (see
+ * RenderThread) never reads the live simulation.
  */
 class GraphicsEngine {
 public:
+    /** @brief Height of a lane in the layout, in metres. */
+    static constexpr double LANE_WIDTH = 3.5;
+    /** @brief Space between two roads in the layout, in metres. */
+    static constexpr double ROAD_GAP = 3.5;
+
     /**
-     * @brief Renders a simulation frame by displaying roads, vehicles, and traffic light statuses.
-     * @pre All pointers in roads, vehicles, and lights vectors are non-null.
-     * @post Console output has been generated that reflects the simulation state.
-     *
-     * @param roads Vector of pointers to roads in the simulation.
-     * @param vehicles Vector of pointers to vehicles on the roads.
-     * @param lights Vector of pointers to traffic lights controlling the traffic.
-     */
-    void render(const std::vector<Road*>& roads,
-                const std::vector<Vehicle*>& vehicles,
-                const std::vector<TrafficLight*>& lights) const;
+     * @brief Rectangle of the layout, in metres, that is drawn.
+     */
+    struct Viewport {
+        double x = 0;        ///< Left edge.
+        double y = 0;        ///< Top edge.
+        double width = 1;    ///< Width, greater than 0.
+        double height = 1;   ///< Height, greater than 0.
+    };
+
+    /**
+     * @brief A pixel colour.
+     */
+    struct Color {
+        std::uint8_t r = 0;
+        std::uint8_t g = 0;
+        std::uint8_t b = 0;
+        bool operator==(const Color& other) const { return r == other.r && g == other.g && b == other.b; }
+    };
+
+    /**
+     * @brief Number of elements drawn in the last frame.
+     */
+    struct FrameStats {
+        int roads = 0;
+        int vehicles = 0;
+        int lights = 0;
+    };
+
+    /**
+     * @brief Creates an engine with a framebuffer of the given size.
+     * @param width Width in pixels.
+     * @param height Height in pixels.
+     * @pre width > 0 && height > 0
+     * @post the viewport covers width by height metres from the origin
+     */
+    GraphicsEngine(int width = 800, int height = 600);
+
+    /** @brief Returns the width of the frame in pixels. */
+    int getWidth() const;
+
+    /** @brief Returns the height of the frame in pixels. */
+    int getHeight() const;
+
+    /**
+     * @brief Selects the part of the layout that is drawn.
+     * @param viewport The rectangle.
+     * @pre viewport.width > 0 && viewport.height > 0
+     */
+    void setViewport(const Viewport& viewport);
+
+    /** @brief Returns the drawn part of the layout. */
+    const Viewport& getViewport() const;
+
+    /**
+     * @brief Sets the viewport to the whole layout of the roads, keeping pixels square.
+     * @param roads Roads in layout order.
+     */
+    void fitViewport(const std::vector<Road*>& roads);
+
+    /**
+     * @brief Draws one frame of the roads with their vehicles and lights.
+     * The roads are captured into a snapshot first; only call this on the thread
+     * that steps the simulation.
+     * @param roads Roads in layout order.
+     * @pre All pointers in roads are non-null.
+     * @post getFrameStats() counts the drawn elements.
+     */
+    void render(const std::vector<Road*>& roads);
+
+    /**
+     * @brief Draws one frame of a snapshot.
+     * @param snapshot The captured roads, vehicles and lights.
+     * @post getFrameStats() counts the drawn elements.
+     */
+    void render(const FrameSnapshot& snapshot);
+
+    /**
+     * @brief Returns the frame as rows of RGB bytes, top row first.
+     * @return getWidth() * getHeight() * 3 bytes.
+     */
+    const std::vector<std::uint8_t>& getFramebuffer() const;
+
+    /**
+     * @brief Returns the colour of one pixel.
+     * @pre 0 <= x < getWidth() && 0 <= y < getHeight()
+     */
+    Color getPixel(int x, int y) const;
+
+    /** @brief Returns the number of elements drawn by the last render(). */
+    const FrameStats& getFrameStats() const;
+
+    /**
+     * @brief Returns the colour of a vehicle: its type colour, dimmed when it drives slowly.
+     * @param vehicle The vehicle.
+     */
+    static Color vehicleColor(const Vehicle* vehicle);
+
+    /**
+     * @brief Returns the colour of a captured vehicle.
+     * @param vehicle The vehicle.
+     */
+    static Color vehicleColor(const FrameSnapshot::VehicleEntry& vehicle);
+
+    /**
+     * @brief Writes the frame as a binary PPM (P6) image.
+     * @param filename Path of the image.
+     * @throws std::runtime_error if the file cannot be written.
+     */
+    void writePpm(const std::string& filename) const;
+
+    /**
+     * @brief Writes the frame as an uncompressed PNG image.
+     * @param filename Path of the image.
+     * @throws std::runtime_error if the file cannot be written.
+     */
+    void writePng(const std::string& filename) const;
+
+private:
+    /** @brief Fills the pixels covered by a rectangle of the layout; anything visible gets at least one pixel. */
+    void fill(double x0, double y0, double x1, double y1, Color color);
+
+    int width;
+    int height;
+    Viewport viewport;
+    std::vector<std::uint8_t> pixels;
+    FrameStats stats;
+    FrameSnapshot scratch;   ///< Capture of render(roads).
 };
 
 #endif
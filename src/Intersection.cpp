@@ -1,5 +1,8 @@
 #include "Intersection.h"
 #include "DesignByContract.h"
+#include "SimulationStats.h"
+#include "CloneMap.h"
+#include "Journal.h"
 #include <cstdlib>
 #include <ctime>
 #include <cmath>
@@ -7,14 +10,15 @@
 /**
  * @brief Constructs an intersection connecting two distinct roads at specified positions.
  * 
- * Seeds the random number generator the first time an intersection is created.
+ * Seeds the global random number generator the first time an intersection is
+ * created, and seeds the intersection's own generator from it.
  * 
  * @param road1 Pointer to the first road.
  * @param pos1 Position along the first road where the intersection occurs.
  * @param road2 Pointer to the second road.
  * @param pos2 Position along the second road where the intersection occurs.
  */
-Intersection::Intersection(Road* road1, double pos1, Road* road2, double pos2) {
+Intersection::Intersection(Road* road1, double pos1, Road* road2, double pos2) : journal(nullptr) {
     REQUIRE(road1 != nullptr, "road1 must not be null");
     REQUIRE(road2 != nullptr, "road2 must not be null");
     REQUIRE(pos1 >= 0.0, "pos1 must be non-negative");
@@ -24,11 +28,9 @@ Intersection::Intersection(Road* road1, double pos1, Road* road2, double pos2) {
     roads.first = {road1, pos1};
     roads.second = {road2, pos2};
 
-    static bool seeded = false;
-    if (!seeded) {
-        std::srand(static_cast<unsigned int>(std::time(nullptr)));
-        seeded = true;
-    }
+    static const bool seeded = (std::srand(static_cast<unsigned int>(std::time(nullptr))), true);
+    (void)seeded;
+    random.seed(static_cast<std::minstd_rand::result_type>(std::rand()));
 
     ENSURE(roads.first.road == road1, "first road must be properly set");
     ENSURE(roads.first.position == pos1, "first position must be properly set");
@@ -41,6 +43,8 @@ Intersection::Intersection(Road* road1, double pos1, Road* road2, double pos2) {
  * 
  * If the vehicle is within 1.0 unit of the intersection and a random chance (30%) occurs,
  * it is moved to the connected road at the corresponding intersection position.
+ * A vehicle with a destination is moved only if its next road is the exit road.
+ * The random choice is still drawn while a journal replays, but the journal decides.
  * 
  * @param vehicle Pointer to the vehicle being handled.
  */
@@ -48,10 +52,7 @@ void Intersection::handleRoadSwitch(Vehicle* vehicle) {
     REQUIRE(vehicle != nullptr, "vehicle must not be null");
     REQUIRE(vehicle->getRoad() != nullptr, "vehicle must be on a road");
     
-    Road* originalRoad = const_cast<Road*>(vehicle->getRoad());
-    double originalPosition = vehicle->getPosition();
-    
-    REQUIRE(originalPosition >= 0.0, "vehicle position must be non-negative");
+    REQUIRE(vehicle->getPosition() >= 0.0, "vehicle position must be non-negative");
 
     Road* currentRoad = const_cast<Road*>(vehicle->getRoad());
     double vehiclePos = vehicle->getPosition();
@@ -60,11 +61,21 @@ void Intersection::handleRoadSwitch(Vehicle* vehicle) {
     auto& exit = roads.second;
 
     if (currentRoad == entry.road && std::abs(vehiclePos - entry.position) < 1.0) {
-        if ((std::rand() % 100) < 30) {
+        bool routed = vehicle->getDestination() != nullptr;
+        bool switches;
+        if (routed) {
+            switches = vehicle->getNextRoad() == exit.road;
+        } else {
+            switches = (random() % 100) < 30;
+            if (journal != nullptr)
+                switches = journal->turn(switches);
+        }
+        if (switches) {
             entry.road->removeVehicle(vehicle);
-            exit.road->addVehicle(vehicle);
             vehicle->setRoad(exit.road);
             vehicle->setPosition(exit.position);
+            exit.road->addVehicle(vehicle);  // after setPosition, so it lands at the right place in its lane
+            SimulationStats::current().vehiclesTransferred++;
             
             ENSURE(vehicle->getRoad() == exit.road, "vehicle must be on the exit road after switch");
             ENSURE(vehicle->getPosition() == exit.position, "vehicle position must be set to exit position");
@@ -74,3 +85,61 @@ void Intersection::handleRoadSwitch(Vehicle* vehicle) {
     ENSURE(vehicle != nullptr, "vehicle must still be valid after handling");
     ENSURE(vehicle->getRoad() != nullptr, "vehicle must still be on a road after handling");
 }
+
+/**
+ * @brief Returns the entry road.
+ * @return Road vehicles switch from.
+ */
+const Road* Intersection::getEntryRoad() const {
+    return roads.first.road;
+}
+
+/**
+ * @brief Returns the entry position.
+ * @return Position on the entry road.
+ */
+double Intersection::getEntryPosition() const {
+    return roads.first.position;
+}
+
+/**
+ * @brief Returns the exit road.
+ * @return Road vehicles switch to.
+ */
+const Road* Intersection::getExitRoad() const {
+    return roads.second.road;
+}
+
+/**
+ * @brief Returns the exit position.
+ * @return Position on the exit road.
+ */
+double Intersection::getExitPosition() const {
+    return roads.second.position;
+}
+
+/**
+ * @brief Restarts the random generator of the intersection.
+ * @param value The seed; minstd_rand maps 0 to a valid state itself.
+ */
+void Intersection::seed(std::uint32_t value) {
+    random.seed(value);
+}
+
+/**
+ * @brief Sets the journal of the switch choices.
+ * @param journal The journal, or nullptr.
+ */
+void Intersection::setJournal(Journal* journal) {
+    this->journal = journal;
+}
+
+/**
+ * @brief Replaces the roads of a copied intersection by their copies and drops its journal.
+ * @param map Originals to copies.
+ */
+void Intersection::rebind(const CloneMap& map) {
+    roads.first.road = map(roads.first.road);
+    roads.second.road = map(roads.second.road);
+    journal = nullptr;
+}
@@ -3,6 +3,11 @@
 
 #include "Road.h"
 #include "Vehicle.h"
+#include <cstdint>
+#include <random>
+
+class CloneMap;
+class Journal;
 
 /**
  * @class Intersection
@@ -10,6 +15,10 @@
  * 
  * Each intersection links two distinct roads at specific positions. When a vehicle approaches
  * the intersection, there is a probability that it will switch to the connected road.
+ * Vehicles with a destination switch exactly when their route continues on the other road.
+ * Each intersection draws from its own random generator, so the choices do not
+ * depend on the order or the thread in which roads are updated. With a journal
+ * set, every draw is recorded into it or replayed from it.
  */
 class Intersection {
 public:
@@ -43,6 +52,38 @@ public:
      */
     void handleRoadSwitch(Vehicle* vehicle);
 
+    /** @brief Returns the road vehicles switch from. */
+    const Road* getEntryRoad() const;
+
+    /** @brief Returns the position of the intersection on the entry road. */
+    double getEntryPosition() const;
+
+    /** @brief Returns the road vehicles switch to. */
+    const Road* getExitRoad() const;
+
+    /** @brief Returns the position of the intersection on the exit road. */
+    double getExitPosition() const;
+
+    /**
+     * @brief Restarts the intersection's random generator from a seed.
+     * Intersections seeded alike make the same switch choices.
+     * @param value The seed.
+     */
+    void seed(std::uint32_t value);
+
+    /**
+     * @brief Passes the unrouted switch choices through a journal.
+     * Set by Simulation::setJournal(); copies of the intersection do not keep it.
+     * @param journal The journal, or nullptr.
+     */
+    void setJournal(Journal* journal);
+
+    /**
+     * @brief Points a copied intersection at the copies of its roads.
+     * @param map Originals to copies.
+     */
+    void rebind(const CloneMap& map);
+
 private:
     /**
      * @brief Helper struct representing a road and a position on that road.
@@ -53,6 +94,8 @@ private:
     };
 
     std::pair<RoadConnection, RoadConnection> roads; ///< Pair of connected roads with positions.
+    std::minstd_rand random;                         ///< Source of the unrouted switch choices.
+    Journal* journal;                                ///< Records or replays the choices, or nullptr.
 };
 
 #endif
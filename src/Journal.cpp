@@ -0,0 +1,368 @@
+#include "Journal.h"
+#include "Simulation.h"
+#include "DesignByContract.h"
+#include <algorithm>
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+const char MAGIC[4] = {'T', 'S', 'J', '1'};
+
+/**
+ * @brief Returns the header fields that tie a journal to a scenario and a step.
+ */
+std::vector<std::uint64_t> headerOf(const Simulation& simulation) {
+    return {simulation.getRoads().size(), simulation.getIntersections().size(), simulation.getGenerators().size(),
+            simulation.getVehicles().size(), static_cast<std::uint64_t>(simulation.getStepCount())};
+}
+
+} // namespace
+
+/**
+ * @brief Creates a recording journal.
+ * @param out Stream the records are written to.
+ */
+Journal::Journal(std::ostream& out)
+    : out(&out), in(nullptr), pendingSteps(0), step(0), decisions(0), started(false), finished(false),
+      loaded(false), truncated(false), next(END), nextValue(0)
+{
+}
+
+/**
+ * @brief Creates a replaying journal.
+ * @param in Stream the records are read from.
+ */
+Journal::Journal(std::istream& in)
+    : out(nullptr), in(&in), pendingSteps(0), step(0), decisions(0), started(false), finished(false),
+      loaded(false), truncated(false), next(END), nextValue(0)
+{
+}
+
+/**
+ * @brief Writes the end of a recording that was not finished yet.
+ */
+Journal::~Journal() {
+    finish();
+}
+
+/**
+ * @brief Returns whether the journal reads its records.
+ * @return true when replaying.
+ */
+bool Journal::isReplaying() const {
+    return in != nullptr;
+}
+
+/**
+ * @brief Writes the header, or reads it and compares it with the simulation.
+ * @param simulation The simulation the journal is set on.
+ */
+void Journal::begin(const Simulation& simulation) {
+    REQUIRE(!started, "A journal can only begin once");
+    started = true;
+
+    std::vector<std::uint64_t> header = headerOf(simulation);
+    if (out != nullptr) {
+        out->write(MAGIC, sizeof(MAGIC));
+        for (std::uint64_t value : header)
+            writeVarint(value);
+        return;
+    }
+
+    char magic[sizeof(MAGIC)];
+    if (!in->read(magic, sizeof(magic)) || !std::equal(magic, magic + sizeof(magic), MAGIC)) {
+        throw std::runtime_error("Not a simulation journal");
+    }
+    for (std::size_t i = 0; i < header.size(); i++) {
+        std::uint64_t value;
+        if (!readVarint(value)) {
+            throw std::runtime_error("Journal header is incomplete");
+        }
+        if (value != header[i] && i + 1 == header.size()) {
+            throw std::runtime_error("Journal was recorded from step " + std::to_string(value) + ", not from step "
+                                     + std::to_string(header[i]));
+        }
+        if (value != header[i]) {
+            throw std::runtime_error("Journal was recorded on another scenario");
+        }
+    }
+}
+
+/**
+ * @brief Records a draw, or replaces it by the recorded one.
+ * @param drawn The intersection's own outcome.
+ * @return The outcome to use.
+ */
+bool Journal::turn(bool drawn) {
+    if (out != nullptr) {
+        writeKind(drawn ? TURN_YES : TURN_NO);
+        decisions++;
+        return drawn;
+    }
+    if (cutOff())
+        return drawn;
+    if (take(TURN_YES))
+        return true;
+    if (take(TURN_NO))
+        return false;
+    diverged("a turning draw");
+}
+
+/**
+ * @brief Records a spawn, or checks that the journal has the same one.
+ * @param generator Index of the generator.
+ */
+void Journal::spawn(int generator) {
+    REQUIRE(generator >= 0, "The generator index must not be negative");
+
+    if (out != nullptr) {
+        writeKind(SPAWN);
+        writeVarint(static_cast<std::uint64_t>(generator));
+        decisions++;
+        return;
+    }
+    if (cutOff())
+        return;
+    load();
+    if (pendingSteps != 0 || next != SPAWN || nextValue != static_cast<std::uint64_t>(generator))
+        diverged("a spawn of generator " + std::to_string(generator));
+    take(SPAWN);
+}
+
+/**
+ * @brief Records a command with its length.
+ * @param command The command text.
+ */
+void Journal::command(const std::string& command) {
+    REQUIRE(!isReplaying(), "Only a recording journal takes commands");
+
+    writeKind(COMMAND);
+    writeVarint(command.size());
+    out->write(command.data(), static_cast<std::streamsize>(command.size()));
+    decisions++;
+}
+
+/**
+ * @brief Takes the next command if the journal has one in this step.
+ * @param command Receives the command text.
+ * @return true if a command was taken.
+ */
+bool Journal::nextCommand(std::string& command) {
+    REQUIRE(isReplaying(), "Only a replaying journal gives commands");
+
+    load();
+    if (pendingSteps != 0 || next != COMMAND)
+        return false;
+    command = nextText;
+    return take(COMMAND);
+}
+
+/**
+ * @brief Counts a recorded step, or consumes one from the journal.
+ *
+ * A recording is flushed after the first quiet step that follows decisions, so
+ * a crashed run leaves a journal that holds its decisions.
+ */
+void Journal::endStep() {
+    if (out != nullptr) {
+        REQUIRE(started && !finished, "Only a running recording can end steps");
+        pendingSteps++;
+        step++;
+        if (pendingSteps == 1)
+            out->flush();
+        return;
+    }
+    if (cutOff()) {
+        step++;
+        return;
+    }
+    load();
+    if (pendingSteps == 0) {
+        if (next == END) {
+            throw std::runtime_error("Journal ends before step " + std::to_string(step + 1));
+        }
+        diverged("the end of the step");
+    }
+    pendingSteps--;
+    step++;
+}
+
+/**
+ * @brief Checks whether every recorded step was replayed.
+ * @return true at the end of the journal.
+ */
+bool Journal::atEnd() {
+    REQUIRE(isReplaying(), "Only a replaying journal can end");
+
+    load();
+    return pendingSteps == 0 && next == END;
+}
+
+/**
+ * @brief Closes a recording with its last step count and the end record.
+ */
+void Journal::finish() {
+    if (out == nullptr || !started || finished)
+        return;
+    flushSteps();
+    out->put(static_cast<char>(END));
+    out->flush();
+    finished = true;
+}
+
+/**
+ * @brief Returns the decision count.
+ * @return Draws, spawns and commands so far.
+ */
+std::uint64_t Journal::getDecisions() const {
+    return decisions;
+}
+
+/**
+ * @brief Writes the steps that ended without decisions as one record.
+ */
+void Journal::flushSteps() {
+    if (pendingSteps == 0)
+        return;
+    out->put(static_cast<char>(STEPS));
+    writeVarint(pendingSteps);
+    pendingSteps = 0;
+}
+
+/**
+ * @brief Starts a record in the current step.
+ * @param kind Kind of the record.
+ */
+void Journal::writeKind(Kind kind) {
+    REQUIRE(started && !finished, "Only a running recording takes records");
+
+    flushSteps();
+    out->put(static_cast<char>(kind));
+}
+
+/**
+ * @brief Writes 7 bits per byte, setting the high bit on all but the last byte.
+ * @param value The value.
+ */
+void Journal::writeVarint(std::uint64_t value) {
+    while (value >= 0x80) {
+        out->put(static_cast<char>((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+    out->put(static_cast<char>(value));
+}
+
+/**
+ * @brief Reads records until a decision or the end, so the step records in between are counted.
+ *
+ * A record cut off by the end of the stream counts as the end, so a journal
+ * whose recording crashed replays the steps it holds completely.
+ */
+void Journal::load() {
+    REQUIRE(started, "The journal must begin before it is read");
+
+    while (!loaded) {
+        int byte = in->get();
+        if (byte == std::char_traits<char>::eof()) {
+            next = END;
+            loaded = true;
+            truncated = true;
+            break;
+        }
+        std::uint64_t value = 0;
+        switch (byte) {
+            case STEPS:
+                if (readVarint(value)) {
+                    pendingSteps += value;
+                } else {
+                    next = END;
+                    loaded = true;
+                    truncated = true;
+                }
+                break;
+            case END:
+            case TURN_NO:
+            case TURN_YES:
+                next = static_cast<Kind>(byte);
+                loaded = true;
+                break;
+            case SPAWN:
+                next = readVarint(nextValue) ? SPAWN : END;
+                truncated = next == END;
+                loaded = true;
+                break;
+            case COMMAND:
+                next = END;
+                if (readVarint(value)) {
+                    nextText.assign(value, '\0');
+                    if (in->read(&nextText[0], static_cast<std::streamsize>(value)))
+                        next = COMMAND;
+                }
+                truncated = next == END;
+                loaded = true;
+                break;
+            default:
+                throw std::runtime_error("Invalid journal record " + std::to_string(byte) + " after step "
+                                         + std::to_string(step));
+        }
+    }
+}
+
+/**
+ * @brief Reads 7 bits per byte until a byte without the high bit.
+ * @param value Receives the value.
+ * @return false if the stream ends within the varint.
+ */
+bool Journal::readVarint(std::uint64_t& value) {
+    value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        int byte = in->get();
+        if (byte == std::char_traits<char>::eof())
+            return false;
+        value |= static_cast<std::uint64_t>(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0)
+            return true;
+    }
+    throw std::runtime_error("Journal varint is too long");
+}
+
+/**
+ * @brief Checks whether a cut-off journal ran out within the current step.
+ * The rest of that step then runs on its own draws, so it can end.
+ * @return true if no record of the step is left.
+ */
+bool Journal::cutOff() {
+    load();
+    return truncated && pendingSteps == 0 && next == END;
+}
+
+/**
+ * @brief Consumes the loaded decision when it is of the kind and due in this step.
+ * @param kind Expected kind.
+ * @return true if it was consumed.
+ */
+bool Journal::take(Kind kind) {
+    load();
+    if (pendingSteps != 0 || next != kind)
+        return false;
+    loaded = false;
+    decisions++;
+    return true;
+}
+
+/**
+ * @brief Reports where and how the run left the journal.
+ * @param expected What the run did.
+ */
+void Journal::diverged(const std::string& expected) const {
+    static const char* const KINDS[] = {"the end", "", "a draw without a switch", "a draw with a switch", "a spawn",
+                                        "a command"};
+    std::string found = pendingSteps != 0 ? "the end of the step" : KINDS[next];
+    if (pendingSteps == 0 && next == SPAWN)
+        found += " of generator " + std::to_string(nextValue);
+    throw std::runtime_error("Replay diverged from the journal in step " + std::to_string(step + 1) + ": the run made "
+                             + expected + " where the journal has " + found);
+}
@@ -0,0 +1,156 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+
+class Simulation;
+
+/**
+ * @class Journal
+ * @brief Binary log of the decisions that make a run unrepeatable, for replaying it exactly.
+ *
+ * While recording, the simulation writes every random turning draw of an
+ * intersection, every vehicle a generator spawns and every external command
+ * (Simulation::execute()) in the order they happen. While replaying, the draws
+ * and commands come from the journal instead, and spawns are checked against
+ * it, so the run repeats bit for bit whatever the intersections were seeded
+ * with. A journal only replays on the scenario it was recorded on, from the
+ * same step; the header checks this.
+ *
+ * Layout: "TSJ1", then varints of the road, intersection, generator and vehicle
+ * counts and the step count, then records of one kind byte each:
+ * - 1 steps: varint count of steps that ended since the previous record
+ * - 2 / 3: a turning draw that did not / did switch the vehicle
+ * - 4 spawn: varint generator index
+ * - 5 command: varint length and the command text
+ * - 0 end
+ * Unsigned varints use 7 bits per byte, low bits first. A recording is
+ * flushed after every step with decisions; a journal cut off without its end
+ * record replays up to its last complete record, and the step that record is
+ * in is finished with the simulation's own draws.
+ */
+class Journal {
+public:
+    /**
+     * @brief Starts a journal that records into a stream.
+     * @param out Binary stream; must outlive the journal.
+     */
+    explicit Journal(std::ostream& out);
+
+    /**
+     * @brief Starts a journal that replays from a stream.
+     * @param in Binary stream; must outlive the journal.
+     */
+    explicit Journal(std::istream& in);
+
+    /** @brief Finishes a recording; see finish(). */
+    ~Journal();
+
+    Journal(const Journal&) = delete;
+    Journal& operator=(const Journal&) = delete;
+
+    /** @brief Returns whether the journal replays rather than records. */
+    bool isReplaying() const;
+
+    /**
+     * @brief Writes or checks the header for a simulation; called by Simulation::setJournal().
+     * @param simulation The simulation the journal is set on.
+     * @pre begin() was not called yet
+     * @throws std::runtime_error if a replayed journal was recorded on another scenario or step.
+     */
+    void begin(const Simulation& simulation);
+
+    /**
+     * @brief Passes a turning draw through the journal.
+     * @param drawn Outcome of the intersection's own draw.
+     * @return drawn while recording, the recorded outcome while replaying.
+     * @throws std::runtime_error if the replayed journal has no draw here.
+     */
+    bool turn(bool drawn);
+
+    /**
+     * @brief Records or checks a spawn.
+     * @param generator Index of the generator in Simulation::getGenerators().
+     * @throws std::runtime_error if the replayed journal has no spawn of that generator here.
+     */
+    void spawn(int generator);
+
+    /**
+     * @brief Records an external command.
+     * @param command The command text.
+     * @pre !isReplaying()
+     */
+    void command(const std::string& command);
+
+    /**
+     * @brief Reads the next replayed command of the current step, if any.
+     * @param command Receives the command text.
+     * @return true if a command was read.
+     * @pre isReplaying()
+     */
+    bool nextCommand(std::string& command);
+
+    /**
+     * @brief Marks the end of a step.
+     * @throws std::runtime_error if the replayed journal still has decisions in this step.
+     */
+    void endStep();
+
+    /**
+     * @brief Returns whether a replayed journal has no steps left.
+     * @pre isReplaying()
+     */
+    bool atEnd();
+
+    /**
+     * @brief Writes the pending step count and the end record and flushes; later calls do nothing.
+     */
+    void finish();
+
+    /** @brief Returns the number of draws, spawns and commands written or read. */
+    std::uint64_t getDecisions() const;
+
+private:
+    enum Kind : std::uint8_t { END = 0, STEPS = 1, TURN_NO = 2, TURN_YES = 3, SPAWN = 4, COMMAND = 5 };
+
+    /** @brief Writes the count of steps ended since the last record, if any. */
+    void flushSteps();
+
+    /** @brief Writes a kind byte after the pending steps. */
+    void writeKind(Kind kind);
+
+    /** @brief Writes an unsigned varint. */
+    void writeVarint(std::uint64_t value);
+
+    /** @brief Reads the next decision with its payload, adding the step records before it to pendingSteps. */
+    void load();
+
+    /** @brief Reads a varint; false if the stream ends first. */
+    bool readVarint(std::uint64_t& value);
+
+    /** @brief Checks whether a cut-off journal has no records left for the current step. */
+    bool cutOff();
+
+    /** @brief Takes the loaded decision if it belongs to the current step and has the kind. */
+    bool take(Kind kind);
+
+    /** @brief Throws the error for a replayed journal that does not match the run. */
+    [[noreturn]] void diverged(const std::string& expected) const;
+
+    std::ostream* out;
+    std::istream* in;
+    std::uint64_t pendingSteps;   ///< Recording: steps not written yet; replaying: steps before the loaded decision.
+    std::uint64_t step;           ///< Steps ended since begin().
+    std::uint64_t decisions;
+    bool started;
+    bool finished;
+    bool loaded;                  ///< Replaying: whether next holds the upcoming decision.
+    bool truncated;               ///< Replaying: whether the stream ended without an end record.
+    Kind next;
+    std::uint64_t nextValue;      ///< Generator index of a loaded spawn.
+    std::string nextText;         ///< Text of a loaded command.
+};
+
+#endif // JOURNAL_H
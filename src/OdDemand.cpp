@@ -0,0 +1,197 @@
+#include "OdDemand.h"
+#include "Road.h"
+#include "Vehicle.h"
+#include "RouteCache.h"
+#include "DesignByContract.h"
+#include "SimulationStats.h"
+#include <algorithm>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_set>
+
+namespace {
+
+/// Free distance a new vehicle needs at the start of its origin road.
+const double ENTRY_CLEARANCE = 8.0;
+
+std::string trim(const std::string& text) {
+    size_t first = text.find_first_not_of(" \t\r");
+    if (first == std::string::npos)
+        return "";
+    size_t last = text.find_last_not_of(" \t\r");
+    return text.substr(first, last - first + 1);
+}
+
+} // namespace
+
+/**
+ * @brief Opens the demand file.
+ *
+ * Scans the whole file once to sum the trips per origin-destination pair, which
+ * only needs memory per pair, and then reopens it for streaming.
+ *
+ * @param filename Path to the CSV file.
+ * @param roads Roads referred to by name.
+ * @param heavyPairCount Number of heaviest pairs to keep.
+ */
+OdDemand::OdDemand(const std::string& filename, const std::vector<Road*>& roads, std::size_t heavyPairCount)
+    : filename(filename), roads(roads), lineNumber(0), hasPending(false)
+{
+    std::ifstream scan(filename);
+    if (!scan) {
+        throw std::runtime_error("Failed to open demand file: " + filename);
+    }
+    std::map<std::pair<const Road*, const Road*>, long> trips;
+    Row row;
+    while (readRow(scan, row))
+        trips[{row.origin, row.destination}] += row.count;
+
+    std::vector<std::pair<long, std::pair<const Road*, const Road*>>> byWeight;
+    for (const auto& trip : trips)
+        byWeight.emplace_back(trip.second, trip.first);
+    std::size_t keep = std::min(heavyPairCount, byWeight.size());
+    std::partial_sort(byWeight.begin(), byWeight.begin() + keep, byWeight.end(),
+                      [](const auto& a, const auto& b) { return a.first > b.first; });
+    for (std::size_t i = 0; i < keep; i++)
+        heaviestPairs.push_back(byWeight[i].second);
+
+    lineNumber = 0;
+    stream.open(filename);
+    if (!stream) {
+        throw std::runtime_error("Failed to open demand file: " + filename);
+    }
+    hasPending = readRow(stream, pending);
+
+    ENSURE(heaviestPairs.size() <= heavyPairCount, "At most heavyPairCount pairs are kept");
+}
+
+/**
+ * @brief Starts the rows that have begun and departs the vehicles that are due.
+ *
+ * @param currentTime Current simulation time.
+ * @param routes Route cache.
+ * @return The new vehicles.
+ */
+std::vector<Vehicle*> OdDemand::update(double currentTime, RouteCache& routes) {
+    REQUIRE(currentTime >= 0, "currentTime must be non-negative");
+
+    while (hasPending && pending.start <= currentTime) {
+        active.push_back(pending);
+        hasPending = readRow(stream, pending);
+    }
+
+    SimulationStats& counters = SimulationStats::current();
+    std::vector<Vehicle*> spawned;
+    std::unordered_set<const Road*> usedOrigins;
+    for (Row& row : active) {
+        if (row.spawned < row.count && nextDeparture(row) <= currentTime) {
+            // A vehicle that just entered stands at position 0 and does not block
+            // the entry yet, so each origin road gets at most one vehicle per step
+            bool originUsed = usedOrigins.count(row.origin) != 0;
+            int lane = originUsed ? -1 : row.origin->findFreeEntryLane(ENTRY_CLEARANCE);
+            if (lane < 0) {
+                counters.spawnsBlocked++;
+                continue;
+            }
+
+            Vehicle* vehicle = Vehicle::create(row.type, row.origin, 0);
+            vehicle->setLane(lane);
+            if (auto route = routes.get(row.origin, row.destination, nextDeparture(row)))
+                vehicle->setRoute(route);
+            else
+                vehicle->setDestination(row.destination);
+            row.origin->addVehicle(vehicle);
+            spawned.push_back(vehicle);
+            usedOrigins.insert(row.origin);
+            row.spawned++;
+            counters.vehiclesSpawned++;
+        }
+    }
+    active.erase(std::remove_if(active.begin(), active.end(),
+                                [](const Row& row) { return row.spawned >= row.count; }),
+                 active.end());
+    return spawned;
+}
+
+/**
+ * @brief Returns the heaviest pairs found when the file was opened.
+ * @return Pairs, heaviest first.
+ */
+const std::vector<std::pair<const Road*, const Road*>>& OdDemand::getHeaviestPairs() const {
+    return heaviestPairs;
+}
+
+/**
+ * @brief Checks whether all demand has departed.
+ * @return true when nothing is left to spawn.
+ */
+bool OdDemand::isFinished() const {
+    return !hasPending && active.empty();
+}
+
+/**
+ * @brief Parses one CSV row, skipping blank lines and comments.
+ *
+ * @param in Stream to read from.
+ * @param row Row to fill.
+ * @return false at the end of the stream.
+ */
+bool OdDemand::readRow(std::istream& in, Row& row) {
+    std::string line;
+    while (std::getline(in, line)) {
+        lineNumber++;
+        line = trim(line);
+        if (line.empty() || line[0] == '#')
+            continue;
+
+        std::vector<std::string> fields;
+        std::stringstream fieldStream(line);
+        std::string field;
+        while (std::getline(fieldStream, field, ','))
+            fields.push_back(trim(field));
+
+        std::string where = filename + ":" + std::to_string(lineNumber);
+        if (fields.size() < 5 || fields.size() > 6) {
+            throw std::runtime_error("Demand row must have 5 or 6 fields: " + where);
+        }
+
+        Row next;
+        try {
+            next.start = std::stod(fields[0]);
+            next.end = std::stod(fields[1]);
+            next.count = std::stol(fields[4]);
+        } catch (const std::exception&) {
+            throw std::runtime_error("Invalid number in demand row: " + where);
+        }
+        next.origin = fields[2].empty() ? nullptr : Road::getRoadByName(fields[2], roads);
+        next.destination = fields[3].empty() ? nullptr : Road::getRoadByName(fields[3], roads);
+        next.type = fields.size() == 6 ? fields[5] : "auto";
+
+        if (!next.origin || !next.destination) {
+            throw std::runtime_error("Demand row refers to unknown road: " + where);
+        }
+        if (next.start < 0 || next.end < next.start || next.count < 0) {
+            throw std::runtime_error("Invalid demand interval or count: " + where);
+        }
+        if (row.origin != nullptr && next.start < row.start) {
+            throw std::runtime_error("Demand rows must be ordered by start time: " + where);
+        }
+        if (!Vehicle::isKnownType(next.type)) {
+            throw std::runtime_error("Invalid vehicle type in demand row: " + where);
+        }
+
+        row = next;
+        return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Departure time of the next vehicle, spreading the count evenly over the interval.
+ * @param row The demand row.
+ * @return Time in seconds.
+ */
+double OdDemand::nextDeparture(const Row& row) {
+    return row.start + (row.end - row.start) * row.spawned / row.count;
+}
@@ -0,0 +1,96 @@
+#ifndef ODDEMAND_H
+#define ODDEMAND_H
+
+#include <cstddef>
+#include <fstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+class Road;
+class Vehicle;
+class RouteCache;
+
+/**
+ * @class OdDemand
+ * @brief Spawns vehicles from an origin-destination demand file.
+ *
+ * The file is a CSV with one demand row per line:
+ *
+ *     start,einde,herkomst,bestemming,aantal[,type]
+ *
+ * meaning that aantal vehicles of the given type (default "auto") drive from road
+ * herkomst to road bestemming, departing evenly spread over [start, einde) seconds.
+ * Empty lines and lines starting with '#' are skipped, and rows must be ordered by
+ * start time. The file is streamed: a row is only read once the simulation reaches
+ * its start time, so demand files may be much larger than memory.
+ *
+ * Spawned vehicles get their route from a RouteCache.
+ */
+class OdDemand {
+public:
+    /**
+     * @brief Opens a demand file and finds its heaviest origin-destination pairs.
+     * @param filename Path to the CSV file.
+     * @param roads Roads that herkomst and bestemming refer to by name.
+     * @param heavyPairCount Number of heaviest pairs to remember for precomputation.
+     * @throws std::runtime_error If the file cannot be read or a row is invalid.
+     */
+    OdDemand(const std::string& filename, const std::vector<Road*>& roads, std::size_t heavyPairCount = 64);
+
+    /**
+     * @brief Spawns the vehicles whose departure time has come.
+     *
+     * A vehicle that cannot enter its origin road because the entry is occupied
+     * waits and departs on a later step.
+     *
+     * @param currentTime Current simulation time in seconds.
+     * @param routes Cache that supplies the routes.
+     * @return The new vehicles, already added to their origin roads. The caller takes ownership.
+     * @throws std::runtime_error If a row read from the file is invalid.
+     */
+    std::vector<Vehicle*> update(double currentTime, RouteCache& routes);
+
+    /**
+     * @brief Returns the origin-destination pairs with the most trips, heaviest first.
+     * @return Up to heavyPairCount pairs.
+     */
+    const std::vector<std::pair<const Road*, const Road*>>& getHeaviestPairs() const;
+
+    /** @brief Returns whether every row has been read and every vehicle has departed. */
+    bool isFinished() const;
+
+private:
+    /**
+     * @brief One demand row being spawned.
+     */
+    struct Row {
+        double start = 0;
+        double end = 0;
+        Road* origin = nullptr;
+        Road* destination = nullptr;
+        long count = 0;
+        long spawned = 0;
+        std::string type;
+    };
+
+    /**
+     * @brief Reads the next row from a stream.
+     * @return false at the end of the stream.
+     */
+    bool readRow(std::istream& in, Row& row);
+
+    /** @brief Returns the departure time of the next vehicle of a row. */
+    static double nextDeparture(const Row& row);
+
+    std::string filename;
+    std::vector<Road*> roads;
+    std::ifstream stream;
+    int lineNumber;
+    bool hasPending;
+    Row pending;              ///< Next row, read ahead but not started yet.
+    std::vector<Row> active;  ///< Rows with vehicles left to depart.
+    std::vector<std::pair<const Road*, const Road*>> heaviestPairs;
+};
+
+#endif // ODDEMAND_H
@@ -0,0 +1,249 @@
+#include "ParameterSweep.h"
+#include "Simulation.h"
+#include "Road.h"
+#include "Vehicle.h"
+#include "TrafficLight.h"
+#include "VehicleGenerator.h"
+#include "WorkerPool.h"
+#include "DesignByContract.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <numeric>
+#include <ostream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+
+const std::string CYCLE = "cyclus:";
+const std::string FREQUENCY = "frequentie:";
+
+bool startsWith(const std::string& text, const std::string& prefix) {
+    return text.compare(0, prefix.size(), prefix) == 0;
+}
+
+/**
+ * @brief Rounds a cycle or frequency to whole seconds of at least one.
+ */
+int wholeSeconds(double value) {
+    return std::max(1, static_cast<int>(std::lround(value)));
+}
+
+} // namespace
+
+/**
+ * @brief Checks every parameter against the base simulation.
+ *
+ * @param base Simulation the points are cloned from.
+ * @param parameters Swept parameters.
+ */
+ParameterSweep::ParameterSweep(const Simulation& base, std::vector<SweepParameter> parameters)
+    : base(base), parameters(std::move(parameters))
+{
+    for (const SweepParameter& parameter : this->parameters) {
+        if (parameter.levels < 1 || parameter.maximum < parameter.minimum) {
+            throw std::runtime_error("Invalid range for sweep parameter " + parameter.name);
+        }
+        if (parameter.name == "dt") {
+            if (parameter.minimum <= 0)
+                throw std::runtime_error("Sweep parameter dt must be positive");
+        } else if (startsWith(parameter.name, CYCLE)) {
+            const Road* road = Road::getRoadByName(parameter.name.substr(CYCLE.size()), base.getRoads());
+            if (road == nullptr || road->getTrafficLights().empty())
+                throw std::runtime_error("Sweep parameter " + parameter.name + " names no road with traffic lights");
+        } else if (startsWith(parameter.name, FREQUENCY)) {
+            std::string name = parameter.name.substr(FREQUENCY.size());
+            const auto& generators = base.getGenerators();
+            if (std::none_of(generators.begin(), generators.end(),
+                             [&name](const VehicleGenerator* g) { return g->getRoad()->getName() == name; }))
+                throw std::runtime_error("Sweep parameter " + parameter.name + " names no road with a generator");
+        } else {
+            throw std::runtime_error("Unknown sweep parameter " + parameter.name);
+        }
+    }
+}
+
+/**
+ * @brief Returns the swept parameters.
+ * @return Parameters in design order.
+ */
+const std::vector<SweepParameter>& ParameterSweep::getParameters() const {
+    return parameters;
+}
+
+/**
+ * @brief Enumerates every combination of levels like an odometer.
+ * @return The points.
+ */
+std::vector<std::vector<double>> ParameterSweep::cartesian() const {
+    std::vector<std::vector<double>> points;
+    std::vector<int> level(parameters.size(), 0);
+    while (true) {
+        std::vector<double> point;
+        for (std::size_t i = 0; i < parameters.size(); i++) {
+            const SweepParameter& p = parameters[i];
+            double fraction = p.levels > 1 ? static_cast<double>(level[i]) / (p.levels - 1) : 0;
+            point.push_back(p.minimum + fraction * (p.maximum - p.minimum));
+        }
+        points.push_back(point);
+
+        int i = static_cast<int>(parameters.size()) - 1;
+        while (i >= 0 && ++level[i] == parameters[i].levels)
+            level[i--] = 0;
+        if (i < 0)
+            break;
+    }
+    return points;
+}
+
+/**
+ * @brief Draws one random value per stratum and shuffles the strata per parameter.
+ * @param samples Number of points.
+ * @param seed Seed of the draw.
+ * @return The points.
+ */
+std::vector<std::vector<double>> ParameterSweep::latinHypercube(int samples, std::uint32_t seed) const {
+    REQUIRE(samples > 0, "A design needs at least one point");
+
+    std::mt19937 random(seed);
+    std::uniform_real_distribution<double> offset(0, 1);
+    std::vector<std::vector<double>> points(samples, std::vector<double>(parameters.size()));
+    std::vector<int> strata(samples);
+    for (std::size_t i = 0; i < parameters.size(); i++) {
+        std::iota(strata.begin(), strata.end(), 0);
+        std::shuffle(strata.begin(), strata.end(), random);
+        const SweepParameter& p = parameters[i];
+        for (int s = 0; s < samples; s++)
+            points[s][i] = p.minimum + (strata[s] + offset(random)) / samples * (p.maximum - p.minimum);
+    }
+
+    ENSURE(static_cast<int>(points.size()) == samples, "The design must have the requested points");
+    return points;
+}
+
+/**
+ * @brief Writes the values of a point into the lights, generators and step length of a simulation.
+ * @param simulation Simulation to change.
+ * @param point Parameter values.
+ */
+void ParameterSweep::apply(Simulation& simulation, const std::vector<double>& point) const {
+    REQUIRE(point.size() == parameters.size(), "A point needs a value for every parameter");
+
+    for (std::size_t i = 0; i < parameters.size(); i++) {
+        const std::string& name = parameters[i].name;
+        if (name == "dt") {
+            simulation.setTimeStep(point[i]);
+        } else if (startsWith(name, CYCLE)) {
+            Road* road = Road::getRoadByName(name.substr(CYCLE.size()), simulation.getRoads());
+            for (TrafficLight* light : road->getTrafficLights())
+                light->setCycle(wholeSeconds(point[i]));
+        } else {
+            for (VehicleGenerator* generator : simulation.getGenerators()) {
+                if (generator->getRoad()->getName() == name.substr(FREQUENCY.size()))
+                    generator->setFrequency(wholeSeconds(point[i]));
+            }
+        }
+    }
+}
+
+/**
+ * @brief Runs the points on a pool; each worker takes the next unstarted point.
+ *
+ * @param points Points of the design.
+ * @param seconds Simulated time per point.
+ * @param threads Number of workers.
+ * @return The results, in point order.
+ */
+std::vector<ParameterSweep::Result> ParameterSweep::run(const std::vector<std::vector<double>>& points,
+                                                        double seconds, int threads) const {
+    REQUIRE(seconds > 0, "A sweep must simulate a positive duration");
+    REQUIRE(threads >= 1, "threads must be at least 1");
+
+    std::vector<Result> results(points.size());
+    std::atomic<std::size_t> next(0);
+    WorkerPool pool(std::max(1, std::min(threads, static_cast<int>(points.size()))));
+    pool.run([&](int) {
+        for (std::size_t index = next++; index < points.size(); index = next++) {
+            std::unique_ptr<Simulation> sim = base.clone();
+            apply(*sim, points[index]);
+
+            Result& result = results[index];
+            result.values = points[index];
+            result.steps = static_cast<int>(std::ceil(seconds / sim->getTimeStep() - 1e-9));
+            long long vehicleSteps = 0;
+            double speedSum = 0;
+            for (int step = 0; step < result.steps; step++) {
+                for (const Road* road : sim->getRoads()) {
+                    for (const Vehicle* vehicle : road->getVehicles())
+                        speedSum += vehicle->getSpeed();
+                    vehicleSteps += static_cast<long long>(road->getVehicles().size());
+                }
+                sim->runStep();
+            }
+            result.meanVehicles = static_cast<double>(vehicleSteps) / result.steps;
+            result.meanSpeed = vehicleSteps > 0 ? speedSum / vehicleSteps : 0;
+            result.counters = sim->getStats();
+        }
+    });
+
+    ENSURE(results.size() == points.size(), "Every point must have a result");
+    return results;
+}
+
+/**
+ * @brief Parses a sweep file.
+ * @param filename Path of the file.
+ * @return The parameters.
+ */
+std::vector<SweepParameter> ParameterSweep::load(const std::string& filename) {
+    std::ifstream in(filename);
+    if (!in) {
+        throw std::runtime_error("Failed to open sweep file: " + filename);
+    }
+
+    std::vector<SweepParameter> parameters;
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(in, line)) {
+        lineNumber++;
+        if (line.empty() || line[0] == '#')
+            continue;
+
+        std::istringstream fields(line);
+        SweepParameter parameter;
+        if (!(fields >> parameter.name >> parameter.minimum >> parameter.maximum)) {
+            throw std::runtime_error("Sweep line must read 'name minimum maximum [levels]': "
+                                     + filename + ":" + std::to_string(lineNumber));
+        }
+        if (!(fields >> parameter.levels))
+            parameter.levels = 1;
+        parameters.push_back(parameter);
+    }
+    return parameters;
+}
+
+/**
+ * @brief Serializes sweep results to CSV.
+ *
+ * @param out Output stream.
+ * @param parameters Swept parameters.
+ * @param results Results to write.
+ */
+void ParameterSweep::writeCsv(std::ostream& out, const std::vector<SweepParameter>& parameters,
+                              const std::vector<Result>& results) {
+    for (const SweepParameter& parameter : parameters)
+        out << parameter.name << ",";
+    out << "stappen,gem_voertuigen,gem_snelheid,gegenereerd,verlaten,geblokkeerd\n";
+    out << std::setprecision(10);
+    for (const Result& result : results) {
+        for (double value : result.values)
+            out << value << ",";
+        out << result.steps << "," << result.meanVehicles << "," << result.meanSpeed << ","
+            << result.counters.vehiclesSpawned << "," << result.counters.vehiclesExited << ","
+            << result.counters.spawnsBlocked << "\n";
+    }
+}
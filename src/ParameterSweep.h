@@ -0,0 +1,121 @@
+#ifndef PARAMETERSWEEP_H
+#define PARAMETERSWEEP_H
+
+#include "SimulationStats.h"
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+class Simulation;
+
+/**
+ * @brief Range of one swept parameter.
+ */
+struct SweepParameter {
+    std::string name;    ///< "dt", "cyclus:<road>" or "frequentie:<road>".
+    double minimum = 0;  ///< Lowest value.
+    double maximum = 0;  ///< Highest value.
+    int levels = 1;      ///< Evenly spaced values in a Cartesian design.
+};
+
+/**
+ * @class ParameterSweep
+ * @brief Runs a scenario for many parameter combinations in one process.
+ *
+ * A parameter is the step length of the simulation ("dt"), the cycle of every
+ * light on a road ("cyclus:<road>") or the frequency of every generator on a
+ * road ("frequentie:<road>"). Cycles and frequencies are whole seconds, so
+ * their values are rounded when applied. The design is either the Cartesian
+ * product of each parameter's levels or a Latin hypercube sample of the ranges.
+ *
+ * Every point starts from a clone of the loaded base simulation, so the
+ * scenario is parsed once. Points run concurrently on a WorkerPool and each
+ * writes only its own result, so the results do not depend on the thread count.
+ */
+class ParameterSweep {
+public:
+    /**
+     * @brief Measurements of one point of the design.
+     */
+    struct Result {
+        std::vector<double> values;   ///< Parameter values, in parameter order.
+        int steps = 0;                ///< Steps run.
+        double meanVehicles = 0;      ///< Time-averaged number of vehicles on the roads.
+        double meanSpeed = 0;         ///< Average speed over all vehicle steps.
+        SimulationStats counters;     ///< Counters of the run.
+    };
+
+    /**
+     * @brief Prepares a sweep of a loaded simulation.
+     * @param base Simulation every point is cloned from; must not be stepped during run().
+     * @param parameters Swept parameters.
+     * @throws std::runtime_error if a parameter is unknown, names a road without
+     *         lights or generators, or has an invalid range.
+     */
+    ParameterSweep(const Simulation& base, std::vector<SweepParameter> parameters);
+
+    /** @brief Returns the swept parameters. */
+    const std::vector<SweepParameter>& getParameters() const;
+
+    /**
+     * @brief Expands the Cartesian design; the last parameter varies fastest.
+     * @return One point per combination of levels.
+     */
+    std::vector<std::vector<double>> cartesian() const;
+
+    /**
+     * @brief Draws a Latin hypercube design.
+     * Each parameter's range is cut into samples equal strata and every stratum
+     * is used by exactly one point.
+     * @param samples Number of points.
+     * @param seed Seed of the draw.
+     * @return The points.
+     * @pre samples > 0
+     */
+    std::vector<std::vector<double>> latinHypercube(int samples, std::uint32_t seed) const;
+
+    /**
+     * @brief Sets the parameters of a simulation to the values of one point.
+     * @param simulation Simulation to change.
+     * @param point Parameter values.
+     * @pre point.size() == getParameters().size()
+     */
+    void apply(Simulation& simulation, const std::vector<double>& point) const;
+
+    /**
+     * @brief Runs every point for the same simulated duration.
+     * @param points Points of the design.
+     * @param seconds Simulated time per point; the number of steps follows from its dt.
+     * @param threads Points run at the same time.
+     * @return One result per point, in the order of points.
+     * @pre seconds > 0
+     * @pre threads >= 1
+     */
+    std::vector<Result> run(const std::vector<std::vector<double>>& points, double seconds, int threads) const;
+
+    /**
+     * @brief Reads parameters from a sweep file.
+     * Every line other than blank lines and # comments reads
+     * "name minimum maximum [levels]", separated by whitespace.
+     * @param filename Path of the sweep file.
+     * @return The parameters.
+     * @throws std::runtime_error if the file cannot be opened or a line is invalid.
+     */
+    static std::vector<SweepParameter> load(const std::string& filename);
+
+    /**
+     * @brief Writes results as CSV with one column per parameter and metric.
+     * @param out Stream to write to.
+     * @param parameters Swept parameters.
+     * @param results Results of run().
+     */
+    static void writeCsv(std::ostream& out, const std::vector<SweepParameter>& parameters,
+                         const std::vector<Result>& results);
+
+private:
+    const Simulation& base;
+    std::vector<SweepParameter> parameters;
+};
+
+#endif // PARAMETERSWEEP_H
@@ -2,36 +2,26 @@
 #include <fstream>
 #include <sstream>
 #include <algorithm>
+#include <utility>
 #include "Parser.h"
 #include "Road.h"
 #include "Vehicle.h"
 #include "TrafficLight.h"
+#include "Detector.h"
 #include "VehicleGenerator.h"
 #include "BusStop.h"
 #include "Intersection.h"
 #include "../tinyxml/tinyxml.h"
 
 /**
- * @brief Parses the XML input file and constructs simulation elements.
- * 
- * The XML file should contain tags describing roads, vehicles, bus stops,
- * intersections, traffic lights, and vehicle generators. The method parses
- * the file and fills the given vectors with pointers to created objects.
- * 
- * Supported tags:
- * - BAAN (road)
- * - VOERTUIG (vehicle)
- * - BUSHALTE (bus stop)
- * - KRUISPUNT (intersection)
- * - VERKEERSLICHT (traffic light)
- * - VOERTUIGGENERATOR (vehicle generator)
- * 
+ * @brief Reads a scenario file and parses its contents with parseString().
+ *
  * @param filename Path to the XML file to parse.
  * @param roads Vector to append pointers to Road objects.
  * @param generators Vector to append pointers to VehicleGenerator objects.
  * @param busStops Vector to append pointers to BusStop objects.
  * @param intersections Vector to append pointers to Intersection objects.
- * 
+ *
  * @throws std::runtime_error On file I/O or XML parsing failure,
  *         or when encountering inconsistent or invalid data.
  */
@@ -46,14 +36,51 @@ void Parser::parseFile(const std::string& filename,
         throw std::runtime_error("Failed to open XML file: " + filename);
     }
 
-    // Wrap file contents with a root tag to ensure well-formed XML
-    std::stringstream buffer;
-    buffer << "<ROOT>";
-    buffer << file.rdbuf();
-    buffer << "</ROOT>";
+    std::stringstream contents;
+    contents << file.rdbuf();
+    parseString(contents.str(), roads, generators, busStops, intersections);
+}
+
+/**
+ * @brief Parses scenario XML held in memory and constructs simulation elements.
+ * 
+ * The XML text should contain tags describing roads, vehicles, bus stops,
+ * intersections, traffic lights, and vehicle generators. The method parses
+ * the text and fills the given vectors with pointers to created objects.
+ * 
+ * Supported tags:
+ * - BAAN (road), with an optional number of lanes (rijstroken) and any number of
+ *   successor roads (volgende), which may be declared later in the file
+ * - VOERTUIG (vehicle), with an optional lane index (rijstrook) and destination road (bestemming)
+ * - BUSHALTE (bus stop)
+ * - KRUISPUNT (intersection)
+ * - VERKEERSLICHT (traffic light), actuated if it has a minimum and maximum green
+ *   time (mingroen, maxgroen) and optionally a gap time (hiaat) and detection zone
+ *   length (detectiezone); the cycle (cyclus) is then its red time
+ * - VOERTUIGGENERATOR (vehicle generator), with an optional destination road (bestemming)
+ * - DETECTOR (loop detector), with a road (baan), position (positie), aggregation
+ *   interval in seconds (interval) and an optional name (naam)
+ * 
+ * @param xml Contents of a scenario file.
+ * @param roads Vector to append pointers to Road objects.
+ * @param generators Vector to append pointers to VehicleGenerator objects.
+ * @param busStops Vector to append pointers to BusStop objects.
+ * @param intersections Vector to append pointers to Intersection objects.
+ * 
+ * @throws std::runtime_error On XML parsing failure,
+ *         or when encountering inconsistent or invalid data.
+ */
+void Parser::parseString(const std::string& xml,
+                         std::vector<Road*>& roads,
+                         std::vector<VehicleGenerator*>& generators,
+                         std::vector<BusStop*>& busStops,
+                         std::vector<Intersection*>& intersections)
+{
+    // Wrap the contents with a root tag to ensure well-formed XML
+    std::string buffer = "<ROOT>" + xml + "</ROOT>";
 
     TiXmlDocument doc;
-    doc.Parse(buffer.str().c_str());
+    doc.Parse(buffer.c_str());
 
     if (doc.Error()) {
         throw std::runtime_error("Failed to parse XML: " + std::string(doc.ErrorDesc()));
@@ -64,6 +91,11 @@ void Parser::parseFile(const std::string& filename,
         throw std::runtime_error("No root elements found in XML file.");
     }
 
+    // Successor links and destinations are resolved once every road is known
+    std::vector<std::pair<Road*, std::string>> successors;
+    std::vector<std::pair<Vehicle*, std::string>> vehicleDestinations;
+    std::vector<std::pair<VehicleGenerator*, std::string>> generatorDestinations;
+
     while (elem) {
         std::string tag = elem->Value();
 
@@ -73,7 +105,18 @@ void Parser::parseFile(const std::string& filename,
             if (nameElement && lengthElement) {
                 std::string name = nameElement->GetText();
                 int length = std::stoi(lengthElement->GetText());
-                roads.push_back(new Road(name, length));
+                int lanes = 1;
+                if (TiXmlElement* lanesElement = elem->FirstChildElement("rijstroken")) {
+                    lanes = std::stoi(lanesElement->GetText());
+                    if (lanes < 1) {
+                        throw std::runtime_error("Road must have at least one lane: " + name);
+                    }
+                }
+                roads.push_back(new Road(name, length, lanes));
+                for (TiXmlElement* next = elem->FirstChildElement("volgende"); next;
+                     next = next->NextSiblingElement("volgende")) {
+                    successors.emplace_back(roads.back(), next->GetText() ? next->GetText() : "");
+                }
             }
         }
         else if (tag == "VOERTUIG") {
@@ -102,20 +145,24 @@ void Parser::parseFile(const std::string& filename,
                     throw std::runtime_error("Vehicle position exceeds road length: " + std::to_string(pos));
                 }
 
+                int lane = 0;
+                if (TiXmlElement* laneElement = elem->FirstChildElement("rijstrook")) {
+                    lane = std::stoi(laneElement->GetText());
+                    if (lane < 0 || lane >= road->getLaneCount()) {
+                        throw std::runtime_error("Vehicle lane does not exist on road " + baan + ": " + std::to_string(lane));
+                    }
+                }
+
                 // Instantiate the correct vehicle subclass
-                if (type == "bus") {
-                    road->addVehicle(new Bus(road, pos));
-                } else if (type == "auto") {
-                    road->addVehicle(new Auto(road, pos));
-                } else if (type == "politiecombi") {
-                    road->addVehicle(new Combi(road, pos));
-                } else if (type == "ziekenwagen") {
-                    road->addVehicle(new Ziek(road, pos));
-                } else if (type == "brandweerwagen") {
-                    road->addVehicle(new Brand(road, pos));
-                } else {
+                Vehicle* vehicle = Vehicle::create(type, road, pos);
+                if (!vehicle) {
                     throw std::runtime_error("Invalid vehicle type: " + type);
                 }
+                vehicle->setLane(lane);
+                road->addVehicle(vehicle);
+                if (TiXmlElement* destinationElement = elem->FirstChildElement("bestemming")) {
+                    vehicleDestinations.emplace_back(vehicle, destinationElement->GetText() ? destinationElement->GetText() : "");
+                }
             }
         }
         else if (tag == "BUSHALTE") {
@@ -186,17 +233,63 @@ void Parser::parseFile(const std::string& filename,
                 double pos = std::stod(posElement->GetText());
                 int cyclus = std::stoi(cyclusElement->GetText());
 
-                bool found = false;
-                for (auto* r : roads) {
-                    if (r->getName() == baan) {
-                        r->addTrafficLight(new TrafficLight(r, pos, cyclus));
-                        found = true;
-                        break;
+                Road* road = Road::getRoadByName(baan, roads);
+                if (!road) {
+                    throw std::runtime_error("Traffic light refers to unknown road: " + baan);
+                }
+                TiXmlElement* minElement = elem->FirstChildElement("mingroen");
+                TiXmlElement* maxElement = elem->FirstChildElement("maxgroen");
+                TrafficLight::Actuation actuation;
+                if (minElement || maxElement) {
+                    if (!minElement || !maxElement) {
+                        throw std::runtime_error("Actuated traffic light on " + baan + " needs both mingroen and maxgroen");
+                    }
+                    actuation.minGreen = std::stod(minElement->GetText());
+                    actuation.maxGreen = std::stod(maxElement->GetText());
+                    if (TiXmlElement* gapElement = elem->FirstChildElement("hiaat")) {
+                        actuation.gap = std::stod(gapElement->GetText());
+                    }
+                    if (TiXmlElement* zoneElement = elem->FirstChildElement("detectiezone")) {
+                        actuation.zone = std::stod(zoneElement->GetText());
+                    }
+                    if (actuation.minGreen <= 0 || actuation.maxGreen < actuation.minGreen) {
+                        throw std::runtime_error("Traffic light on " + baan + " needs 0 < mingroen <= maxgroen");
+                    }
+                    if (actuation.gap <= 0 || actuation.zone <= 0) {
+                        throw std::runtime_error("Traffic light on " + baan + " needs a positive hiaat and detectiezone");
                     }
                 }
-                if (!found) {
-                    throw std::runtime_error("Traffic light refers to unknown road: " + baan);
+
+                TrafficLight* light = new TrafficLight(road, pos, cyclus);
+                if (minElement) {
+                    light->setActuation(actuation);
                 }
+                road->addTrafficLight(light);
+            }
+        }
+        else if (tag == "DETECTOR") {
+            TiXmlElement* baanElement = elem->FirstChildElement("baan");
+            TiXmlElement* posElement = elem->FirstChildElement("positie");
+            TiXmlElement* intervalElement = elem->FirstChildElement("interval");
+            if (baanElement && posElement && intervalElement) {
+                std::string baan = baanElement->GetText();
+                double pos = std::stod(posElement->GetText());
+                double interval = std::stod(intervalElement->GetText());
+                TiXmlElement* naamElement = elem->FirstChildElement("naam");
+                std::string naam = naamElement && naamElement->GetText() ? naamElement->GetText()
+                                                                         : baan + "@" + posElement->GetText();
+
+                Road* road = Road::getRoadByName(baan, roads);
+                if (!road) {
+                    throw std::runtime_error("Detector refers to unknown road: " + baan);
+                }
+                if (pos < 0 || pos > road->getLength()) {
+                    throw std::runtime_error("Detector position is not on road " + baan + ": " + std::to_string(pos));
+                }
+                if (interval <= 0) {
+                    throw std::runtime_error("Detector interval must be positive: " + std::to_string(interval));
+                }
+                road->addDetector(new Detector(road, pos, interval, naam));
             }
         }
         else if (tag == "VOERTUIGGENERATOR") {
@@ -212,6 +305,9 @@ void Parser::parseFile(const std::string& filename,
                 for (auto* r : roads) {
                     if (r->getName() == baan) {
                         generators.push_back(new VehicleGenerator(r, freq, type));
+                        if (TiXmlElement* destinationElement = elem->FirstChildElement("bestemming")) {
+                            generatorDestinations.emplace_back(generators.back(), destinationElement->GetText() ? destinationElement->GetText() : "");
+                        }
                         found = true;
                         break;
                     }
@@ -224,4 +320,26 @@ void Parser::parseFile(const std::string& filename,
 
         elem = elem->NextSiblingElement();
     }
+
+    for (auto& link : successors) {
+        Road* next = link.second.empty() ? nullptr : Road::getRoadByName(link.second, roads);
+        if (!next || next == link.first) {
+            throw std::runtime_error("Road " + link.first->getName() + " has invalid successor: " + link.second);
+        }
+        link.first->addRoad(next);
+    }
+    for (auto& destination : vehicleDestinations) {
+        Road* road = destination.second.empty() ? nullptr : Road::getRoadByName(destination.second, roads);
+        if (!road) {
+            throw std::runtime_error("Vehicle destination refers to unknown road: " + destination.second);
+        }
+        destination.first->setDestination(road);
+    }
+    for (auto& destination : generatorDestinations) {
+        Road* road = destination.second.empty() ? nullptr : Road::getRoadByName(destination.second, roads);
+        if (!road) {
+            throw std::runtime_error("Vehicle generator destination refers to unknown road: " + destination.second);
+        }
+        destination.first->setDestination(road);
+    }
 }
\ No newline at end of file
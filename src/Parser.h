@@ -12,7 +12,7 @@ class Intersection;
 /**
  * @brief Utility class responsible for parsing XML input files to build the simulation elements.
  * 
- * Provides a static method to parse a scenario file and fill the passed vectors
+ * Provides static methods to parse a scenario file or its contents and fill the passed vectors
  * with dynamically allocated objects representing roads, vehicle generators, bus stops, and intersections.
  */
 class Parser {
@@ -38,6 +38,26 @@ public:
                           std::vector<VehicleGenerator*>& generators,
                           std::vector<BusStop*>& busStops,
                           std::vector<Intersection*>& intersections);
+
+    /**
+     * @brief Parses scenario XML that is already in memory.
+     *
+     * Behaves like parseFile() on a file with these contents, so a scenario read
+     * once can be parsed again for every independent simulation built from it.
+     *
+     * @param xml Contents of a scenario file.
+     * @param roads Vector to be filled with pointers to Road objects.
+     * @param generators Vector to be filled with pointers to VehicleGenerator objects.
+     * @param busStops Vector to be filled with pointers to BusStop objects.
+     * @param intersections Vector to be filled with pointers to Intersection objects.
+     *
+     * @throws std::runtime_error if XML parsing fails or if invalid data is encountered.
+     */
+    static void parseString(const std::string& xml,
+                            std::vector<Road*>& roads,
+                            std::vector<VehicleGenerator*>& generators,
+                            std::vector<BusStop*>& busStops,
+                            std::vector<Intersection*>& intersections);
 };
 
 #endif
@@ -0,0 +1,590 @@
+#include "PartitionedRun.h"
+#include "BoundaryExchange.h"
+#include "Simulation.h"
+#include "Road.h"
+#include "Vehicle.h"
+#include "Intersection.h"
+#include "RoadPartitioner.h"
+#include "RouteCache.h"
+#include "SlotMap.h"
+#include "DesignByContract.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <thread>
+#include <tuple>
+#include <unordered_map>
+#include <unordered_set>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace {
+
+const char* const VEHICLE_TYPES[] = {"auto", "bus", "politiecombi", "ziekenwagen", "brandweerwagen"};
+const int VEHICLE_TYPE_COUNT = sizeof(VEHICLE_TYPES) / sizeof(VEHICLE_TYPES[0]);
+
+int typeIndex(const std::string& type) {
+    for (int i = 0; i < VEHICLE_TYPE_COUNT; i++) {
+        if (type == VEHICLE_TYPES[i])
+            return i;
+    }
+    throw std::runtime_error("Vehicle type cannot cross a partition: " + type);
+}
+
+/**
+ * @brief Fixed-size record exchanged between processes.
+ */
+struct Message {
+    enum Kind : std::int32_t { TAIL, VEHICLE, SPAWN, END };
+
+    std::int32_t kind = END;
+    std::int32_t road = -1;        ///< Road index; generator index for a spawn.
+    std::int32_t lane = 0;
+    std::int32_t type = 0;         ///< Index into VEHICLE_TYPES.
+    std::int32_t destination = -1; ///< Road index, or -1 for an unrouted vehicle.
+    std::int32_t route = -1;       ///< Index into the run's routes, or -1 without a precomputed route.
+    std::int32_t present = 0;      ///< Whether a tail has a vehicle.
+    std::uint32_t id = 0;          ///< Stable id of the vehicle.
+    double position = 0;
+    double speed = 0;
+    double waitStop = -1;          ///< Bus stop being served, see Vehicle::getWaitStop().
+    double waitTime = 0;
+};
+
+using SharedRoute = std::shared_ptr<const Route>;
+
+static_assert(std::atomic<std::uint64_t>::is_always_lock_free,
+              "Ring buffer indices must be lock-free to work across processes");
+
+/**
+ * @brief Single-producer single-consumer ring buffer placed in shared memory.
+ *
+ * head and tail only grow; each sits on its own cache line so the producer and
+ * the consumer do not invalidate each other's line on every message.
+ */
+struct Ring {
+    static constexpr std::uint64_t CAPACITY = 1024;
+
+    alignas(64) std::atomic<std::uint64_t> head{0};  ///< Next message to read.
+    alignas(64) std::atomic<std::uint64_t> tail{0};  ///< Next slot to write.
+    alignas(64) Message slots[CAPACITY];
+
+    bool tryPush(const Message& message) {
+        std::uint64_t write = tail.load(std::memory_order_relaxed);
+        if (write - head.load(std::memory_order_acquire) == CAPACITY)
+            return false;
+        slots[write % CAPACITY] = message;
+        tail.store(write + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool tryPop(Message& message) {
+        std::uint64_t read = head.load(std::memory_order_relaxed);
+        if (read == tail.load(std::memory_order_acquire))
+            return false;
+        message = slots[read % CAPACITY];
+        head.store(read + 1, std::memory_order_release);
+        return true;
+    }
+};
+
+/**
+ * @brief One ring per ordered pair of processes, mapped before forking.
+ * Index partitionCount stands for the parent, which collects the results.
+ */
+class SharedRings {
+public:
+    explicit SharedRings(int partitionCount)
+        : endpoints(partitionCount + 1), bytes(sizeof(Ring) * endpoints * endpoints)
+    {
+        void* memory = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        if (memory == MAP_FAILED) {
+            throw std::runtime_error("Failed to map shared memory for partition exchange");
+        }
+        rings = static_cast<Ring*>(memory);
+        for (int i = 0; i < endpoints * endpoints; i++)
+            new (&rings[i]) Ring();
+    }
+
+    ~SharedRings() {
+        munmap(rings, bytes);
+    }
+
+    SharedRings(const SharedRings&) = delete;
+    SharedRings& operator=(const SharedRings&) = delete;
+
+    Ring& between(int from, int to) {
+        return rings[from * endpoints + to];
+    }
+
+private:
+    int endpoints;
+    std::size_t bytes;
+    Ring* rings;
+};
+
+/**
+ * @brief Boundary exchange of one worker process over the shared rings.
+ *
+ * Every phase sends all its messages and an END marker to every other worker
+ * before receiving anything. Sending never blocks for long: while a ring is full
+ * the worker drains its incoming rings into local queues, so two workers that
+ * fill each other's rings cannot deadlock.
+ */
+class PartitionExchange : public BoundaryExchange {
+public:
+    PartitionExchange(SharedRings& rings, int self, int partitionCount, const std::vector<int>& owners,
+                      const std::vector<Road*>& roads, const std::vector<SharedRoute>& routes)
+        : rings(rings), self(self), partitionCount(partitionCount), owners(owners), roads(roads), routes(routes),
+          tailsFor(partitionCount), pending(partitionCount)
+    {
+        for (std::size_t i = 0; i < roads.size(); i++)
+            indices[roads[i]] = static_cast<int>(i);
+        for (std::size_t i = 0; i < routes.size(); i++)
+            routeIndices[routes[i].get()] = static_cast<int>(i);
+
+        // The tails of owned roads that a foreign road leads into
+        for (std::size_t i = 0; i < roads.size(); i++) {
+            int predecessorOwner = owners[i];
+            if (predecessorOwner == self)
+                continue;
+            for (const Road* successor : roads[i]->getRoads()) {
+                int index = indexOf(successor);
+                if (index >= 0 && owners[index] == self)
+                    tailsFor[predecessorOwner].push_back(index);
+            }
+        }
+        for (auto& list : tailsFor) {
+            std::sort(list.begin(), list.end());
+            list.erase(std::unique(list.begin(), list.end()), list.end());
+        }
+    }
+
+    bool ownsRoad(const Road* road) const override {
+        int index = indexOf(road);
+        return index >= 0 && owners[index] == self;
+    }
+
+    void exchangeTails(const std::vector<Road*>& roads) override {
+        for (int other = 0; other < partitionCount; other++) {
+            if (other == self)
+                continue;
+            for (int index : tailsFor[other]) {
+                for (int lane = 0; lane < roads[index]->getLaneCount(); lane++) {
+                    const Road::Tail& tail = roads[index]->getTail(lane);
+                    Message message;
+                    message.kind = Message::TAIL;
+                    message.road = index;
+                    message.lane = lane;
+                    message.present = tail.present;
+                    message.position = tail.position;
+                    message.speed = tail.speed;
+                    send(other, message);
+                }
+            }
+            send(other, Message());
+        }
+
+        for (int other = 0; other < partitionCount; other++) {
+            if (other == self)
+                continue;
+            for (Message message = receive(other); message.kind != Message::END; message = receive(other)) {
+                REQUIRE(message.kind == Message::TAIL, "Expected a tail");
+                Road::Tail tail;
+                tail.present = message.present != 0;
+                tail.position = message.position;
+                tail.speed = message.speed;
+                roads[message.road]->setTail(message.lane, tail);
+            }
+        }
+    }
+
+    void sendVehicle(const Vehicle* vehicle, Road* successor, double position) override {
+        Message message;
+        message.kind = Message::VEHICLE;
+        message.road = indexOf(successor);
+        message.lane = vehicle->getLane();
+        message.type = typeIndex(vehicle->getType());
+        message.destination = vehicle->getDestination() != nullptr ? indexOf(vehicle->getDestination()) : -1;
+        message.id = vehicle->getId();
+        message.position = position;
+        message.speed = vehicle->getSpeed();
+        message.waitStop = vehicle->getWaitStop();
+        message.waitTime = vehicle->getWaitTime();
+        if (vehicle->getRoute()) {
+            // Routes are only set before the fork, so every worker shares the run's list
+            auto it = routeIndices.find(vehicle->getRoute().get());
+            if (it == routeIndices.end()) {
+                throw std::runtime_error("Route cannot cross a partition");
+            }
+            message.route = it->second;
+        }
+        REQUIRE(message.road >= 0, "Successor must be a road of the simulation");
+        send(owners[message.road], message);
+    }
+
+    std::vector<Vehicle*> receiveVehicles() override {
+        for (int other = 0; other < partitionCount; other++) {
+            if (other != self)
+                send(other, Message());
+        }
+
+        std::vector<Vehicle*> received;
+        for (int other = 0; other < partitionCount; other++) {
+            if (other == self)
+                continue;
+            for (Message message = receive(other); message.kind != Message::END; message = receive(other)) {
+                REQUIRE(message.kind == Message::VEHICLE, "Expected a vehicle");
+                Road* road = roads[message.road];
+                Vehicle* vehicle = Vehicle::create(VEHICLE_TYPES[message.type], road, message.position);
+                vehicle->setLane(std::min(message.lane, road->getLaneCount() - 1));
+                vehicle->setSpeed(message.speed);
+                vehicle->setWait(message.waitStop, message.waitTime);
+                if (message.destination >= 0)
+                    vehicle->setDestination(roads[message.destination]);
+                if (message.route >= 0)
+                    vehicle->setRoute(routes[message.route]);
+                // Its acceleration is recomputed before it moves again, so it need not cross
+                vehicle->setRegistration(INVALID_HANDLE, message.id);
+                road->addVehicle(vehicle);
+                received.push_back(vehicle);
+            }
+        }
+        return received;
+    }
+
+    std::vector<int> exchangeSpawns(const std::vector<int>& spawned) override {
+        for (int other = 0; other < partitionCount; other++) {
+            if (other == self)
+                continue;
+            for (int generator : spawned) {
+                Message message;
+                message.kind = Message::SPAWN;
+                message.road = generator;
+                send(other, message);
+            }
+            send(other, Message());
+        }
+
+        std::vector<int> all = spawned;
+        for (int other = 0; other < partitionCount; other++) {
+            if (other == self)
+                continue;
+            for (Message message = receive(other); message.kind != Message::END; message = receive(other)) {
+                REQUIRE(message.kind == Message::SPAWN, "Expected a spawn");
+                all.push_back(message.road);
+            }
+        }
+        std::sort(all.begin(), all.end());
+        return all;
+    }
+
+    /** @brief Sends a message to the parent process. */
+    void report(const Message& message) {
+        while (!rings.between(self, partitionCount).tryPush(message))
+            std::this_thread::yield();
+    }
+
+private:
+    int indexOf(const Road* road) const {
+        auto it = indices.find(road);
+        return it == indices.end() ? -1 : it->second;
+    }
+
+    void send(int to, const Message& message) {
+        Ring& ring = rings.between(self, to);
+        while (!ring.tryPush(message)) {
+            drain();
+            std::this_thread::yield();
+        }
+    }
+
+    Message receive(int from) {
+        if (!pending[from].empty()) {
+            Message message = pending[from].front();
+            pending[from].pop_front();
+            return message;
+        }
+        Message message;
+        while (!rings.between(from, self).tryPop(message))
+            std::this_thread::yield();
+        return message;
+    }
+
+    void drain() {
+        Message message;
+        for (int other = 0; other < partitionCount; other++) {
+            if (other == self)
+                continue;
+            while (rings.between(other, self).tryPop(message))
+                pending[other].push_back(message);
+        }
+    }
+
+    SharedRings& rings;
+    int self;
+    int partitionCount;
+    const std::vector<int>& owners;
+    const std::vector<Road*>& roads;
+    const std::vector<SharedRoute>& routes;
+    std::unordered_map<const Road*, int> indices;
+    std::unordered_map<const Route*, int> routeIndices;
+    std::vector<std::vector<int>> tailsFor;    ///< Per partition: owned roads whose tails it needs.
+    std::vector<std::deque<Message>> pending;  ///< Per partition: messages drained while sending.
+};
+
+/**
+ * @brief Body of a worker process.
+ * @return The process exit status.
+ */
+int runPartition(Simulation& simulation, SharedRings& rings, int self, int partitionCount,
+                 const std::vector<int>& owners, const std::vector<SharedRoute>& routes, int steps) {
+    try {
+        const std::vector<Road*>& roads = simulation.getRoads();
+        PartitionExchange exchange(rings, self, partitionCount, owners, roads, routes);
+        simulation.setBoundaryExchange(&exchange);
+        for (int step = 0; step < steps; step++)
+            simulation.runStep();
+
+        for (std::size_t i = 0; i < roads.size(); i++) {
+            if (owners[i] != self)
+                continue;
+            for (const Vehicle* vehicle : roads[i]->getVehicles()) {
+                Message message;
+                message.kind = Message::VEHICLE;
+                message.road = static_cast<int>(i);
+                message.lane = vehicle->getLane();
+                message.type = typeIndex(vehicle->getType());
+                message.id = vehicle->getId();
+                message.position = vehicle->getPosition();
+                message.speed = vehicle->getSpeed();
+                exchange.report(message);
+            }
+        }
+        exchange.report(Message());
+        return 0;
+    } catch (const std::exception& e) {
+        std::cerr << "Partition " << self << " failed: " << e.what() << std::endl;
+        return 1;
+    }
+}
+
+} // namespace
+
+/**
+ * @brief Compares two vehicle states field by field.
+ */
+bool VehicleState::operator==(const VehicleState& other) const {
+    return road == other.road && lane == other.lane && position == other.position
+        && speed == other.speed && type == other.type && id == other.id;
+}
+
+/**
+ * @brief Orders vehicle states by road, lane and position.
+ */
+bool VehicleState::operator<(const VehicleState& other) const {
+    return std::tie(road, lane, position, speed, type, id)
+         < std::tie(other.road, other.lane, other.position, other.speed, other.type, other.id);
+}
+
+/**
+ * @brief Splits the roads with the multilevel RoadPartitioner.
+ *
+ * @param simulation The loaded simulation.
+ * @param partitionCount Number of partitions.
+ * @return Owner of each road.
+ */
+std::vector<int> PartitionedRun::assignRoads(const Simulation& simulation, int partitionCount) {
+    REQUIRE(partitionCount > 0, "partitionCount must be positive");
+    return RoadPartitioner(simulation).partition(partitionCount);
+}
+
+/**
+ * @brief Loads the saved assignment, checking that it keeps every intersection
+ * in one partition, or assigns the roads anew.
+ *
+ * @param simulation The loaded simulation.
+ * @param scenarioFile Scenario path.
+ * @param partitionCount Partitions of a new assignment.
+ * @return Owner of each road.
+ */
+std::vector<int> PartitionedRun::loadRoads(const Simulation& simulation, const std::string& scenarioFile,
+                                           int partitionCount) {
+    REQUIRE(partitionCount > 0, "partitionCount must be positive");
+
+    std::string filename = RoadPartitioner::assignmentFile(scenarioFile);
+    if (!std::ifstream(filename))
+        return assignRoads(simulation, partitionCount);
+
+    const std::vector<Road*>& roads = simulation.getRoads();
+    std::vector<int> owners = RoadPartitioner::load(filename, roads);
+    std::unordered_map<const Road*, int> indices;
+    for (std::size_t i = 0; i < roads.size(); i++)
+        indices[roads[i]] = static_cast<int>(i);
+    for (const Intersection* intersection : simulation.getIntersections()) {
+        if (owners[indices.at(intersection->getEntryRoad())] != owners[indices.at(intersection->getExitRoad())]) {
+            throw std::runtime_error("Partition file splits the intersection of " + intersection->getEntryRoad()->getName()
+                                     + " and " + intersection->getExitRoad()->getName() + ": " + filename);
+        }
+    }
+    return owners;
+}
+
+/**
+ * @brief Stores the simulation and its road assignment.
+ *
+ * @param simulation The loaded simulation.
+ * @param owners Owner of each road.
+ */
+PartitionedRun::PartitionedRun(Simulation& simulation, std::vector<int> owners)
+    : simulation(simulation), owners(std::move(owners)), partitionCount(0)
+{
+    const std::vector<Road*>& roads = simulation.getRoads();
+    REQUIRE(this->owners.size() == roads.size(), "Every road must have an owner");
+    REQUIRE(simulation.getThreadCount() == 1, "Worker threads cannot be forked");
+
+    std::unordered_map<const Road*, int> indices;
+    for (std::size_t i = 0; i < roads.size(); i++) {
+        REQUIRE(this->owners[i] >= 0, "Owners must be non-negative");
+        indices[roads[i]] = static_cast<int>(i);
+        partitionCount = std::max(partitionCount, this->owners[i] + 1);
+    }
+    for (const Intersection* intersection : simulation.getIntersections()) {
+        REQUIRE(this->owners[indices.at(intersection->getEntryRoad())]
+                == this->owners[indices.at(intersection->getExitRoad())],
+                "Roads joined by an intersection must be in the same partition");
+    }
+    partitionCount = std::max(partitionCount, 1);
+
+    ENSURE(getPartitionCount() >= 1, "A run has at least one partition");
+}
+
+/**
+ * @brief Forks the workers, collects their final states and waits for them.
+ *
+ * The parent drains the result rings while the workers run, and stops every
+ * worker as soon as one of them fails, since the others would wait forever for
+ * its messages.
+ *
+ * @param steps Number of steps.
+ * @return Sorted states of all vehicles.
+ */
+std::vector<VehicleState> PartitionedRun::run(int steps) {
+    REQUIRE(steps >= 0, "steps must be non-negative");
+
+    // Precomputed routes cross as indices into this list, which every worker inherits
+    std::vector<SharedRoute> routes;
+    std::unordered_set<const Route*> seen;
+    for (const Vehicle* vehicle : simulation.getVehicles()) {
+        if (vehicle->getRoute() && seen.insert(vehicle->getRoute().get()).second)
+            routes.push_back(vehicle->getRoute());
+    }
+
+    SharedRings rings(partitionCount);
+    std::cout.flush();
+    std::cerr.flush();
+    std::fflush(nullptr);
+
+    std::vector<pid_t> workers;
+    for (int partition = 0; partition < partitionCount; partition++) {
+        pid_t pid = fork();
+        if (pid == 0)
+            _exit(runPartition(simulation, rings, partition, partitionCount, owners, routes, steps));
+        if (pid < 0) {
+            for (pid_t worker : workers) {
+                kill(worker, SIGKILL);
+                waitpid(worker, nullptr, 0);
+            }
+            throw std::runtime_error("Failed to fork a partition worker");
+        }
+        workers.push_back(pid);
+    }
+
+    std::vector<VehicleState> states;
+    std::vector<bool> finished(partitionCount, false);
+    std::vector<bool> exited(partitionCount, false);
+    int remaining = partitionCount;
+    bool failed = false;
+    while (remaining > 0 && !failed) {
+        bool progress = false;
+        for (int partition = 0; partition < partitionCount; partition++) {
+            Message message;
+            while (!finished[partition] && rings.between(partition, partitionCount).tryPop(message)) {
+                progress = true;
+                if (message.kind == Message::END) {
+                    finished[partition] = true;
+                    remaining--;
+                    break;
+                }
+                states.push_back({message.road, message.lane, message.position, message.speed,
+                                  VEHICLE_TYPES[message.type], message.id});
+            }
+        }
+        if (progress)
+            continue;
+
+        // A worker that exits before reporting everything has failed
+        for (int partition = 0; partition < partitionCount && !failed; partition++) {
+            int status = 0;
+            if (!exited[partition] && waitpid(workers[partition], &status, WNOHANG) == workers[partition]) {
+                exited[partition] = true;
+                if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+                    failed = true;
+            }
+        }
+        std::this_thread::yield();
+    }
+
+    for (int partition = 0; partition < partitionCount; partition++) {
+        if (exited[partition])
+            continue;
+        if (failed)
+            kill(workers[partition], SIGKILL);
+        int status = 0;
+        waitpid(workers[partition], &status, 0);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+            failed = true;
+    }
+    if (failed) {
+        throw std::runtime_error("A partition worker failed");
+    }
+
+    std::sort(states.begin(), states.end());
+    return states;
+}
+
+/**
+ * @brief Returns the number of partitions.
+ * @return Partition count.
+ */
+int PartitionedRun::getPartitionCount() const {
+    return partitionCount;
+}
+
+/**
+ * @brief Collects and sorts the states of every vehicle on a road.
+ *
+ * @param simulation The simulation.
+ * @return Sorted states.
+ */
+std::vector<VehicleState> PartitionedRun::captureStates(const Simulation& simulation) {
+    std::vector<VehicleState> states;
+    const std::vector<Road*>& roads = simulation.getRoads();
+    for (std::size_t i = 0; i < roads.size(); i++) {
+        for (const Vehicle* vehicle : roads[i]->getVehicles()) {
+            states.push_back({static_cast<int>(i), vehicle->getLane(), vehicle->getPosition(),
+                              vehicle->getSpeed(), vehicle->getType(), vehicle->getId()});
+        }
+    }
+    std::sort(states.begin(), states.end());
+    return states;
+}
@@ -0,0 +1,106 @@
+#ifndef PARTITIONEDRUN_H
+#define PARTITIONEDRUN_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class Simulation;
+
+/**
+ * @brief State of one vehicle at the end of a run, used to compare runs.
+ */
+struct VehicleState {
+    int road;           ///< Index of the road in Simulation::getRoads().
+    int lane;           ///< Lane on that road.
+    double position;    ///< Position on the road.
+    double speed;       ///< Speed.
+    std::string type;   ///< Vehicle type.
+    std::uint32_t id;   ///< Stable id, see Vehicle::getId().
+
+    bool operator==(const VehicleState& other) const;
+    bool operator<(const VehicleState& other) const;
+};
+
+/**
+ * @class PartitionedRun
+ * @brief Steps a simulation in several processes, each owning part of the roads.
+ *
+ * The run forks one worker process per partition from a fully loaded simulation,
+ * so every worker starts from the same state without parsing again. Each worker
+ * steps only its own roads through a BoundaryExchange. Workers exchange the tails
+ * of boundary roads and the vehicles crossing a boundary every step through
+ * single-producer single-consumer ring buffers in shared memory; a worker waits
+ * for the end-of-phase marker of every other worker, which doubles as the step
+ * barrier. A crossing vehicle keeps its id, route and bus stop state, and spawns
+ * are numbered in generator order across all partitions. Because partitions see
+ * exactly the inputs a single-process step would give them, the final states and
+ * ids are identical to those of Simulation::runStep.
+ *
+ * Intersections move vehicles within a step, so the roads they join must be in
+ * the same partition; assignRoads() guarantees this. The simulation must update
+ * its roads on one thread, since worker threads do not survive the fork.
+ */
+class PartitionedRun {
+public:
+    /**
+     * @brief Splits the roads over partitions with a RoadPartitioner using estimated loads.
+     * Roads joined by intersections are kept together.
+     * @param simulation The loaded simulation.
+     * @param partitionCount Number of partitions.
+     * @return The owning partition of each road, in Simulation::getRoads() order.
+     * @pre partitionCount > 0
+     */
+    static std::vector<int> assignRoads(const Simulation& simulation, int partitionCount);
+
+    /**
+     * @brief Uses the assignment saved next to the scenario (RoadPartitioner::assignmentFile())
+     * if there is one, and assignRoads() otherwise.
+     * @param simulation The loaded simulation.
+     * @param scenarioFile Path of the scenario the simulation was loaded from.
+     * @param partitionCount Number of partitions to assign when nothing was saved.
+     * @return The owning partition of each road, in Simulation::getRoads() order.
+     * @throws std::runtime_error If the saved assignment cannot be read or splits an intersection.
+     * @pre partitionCount > 0
+     */
+    static std::vector<int> loadRoads(const Simulation& simulation, const std::string& scenarioFile,
+                                      int partitionCount);
+
+    /**
+     * @brief Prepares a partitioned run of a loaded simulation.
+     * @param simulation Simulation to run; it is only read by this process.
+     * @param owners Owning partition of each road, in Simulation::getRoads() order.
+     * @pre owners.size() == simulation.getRoads().size()
+     * @pre every owner is >= 0
+     * @pre the two roads of every intersection have the same owner
+     * @pre simulation.getThreadCount() == 1
+     */
+    PartitionedRun(Simulation& simulation, std::vector<int> owners);
+
+    /**
+     * @brief Runs the given number of steps in one worker process per partition.
+     * @param steps Number of steps.
+     * @return States of all vehicles after the last step, sorted.
+     * @throws std::runtime_error If shared memory or a worker process cannot be
+     *         created, or if a worker fails.
+     * @pre steps >= 0
+     */
+    std::vector<VehicleState> run(int steps);
+
+    /** @brief Returns the number of partitions. */
+    int getPartitionCount() const;
+
+    /**
+     * @brief Collects the states of all vehicles on the roads of a simulation.
+     * @param simulation The simulation.
+     * @return Sorted states.
+     */
+    static std::vector<VehicleState> captureStates(const Simulation& simulation);
+
+private:
+    Simulation& simulation;
+    std::vector<int> owners;
+    int partitionCount;
+};
+
+#endif // PARTITIONEDRUN_H
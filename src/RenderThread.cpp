@@ -0,0 +1,90 @@
+#include "RenderThread.h"
+#include "GraphicsEngine.h"
+#include "DesignByContract.h"
+#include <chrono>
+#include <utility>
+
+/**
+ * @brief Starts the thread, which sleeps until a snapshot is published.
+ * @param engine Engine that draws the frames.
+ * @param onFrame Called after every frame.
+ */
+RenderThread::RenderThread(GraphicsEngine& engine, FrameCallback onFrame)
+    : engine(engine), onFrame(std::move(onFrame)), running(true), published(0), rendered(0)
+{
+    thread = std::thread(&RenderThread::loop, this);
+}
+
+/**
+ * @brief Stops and joins the thread.
+ */
+RenderThread::~RenderThread() {
+    stop();
+}
+
+/**
+ * @brief Fills the back slot and publishes it.
+ *
+ * The wake-up is sent without the mutex, so a sleeping thread may miss it; it
+ * then notices the snapshot when its sleep times out.
+ *
+ * @param roads Roads in layout order.
+ * @param time Simulation time.
+ */
+void RenderThread::publish(const std::vector<Road*>& roads, double time) {
+    snapshots.back().capture(roads, time);
+    snapshots.publish();
+    published++;
+    wake.notify_one();
+}
+
+/**
+ * @brief Lets the thread finish the newest snapshot and joins it.
+ */
+void RenderThread::stop() {
+    if (!thread.joinable())
+        return;
+    running = false;
+    wake.notify_one();
+    thread.join();
+    ENSURE(getRendered() <= getPublished(), "Only published snapshots can be drawn");
+}
+
+/**
+ * @brief Returns the number of published snapshots.
+ * @return Count since construction.
+ */
+int RenderThread::getPublished() const {
+    return published;
+}
+
+/**
+ * @brief Returns the number of drawn frames.
+ * @return Count since construction.
+ */
+int RenderThread::getRendered() const {
+    return rendered;
+}
+
+/**
+ * @brief Draws the newest snapshot whenever one was published since the last frame.
+ *
+ * running is read before the buffer, so a snapshot published before stop() is
+ * always drawn.
+ */
+void RenderThread::loop() {
+    while (true) {
+        bool last = !running;
+        if (snapshots.acquire()) {
+            engine.render(snapshots.front());
+            if (onFrame)
+                onFrame(engine, snapshots.front(), rendered);
+            rendered++;
+        } else if (last) {
+            break;
+        } else {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait_for(lock, std::chrono::milliseconds(10));
+        }
+    }
+}
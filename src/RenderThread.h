@@ -0,0 +1,82 @@
+#ifndef RENDERTHREAD_H
+#define RENDERTHREAD_H
+
+#include "FrameSnapshot.h"
+#include "TripleBuffer.h"
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class GraphicsEngine;
+class Road;
+
+/**
+ * @class RenderThread
+ * @brief Draws frames on its own thread from snapshots the simulation publishes.
+ *
+ * publish() captures the roads into the back slot of a TripleBuffer and hands
+ * it over without waiting, so stepping never waits for drawing. The thread
+ * always draws the newest snapshot and skips those it was too slow for, so
+ * under load the frame rate drops instead of the simulation slowing down.
+ */
+class RenderThread {
+public:
+    /**
+     * @brief Called on the render thread after each frame, e.g. to save it.
+     * Receives the engine with the frame, the snapshot it shows and the number of
+     * frames rendered before it.
+     */
+    using FrameCallback = std::function<void(const GraphicsEngine&, const FrameSnapshot&, int)>;
+
+    /**
+     * @brief Starts the render thread.
+     * @param engine Engine that draws the frames; only the render thread uses it until stop().
+     * @param onFrame Called after every frame; may be empty.
+     */
+    RenderThread(GraphicsEngine& engine, FrameCallback onFrame);
+
+    /** @brief Stops the thread; see stop(). */
+    ~RenderThread();
+
+    RenderThread(const RenderThread&) = delete;
+    RenderThread& operator=(const RenderThread&) = delete;
+
+    /**
+     * @brief Captures the roads and makes them the newest snapshot.
+     * Only one thread, the one that steps the simulation, may publish.
+     * @param roads Roads in layout order.
+     * @param time Simulation time.
+     */
+    void publish(const std::vector<Road*>& roads, double time);
+
+    /**
+     * @brief Draws the newest snapshot if it was not drawn yet and ends the thread.
+     * @post getRendered() <= getPublished()
+     */
+    void stop();
+
+    /** @brief Returns the number of published snapshots. */
+    int getPublished() const;
+
+    /** @brief Returns the number of drawn frames. */
+    int getRendered() const;
+
+private:
+    /** @brief Draws new snapshots until stop() is called. */
+    void loop();
+
+    GraphicsEngine& engine;
+    FrameCallback onFrame;
+    TripleBuffer<FrameSnapshot> snapshots;
+    std::atomic<bool> running;
+    std::atomic<int> published;
+    std::atomic<int> rendered;
+    std::mutex mutex;                ///< Only for sleeping; publish() never locks it.
+    std::condition_variable wake;
+    std::thread thread;
+};
+
+#endif // RENDERTHREAD_H
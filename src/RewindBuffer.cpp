@@ -0,0 +1,289 @@
+#include "RewindBuffer.h"
+#include "Simulation.h"
+#include "Road.h"
+#include "Vehicle.h"
+#include "TrafficLight.h"
+#include "Detector.h"
+#include "Intersection.h"
+#include "VehicleGenerator.h"
+#include "BusStop.h"
+#include "DesignByContract.h"
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <string>
+#include <utility>
+
+namespace {
+
+template <class T>
+T getLittleEndian(const std::vector<std::uint8_t>& in, std::size_t offset) {
+    T value = 0;
+    for (std::size_t i = 0; i < sizeof(T); i++)
+        value |= static_cast<T>(static_cast<T>(in[offset + i]) << (8 * i));
+    return value;
+}
+
+float getFloat(const std::vector<std::uint8_t>& in, std::size_t offset) {
+    std::uint32_t bits = getLittleEndian<std::uint32_t>(in, offset);
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+/** @brief Bookkeeping a typical allocator adds to every heap block. */
+const std::size_t ALLOCATION_OVERHEAD = 16;
+
+/**
+ * @brief Returns the heap bytes of a vector's buffer.
+ */
+template <class T>
+std::size_t vectorBytes(const std::vector<T>& vector) {
+    return vector.capacity() == 0 ? 0 : vector.capacity() * sizeof(T) + ALLOCATION_OVERHEAD;
+}
+
+/**
+ * @brief Returns the heap bytes of a string; short strings are stored inside the object.
+ */
+std::size_t stringBytes(const std::string& text) {
+    const char* data = text.data();
+    const char* object = reinterpret_cast<const char*>(&text);
+    if (data >= object && data < object + sizeof(std::string))
+        return 0;
+    return text.capacity() + 1 + ALLOCATION_OVERHEAD;
+}
+
+/**
+ * @brief Estimates the heap bytes of a clone by walking it.
+ *
+ * Counts every entity with its allocator overhead, the road's name, lane and
+ * link vectors by capacity, and the registry slot, id map node and list
+ * entries of every entity. Containers private to the entities (intersection
+ * and generator tables, road tails, detector intervals) and shared routes are
+ * left out, so the result is a lower bound on what the clone holds.
+ */
+std::size_t estimateBytes(const Simulation& simulation) {
+    const std::size_t entry = sizeof(void*) + ALLOCATION_OVERHEAD;
+    std::size_t bytes = sizeof(Simulation) + ALLOCATION_OVERHEAD;
+    for (const Road* road : simulation.getRoads()) {
+        bytes += sizeof(Road) + ALLOCATION_OVERHEAD + 2 * entry + stringBytes(road->getName());
+        for (int lane = 0; lane < road->getLaneCount(); lane++)
+            bytes += sizeof(std::vector<Vehicle*>) + vectorBytes(road->getLaneVehicles(lane));
+        bytes += vectorBytes(road->getTrafficLights()) + vectorBytes(road->getDetectors())
+                 + vectorBytes(road->getRoads());
+    }
+    for (const Vehicle* vehicle : simulation.getVehicles())
+        bytes += sizeof(Vehicle) + ALLOCATION_OVERHEAD + 4 * entry + stringBytes(vehicle->getType());
+    bytes += simulation.getTrafficLights().size() * (sizeof(TrafficLight) + ALLOCATION_OVERHEAD + 2 * entry);
+    bytes += simulation.getDetectors().size() * (sizeof(Detector) + ALLOCATION_OVERHEAD + 2 * entry);
+    bytes += simulation.getIntersections().size() * (sizeof(Intersection) + ALLOCATION_OVERHEAD + 2 * entry);
+    bytes += simulation.getGenerators().size() * (sizeof(VehicleGenerator) + ALLOCATION_OVERHEAD + 2 * entry);
+    bytes += simulation.getBusStops().size() * (sizeof(BusStop) + ALLOCATION_OVERHEAD + 2 * entry);
+    return bytes;
+}
+
+/**
+ * @brief Returns the bytes a stored delta takes, with its vector header.
+ */
+std::size_t deltaBytes(const std::vector<std::uint8_t>& delta) {
+    return sizeof(delta) + vectorBytes(delta);
+}
+
+} // namespace
+
+/**
+ * @brief Creates an empty buffer.
+ * @param keyframeInterval Steps between keyframes.
+ * @param memoryBudget Estimated bytes the buffer may use.
+ * @param positionStep Position quantization in metres.
+ * @param speedStep Speed quantization in m/s.
+ */
+RewindBuffer::RewindBuffer(int keyframeInterval, std::size_t memoryBudget, double positionStep, double speedStep)
+    : keyframeInterval(keyframeInterval), memoryBudget(memoryBudget), memoryUsage(0),
+      encoder(positionStep, speedStep, true)
+{
+    REQUIRE(keyframeInterval >= 1, "The keyframe interval must be at least one step");
+}
+
+RewindBuffer::~RewindBuffer() = default;
+
+/**
+ * @brief Starts a segment on keyframe steps and appends the step's delta.
+ *
+ * The first delta of a segment is a full state, so a segment decodes on its own
+ * once the segments before it are evicted.
+ *
+ * @param simulation The simulation after its step.
+ */
+void RewindBuffer::record(const Simulation& simulation) {
+    int step = simulation.getStepCount();
+    REQUIRE(segments.empty() || step == getLastStep() + 1, "Steps must be recorded in order");
+
+    if (segments.empty() || step % keyframeInterval == 0) {
+        Segment segment{step, simulation.clone(), 0, {}, 0};
+        segment.keyframeBytes = estimateBytes(*segment.keyframe);
+        memoryUsage += segment.keyframeBytes;
+        segments.push_back(std::move(segment));
+        encoder.subscribe({});
+    }
+
+    snapshot.capture(simulation.getRoads(), simulation.currentTime);
+    Segment& segment = segments.back();
+    segment.deltas.push_back(encoder.encode(snapshot, static_cast<std::uint32_t>(step)));
+    segment.deltas.back().shrink_to_fit();
+    segment.deltaBytes += deltaBytes(segment.deltas.back());
+    memoryUsage += deltaBytes(segment.deltas.back());
+    evict();
+
+    ENSURE(getLastStep() == step, "The step must be recorded");
+}
+
+/**
+ * @brief Returns the step of the oldest keyframe.
+ * @return The step, or -1.
+ */
+int RewindBuffer::getFirstStep() const {
+    return segments.empty() ? -1 : segments.front().step;
+}
+
+/**
+ * @brief Returns the newest recorded step.
+ * @return The step, or -1.
+ */
+int RewindBuffer::getLastStep() const {
+    if (segments.empty())
+        return -1;
+    return segments.back().step + static_cast<int>(segments.back().deltas.size()) - 1;
+}
+
+/**
+ * @brief Returns the number of segments.
+ * @return Keyframes in the buffer.
+ */
+int RewindBuffer::getKeyframeCount() const {
+    return static_cast<int>(segments.size());
+}
+
+/**
+ * @brief Returns the estimated memory use.
+ * @return Bytes of keyframes and deltas.
+ */
+std::size_t RewindBuffer::getMemoryUsage() const {
+    return memoryUsage;
+}
+
+/**
+ * @brief Returns the keyframe of the segment holding a step.
+ * @param step A recorded step.
+ * @return The keyframe.
+ */
+const Simulation& RewindBuffer::keyframeAt(int step) const {
+    return *segmentOf(step).keyframe;
+}
+
+/**
+ * @brief Drops the segments and deltas after a step.
+ *
+ * The encoder no longer knows what the last kept delta holds, so the next
+ * record() writes a full state.
+ *
+ * @param step A recorded step.
+ */
+void RewindBuffer::truncate(int step) {
+    REQUIRE(step >= getFirstStep() && step <= getLastStep(), "Only recorded steps can be kept");
+
+    while (segments.back().step > step) {
+        memoryUsage -= segments.back().keyframeBytes + segments.back().deltaBytes;
+        segments.pop_back();
+    }
+    Segment& segment = segments.back();
+    while (segment.step + static_cast<int>(segment.deltas.size()) - 1 > step) {
+        segment.deltaBytes -= deltaBytes(segment.deltas.back());
+        memoryUsage -= deltaBytes(segment.deltas.back());
+        segment.deltas.pop_back();
+    }
+    encoder.subscribe({});
+
+    ENSURE(getLastStep() == step, "The buffer must end at the step");
+}
+
+/**
+ * @brief Applies the deltas of a segment up to a step.
+ *
+ * Vehicles not sent in the last message keep driving at their sent speed from
+ * the time they were sent, the same prediction the encoder left them out by.
+ *
+ * @param step A recorded step.
+ * @return The decoded frame.
+ */
+RewindBuffer::Frame RewindBuffer::frameAt(int step) const {
+    const Segment& segment = segmentOf(step);
+    std::map<std::uint32_t, std::pair<VehicleState, double>> vehicles;
+    std::map<std::pair<std::uint16_t, std::uint16_t>, bool> lights;
+    Frame frame;
+    bool extrapolated = false;
+    for (int i = 0; i <= step - segment.step; i++) {
+        const std::vector<std::uint8_t>& message = segment.deltas[i];
+        std::uint64_t timeBits = getLittleEndian<std::uint64_t>(message, 4);
+        std::memcpy(&frame.time, &timeBits, sizeof(frame.time));
+        extrapolated = (message[12] & 2) != 0;
+        if (message[12] & 1) {
+            vehicles.clear();
+            lights.clear();
+        }
+        std::uint32_t vehicleCount = getLittleEndian<std::uint32_t>(message, 13);
+        std::uint32_t removalCount = getLittleEndian<std::uint32_t>(message, 17);
+        std::uint32_t lightCount = getLittleEndian<std::uint32_t>(message, 21);
+        std::size_t offset = DeltaEncoder::HEADER_SIZE;
+        for (std::uint32_t v = 0; v < vehicleCount; v++, offset += DeltaEncoder::VEHICLE_SIZE) {
+            VehicleState state;
+            state.id = getLittleEndian<std::uint32_t>(message, offset);
+            state.road = getLittleEndian<std::uint16_t>(message, offset + 4);
+            state.lane = message[offset + 6];
+            state.position = getFloat(message, offset + 8);
+            state.speed = getFloat(message, offset + 12);
+            vehicles[state.id] = {state, frame.time};
+        }
+        for (std::uint32_t r = 0; r < removalCount; r++, offset += DeltaEncoder::REMOVAL_SIZE)
+            vehicles.erase(getLittleEndian<std::uint32_t>(message, offset));
+        for (std::uint32_t l = 0; l < lightCount; l++, offset += DeltaEncoder::LIGHT_SIZE) {
+            lights[{getLittleEndian<std::uint16_t>(message, offset), getLittleEndian<std::uint16_t>(message, offset + 2)}]
+                = message[offset + 4] != 0;
+        }
+        ENSURE(offset == message.size(), "A delta must be decoded completely");
+    }
+
+    frame.step = step;
+    for (const auto& entry : vehicles) {
+        VehicleState state = entry.second.first;
+        if (extrapolated)
+            state.position = static_cast<float>(state.position + state.speed * (frame.time - entry.second.second));
+        frame.vehicles.push_back(state);
+    }
+    for (const auto& entry : lights)
+        frame.lights.push_back(LightState{entry.first.first, entry.first.second, entry.second});
+    return frame;
+}
+
+/**
+ * @brief Finds the segment of a step by binary search over the keyframe steps.
+ * @param step A recorded step.
+ * @return The segment.
+ */
+const RewindBuffer::Segment& RewindBuffer::segmentOf(int step) const {
+    REQUIRE(step >= getFirstStep() && step <= getLastStep(), "The step must be recorded");
+
+    auto it = std::upper_bound(segments.begin(), segments.end(), step,
+                               [](int s, const Segment& segment) { return s < segment.step; });
+    return *(it - 1);
+}
+
+/**
+ * @brief Drops whole segments from the front while over budget.
+ */
+void RewindBuffer::evict() {
+    while (memoryUsage > memoryBudget && segments.size() > 1) {
+        memoryUsage -= segments.front().keyframeBytes + segments.front().deltaBytes;
+        segments.pop_front();
+    }
+}
@@ -0,0 +1,150 @@
+#ifndef REWINDBUFFER_H
+#define REWINDBUFFER_H
+
+#include "DeltaEncoder.h"
+#include "FrameSnapshot.h"
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <vector>
+
+class Simulation;
+
+/**
+ * @class RewindBuffer
+ * @brief Bounded history of a running simulation, for stepping backwards.
+ *
+ * Every keyframeInterval steps the buffer stores a keyframe, a clone of the
+ * simulation; after every step it stores the vehicle kinematics and light
+ * states as an extrapolating DeltaEncoder message against the previous step,
+ * so a vehicle that stands still or keeps its speed is not stored again. A
+ * keyframe and the deltas up to the next one form a segment. When the
+ * estimated memory use exceeds the budget the oldest segments are dropped, but
+ * the newest one is always kept.
+ *
+ * The memory use is estimated by walking each keyframe and counting the
+ * entities, their lists and allocator overhead; tables private to the
+ * entities are not counted, so the budget is a rough lower bound on what the
+ * buffer really holds.
+ *
+ * Simulation::seek() restores the keyframe at or before a step and simulates
+ * forward from it, so a seek costs at most keyframeInterval steps. frameAt()
+ * decodes the kinematics of a recorded step from the deltas alone, within the
+ * quantization steps, without simulating.
+ */
+class RewindBuffer {
+public:
+    /**
+     * @brief Kinematics of a vehicle in a decoded frame.
+     */
+    struct VehicleState {
+        std::uint32_t id;        ///< Vehicle id.
+        std::uint16_t road;      ///< Index of the road in Simulation::getRoads().
+        std::uint8_t lane;       ///< Lane on the road.
+        float position;          ///< Position within the position step.
+        float speed;             ///< Speed within the speed step.
+    };
+
+    /**
+     * @brief State of a light in a decoded frame.
+     */
+    struct LightState {
+        std::uint16_t road;      ///< Index of the road in Simulation::getRoads().
+        std::uint16_t index;     ///< Index of the light on its road.
+        bool green;              ///< Whether the light was green.
+    };
+
+    /**
+     * @brief Vehicles and lights after a recorded step.
+     */
+    struct Frame {
+        int step = 0;                       ///< Step count of the simulation.
+        double time = 0;                    ///< Simulation time.
+        std::vector<VehicleState> vehicles; ///< Vehicles ordered by id.
+        std::vector<LightState> lights;     ///< Lights in road order.
+    };
+
+    /**
+     * @brief Creates an empty buffer.
+     * @param keyframeInterval Steps between two keyframes.
+     * @param memoryBudget Bytes the buffer may use, as estimated by getMemoryUsage().
+     * @param positionStep Position quantization of the deltas in metres.
+     * @param speedStep Speed quantization of the deltas in m/s.
+     * @pre keyframeInterval >= 1
+     */
+    RewindBuffer(int keyframeInterval, std::size_t memoryBudget, double positionStep = 0.01, double speedStep = 0.01);
+
+    ~RewindBuffer();
+
+    RewindBuffer(const RewindBuffer&) = delete;
+    RewindBuffer& operator=(const RewindBuffer&) = delete;
+
+    /**
+     * @brief Records the state of a simulation after a step.
+     * Made by the simulation the buffer is set on; see Simulation::setRewind().
+     * @param simulation The simulation.
+     * @pre the buffer is empty or simulation.getStepCount() == getLastStep() + 1
+     */
+    void record(const Simulation& simulation);
+
+    /** @brief Returns the first recorded step, or -1 if the buffer is empty. */
+    int getFirstStep() const;
+
+    /** @brief Returns the last recorded step, or -1 if the buffer is empty. */
+    int getLastStep() const;
+
+    /** @brief Returns the number of stored keyframes. */
+    int getKeyframeCount() const;
+
+    /** @brief Returns the estimated bytes used by keyframes and deltas; a lower bound, see the class. */
+    std::size_t getMemoryUsage() const;
+
+    /**
+     * @brief Returns the newest keyframe at or before a step.
+     * @param step A recorded step.
+     * @return The keyframe.
+     * @pre getFirstStep() <= step <= getLastStep()
+     */
+    const Simulation& keyframeAt(int step) const;
+
+    /**
+     * @brief Forgets every step after the given one; the next record() continues from it.
+     * @param step A recorded step.
+     * @pre getFirstStep() <= step <= getLastStep()
+     * @post getLastStep() == step
+     */
+    void truncate(int step);
+
+    /**
+     * @brief Decodes the vehicles and lights of a recorded step from the deltas.
+     * @param step A recorded step.
+     * @return The frame.
+     * @pre getFirstStep() <= step <= getLastStep()
+     */
+    Frame frameAt(int step) const;
+
+private:
+    struct Segment {
+        int step;                                      ///< Step of the keyframe.
+        std::unique_ptr<Simulation> keyframe;
+        std::size_t keyframeBytes;
+        std::vector<std::vector<std::uint8_t>> deltas; ///< One message per step from the keyframe on.
+        std::size_t deltaBytes;
+    };
+
+    /** @brief Returns the segment that holds a recorded step. */
+    const Segment& segmentOf(int step) const;
+
+    /** @brief Drops the oldest segments until the budget is met or one is left. */
+    void evict();
+
+    int keyframeInterval;
+    std::size_t memoryBudget;
+    std::size_t memoryUsage;
+    DeltaEncoder encoder;
+    FrameSnapshot snapshot;
+    std::deque<Segment> segments;
+};
+
+#endif // REWINDBUFFER_H
@@ -4,28 +4,66 @@
 #include "BusStop.h"
 #include "Intersection.h"
 #include "DesignByContract.h"
+#include "SimulationStats.h"
+#include "Trace.h"
+#include "CloneMap.h"
+#include "Detector.h"
 #include <limits>
 #include <iostream>
 #include <vector>
 #include <algorithm>
+#include <iterator>
+#include <cstdint>
+
+namespace {
+
+bool byPosition(const Vehicle* a, const Vehicle* b) {
+    return a->getPosition() < b->getPosition();
+}
+
+bool beforePosition(const Vehicle* vehicle, double position) {
+    return vehicle->getPosition() < position;
+}
+
+bool afterPosition(double position, const Vehicle* vehicle) {
+    return position < vehicle->getPosition();
+}
+
+/**
+ * @brief Erases a vehicle from a lane if it is in it.
+ * @return true if it was erased.
+ */
+bool eraseFrom(std::vector<Vehicle*>& lane, const Vehicle* vehicle) {
+    auto it = std::find(lane.begin(), lane.end(), vehicle);
+    if (it == lane.end())
+        return false;
+    lane.erase(it);
+    return true;
+}
+
+} // namespace
 
 /**
- * @brief Constructs a road with a given name and length.
+ * @brief Constructs a road with a given name, length and number of lanes.
  * 
  * The length is guaranteed to be at least 100.
  * 
  * @param name The name of the road. Must not be empty.
  * @param length The length of the road. Must be positive.
+ * @param laneCount The number of lanes. Must be at least 1.
  */
-Road::Road(const std::string& name, int length) {
+Road::Road(const std::string& name, int length, int laneCount)
+    : laneChangeParity(0), lanes(laneCount > 0 ? laneCount : 1), tails(lanes.size()) {
     REQUIRE(!name.empty(), "Road name cannot be empty");
     REQUIRE(length > 0, "Road length must be positive");
+    REQUIRE(laneCount >= 1, "Road must have at least one lane");
     
     this->name = name;
     this->length = std::max(length, 100);
     
     ENSURE(!this->name.empty(), "Road name was not set properly");
     ENSURE(this->length >= 100, "Road length must be at least 100");
+    ENSURE(getLaneCount() == laneCount, "Lane count was not set properly");
 }
 
 /**
@@ -48,20 +86,71 @@ int Road::getLength() const {
     return length;
 }
 
+/**
+ * @brief Returns the number of lanes.
+ * 
+ * @return int The number of lanes.
+ */
+int Road::getLaneCount() const {
+    return static_cast<int>(lanes.size());
+}
+
+/**
+ * @brief Returns the vehicles in a lane, ordered by position.
+ * 
+ * @param lane The lane index.
+ * @return const std::vector<Vehicle*>& Vector of vehicle pointers.
+ */
+const std::vector<Vehicle*>& Road::getLaneVehicles(int lane) const {
+    REQUIRE(lane >= 0 && lane < getLaneCount(), "Lane index out of range");
+    return lanes[lane];
+}
+
 /**
  * @brief Adds a vehicle to this road.
  * 
+ * The vehicle is inserted into its lane at the place that keeps the lane ordered.
+ * 
  * @param vehicle Pointer to the vehicle to add. Must not be null.
  */
 void Road::addVehicle(Vehicle* vehicle) {
     REQUIRE(vehicle != nullptr, "Vehicle cannot be null");
     
-    size_t oldSize = vehicles.size();
+    CONTRACT_OLD(size_t, oldSize, vehicles.size());
+    if (vehicle->getLane() >= getLaneCount())
+        vehicle->setLane(getLaneCount() - 1);
     vehicles.push_back(vehicle);
+    totals.entries++;
+    std::vector<Vehicle*>& lane = lanes[vehicle->getLane()];
+    lane.insert(std::upper_bound(lane.begin(), lane.end(), vehicle, byPosition), vehicle);
     
     ENSURE(vehicles.size() == oldSize + 1, "Vehicle was not added properly");
 }
 
+/**
+ * @brief Finds a lane in which a vehicle can enter at position 0.
+ * 
+ * @param clearance Free distance needed at the start of the lane.
+ * @return int The rightmost free lane, or -1.
+ */
+int Road::findFreeEntryLane(double clearance) const {
+    for (int lane = 0; lane < getLaneCount(); lane++) {
+        bool free = true;
+        for (const Vehicle* vehicle : lanes[lane]) {
+            double position = vehicle->getPosition();
+            if (position >= clearance)
+                break;  // lanes are ordered by position
+            if (position > 0) {
+                free = false;
+                break;
+            }
+        }
+        if (free)
+            return lane;
+    }
+    return -1;
+}
+
 /**
  * @brief Adds a traffic light to this road.
  * 
@@ -70,12 +159,37 @@ void Road::addVehicle(Vehicle* vehicle) {
 void Road::addTrafficLight(TrafficLight* light) {
     REQUIRE(light != nullptr, "Traffic light cannot be null");
     
-    size_t oldSize = lights.size();
+    CONTRACT_OLD(size_t, oldSize, lights.size());
     lights.push_back(light);
     
     ENSURE(lights.size() == oldSize + 1, "Traffic light was not added properly");
 }
 
+/**
+ * @brief Adds a loop detector to this road, keeping the detectors sorted by position.
+ * 
+ * @param detector Pointer to the detector to add. Must not be null.
+ */
+void Road::addDetector(Detector* detector) {
+    REQUIRE(detector != nullptr, "Detector cannot be null");
+    REQUIRE(detector->getRoad() == this, "Detector must be on this road");
+
+    CONTRACT_OLD(size_t, oldSize, detectors.size());
+    auto at = std::upper_bound(detectors.begin(), detectors.end(), detector->getPosition(),
+                               [](double position, const Detector* d) { return position < d->getPosition(); });
+    detectors.insert(at, detector);
+
+    ENSURE(detectors.size() == oldSize + 1, "Detector was not added properly");
+}
+
+/**
+ * @brief Returns the loop detectors of this road.
+ * @return Detectors in position order.
+ */
+const std::vector<Detector*>& Road::getDetectors() const {
+    return detectors;
+}
+
 /**
  * @brief Adds a connected road to this road.
  * 
@@ -85,7 +199,7 @@ void Road::addRoad(Road* road) {
     REQUIRE(road != nullptr, "Road cannot be null");
     REQUIRE(road != this, "Cannot add road to itself");
     
-    size_t oldSize = roads.size();
+    CONTRACT_OLD(size_t, oldSize, roads.size());
     roads.push_back(road);
     
     ENSURE(roads.size() == oldSize + 1, "Road was not added properly");
@@ -99,7 +213,7 @@ void Road::addRoad(Road* road) {
 void Road::addBusStop(BusStop* stop) {
     REQUIRE(stop != nullptr, "Bus stop cannot be null");
     
-    size_t oldSize = busStops.size();
+    CONTRACT_OLD(size_t, oldSize, busStops.size());
     busStops.push_back(stop);
     
     ENSURE(busStops.size() == oldSize + 1, "Bus stop was not added properly");
@@ -113,30 +227,134 @@ void Road::addBusStop(BusStop* stop) {
 void Road::addIntersection(Intersection* intersection) {
     REQUIRE(intersection != nullptr, "Intersection cannot be null");
     
-    size_t oldSize = intersections.size();
+    CONTRACT_OLD(size_t, oldSize, intersections.size());
     intersections.push_back(intersection);
     
     ENSURE(intersections.size() == oldSize + 1, "Intersection was not added properly");
 }
 
+/**
+ * @brief Returns the road that vehicles continue on.
+ * 
+ * @return Road* The first connected road, or nullptr.
+ */
+Road* Road::getSuccessor() const {
+    return roads.empty() ? nullptr : roads.front();
+}
+
+/**
+ * @brief Returns the road that a vehicle continues on.
+ * 
+ * @param vehicle The vehicle. Must not be null.
+ * @return Road* The successor on its route, the first successor, or nullptr.
+ */
+Road* Road::getSuccessor(const Vehicle* vehicle) const {
+    REQUIRE(vehicle != nullptr, "Vehicle cannot be null");
+    
+    if (vehicle->getDestination() == this)
+        return nullptr;
+    if (vehicle->getDestination() != nullptr) {
+        Road* next = vehicle->getNextRoad();
+        if (std::find(roads.begin(), roads.end(), next) != roads.end())
+            return next;
+    }
+    return getSuccessor();
+}
+
+/**
+ * @brief Records position and speed of the rearmost vehicle of each lane.
+ */
+void Road::captureTail() {
+    for (size_t lane = 0; lane < lanes.size(); lane++) {
+        Tail& tail = tails[lane];
+        tail.present = !lanes[lane].empty();
+        if (tail.present) {
+            tail.position = lanes[lane].front()->getPosition();
+            tail.speed = lanes[lane].front()->getSpeed();
+        }
+    }
+}
+
+/**
+ * @brief Returns the recorded rearmost vehicle of a lane.
+ * 
+ * @param lane The lane index.
+ * @return const Tail& The tail, in this road's coordinates.
+ */
+const Road::Tail& Road::getTail(int lane) const {
+    REQUIRE(lane >= 0, "Lane index must be non-negative");
+    return tails[std::min(lane, getLaneCount() - 1)];
+}
+
+/**
+ * @brief Overwrites the recorded tail of a lane.
+ * 
+ * @param lane The lane index.
+ * @param tail The tail to record.
+ */
+void Road::setTail(int lane, const Tail& tail) {
+    REQUIRE(lane >= 0 && lane < getLaneCount(), "Lane index out of range");
+    tails[lane] = tail;
+    ENSURE(getTail(lane).present == tail.present, "Tail was not recorded");
+}
+
 /**
  * @brief Updates the state of the road and all vehicles on it.
  * 
- * Performs the following for each vehicle:
- * - Calculates acceleration and applies traffic light rules.
- * - Checks if buses need to wait at bus stops.
- * - Updates vehicle position if not waiting.
+ * First calculates the acceleration of every vehicle from the positions at the
+ * start of the step, taking the leader from the vehicle's lane, and applies
+ * traffic light rules. The last vehicle of a lane follows the captured tail of
+ * the same lane on its successor, so queues are seen across the boundary. On
+ * multi-lane roads vehicles then change lanes, towards the left and the right on
+ * alternate steps so that no two vehicles merge into the same gap from both
+ * sides. Then every vehicle moves, unless it is a bus waiting at a bus stop.
+ * Finally, in the same vehicle order, each vehicle:
  * - Handles road switching at intersections.
- * - Removes vehicles that have reached the end of the road.
+ * - Is removed if it has reached the end of the road and handed over through
+ *   getExitedVehicles().
+ *
+ * Moving touches only the vehicle itself, so doing it in a pass of its own
+ * keeps every draw and removal in the same order while the intersection
+ * switches get a trace span per road. Vehicles of the last pass are visited by
+ * index so that removals do not skip the vehicle behind the one that left.
  */
-void Road::update() {
-    for (auto* vehicle : getVehicles()) {
-        if (vehicle == nullptr) continue;
+void Road::update(double dt) {
+    REQUIRE(dt > 0, "The time step must be positive");
+
+    sortLanes();
 
-        // Update vehicle acceleration and traffic light compliance
-        vehicle->calculateAcceleration();
-        vehicle->applyTrafficLightRules();
+    // Update vehicle acceleration and traffic light compliance
+    for (size_t laneIndex = 0; laneIndex < lanes.size(); laneIndex++) {
+        const std::vector<Vehicle*>& lane = lanes[laneIndex];
+        for (size_t i = 0; i < lane.size(); i++) {
+            Vehicle* vehicle = lane[i];
+            size_t leader = i + 1;
+            while (leader < lane.size() && lane[leader]->getPosition() <= vehicle->getPosition())
+                leader++;
+            if (leader < lane.size()) {
+                vehicle->calculateAcceleration(lane[leader]);
+                vehicle->applyTrafficLightRules();
+                continue;
+            }
 
+            const Road* successor = getSuccessor(vehicle);
+            const Tail* tail = successor != nullptr ? &successor->getTail(static_cast<int>(laneIndex)) : nullptr;
+            if (tail != nullptr && tail->present && getLength() + tail->position > vehicle->getPosition()) {
+                vehicle->calculateAcceleration(getLength() + tail->position, tail->speed);
+            } else {
+                vehicle->calculateAcceleration(nullptr);
+            }
+            vehicle->applyTrafficLightRules();
+        }
+        SimulationStats::current().leaderLookups += lane.size();
+    }
+
+    if (lanes.size() > 1) {
+        changeLanes(laneChangeParity == 0 ? 1 : -1);
+        laneChangeParity = 1 - laneChangeParity;
+    }
+
+    for (Vehicle* vehicle : vehicles) {
         // Determine if bus must wait at a nearby bus stop
         bool isWaiting = false;
         for (auto* busStop : busStops) {
@@ -144,28 +362,178 @@ void Road::update() {
                 && std::abs(vehicle->getPosition() - busStop->getPosition()) < 1.0
                 && vehicle->getType() == "bus") {
 
-                isWaiting = vehicle->shouldWaitAt(busStop->getPosition(), busStop->getWaitTime());
+                isWaiting = vehicle->shouldWaitAt(busStop->getPosition(), busStop->getWaitTime(), dt);
                 break;
             }
         }
 
         // Update vehicle's position if it is not waiting
+        double from = vehicle->getPosition();
         if (!isWaiting) {
-            vehicle->update(0.0166); // Assuming ~60 FPS frame time
+            vehicle->update(dt);
+        }
+        if (!detectors.empty() && vehicle->getPosition() > from)
+            recordDetectors(vehicle, from, vehicle->getPosition(), dt);
+        totals.vehicleSeconds += dt;
+        totals.vehicleMetres += std::min<double>(vehicle->getPosition(), getLength()) - from;
+    }
+
+    {
+        TRACE_SCOPE("intersections");
+        size_t i = 0;
+        while (i < vehicles.size()) {
+            Vehicle* vehicle = vehicles[i];
+
+            // Handle potential road switching at intersections
+            if (!intersections.empty()) {
+                for (auto* intersection : intersections) {
+                    intersection->handleRoadSwitch(vehicle);
+                    if (vehicle->getRoad() != this)
+                        break;
+                }
+            }
+
+            // A vehicle that switched roads has already been removed from this one
+            if (vehicle->getRoad() != this) {
+                for (Detector* detector : detectors)
+                    detector->release(vehicle, dt);
+                totals.exits++;
+                continue;
+            }
+
+            // Remove vehicle if it has passed the end of the road
+            if (vehicle->getPosition() >= getLength()) {
+                for (Detector* detector : detectors)
+                    detector->release(vehicle, dt);
+                removeVehicle(vehicle);
+                exitedVehicles.push_back(vehicle);
+                totals.exits++;
+                continue;
+            }
+            i++;
+        }
+    }
+
+    sortLanes();
+}
+
+/**
+ * @brief Lets vehicles change to the adjacent lane on one side if MOBIL allows it.
+ * 
+ * Every source lane is walked in position order together with a cursor into the
+ * target lane, so each vehicle's new leader and follower are found in amortized
+ * O(1). A gap in the target lane is given to at most one vehicle per step.
+ * 
+ * @param direction +1 to change to the next lane on the left, -1 to the right.
+ */
+void Road::changeLanes(int direction) {
+    std::vector<std::vector<Vehicle*>> incoming(lanes.size());
+    std::uint64_t changes = 0;
+
+    for (int source = 0; source < getLaneCount(); source++) {
+        int target = source + direction;
+        if (target < 0 || target >= getLaneCount())
+            continue;
+
+        const std::vector<Vehicle*>& from = lanes[source];
+        const std::vector<Vehicle*>& to = lanes[target];
+        size_t gap = 0;  // index of the first vehicle ahead in the target lane
+        size_t claimedGap = std::numeric_limits<size_t>::max();
+        for (size_t i = 0; i < from.size(); i++) {
+            Vehicle* vehicle = from[i];
+            while (gap < to.size() && to[gap]->getPosition() <= vehicle->getPosition())
+                gap++;
+            if (gap == claimedGap)
+                continue;
+
+            const Vehicle* newLeader = gap < to.size() ? to[gap] : nullptr;
+            const Vehicle* newFollower = gap > 0 ? to[gap - 1] : nullptr;
+            const Vehicle* oldLeader = i + 1 < from.size() ? from[i + 1] : nullptr;
+            const Vehicle* oldFollower = i > 0 ? from[i - 1] : nullptr;
+            if (vehicle->shouldChangeLane(newLeader, newFollower, oldLeader, oldFollower)) {
+                incoming[target].push_back(vehicle);
+                claimedGap = gap;
+                changes++;
+            }
         }
+    }
+    if (changes == 0)
+        return;
 
-        // Handle potential road switching at intersections
-        for (auto* intersection : intersections) {
-            intersection->handleRoadSwitch(vehicle);
+    // The movers of a target lane are in position order, like their source lane
+    for (int target = 0; target < getLaneCount(); target++) {
+        const std::vector<Vehicle*>& movers = incoming[target];
+        if (movers.empty())
+            continue;
+        std::vector<Vehicle*>& source = lanes[target - direction];
+        size_t kept = 0;
+        size_t mover = 0;
+        for (Vehicle* vehicle : source) {
+            if (mover < movers.size() && movers[mover] == vehicle)
+                mover++;
+            else
+                source[kept++] = vehicle;
         }
+        source.resize(kept);
+        for (Vehicle* vehicle : movers)
+            vehicle->setLane(target);
+    }
+    for (int lane = 0; lane < getLaneCount(); lane++) {
+        if (incoming[lane].empty())
+            continue;
+        std::vector<Vehicle*> merged;
+        merged.reserve(lanes[lane].size() + incoming[lane].size());
+        std::merge(lanes[lane].begin(), lanes[lane].end(),
+                   incoming[lane].begin(), incoming[lane].end(),
+                   std::back_inserter(merged), byPosition);
+        lanes[lane].swap(merged);
+    }
+    SimulationStats::current().laneChanges += changes;
+}
 
-        // Remove vehicle if it has passed the end of the road
-        if (vehicle->getPosition() >= getLength()) {
-            removeVehicle(vehicle);
+/**
+ * @brief Insertion-sorts every lane by position.
+ */
+void Road::sortLanes() {
+    for (auto& lane : lanes) {
+        for (size_t i = 1; i < lane.size(); i++) {
+            Vehicle* vehicle = lane[i];
+            size_t j = i;
+            while (j > 0 && byPosition(vehicle, lane[j - 1])) {
+                lane[j] = lane[j - 1];
+                j--;
+            }
+            lane[j] = vehicle;
         }
     }
 }
 
+/**
+ * @brief Returns the vehicles that drove off the end of this road since the last clear.
+ * 
+ * @return const std::vector<Vehicle*>& Vector of vehicle pointers.
+ */
+const std::vector<Vehicle*>& Road::getExitedVehicles() const {
+    return exitedVehicles;
+}
+
+/**
+ * @brief Returns the running traffic sums.
+ * 
+ * @return const Road::Totals& The sums.
+ */
+const Road::Totals& Road::getTotals() const {
+    return totals;
+}
+
+/**
+ * @brief Forgets the vehicles that exited this road.
+ */
+void Road::clearExitedVehicles() {
+    exitedVehicles.clear();
+    ENSURE(exitedVehicles.empty(), "Exited vehicles were not cleared");
+}
+
 /**
  * @brief Returns the vector of vehicles currently on the road.
  * 
@@ -194,7 +562,7 @@ const std::vector<Road*>& Road::getRoads() const {
 }
 
 /**
- * @brief Checks if there is a vehicle ahead of the given vehicle on this road.
+ * @brief Checks if there is a vehicle ahead of the given vehicle in its lane.
  * 
  * @param vehicle Pointer to the vehicle to check for leading vehicles. Must not be null.
  * @return true if there is a vehicle ahead, false otherwise.
@@ -202,16 +570,13 @@ const std::vector<Road*>& Road::getRoads() const {
 bool Road::hasLeadingVehicle(const Vehicle* vehicle) const {
     REQUIRE(vehicle != nullptr, "Vehicle cannot be null");
     
-    for (auto* v : vehicles) {
-        if (v->getPosition() > vehicle->getPosition()) {
-            return true;
-        }
-    }
-    return false;
+    return getLeadingVehicle(vehicle) != nullptr;
 }
 
 /**
- * @brief Finds and returns the closest vehicle ahead of the given vehicle.
+ * @brief Finds and returns the closest vehicle ahead of the given vehicle in its lane.
+ * 
+ * Lanes are ordered by position, so this is a binary search.
  * 
  * @param vehicle Pointer to the vehicle for which to find the leading vehicle. Must not be null.
  * @return Vehicle* Pointer to the closest vehicle ahead, or nullptr if none found.
@@ -219,15 +584,10 @@ bool Road::hasLeadingVehicle(const Vehicle* vehicle) const {
 Vehicle* Road::getLeadingVehicle(const Vehicle* vehicle) const {
     REQUIRE(vehicle != nullptr, "Vehicle cannot be null");
     
-    Vehicle* closest = nullptr;
-    double minDist = std::numeric_limits<double>::max();
-    for (auto* v : vehicles) {
-        double gap = v->getPosition() - vehicle->getPosition();
-        if (gap > 0 && gap < minDist) {
-            minDist = gap;
-            closest = v;
-        }
-    }
+    SimulationStats::current().leaderLookups++;
+    const std::vector<Vehicle*>& lane = lanes[std::min(vehicle->getLane(), getLaneCount() - 1)];
+    auto it = std::upper_bound(lane.begin(), lane.end(), vehicle, byPosition);
+    Vehicle* closest = it != lane.end() ? *it : nullptr;
     
     if (closest != nullptr) {
         ENSURE(closest->getPosition() > vehicle->getPosition(), "Leading vehicle must be ahead");
@@ -235,6 +595,116 @@ Vehicle* Road::getLeadingVehicle(const Vehicle* vehicle) const {
     return closest;
 }
 
+/**
+ * @brief Appends the vehicles of one or all lanes with a position in [from, to].
+ * 
+ * @param from Start of the range. Must not exceed to.
+ * @param to End of the range.
+ * @param out Receives the vehicles, lane by lane.
+ * @param lane Lane index, or -1 for every lane.
+ */
+void Road::findVehicles(double from, double to, std::vector<Vehicle*>& out, int lane) const {
+    REQUIRE(from <= to, "Range must not be reversed");
+    REQUIRE(lane >= -1 && lane < getLaneCount(), "Lane out of range");
+    
+    int first = lane < 0 ? 0 : lane;
+    int last = lane < 0 ? getLaneCount() - 1 : lane;
+    for (int index = first; index <= last; index++) {
+        const std::vector<Vehicle*>& vehicles = lanes[index];
+        auto begin = std::lower_bound(vehicles.begin(), vehicles.end(), from, beforePosition);
+        auto end = std::upper_bound(begin, vehicles.end(), to, afterPosition);
+        out.insert(out.end(), begin, end);
+    }
+}
+
+/**
+ * @brief Counts the vehicles of one or all lanes with a position in [from, to].
+ * 
+ * @param from Start of the range. Must not exceed to.
+ * @param to End of the range.
+ * @param lane Lane index, or -1 for every lane.
+ * @return int Number of vehicles in the range.
+ */
+int Road::countVehicles(double from, double to, int lane) const {
+    REQUIRE(from <= to, "Range must not be reversed");
+    REQUIRE(lane >= -1 && lane < getLaneCount(), "Lane out of range");
+    
+    int first = lane < 0 ? 0 : lane;
+    int last = lane < 0 ? getLaneCount() - 1 : lane;
+    int count = 0;
+    for (int index = first; index <= last; index++) {
+        const std::vector<Vehicle*>& vehicles = lanes[index];
+        auto begin = std::lower_bound(vehicles.begin(), vehicles.end(), from, beforePosition);
+        count += static_cast<int>(std::upper_bound(begin, vehicles.end(), to, afterPosition) - begin);
+    }
+    ENSURE(count >= 0, "Count must not be negative");
+    return count;
+}
+
+/**
+ * @brief Finds the vehicle closest to a position in one or all lanes.
+ * 
+ * Only the two neighbours of the position in each lane are candidates.
+ * 
+ * @param position Position on the road.
+ * @param lane Lane index, or -1 for every lane.
+ * @return Vehicle* The closest vehicle, or nullptr if there is none.
+ */
+Vehicle* Road::findNearestVehicle(double position, int lane) const {
+    REQUIRE(lane >= -1 && lane < getLaneCount(), "Lane out of range");
+    
+    int first = lane < 0 ? 0 : lane;
+    int last = lane < 0 ? getLaneCount() - 1 : lane;
+    Vehicle* nearest = nullptr;
+    double nearestDistance = std::numeric_limits<double>::infinity();
+    for (int index = first; index <= last; index++) {
+        const std::vector<Vehicle*>& vehicles = lanes[index];
+        auto it = std::lower_bound(vehicles.begin(), vehicles.end(), position, beforePosition);
+        if (it != vehicles.end() && (*it)->getPosition() - position < nearestDistance) {
+            nearest = *it;
+            nearestDistance = (*it)->getPosition() - position;
+        }
+        if (it != vehicles.begin() && position - (*(it - 1))->getPosition() < nearestDistance) {
+            nearest = *(it - 1);
+            nearestDistance = position - nearest->getPosition();
+        }
+    }
+    return nearest;
+}
+
+/**
+ * @brief Walks each lane upstream from a position while vehicles are slow and close together.
+ * 
+ * The walk starts with a binary search and stops at the first vehicle that is
+ * not queued, so the cost is O(lanes * log n + k) for k queued vehicles.
+ * 
+ * @param position Position of the stop line.
+ * @param maxSpeed Speed from which a vehicle is not queued. Must be positive.
+ * @param maxGap Largest gap within the queue. Must not be negative.
+ * @return Queue The queued vehicles and the longest lane queue.
+ */
+Road::Queue Road::getQueue(double position, double maxSpeed, double maxGap) const {
+    REQUIRE(maxSpeed > 0, "Queue speed must be positive");
+    REQUIRE(maxGap >= 0, "Queue gap must not be negative");
+    
+    Queue queue;
+    for (const std::vector<Vehicle*>& vehicles : lanes) {
+        auto it = std::upper_bound(vehicles.begin(), vehicles.end(), position, afterPosition);
+        double front = position;
+        while (it != vehicles.begin()) {
+            const Vehicle* vehicle = *(it - 1);
+            if (vehicle->getSpeed() >= maxSpeed || front - vehicle->getPosition() > maxGap)
+                break;
+            front = vehicle->getPosition() - vehicle->getLength();
+            queue.vehicles++;
+            --it;
+        }
+        queue.length = std::max(queue.length, position - front);
+    }
+    ENSURE(queue.vehicles >= 0 && queue.length >= 0, "Queue must not be negative");
+    return queue;
+}
+
 /**
  * @brief Removes a vehicle from the road.
  * 
@@ -243,10 +713,17 @@ Vehicle* Road::getLeadingVehicle(const Vehicle* vehicle) const {
 void Road::removeVehicle(Vehicle* vehicle) {
     REQUIRE(vehicle != nullptr, "Vehicle cannot be null");
     
-    size_t oldSize = vehicles.size();
+    CONTRACT_OLD(size_t, oldSize, vehicles.size());
     auto it = std::find(vehicles.begin(), vehicles.end(), vehicle);
     if (it != vehicles.end()) {
         vehicles.erase(it);
+        // Vehicle::setLane may have changed the lane since the vehicle was added
+        if (!eraseFrom(lanes[std::min(vehicle->getLane(), getLaneCount() - 1)], vehicle)) {
+            for (std::vector<Vehicle*>& lane : lanes) {
+                if (eraseFrom(lane, vehicle))
+                    break;
+            }
+        }
         ENSURE(vehicles.size() == oldSize - 1, "Vehicle was not removed properly");
     }
 }
@@ -270,3 +747,37 @@ Road* Road::getRoadByName(const std::string& roadName, const std::vector<Road*>&
     }
     return nullptr;
 }
+
+/**
+ * @brief Replaces every entity pointer of a copied road by its copy.
+ * @param map Originals to copies.
+ */
+void Road::rebind(const CloneMap& map) {
+    map.remap(vehicles);
+    for (auto& lane : lanes)
+        map.remap(lane);
+    map.remap(exitedVehicles);
+    map.remap(lights);
+    map.remap(detectors);
+    map.remap(roads);
+    map.remap(busStops);
+    map.remap(intersections);
+}
+
+/**
+ * @brief Passes a move to the detectors whose front or rear line lies within it.
+ *
+ * Only detectors between from - length and to are visited, found by binary search.
+ *
+ * @param vehicle The vehicle that moved.
+ * @param from Position before the move.
+ * @param to Position after the move.
+ * @param dt Length of the step.
+ */
+void Road::recordDetectors(const Vehicle* vehicle, double from, double to, double dt) {
+    double first = from - vehicle->getLength();
+    auto it = std::upper_bound(detectors.begin(), detectors.end(), first,
+                               [](double position, const Detector* d) { return position < d->getPosition(); });
+    for (; it != detectors.end() && (*it)->getPosition() <= to; ++it)
+        (*it)->recordMove(vehicle, from, to, dt);
+}
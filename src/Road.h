@@ -9,26 +9,66 @@ class TrafficLight;
 class Intersection;
 class BusStop;
 class VehicleGenerator;
+class CloneMap;
+class Detector;
 
 /**
  * @class Road
  * @brief Represents a road in the traffic simulation.
  * 
  * Stores vehicles, traffic lights, bus stops, intersections, and connected roads.
+ * A road has one or more lanes; each lane keeps its vehicles ordered by position,
+ * so leaders and followers are neighbours in that sequence.
+ *
+ * Connected roads (addRoad) are successors: a vehicle that reaches the end of the
+ * road continues on the successor its route leads to, or on the first successor,
+ * and the last vehicle of a lane sees the rearmost vehicle of that successor's
+ * lane as its leader.
  */
 class Road {
 public:
     /**
-     * @brief Constructs a Road with a name and length.
+     * @brief Rearmost vehicle of a lane, as recorded by captureTail().
+     */
+    struct Tail {
+        bool present = false;  ///< Whether the lane had a vehicle.
+        double position = 0;   ///< Position of the rearmost vehicle.
+        double speed = 0;      ///< Speed of the rearmost vehicle.
+    };
+
+    /**
+     * @brief Running sums of the traffic on the road since it was created.
+     * Interval aggregates are differences of two snapshots (see RoadMetrics).
+     */
+    struct Totals {
+        double vehicleSeconds = 0;  ///< Time spent on the road, summed over vehicles.
+        double vehicleMetres = 0;   ///< Distance driven on the road, summed over vehicles.
+        long long entries = 0;      ///< Vehicles added to the road.
+        long long exits = 0;        ///< Vehicles that left it at its end or at an intersection.
+    };
+
+    /**
+     * @brief Queue behind a position, as measured by getQueue().
+     */
+    struct Queue {
+        int vehicles = 0;    ///< Queued vehicles, summed over the lanes.
+        double length = 0;   ///< Distance from the position to the rear of the last queued vehicle, longest lane.
+    };
+
+    /**
+     * @brief Constructs a Road with a name, length and number of lanes.
      * Length is set to minimum 100 if smaller.
      * 
      * @param name Name of the road.
      * @param length Length of the road.
+     * @param laneCount Number of lanes.
      * @pre length >= 0
+     * @pre laneCount >= 1
      * @post getName() == name
      * @post getLength() >= 100
+     * @post getLaneCount() == laneCount
      */
-    Road(const std::string& name, int length);
+    Road(const std::string& name, int length, int laneCount = 1);
 
     /**
      * @brief Gets the name of the road.
@@ -45,13 +85,36 @@ public:
     int getLength() const;
 
     /**
-     * @brief Adds a vehicle to the road.
+     * @brief Gets the number of lanes.
+     * @return int Number of lanes, at least 1.
+     */
+    int getLaneCount() const;
+
+    /**
+     * @brief Gets the vehicles in one lane, ordered by increasing position.
+     * @param lane Lane index.
+     * @return const std::vector<Vehicle*>& Vehicles in the lane.
+     * @pre 0 <= lane < getLaneCount()
+     */
+    const std::vector<Vehicle*>& getLaneVehicles(int lane) const;
+
+    /**
+     * @brief Adds a vehicle to the road, in the lane it reports.
+     * A vehicle whose lane does not exist on this road is moved to the leftmost lane.
      * @param vehicle Pointer to the vehicle.
      * @pre vehicle != nullptr
      * @post getVehicles().size() increased by 1
      */
     void addVehicle(Vehicle* vehicle);
 
+    /**
+     * @brief Finds the rightmost lane whose entry is clear for a new vehicle.
+     * A lane is clear when no vehicle is past the start but within the clearance.
+     * @param clearance Distance from the start of the road that must be free.
+     * @return Lane index, or -1 if every lane's entry is occupied.
+     */
+    int findFreeEntryLane(double clearance) const;
+
     /**
      * @brief Adds a traffic light to the road.
      * @param light Pointer to the traffic light.
@@ -61,7 +124,22 @@ public:
     void addTrafficLight(TrafficLight* light);
 
     /**
-     * @brief Adds a connected road.
+     * @brief Adds a loop detector to the road; detectors are kept in position order.
+     * @param detector Pointer to the detector.
+     * @pre detector != nullptr
+     * @pre detector->getRoad() == this
+     * @post getDetectors().size() increased by 1
+     */
+    void addDetector(Detector* detector);
+
+    /**
+     * @brief Gets the loop detectors on the road.
+     * @return Detectors sorted by position.
+     */
+    const std::vector<Detector*>& getDetectors() const;
+
+    /**
+     * @brief Adds a connected road that vehicles continue on after this one.
      * @param road Pointer to the connected road.
      * @pre road != nullptr
      * @post getRoads().size() increased by 1
@@ -84,11 +162,80 @@ public:
      */
     void addIntersection(Intersection* intersection);
 
+    /**
+     * @brief Gets the road vehicles continue on after the end of this one.
+     * @return Road* The first connected road, or nullptr if this road is a dead end.
+     */
+    Road* getSuccessor() const;
+
+    /**
+     * @brief Gets the road a particular vehicle continues on after the end of this one.
+     * A routed vehicle continues on its next road if that is a successor, and leaves
+     * the network at the end of its destination; other vehicles take getSuccessor().
+     * @param vehicle The vehicle.
+     * @return Road* The road to continue on, or nullptr if the vehicle leaves.
+     * @pre vehicle != nullptr
+     */
+    Road* getSuccessor(const Vehicle* vehicle) const;
+
+    /**
+     * @brief Records the rearmost vehicle of every lane.
+     * The Simulation calls this for all roads before updating any of them, so what
+     * a predecessor sees across the boundary does not depend on the update order.
+     * @post getTail(lane) describes the rearmost vehicle of each lane
+     */
+    void captureTail();
+
+    /**
+     * @brief Gets the rearmost vehicle of a lane as of the last captureTail().
+     * @param lane Lane index; lanes beyond getLaneCount() map to the leftmost lane.
+     * @return const Tail& The recorded tail.
+     * @pre lane >= 0
+     */
+    const Tail& getTail(int lane) const;
+
+    /**
+     * @brief Overwrites the recorded tail of a lane.
+     * Used when another process steps this road and sends its tail over.
+     * @param lane Lane index.
+     * @param tail The tail, in this road's coordinates.
+     * @pre 0 <= lane < getLaneCount()
+     * @post getTail(lane) equals tail
+     */
+    void setTail(int lane, const Tail& tail);
+
     /**
      * @brief Updates all vehicles and road state for a simulation step.
+     * Accelerations are computed first for all vehicles, then lane changes are
+     * decided (on multi-lane roads), and finally vehicles are moved.
+     * The last vehicle of a lane follows the successor's tail (see captureTail()).
+     * Vehicles that reach the end of the road are removed and collected in getExitedVehicles();
+     * the Simulation moves them to the successor after all roads have been updated.
+     * @param dt Length of the step in seconds.
+     * @pre dt > 0
      * @post state of vehicles and road updated appropriately
      */
-    void update();
+    void update(double dt);
+
+    /**
+     * @brief Gets the vehicles that left this road at its end since the last clearExitedVehicles().
+     * The road no longer references them; the owner (usually the Simulation) must release them.
+     * @return const std::vector<Vehicle*>& Vector of vehicle pointers.
+     */
+    const std::vector<Vehicle*>& getExitedVehicles() const;
+
+    /**
+     * @brief Gets the running traffic sums of the road.
+     * Every vehicle adds the step length and the distance it drove here in each update().
+     * @return The sums.
+     */
+    const Totals& getTotals() const;
+
+    /**
+     * @brief Forgets the exited vehicles.
+     * @post getExitedVehicles().empty()
+     */
+    void clearExitedVehicles();
 
     /**
      * @brief Gets the vehicles on the road.
@@ -127,6 +274,53 @@ public:
      */
     Vehicle* getLeadingVehicle(const Vehicle* vehicle) const;
 
+    /**
+     * @brief Finds the vehicles with a position in [from, to].
+     * Each lane is binary-searched, so the cost is O(lanes * log n + k).
+     * @param from Start of the range in metres.
+     * @param to End of the range in metres.
+     * @param out Receives the vehicles, lane by lane, each lane ordered by position.
+     * @param lane Lane index, or -1 for every lane.
+     * @pre from <= to
+     * @pre -1 <= lane < getLaneCount()
+     */
+    void findVehicles(double from, double to, std::vector<Vehicle*>& out, int lane = -1) const;
+
+    /**
+     * @brief Counts the vehicles with a position in [from, to] without visiting them.
+     * @param from Start of the range in metres.
+     * @param to End of the range in metres.
+     * @param lane Lane index, or -1 for every lane.
+     * @return int Number of vehicles in the range.
+     * @pre from <= to
+     * @pre -1 <= lane < getLaneCount()
+     */
+    int countVehicles(double from, double to, int lane = -1) const;
+
+    /**
+     * @brief Finds the vehicle closest to a position, ahead or behind.
+     * @param position Position in metres.
+     * @param lane Lane index, or -1 for every lane.
+     * @return Vehicle* The closest vehicle, or nullptr if the lanes are empty.
+     * @pre -1 <= lane < getLaneCount()
+     */
+    Vehicle* findNearestVehicle(double position, int lane = -1) const;
+
+    /**
+     * @brief Measures the queue of slow vehicles standing behind a position, such as a stop line.
+     *
+     * Per lane the queue starts at the last vehicle at or before the position, if
+     * it is within maxGap of it, and continues upstream while vehicles are slower
+     * than maxSpeed and at most maxGap behind the vehicle in front.
+     *
+     * @param position Position of the stop line in metres.
+     * @param maxSpeed Vehicles at this speed or faster are not queued, in m/s.
+     * @param maxGap Largest bumper-to-bumper gap within the queue, in metres.
+     * @return Queue Vehicles queued on all lanes and the length of the longest lane queue.
+     * @pre maxSpeed > 0 && maxGap >= 0
+     */
+    Queue getQueue(double position, double maxSpeed = 2.0, double maxGap = 10.0) const;
+
     /**
      * @brief Removes a vehicle from the road.
      * @param vehicle Pointer to the vehicle to remove.
@@ -145,11 +339,40 @@ public:
      */
     static Road* getRoadByName(const std::string& roadName, const std::vector<Road*>& roads);
 
+    /**
+     * @brief Points a copied road at the copies of its vehicles, lights, stops, intersections and successors.
+     * @param map Originals to copies.
+     */
+    void rebind(const CloneMap& map);
+
 private:
+    /**
+     * @brief Decides and applies MOBIL lane changes towards one side.
+     * Each source lane is walked together with its target lane, so the leader and
+     * follower in the target lane are found without searching.
+     * @param direction +1 to change to the left, -1 to change to the right.
+     */
+    void changeLanes(int direction);
+
+    /**
+     * @brief Restores the position order of every lane.
+     * Lanes are nearly sorted after a step, so an insertion sort is linear in practice.
+     */
+    void sortLanes();
+
+    /** @brief Reports a vehicle move to the detectors it may have passed. */
+    void recordDetectors(const Vehicle* vehicle, double from, double to, double dt);
+
     std::string name;
     int length;
+    int laneChangeParity;
     std::vector<Vehicle*> vehicles;
+    std::vector<std::vector<Vehicle*>> lanes;
+    std::vector<Tail> tails;
+    Totals totals;
+    std::vector<Vehicle*> exitedVehicles;
     std::vector<TrafficLight*> lights;
+    std::vector<Detector*> detectors;
     std::vector<Road*> roads;
     std::vector<BusStop*> busStops;
     std::vector<Intersection*> intersections;
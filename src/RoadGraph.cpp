@@ -0,0 +1,240 @@
+#include "RoadGraph.h"
+#include "Road.h"
+#include "Intersection.h"
+#include "DesignByContract.h"
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <queue>
+#include <tuple>
+#include <utility>
+
+const double RoadGraph::UNREACHABLE = std::numeric_limits<double>::infinity();
+
+namespace {
+
+/**
+ * @brief Lays out (source, target, weight) edges as CSR arrays, grouped by source.
+ */
+void buildCsr(int nodeCount,
+              const std::vector<std::tuple<int, int, double>>& edges,
+              bool reverse,
+              std::vector<std::int32_t>& offsets,
+              std::vector<std::int32_t>& targets,
+              std::vector<double>& weights) {
+    offsets.assign(nodeCount + 1, 0);
+    for (const auto& edge : edges)
+        offsets[(reverse ? std::get<1>(edge) : std::get<0>(edge)) + 1]++;
+    for (int node = 0; node < nodeCount; node++)
+        offsets[node + 1] += offsets[node];
+
+    targets.resize(edges.size());
+    weights.resize(edges.size());
+    std::vector<std::int32_t> fill(offsets.begin(), offsets.end() - 1);
+    for (const auto& edge : edges) {
+        int from = reverse ? std::get<1>(edge) : std::get<0>(edge);
+        int to = reverse ? std::get<0>(edge) : std::get<1>(edge);
+        targets[fill[from]] = to;
+        weights[fill[from]] = std::get<2>(edge);
+        fill[from]++;
+    }
+}
+
+} // namespace
+
+/**
+ * @brief Creates an empty graph.
+ */
+RoadGraph::RoadGraph() {
+    build({}, {});
+    ENSURE(getRoadCount() == 0, "New graph must be empty");
+}
+
+/**
+ * @brief Compiles roads and intersections into CSR arrays.
+ *
+ * Parallel connections between the same two roads are merged, keeping the shortest.
+ *
+ * @param roads The roads; their order defines the node indices.
+ * @param intersections The intersections between the roads.
+ */
+void RoadGraph::build(const std::vector<Road*>& roads, const std::vector<Intersection*>& intersections) {
+    this->roads = roads;
+    indices.clear();
+    for (size_t i = 0; i < roads.size(); i++)
+        indices[roads[i]] = static_cast<int>(i);
+
+    std::vector<std::tuple<int, int, double>> edges;
+    for (size_t i = 0; i < roads.size(); i++) {
+        for (const Road* successor : roads[i]->getRoads()) {
+            int target = indexOf(successor);
+            if (target >= 0)
+                edges.emplace_back(static_cast<int>(i), target, roads[i]->getLength());
+        }
+    }
+    for (const Intersection* intersection : intersections) {
+        int source = indexOf(intersection->getEntryRoad());
+        int target = indexOf(intersection->getExitRoad());
+        REQUIRE(source >= 0 && target >= 0, "Intersection must connect roads of the graph");
+        edges.emplace_back(source, target, intersection->getEntryPosition());
+    }
+
+    // Keep only the shortest of parallel edges
+    std::sort(edges.begin(), edges.end());
+    edges.erase(std::unique(edges.begin(), edges.end(),
+                            [](const std::tuple<int, int, double>& a, const std::tuple<int, int, double>& b) {
+                                return std::get<0>(a) == std::get<0>(b) && std::get<1>(a) == std::get<1>(b);
+                            }),
+                edges.end());
+
+    int nodeCount = static_cast<int>(roads.size());
+    buildCsr(nodeCount, edges, false, outOffsets, outTargets, outWeights);
+    buildCsr(nodeCount, edges, true, inOffsets, inSources, inWeights);
+
+    trees.assign(roads.size(), Tree());
+    treeBuilt.reset(new std::once_flag[roads.size()]);
+
+    ENSURE(getRoadCount() == nodeCount, "Graph must have a node per road");
+    ENSURE(static_cast<int>(inSources.size()) == getEdgeCount(), "Reverse graph must have the same edges");
+}
+
+/**
+ * @brief Returns the number of nodes.
+ * @return Road count.
+ */
+int RoadGraph::getRoadCount() const {
+    return static_cast<int>(roads.size());
+}
+
+/**
+ * @brief Returns the number of edges.
+ * @return Edge count.
+ */
+int RoadGraph::getEdgeCount() const {
+    return static_cast<int>(outTargets.size());
+}
+
+/**
+ * @brief Looks up the node index of a road.
+ * @param road The road.
+ * @return Its index, or -1.
+ */
+int RoadGraph::indexOf(const Road* road) const {
+    auto it = indices.find(road);
+    return it == indices.end() ? -1 : it->second;
+}
+
+/**
+ * @brief Returns the road of a node.
+ * @param index Node index.
+ * @return The road.
+ */
+Road* RoadGraph::getRoad(int index) const {
+    REQUIRE(index >= 0 && index < getRoadCount(), "Node index out of range");
+    return roads[index];
+}
+
+/**
+ * @brief Next road towards a destination, from the destination's tree.
+ * @param from Current road.
+ * @param destination Destination road.
+ * @return The next road, or nullptr.
+ */
+Road* RoadGraph::nextRoad(const Road* from, const Road* destination) const {
+    int source = indexOf(from);
+    int target = indexOf(destination);
+    if (source < 0 || target < 0 || source == target)
+        return nullptr;
+    int next = tree(target).next[source];
+    return next < 0 ? nullptr : roads[next];
+}
+
+/**
+ * @brief Length of the shortest route.
+ * @param from Start road.
+ * @param destination Destination road.
+ * @return Distance, or UNREACHABLE.
+ */
+double RoadGraph::distance(const Road* from, const Road* destination) const {
+    int source = indexOf(from);
+    int target = indexOf(destination);
+    if (source < 0 || target < 0)
+        return UNREACHABLE;
+    return tree(target).distance[source];
+}
+
+/**
+ * @brief Follows the next-road links from the start to the destination.
+ * @param from Start road.
+ * @param destination Destination road.
+ * @return The roads on the route, or an empty vector.
+ */
+std::vector<Road*> RoadGraph::route(const Road* from, const Road* destination) const {
+    std::vector<Road*> result;
+    int source = indexOf(from);
+    int target = indexOf(destination);
+    if (source < 0 || target < 0 || tree(target).distance[source] == UNREACHABLE)
+        return result;
+
+    const Tree& towards = tree(target);
+    for (int node = source; node >= 0; node = towards.next[node]) {
+        result.push_back(roads[node]);
+        if (node == target)
+            break;
+    }
+    ENSURE(result.back() == destination, "Route must end at the destination");
+    return result;
+}
+
+/**
+ * @brief Builds the tree of a destination if it does not exist yet.
+ * @param destination The destination road.
+ */
+void RoadGraph::precompute(const Road* destination) const {
+    REQUIRE(indexOf(destination) >= 0, "Destination must be in the graph");
+    tree(indexOf(destination));
+}
+
+/**
+ * @brief Returns the tree of a destination, building it exactly once.
+ * @param destination Destination node.
+ * @return The tree.
+ */
+const RoadGraph::Tree& RoadGraph::tree(int destination) const {
+    std::call_once(treeBuilt[destination], [this, destination]() {
+        buildTree(destination, trees[destination]);
+    });
+    return trees[destination];
+}
+
+/**
+ * @brief Dijkstra over the reverse graph, recording each node's next hop.
+ * @param destination Destination node.
+ * @param result Tree to fill.
+ */
+void RoadGraph::buildTree(int destination, Tree& result) const {
+    result.distance.assign(roads.size(), UNREACHABLE);
+    result.next.assign(roads.size(), -1);
+
+    using Entry = std::pair<double, int>;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> queue;
+    result.distance[destination] = 0;
+    queue.emplace(0, destination);
+
+    while (!queue.empty()) {
+        Entry top = queue.top();
+        queue.pop();
+        int node = top.second;
+        if (top.first > result.distance[node])
+            continue;
+        for (int edge = inOffsets[node]; edge < inOffsets[node + 1]; edge++) {
+            int source = inSources[edge];
+            double candidate = top.first + inWeights[edge];
+            if (candidate < result.distance[source]) {
+                result.distance[source] = candidate;
+                result.next[source] = node;
+                queue.emplace(candidate, source);
+            }
+        }
+    }
+}
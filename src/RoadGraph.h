@@ -0,0 +1,131 @@
+#ifndef ROADGRAPH_H
+#define ROADGRAPH_H
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+class Road;
+class Intersection;
+
+/**
+ * @class RoadGraph
+ * @brief Road network compiled into a CSR adjacency graph with shortest-path routing.
+ *
+ * Every road is a node, numbered in the order the roads were given. There is an
+ * edge for every successor link (Road::addRoad), weighted with the length of the
+ * road, and one for every intersection, weighted with the distance from the start
+ * of the entry road to the intersection.
+ *
+ * Routes are answered from per-destination shortest-path trees: the first query
+ * for a destination runs one reverse Dijkstra over the whole graph and stores,
+ * for every road, the next road towards that destination. Every later query for
+ * that destination is a single array lookup. Trees are built at most once, also
+ * when several threads query the same destination at the same time.
+ */
+class RoadGraph {
+public:
+    /// Distance reported for unreachable roads.
+    static const double UNREACHABLE;
+
+    /**
+     * @brief Creates an empty graph.
+     * @post getRoadCount() == 0
+     */
+    RoadGraph();
+
+    RoadGraph(const RoadGraph&) = delete;
+    RoadGraph& operator=(const RoadGraph&) = delete;
+
+    /**
+     * @brief Compiles the graph, discarding all cached routes.
+     * @param roads Nodes of the graph, in index order.
+     * @param intersections Intersections between those roads.
+     * @pre every intersection connects roads in roads
+     * @post getRoadCount() == roads.size()
+     */
+    void build(const std::vector<Road*>& roads, const std::vector<Intersection*>& intersections);
+
+    /** @brief Returns the number of roads (nodes). */
+    int getRoadCount() const;
+
+    /** @brief Returns the number of connections (edges). */
+    int getEdgeCount() const;
+
+    /**
+     * @brief Returns the node index of a road.
+     * @return Index in [0, getRoadCount()), or -1 if the road is not in the graph.
+     */
+    int indexOf(const Road* road) const;
+
+    /**
+     * @brief Returns the road at a node index.
+     * @pre 0 <= index < getRoadCount()
+     */
+    Road* getRoad(int index) const;
+
+    /**
+     * @brief Returns the next road on a shortest route.
+     * @param from Road the vehicle is on.
+     * @param destination Road the vehicle is heading to.
+     * @return The road to continue on, or nullptr if from is the destination,
+     *         the destination is unreachable, or a road is not in the graph.
+     */
+    Road* nextRoad(const Road* from, const Road* destination) const;
+
+    /**
+     * @brief Returns the length of a shortest route.
+     * @return Distance in meters, or UNREACHABLE.
+     */
+    double distance(const Road* from, const Road* destination) const;
+
+    /**
+     * @brief Returns a whole shortest route.
+     * @return The roads from from to destination inclusive, or an empty vector if unreachable.
+     */
+    std::vector<Road*> route(const Road* from, const Road* destination) const;
+
+    /**
+     * @brief Builds the shortest-path tree of a destination ahead of time.
+     * @param destination Road to build the tree for.
+     * @pre indexOf(destination) >= 0
+     */
+    void precompute(const Road* destination) const;
+
+private:
+    /**
+     * @brief Shortest-path tree towards one destination.
+     */
+    struct Tree {
+        std::vector<double> distance;  ///< Distance from every node to the destination.
+        std::vector<std::int32_t> next;  ///< Next node towards the destination, or -1.
+    };
+
+    /**
+     * @brief Returns the tree of a destination, building it on first use.
+     */
+    const Tree& tree(int destination) const;
+
+    /**
+     * @brief Runs a reverse Dijkstra from destination over the incoming edges.
+     */
+    void buildTree(int destination, Tree& result) const;
+
+    std::vector<Road*> roads;
+    std::unordered_map<const Road*, int> indices;
+
+    // Forward and reverse adjacency in CSR form
+    std::vector<std::int32_t> outOffsets;
+    std::vector<std::int32_t> outTargets;
+    std::vector<double> outWeights;
+    std::vector<std::int32_t> inOffsets;
+    std::vector<std::int32_t> inSources;
+    std::vector<double> inWeights;
+
+    mutable std::vector<Tree> trees;
+    mutable std::unique_ptr<std::once_flag[]> treeBuilt;
+};
+
+#endif // ROADGRAPH_H
@@ -0,0 +1,99 @@
+#include "RoadMetrics.h"
+#include "DesignByContract.h"
+#include <ostream>
+
+/**
+ * @brief Creates the metrics; the first interval starts at time 0.
+ * @param period Seconds per interval.
+ */
+RoadMetrics::RoadMetrics(double period)
+    : period(period), intervalStart(0)
+{
+    REQUIRE(period > 0, "The aggregation period must be positive");
+}
+
+/**
+ * @brief Returns the period.
+ * @return Seconds per interval.
+ */
+double RoadMetrics::getPeriod() const {
+    return period;
+}
+
+/**
+ * @brief Takes the sums of every road as the baseline of the first interval.
+ * @param time Current simulation time.
+ * @param roads Roads to measure.
+ */
+void RoadMetrics::start(double time, const std::vector<Road*>& roads) {
+    intervalStart = time;
+    baseline.clear();
+    for (const Road* road : roads)
+        baseline.push_back(road->getTotals());
+    latest.clear();
+    ENSURE(getLatest().empty(), "A started interval has no measures");
+}
+
+/**
+ * @brief Derives the measures of every road from its sums and starts the next interval.
+ * @param time Simulation time after the step.
+ * @param roads Roads to measure.
+ * @return Whether an interval was closed.
+ */
+bool RoadMetrics::advance(double time, const std::vector<Road*>& roads) {
+    if (time < intervalStart + period - 1e-9)
+        return false;
+
+    baseline.resize(roads.size());
+    latest.resize(roads.size());
+    double seconds = time - intervalStart;
+    for (std::size_t i = 0; i < roads.size(); i++) {
+        const Road::Totals& now = roads[i]->getTotals();
+        const Road::Totals& then = baseline[i];
+        double vehicleSeconds = now.vehicleSeconds - then.vehicleSeconds;
+        double vehicleMetres = now.vehicleMetres - then.vehicleMetres;
+        double area = seconds * roads[i]->getLength();
+
+        Aggregate& aggregate = latest[i];
+        aggregate.road = roads[i];
+        aggregate.start = intervalStart;
+        aggregate.end = time;
+        aggregate.entries = now.entries - then.entries;
+        aggregate.exits = now.exits - then.exits;
+        aggregate.flow = vehicleMetres / area * 3600.0;
+        aggregate.density = vehicleSeconds / area * 1000.0;
+        aggregate.speed = vehicleSeconds > 0 ? vehicleMetres / vehicleSeconds : 0;
+        baseline[i] = now;
+    }
+    intervalStart = time;
+    return true;
+}
+
+/**
+ * @brief Returns the measures of the last closed interval.
+ * @return One aggregate per road.
+ */
+const std::vector<RoadMetrics::Aggregate>& RoadMetrics::getLatest() const {
+    return latest;
+}
+
+/**
+ * @brief Writes the column names.
+ * @param out Output stream.
+ */
+void RoadMetrics::writeCsvHeader(std::ostream& out) {
+    out << "begin,einde,baan,ingereden,uitgereden,debiet,dichtheid,snelheid\n";
+}
+
+/**
+ * @brief Writes the aggregates as CSV lines.
+ * @param out Output stream.
+ * @param aggregates Measures to write.
+ */
+void RoadMetrics::writeCsv(std::ostream& out, const std::vector<Aggregate>& aggregates) {
+    for (const Aggregate& aggregate : aggregates) {
+        out << aggregate.start << "," << aggregate.end << "," << aggregate.road->getName() << ","
+            << aggregate.entries << "," << aggregate.exits << "," << aggregate.flow << ","
+            << aggregate.density << "," << aggregate.speed << "\n";
+    }
+}
@@ -0,0 +1,89 @@
+#ifndef ROADMETRICS_H
+#define ROADMETRICS_H
+
+#include "Road.h"
+#include <iosfwd>
+#include <vector>
+
+/**
+ * @class RoadMetrics
+ * @brief Turns the running sums of the roads into per-interval traffic measures.
+ *
+ * Roads keep running sums of vehicle-seconds, vehicle-metres, entries and exits
+ * while they update (see Road::getTotals()). At the end of every period the
+ * measures of each road follow from the difference with the sums at the start
+ * of the period, so closing an interval costs O(roads) however many vehicles
+ * drove. Flow, density and space-mean speed use Edie's definitions over the
+ * road and the interval, so flow = density * speed.
+ */
+class RoadMetrics {
+public:
+    /**
+     * @brief Measures of one road over one interval.
+     */
+    struct Aggregate {
+        const Road* road = nullptr;
+        double start = 0;        ///< Simulation time at the start.
+        double end = 0;          ///< Simulation time at the end.
+        long long entries = 0;   ///< Vehicles that entered the road.
+        long long exits = 0;     ///< Vehicles that left the road.
+        double flow = 0;         ///< Vehicles per hour (vehicle-metres over road length and time).
+        double density = 0;      ///< Vehicles per kilometre (vehicle-seconds over road length and time).
+        double speed = 0;        ///< Space-mean speed in m/s, or 0 if the road was empty.
+    };
+
+    /**
+     * @brief Creates the metrics for a fixed period.
+     * @param period Seconds per interval.
+     * @pre period > 0
+     */
+    explicit RoadMetrics(double period);
+
+    /** @brief Returns the seconds per interval. */
+    double getPeriod() const;
+
+    /**
+     * @brief Starts the first interval.
+     * @param time Current simulation time.
+     * @param roads Roads to measure.
+     * @post getLatest().empty()
+     */
+    void start(double time, const std::vector<Road*>& roads);
+
+    /**
+     * @brief Closes the interval if the period is over.
+     * Intervals end on the first step at or after their nominal end. Roads added
+     * after start() are measured from their creation.
+     * @param time Simulation time after the step.
+     * @param roads Roads to measure, in the order passed to start().
+     * @return Whether an interval was closed; its measures are in getLatest().
+     */
+    bool advance(double time, const std::vector<Road*>& roads);
+
+    /**
+     * @brief Returns the measures of the last closed interval, one per road.
+     * @return The measures, in road order.
+     */
+    const std::vector<Aggregate>& getLatest() const;
+
+    /**
+     * @brief Writes the CSV header of writeCsv().
+     * @param out Stream to write to.
+     */
+    static void writeCsvHeader(std::ostream& out);
+
+    /**
+     * @brief Writes one CSV line per aggregate.
+     * @param out Stream to write to.
+     * @param aggregates Measures to write.
+     */
+    static void writeCsv(std::ostream& out, const std::vector<Aggregate>& aggregates);
+
+private:
+    double period;
+    double intervalStart;
+    std::vector<Road::Totals> baseline;  ///< Sums of each road at intervalStart.
+    std::vector<Aggregate> latest;
+};
+
+#endif // ROADMETRICS_H
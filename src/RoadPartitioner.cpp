@@ -0,0 +1,495 @@
+#include "RoadPartitioner.h"
+#include "Simulation.h"
+#include "Road.h"
+#include "VehicleGenerator.h"
+#include "Intersection.h"
+#include "DesignByContract.h"
+#include <algorithm>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <numeric>
+#include <stdexcept>
+#include <tuple>
+#include <unordered_map>
+
+namespace {
+
+/// Speed used to turn a flow into vehicles on a road (the free speed of a vehicle).
+const double FREE_SPEED = 16.6;
+/// Load of an empty road, so that stepping it still counts.
+const double ROAD_BASE_LOAD = 0.1;
+/// Weight of an unused link, so that adjacency still breaks ties in the cut.
+const double LINK_BASE_WEIGHT = 0.01;
+/// Maximum number of refinement passes per level.
+const int REFINE_PASSES = 8;
+
+/**
+ * @brief Undirected weighted graph of one coarsening level.
+ */
+struct Graph {
+    std::vector<double> weights;
+    std::vector<std::vector<std::pair<int, double>>> edges;
+
+    int size() const {
+        return static_cast<int>(weights.size());
+    }
+};
+
+/**
+ * @brief Builds a graph from vertex weights and (possibly repeated) weighted edges.
+ * Edges within one vertex are dropped and parallel edges are merged.
+ */
+Graph makeGraph(std::vector<double> weights, const std::vector<std::tuple<int, int, double>>& edges) {
+    Graph graph;
+    graph.weights = std::move(weights);
+    std::vector<std::map<int, double>> merged(graph.size());
+    for (const auto& edge : edges) {
+        int a = std::get<0>(edge);
+        int b = std::get<1>(edge);
+        if (a == b)
+            continue;
+        merged[a][b] += std::get<2>(edge);
+        merged[b][a] += std::get<2>(edge);
+    }
+    graph.edges.resize(graph.size());
+    for (int v = 0; v < graph.size(); v++)
+        graph.edges[v].assign(merged[v].begin(), merged[v].end());
+    return graph;
+}
+
+/**
+ * @brief Heavy-edge matching: pairs every vertex with its heaviest unmatched neighbour.
+ * @param graph The graph to coarsen.
+ * @param maxWeight Heaviest vertex the coarse graph may get.
+ * @param coarse Receives the coarse vertex of each vertex.
+ * @return The coarse graph.
+ */
+Graph coarsen(const Graph& graph, double maxWeight, std::vector<int>& coarse) {
+    std::vector<int> order(graph.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(),
+                     [&graph](int a, int b) { return graph.weights[a] < graph.weights[b]; });
+
+    coarse.assign(graph.size(), -1);
+    std::vector<double> weights;
+    for (int v : order) {
+        if (coarse[v] >= 0)
+            continue;
+        int best = -1;
+        double bestWeight = -1;
+        for (const auto& edge : graph.edges[v]) {
+            int u = edge.first;
+            if (coarse[u] < 0 && edge.second > bestWeight && graph.weights[u] + graph.weights[v] <= maxWeight) {
+                best = u;
+                bestWeight = edge.second;
+            }
+        }
+        coarse[v] = static_cast<int>(weights.size());
+        weights.push_back(graph.weights[v]);
+        if (best >= 0) {
+            coarse[best] = coarse[v];
+            weights.back() += graph.weights[best];
+        }
+    }
+
+    std::vector<std::tuple<int, int, double>> edges;
+    for (int v = 0; v < graph.size(); v++) {
+        for (const auto& edge : graph.edges[v]) {
+            if (v < edge.first)
+                edges.emplace_back(coarse[v], coarse[edge.first], edge.second);
+        }
+    }
+    return makeGraph(std::move(weights), edges);
+}
+
+/**
+ * @brief Greedy initial split: heaviest vertices first, each into the partition it
+ * is most connected to among those it still fits in.
+ */
+std::vector<int> initialPartition(const Graph& graph, int k, double limit) {
+    std::vector<int> order(graph.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(),
+                     [&graph](int a, int b) { return graph.weights[a] > graph.weights[b]; });
+
+    std::vector<int> part(graph.size(), -1);
+    std::vector<double> load(k, 0);
+    for (int v : order) {
+        std::vector<double> connection(k, 0);
+        for (const auto& edge : graph.edges[v]) {
+            if (part[edge.first] >= 0)
+                connection[part[edge.first]] += edge.second;
+        }
+        int best = -1;
+        for (int p = 0; p < k; p++) {
+            if (load[p] + graph.weights[v] > limit)
+                continue;
+            if (best < 0 || connection[p] > connection[best]
+                || (connection[p] == connection[best] && load[p] < load[best]))
+                best = p;
+        }
+        if (best < 0)
+            best = static_cast<int>(std::min_element(load.begin(), load.end()) - load.begin());
+        part[v] = best;
+        load[best] += graph.weights[v];
+    }
+    return part;
+}
+
+/**
+ * @brief Moves boundary vertices to the neighbouring partition that reduces the cut
+ * most, or that relieves an overloaded partition, until no move helps.
+ */
+void refine(const Graph& graph, int k, double limit, std::vector<int>& part) {
+    std::vector<double> load(k, 0);
+    for (int v = 0; v < graph.size(); v++)
+        load[part[v]] += graph.weights[v];
+
+    for (int pass = 0; pass < REFINE_PASSES; pass++) {
+        bool moved = false;
+        for (int v = 0; v < graph.size(); v++) {
+            int own = part[v];
+            double weight = graph.weights[v];
+            std::map<int, double> connection;
+            for (const auto& edge : graph.edges[v])
+                connection[part[edge.first]] += edge.second;
+            double internal = connection[own];
+            bool overloaded = load[own] > limit;
+
+            int best = own;
+            double bestGain = 0;
+            for (const auto& candidate : connection) {
+                int target = candidate.first;
+                if (target == own || load[target] + weight > limit)
+                    continue;
+                double gain = candidate.second - internal;
+                bool balances = load[target] + weight < load[own];
+                if (gain > bestGain || (best == own && (overloaded || (gain == 0 && balances)))) {
+                    best = target;
+                    bestGain = gain;
+                }
+            }
+            if (best == own && overloaded) {
+                // No neighbour can take it, so relieve the partition through the lightest one
+                int lightest = static_cast<int>(std::min_element(load.begin(), load.end()) - load.begin());
+                if (load[lightest] + weight < load[own])
+                    best = lightest;
+            }
+            if (best != own) {
+                part[v] = best;
+                load[own] -= weight;
+                load[best] += weight;
+                moved = true;
+            }
+        }
+        if (!moved)
+            break;
+    }
+}
+
+} // namespace
+
+/**
+ * @brief Collects the roads, intersection groups and links, and estimates the loads.
+ *
+ * Generated flow enters on the generator's road and is split evenly over the
+ * successors of every road it reaches. A road carrying flow f for a length L
+ * holds about f * L / FREE_SPEED vehicles.
+ *
+ * @param simulation The loaded simulation.
+ */
+RoadPartitioner::RoadPartitioner(const Simulation& simulation)
+    : roads(simulation.getRoads())
+{
+    std::unordered_map<const Road*, int> indices;
+    for (std::size_t i = 0; i < roads.size(); i++)
+        indices[roads[i]] = static_cast<int>(i);
+
+    group.resize(roads.size());
+    std::iota(group.begin(), group.end(), 0);
+    std::function<int(int)> find = [&](int road) {
+        return group[road] == road ? road : group[road] = find(group[road]);
+    };
+    for (const Intersection* intersection : simulation.getIntersections()) {
+        int a = find(indices.at(intersection->getEntryRoad()));
+        int b = find(indices.at(intersection->getExitRoad()));
+        group[std::max(a, b)] = std::min(a, b);
+    }
+    for (std::size_t i = 0; i < roads.size(); i++)
+        group[i] = find(static_cast<int>(i));
+
+    for (std::size_t i = 0; i < roads.size(); i++) {
+        for (const Road* successor : roads[i]->getRoads()) {
+            auto it = indices.find(successor);
+            if (it != indices.end())
+                links.emplace_back(static_cast<int>(i), it->second);
+        }
+    }
+
+    // Propagate the generated flow; on cyclic networks this stops after one round per road
+    std::vector<double> generated(roads.size(), 0);
+    for (const VehicleGenerator* generator : simulation.getGenerators()) {
+        auto it = indices.find(generator->getRoad());
+        if (it != indices.end())
+            generated[it->second] += 1.0 / generator->getFrequency();
+    }
+    std::vector<double> flow = generated;
+    for (std::size_t round = 0; round < roads.size(); round++) {
+        std::vector<double> next = generated;
+        for (const auto& link : links)
+            next[link.second] += flow[link.first] / roads[link.first]->getRoads().size();
+        if (next == flow)
+            break;
+        flow = std::move(next);
+    }
+
+    loads.resize(roads.size());
+    for (std::size_t i = 0; i < roads.size(); i++) {
+        loads[i] = ROAD_BASE_LOAD + roads[i]->getVehicles().size()
+                 + flow[i] * roads[i]->getLength() / FREE_SPEED;
+    }
+    estimateTransfers();
+
+    ENSURE(loads.size() == roads.size(), "Every road must have a load");
+}
+
+/**
+ * @brief Replaces the loads and re-estimates the transfers.
+ * @param newLoads Load of each road.
+ */
+void RoadPartitioner::setLoads(const std::vector<double>& newLoads) {
+    REQUIRE(newLoads.size() == roads.size(), "Every road must have a load");
+    REQUIRE(std::all_of(newLoads.begin(), newLoads.end(), [](double load) { return load >= 0; }),
+            "Loads must be non-negative");
+
+    loads = newLoads;
+    estimateTransfers();
+
+    ENSURE(loads == newLoads, "Loads were not set");
+}
+
+/**
+ * @brief Returns the load of each road.
+ * @return Loads in road order.
+ */
+const std::vector<double>& RoadPartitioner::getLoads() const {
+    return loads;
+}
+
+/**
+ * @brief Averages the vehicle count of every road over a number of steps.
+ * @param simulation The simulation to step.
+ * @param steps Number of steps.
+ * @return Average vehicles per road.
+ */
+std::vector<double> RoadPartitioner::profileLoads(Simulation& simulation, int steps) {
+    REQUIRE(steps > 0, "steps must be positive");
+
+    std::vector<double> totals(simulation.getRoads().size(), 0);
+    for (int step = 0; step < steps; step++) {
+        simulation.runStep();
+        const std::vector<Road*>& roads = simulation.getRoads();
+        for (std::size_t i = 0; i < roads.size(); i++)
+            totals[i] += roads[i]->getVehicles().size();
+    }
+    for (double& total : totals)
+        total /= steps;
+    return totals;
+}
+
+/**
+ * @brief Partitions the intersection groups with a multilevel scheme.
+ *
+ * @param k Number of partitions.
+ * @param imbalance Allowed overload of a partition.
+ * @return Partition of each road.
+ */
+std::vector<int> RoadPartitioner::partition(int k, double imbalance) const {
+    REQUIRE(k > 0, "k must be positive");
+    REQUIRE(imbalance >= 0, "imbalance must be non-negative");
+
+    // Level 0: one vertex per intersection group
+    std::vector<int> vertexOf(roads.size(), -1);
+    std::vector<double> weights;
+    for (std::size_t i = 0; i < roads.size(); i++) {
+        if (vertexOf[group[i]] < 0) {
+            vertexOf[group[i]] = static_cast<int>(weights.size());
+            weights.push_back(0);
+        }
+        weights[vertexOf[group[i]]] += loads[i];
+    }
+    std::vector<std::tuple<int, int, double>> edges;
+    for (std::size_t l = 0; l < links.size(); l++)
+        edges.emplace_back(vertexOf[group[links[l].first]], vertexOf[group[links[l].second]], linkWeights[l]);
+
+    std::vector<Graph> levels{makeGraph(std::move(weights), edges)};
+    std::vector<std::vector<int>> maps;
+    double total = std::accumulate(levels[0].weights.begin(), levels[0].weights.end(), 0.0);
+    double limit = (1 + imbalance) * total / k;
+
+    // Coarsen until the graph is small or matching stops shrinking it
+    const int coarsest = std::max(8 * k, 16);
+    while (levels.back().size() > coarsest) {
+        std::vector<int> coarse;
+        Graph next = coarsen(levels.back(), limit / 2, coarse);
+        if (next.size() > levels.back().size() * 0.95)
+            break;
+        maps.push_back(std::move(coarse));
+        levels.push_back(std::move(next));
+    }
+
+    std::vector<int> part = initialPartition(levels.back(), k, limit);
+    refine(levels.back(), k, limit, part);
+    for (std::size_t level = levels.size() - 1; level > 0; level--) {
+        std::vector<int> finer(levels[level - 1].size());
+        for (std::size_t v = 0; v < finer.size(); v++)
+            finer[v] = part[maps[level - 1][v]];
+        part = std::move(finer);
+        refine(levels[level - 1], k, limit, part);
+    }
+
+    std::vector<int> owners(roads.size());
+    for (std::size_t i = 0; i < roads.size(); i++)
+        owners[i] = part[vertexOf[group[i]]];
+
+    ENSURE(owners.size() == roads.size(), "Every road must have a partition");
+    return owners;
+}
+
+/**
+ * @brief Sums the weights of the cut links.
+ * @param owners Partition of each road.
+ * @return Cut weight.
+ */
+double RoadPartitioner::cutWeight(const std::vector<int>& owners) const {
+    REQUIRE(owners.size() == roads.size(), "Every road must have a partition");
+
+    double cut = 0;
+    for (std::size_t l = 0; l < links.size(); l++) {
+        if (owners[links[l].first] != owners[links[l].second])
+            cut += linkWeights[l];
+    }
+    return cut;
+}
+
+/**
+ * @brief Sums the road loads of each partition.
+ * @param owners Partition of each road.
+ * @param k Number of partitions.
+ * @return Partition loads.
+ */
+std::vector<double> RoadPartitioner::partitionLoads(const std::vector<int>& owners, int k) const {
+    REQUIRE(owners.size() == roads.size(), "Every road must have a partition");
+
+    std::vector<double> result(k, 0);
+    for (std::size_t i = 0; i < roads.size(); i++) {
+        REQUIRE(owners[i] >= 0 && owners[i] < k, "Partition out of range");
+        result[owners[i]] += loads[i];
+    }
+    return result;
+}
+
+/**
+ * @brief Returns the assignment file next to a scenario.
+ * @param scenarioFile Scenario path.
+ * @return Assignment path.
+ */
+std::string RoadPartitioner::assignmentFile(const std::string& scenarioFile) {
+    return scenarioFile + ".partities";
+}
+
+/**
+ * @brief Writes one "road<TAB>partition" line per road.
+ *
+ * @param filename Output file.
+ * @param roads The roads.
+ * @param owners Partition of each road.
+ */
+void RoadPartitioner::save(const std::string& filename, const std::vector<Road*>& roads, const std::vector<int>& owners) {
+    REQUIRE(owners.size() == roads.size(), "Every road must have a partition");
+
+    std::ofstream out(filename);
+    if (!out) {
+        throw std::runtime_error("Failed to write partition file: " + filename);
+    }
+    out << "# baan\tpartitie\n";
+    for (std::size_t i = 0; i < roads.size(); i++)
+        out << roads[i]->getName() << '\t' << owners[i] << '\n';
+    if (!out) {
+        throw std::runtime_error("Failed to write partition file: " + filename);
+    }
+}
+
+/**
+ * @brief Reads an assignment written by save().
+ *
+ * @param filename Input file.
+ * @param roads The roads of the scenario.
+ * @return Partition of each road.
+ */
+std::vector<int> RoadPartitioner::load(const std::string& filename, const std::vector<Road*>& roads) {
+    std::ifstream in(filename);
+    if (!in) {
+        throw std::runtime_error("Failed to open partition file: " + filename);
+    }
+
+    std::unordered_map<std::string, std::size_t> indices;
+    for (std::size_t i = 0; i < roads.size(); i++)
+        indices.emplace(roads[i]->getName(), i);
+
+    std::vector<int> owners(roads.size(), -1);
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(in, line)) {
+        lineNumber++;
+        if (line.empty() || line[0] == '#')
+            continue;
+        std::string where = filename + ":" + std::to_string(lineNumber);
+
+        std::size_t separator = line.find_last_of(" \t");
+        if (separator == std::string::npos) {
+            throw std::runtime_error("Partition line must name a road and a partition: " + where);
+        }
+        std::string name = line.substr(0, separator);
+        name.erase(name.find_last_not_of(" \t") + 1);
+        int owner;
+        try {
+            owner = std::stoi(line.substr(separator + 1));
+        } catch (const std::exception&) {
+            throw std::runtime_error("Invalid partition number: " + where);
+        }
+
+        auto it = indices.find(name);
+        if (it == indices.end()) {
+            throw std::runtime_error("Partition file refers to unknown road '" + name + "': " + where);
+        }
+        if (owner < 0) {
+            throw std::runtime_error("Partition number must be non-negative: " + where);
+        }
+        owners[it->second] = owner;
+    }
+
+    for (std::size_t i = 0; i < roads.size(); i++) {
+        if (owners[i] < 0) {
+            throw std::runtime_error("Partition file does not assign road " + roads[i]->getName() + ": " + filename);
+        }
+    }
+    return owners;
+}
+
+/**
+ * @brief Estimates the vehicles crossing every link per second.
+ *
+ * A road with n vehicles over length L passes about n * FREE_SPEED / L vehicles
+ * per second to its successors, split evenly.
+ */
+void RoadPartitioner::estimateTransfers() {
+    linkWeights.resize(links.size());
+    for (std::size_t l = 0; l < links.size(); l++) {
+        const Road* from = roads[links[l].first];
+        linkWeights[l] = LINK_BASE_WEIGHT
+                       + loads[links[l].first] * FREE_SPEED / from->getLength() / from->getRoads().size();
+    }
+    ENSURE(linkWeights.size() == links.size(), "Every link must have a weight");
+}
@@ -0,0 +1,119 @@
+#ifndef ROADPARTITIONER_H
+#define ROADPARTITIONER_H
+
+#include <string>
+#include <utility>
+#include <vector>
+
+class Road;
+class Simulation;
+
+/**
+ * @class RoadPartitioner
+ * @brief Multilevel partitioner of the road network for parallel and distributed runs.
+ *
+ * Every road is a vertex weighted by its expected vehicle load, and every
+ * successor link an edge weighted by its expected transfer volume. The graph is
+ * coarsened by heavy-edge matching, the coarsest graph is split greedily, and
+ * the split is refined on every level on the way back with boundary moves that
+ * reduce the cut without breaking the balance.
+ *
+ * Roads joined by an intersection are merged into one vertex before
+ * partitioning, because a vehicle can switch between them within a step.
+ */
+class RoadPartitioner {
+public:
+    /**
+     * @brief Builds the weighted graph of a simulation.
+     * Loads are estimated from the initial vehicles and the generator
+     * frequencies, with generated flow split evenly over successors.
+     * @param simulation The loaded simulation.
+     */
+    explicit RoadPartitioner(const Simulation& simulation);
+
+    /**
+     * @brief Replaces the estimated loads, e.g. by profileLoads().
+     * Edge weights are re-estimated from the new loads.
+     * @param loads Load of each road, in Simulation::getRoads() order.
+     * @pre loads.size() equals the number of roads
+     * @pre every load >= 0
+     */
+    void setLoads(const std::vector<double>& loads);
+
+    /** @brief Returns the load of each road. */
+    const std::vector<double>& getLoads() const;
+
+    /**
+     * @brief Measures loads with a profiling run: the average number of vehicles per road.
+     * @param simulation Simulation to step; it is advanced by the given number of steps.
+     * @param steps Number of steps.
+     * @return Average vehicles of each road.
+     * @pre steps > 0
+     */
+    static std::vector<double> profileLoads(Simulation& simulation, int steps);
+
+    /**
+     * @brief Splits the roads into k partitions.
+     * @param k Number of partitions.
+     * @param imbalance Allowed load above the average partition, as a fraction.
+     * @return The partition of each road, in Simulation::getRoads() order.
+     * @pre k > 0
+     * @pre imbalance >= 0
+     * @post roads joined by an intersection have the same partition
+     */
+    std::vector<int> partition(int k, double imbalance = 0.05) const;
+
+    /**
+     * @brief Sums the weights of the links between different partitions.
+     * @param owners Partition of each road.
+     * @return Cut weight.
+     */
+    double cutWeight(const std::vector<int>& owners) const;
+
+    /**
+     * @brief Sums the road loads per partition.
+     * @param owners Partition of each road.
+     * @param k Number of partitions.
+     * @return Load of each partition.
+     */
+    std::vector<double> partitionLoads(const std::vector<int>& owners, int k) const;
+
+    /**
+     * @brief Returns the file that stores the partition assignment of a scenario.
+     * @param scenarioFile Path of the scenario XML file.
+     * @return The scenario path with ".partities" appended.
+     */
+    static std::string assignmentFile(const std::string& scenarioFile);
+
+    /**
+     * @brief Writes a partition assignment, one "road partition" line per road.
+     * @param filename File to write.
+     * @param roads The roads.
+     * @param owners Partition of each road.
+     * @throws std::runtime_error If the file cannot be written.
+     * @pre owners.size() == roads.size()
+     */
+    static void save(const std::string& filename, const std::vector<Road*>& roads, const std::vector<int>& owners);
+
+    /**
+     * @brief Reads a partition assignment written by save().
+     * @param filename File to read.
+     * @param roads The roads of the scenario.
+     * @return Partition of each road.
+     * @throws std::runtime_error If the file cannot be read, names an unknown
+     *         road, or does not assign every road.
+     */
+    static std::vector<int> load(const std::string& filename, const std::vector<Road*>& roads);
+
+private:
+    /** @brief Recomputes the link weights from the loads. */
+    void estimateTransfers();
+
+    std::vector<Road*> roads;
+    std::vector<int> group;                            ///< Intersection group of each road.
+    std::vector<double> loads;                         ///< Expected vehicles per road.
+    std::vector<std::pair<int, int>> links;            ///< Successor links (from, to).
+    std::vector<double> linkWeights;                   ///< Expected transfers per link.
+};
+
+#endif // ROADPARTITIONER_H
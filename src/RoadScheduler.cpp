@@ -0,0 +1,224 @@
+#include "RoadScheduler.h"
+#include "Road.h"
+#include "Intersection.h"
+#include "SimulationStats.h"
+#include "DesignByContract.h"
+#include "Trace.h"
+#include <algorithm>
+#include <chrono>
+#include <numeric>
+
+/**
+ * @brief Starts the workers; the scheduler has no groups until build().
+ *
+ * @param threads Number of workers.
+ * @param rebalanceInterval Steps per measurement window.
+ * @param imbalanceThreshold Imbalance that triggers a rebalance.
+ */
+RoadScheduler::RoadScheduler(int threads, int rebalanceInterval, double imbalanceThreshold)
+    : pool(threads), rebalanceInterval(rebalanceInterval), imbalanceThreshold(imbalanceThreshold),
+      windowSteps(0), imbalance(1), migrations(0)
+{
+    REQUIRE(rebalanceInterval >= 1, "rebalanceInterval must be at least 1");
+    REQUIRE(imbalanceThreshold >= 1, "imbalanceThreshold must be at least 1");
+    ENSURE(getGroupCount() == 0, "A new scheduler has no groups");
+}
+
+/**
+ * @brief Forms the intersection groups and assigns them by initial vehicle count.
+ *
+ * @param roads Roads in update order.
+ * @param intersections Intersections between them.
+ */
+void RoadScheduler::build(const std::vector<Road*>& roads, const std::vector<Intersection*>& intersections) {
+    std::unordered_map<const Road*, int> indices;
+    for (std::size_t i = 0; i < roads.size(); i++)
+        indices[roads[i]] = static_cast<int>(i);
+
+    std::vector<int> root(roads.size());
+    std::iota(root.begin(), root.end(), 0);
+    std::function<int(int)> find = [&](int road) {
+        return root[road] == road ? road : root[road] = find(root[road]);
+    };
+    for (const Intersection* intersection : intersections) {
+        auto entry = indices.find(intersection->getEntryRoad());
+        auto exit = indices.find(intersection->getExitRoad());
+        if (entry == indices.end() || exit == indices.end())
+            continue;
+        int a = find(entry->second);
+        int b = find(exit->second);
+        root[std::max(a, b)] = std::min(a, b);
+    }
+
+    groups.clear();
+    groupOf.clear();
+    std::vector<int> groupOfRoot(roads.size(), -1);
+    for (std::size_t i = 0; i < roads.size(); i++) {
+        int top = find(static_cast<int>(i));
+        if (groupOfRoot[top] < 0) {
+            groupOfRoot[top] = static_cast<int>(groups.size());
+            groups.emplace_back();
+        }
+        groups[groupOfRoot[top]].push_back(roads[i]);
+        groupOf[roads[i]] = groupOfRoot[top];
+    }
+
+    // Start from the vehicle counts; measurements take over after the first window
+    std::vector<double> estimates(groups.size(), 0);
+    for (std::size_t g = 0; g < groups.size(); g++) {
+        for (const Road* road : groups[g])
+            estimates[g] += 1 + road->getVehicles().size();
+    }
+    workerOf.assign(groups.size(), 0);
+    rebalance(estimates);
+    migrations = 0;
+    windowCosts.assign(groups.size(), 0);
+    windowSteps = 0;
+
+    ENSURE(getGroupCount() <= static_cast<int>(roads.size()), "Groups cannot outnumber roads");
+}
+
+/**
+ * @brief Updates every group on its worker and timestamps each group.
+ *
+ * At the end of a window the imbalance is computed from the measured costs, and
+ * the groups are rebalanced if it exceeds the threshold.
+ *
+ * @param stats Collector for the workers' counters.
+ * @param update Road update.
+ */
+void RoadScheduler::updateRoads(StatsCollector& stats, const std::function<void(Road*)>& update) {
+    using Clock = std::chrono::steady_clock;
+
+    bool audit = contracts::auditStep;
+    pool.run([&](int worker) {
+        StatsCollector::Scope statsScope(stats);
+        contracts::AuditScope auditScope(audit);
+        TRACE_SCOPE("worker");
+        for (int group : schedule[worker]) {
+            Clock::time_point start = Clock::now();
+            for (Road* road : groups[group])
+                update(road);
+            windowCosts[group] += std::chrono::duration<double>(Clock::now() - start).count();
+        }
+    });
+
+    if (++windowSteps < rebalanceInterval)
+        return;
+
+    std::vector<double> costs = getWorkerCosts(windowCosts);
+    double mean = std::accumulate(costs.begin(), costs.end(), 0.0) / costs.size();
+    imbalance = mean > 0 ? *std::max_element(costs.begin(), costs.end()) / mean : 1;
+    if (imbalance > imbalanceThreshold) {
+        TRACE_SCOPE("rebalance");
+        rebalance(windowCosts);
+    }
+    std::fill(windowCosts.begin(), windowCosts.end(), 0);
+    windowSteps = 0;
+}
+
+/**
+ * @brief Longest processing time first assignment of the groups.
+ *
+ * Ties keep a group on its current worker, so equal costs do not shuffle groups.
+ *
+ * @param groupCosts Cost of each group.
+ */
+void RoadScheduler::rebalance(const std::vector<double>& groupCosts) {
+    REQUIRE(groupCosts.size() == groups.size(), "Every group must have a cost");
+
+    std::vector<int> order(groups.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(),
+                     [&groupCosts](int a, int b) { return groupCosts[a] > groupCosts[b]; });
+
+    std::vector<double> load(pool.getThreadCount(), 0);
+    for (int group : order) {
+        int target = workerOf[group];
+        for (int worker = 0; worker < pool.getThreadCount(); worker++) {
+            if (load[worker] < load[target])
+                target = worker;
+        }
+        if (target != workerOf[group]) {
+            workerOf[group] = target;
+            migrations++;
+        }
+        load[target] += groupCosts[group];
+    }
+    makeSchedule();
+}
+
+/**
+ * @brief Sums the group costs of every worker.
+ * @param groupCosts Cost of each group.
+ * @return Worker costs.
+ */
+std::vector<double> RoadScheduler::getWorkerCosts(const std::vector<double>& groupCosts) const {
+    REQUIRE(groupCosts.size() == groups.size(), "Every group must have a cost");
+
+    std::vector<double> costs(pool.getThreadCount(), 0);
+    for (std::size_t group = 0; group < groups.size(); group++)
+        costs[workerOf[group]] += groupCosts[group];
+    return costs;
+}
+
+/**
+ * @brief Returns the number of workers.
+ * @return Worker count.
+ */
+int RoadScheduler::getThreadCount() const {
+    return pool.getThreadCount();
+}
+
+/**
+ * @brief Returns the number of groups.
+ * @return Group count.
+ */
+int RoadScheduler::getGroupCount() const {
+    return static_cast<int>(groups.size());
+}
+
+/**
+ * @brief Looks up the group of a road.
+ * @param road The road.
+ * @return Group index, or -1.
+ */
+int RoadScheduler::getGroupOf(const Road* road) const {
+    auto it = groupOf.find(road);
+    return it == groupOf.end() ? -1 : it->second;
+}
+
+/**
+ * @brief Returns the worker of a group.
+ * @param group Group index.
+ * @return Worker index.
+ */
+int RoadScheduler::getWorkerOf(int group) const {
+    REQUIRE(group >= 0 && group < getGroupCount(), "Group index out of range");
+    return workerOf[group];
+}
+
+/**
+ * @brief Returns the imbalance of the last completed window.
+ * @return Busiest worker cost divided by the average.
+ */
+double RoadScheduler::getImbalance() const {
+    return imbalance;
+}
+
+/**
+ * @brief Returns the number of group migrations.
+ * @return Migrations since build().
+ */
+int RoadScheduler::getMigrations() const {
+    return migrations;
+}
+
+/**
+ * @brief Lists each worker's groups in update order.
+ */
+void RoadScheduler::makeSchedule() {
+    schedule.assign(pool.getThreadCount(), std::vector<int>());
+    for (std::size_t group = 0; group < groups.size(); group++)
+        schedule[workerOf[group]].push_back(static_cast<int>(group));
+}
@@ -0,0 +1,107 @@
+#ifndef ROADSCHEDULER_H
+#define ROADSCHEDULER_H
+
+#include "WorkerPool.h"
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+class Road;
+class Intersection;
+class StatsCollector;
+
+/**
+ * @class RoadScheduler
+ * @brief Updates roads on several threads and rebalances them by measured cost.
+ *
+ * Roads joined by an intersection form one group, because a vehicle can move
+ * between them during the update; groups are the unit of work. Each worker
+ * updates its groups, and every road keeps the global update order within its
+ * group, so the result does not depend on the thread count or on which worker
+ * owns a group.
+ *
+ * The time of every group update is measured. After each window of steps the
+ * scheduler compares the workers' measured costs, and when the busiest worker
+ * exceeds the average by more than the threshold, the groups are reassigned
+ * longest-processing-time first.
+ */
+class RoadScheduler {
+public:
+    /**
+     * @brief Creates a scheduler with its worker threads.
+     * @param threads Number of workers.
+     * @param rebalanceInterval Steps per measurement window.
+     * @param imbalanceThreshold Busiest worker cost over the average that triggers a rebalance.
+     * @pre threads >= 1
+     * @pre rebalanceInterval >= 1
+     * @pre imbalanceThreshold >= 1
+     */
+    RoadScheduler(int threads, int rebalanceInterval = 300, double imbalanceThreshold = 1.2);
+
+    /**
+     * @brief Groups the roads and spreads the groups over the workers by vehicle count.
+     * @param roads Roads in update order.
+     * @param intersections Intersections between the roads.
+     * @post getGroupCount() <= roads.size()
+     */
+    void build(const std::vector<Road*>& roads, const std::vector<Intersection*>& intersections);
+
+    /**
+     * @brief Runs update on every road, in parallel over the workers.
+     * Each worker binds its statistics counters to stats while it works.
+     * @param stats Collector for the workers' counters.
+     * @param update Called once per road; must only touch that road's group.
+     */
+    void updateRoads(StatsCollector& stats, const std::function<void(Road*)>& update);
+
+    /**
+     * @brief Reassigns groups to workers, heaviest first onto the least loaded worker.
+     * @param groupCosts Cost of each group.
+     * @pre groupCosts.size() == getGroupCount()
+     */
+    void rebalance(const std::vector<double>& groupCosts);
+
+    /**
+     * @brief Sums group costs per worker under the current assignment.
+     * @param groupCosts Cost of each group.
+     * @return Cost of each worker.
+     */
+    std::vector<double> getWorkerCosts(const std::vector<double>& groupCosts) const;
+
+    /** @brief Returns the number of workers. */
+    int getThreadCount() const;
+
+    /** @brief Returns the number of road groups. */
+    int getGroupCount() const;
+
+    /** @brief Returns the group of a road, or -1 if unknown. */
+    int getGroupOf(const Road* road) const;
+
+    /** @brief Returns the worker that updates a group. */
+    int getWorkerOf(int group) const;
+
+    /** @brief Returns busiest over average worker cost in the last completed window. */
+    double getImbalance() const;
+
+    /** @brief Returns the number of times a group moved to another worker. */
+    int getMigrations() const;
+
+private:
+    /** @brief Rebuilds each worker's list of groups from the assignment. */
+    void makeSchedule();
+
+    WorkerPool pool;
+    int rebalanceInterval;
+    double imbalanceThreshold;
+
+    std::vector<std::vector<Road*>> groups;      ///< Roads of each group, in update order.
+    std::unordered_map<const Road*, int> groupOf;
+    std::vector<int> workerOf;                   ///< Worker of each group.
+    std::vector<std::vector<int>> schedule;      ///< Groups of each worker, ascending.
+    std::vector<double> windowCosts;             ///< Seconds spent per group in this window.
+    int windowSteps;
+    double imbalance;
+    int migrations;
+};
+
+#endif // ROADSCHEDULER_H
@@ -0,0 +1,172 @@
+#include "RouteCache.h"
+#include "RoadGraph.h"
+#include "DesignByContract.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <functional>
+#include <thread>
+
+/**
+ * @brief Creates an empty cache.
+ *
+ * @param graph Graph used to compute routes.
+ * @param capacity Maximum number of routes kept.
+ * @param bucketSeconds Width of the departure time buckets.
+ */
+RouteCache::RouteCache(const RoadGraph& graph, std::size_t capacity, double bucketSeconds)
+    : graph(graph), capacity(capacity), bucketSeconds(bucketSeconds), hits(0), misses(0)
+{
+    REQUIRE(capacity > 0, "capacity must be positive");
+    REQUIRE(bucketSeconds > 0, "bucketSeconds must be positive");
+}
+
+/**
+ * @brief Combines the key fields into one hash.
+ */
+std::size_t RouteCache::KeyHash::operator()(const Key& key) const {
+    std::size_t hash = std::hash<const Road*>()(key.origin);
+    hash = hash * 31 + std::hash<const Road*>()(key.destination);
+    return hash * 31 + std::hash<std::int64_t>()(key.bucket);
+}
+
+/**
+ * @brief Builds the cache key of a trip.
+ */
+RouteCache::Key RouteCache::makeKey(const Road* origin, const Road* destination, double departureTime) const {
+    return Key{origin, destination, static_cast<std::int64_t>(std::floor(departureTime / bucketSeconds))};
+}
+
+/**
+ * @brief Looks up a route, computing and caching it on a miss.
+ *
+ * Unreachable trips are cached as well, so they are not searched again either.
+ *
+ * @param origin Start road.
+ * @param destination Destination road.
+ * @param departureTime Departure time in seconds.
+ * @return The route, or nullptr if unreachable.
+ */
+std::shared_ptr<const Route> RouteCache::get(const Road* origin, const Road* destination, double departureTime) {
+    Key key = makeKey(origin, destination, departureTime);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = index.find(key);
+        if (it != index.end()) {
+            entries.splice(entries.begin(), entries, it->second);
+            hits++;
+            return it->second->second;
+        }
+        misses++;
+    }
+
+    // Compute outside the lock; the graph is safe to query from several threads
+    std::shared_ptr<const Route> route;
+    std::vector<Road*> roads = graph.route(origin, destination);
+    if (!roads.empty())
+        route = std::make_shared<const Route>(std::move(roads));
+
+    std::lock_guard<std::mutex> lock(mutex);
+    insert(key, route);
+    return route;
+}
+
+/**
+ * @brief Fills the cache for a list of trips in parallel.
+ *
+ * Building a destination's shortest-path tree is the expensive part, so the
+ * workers first build the trees of all distinct destinations. Extracting the
+ * routes afterwards is cheap.
+ *
+ * @param trips Origin/destination pairs.
+ * @param departureTime Departure time for the bucket.
+ * @param threads Worker count; 0 for the hardware concurrency.
+ */
+void RouteCache::precompute(const std::vector<std::pair<const Road*, const Road*>>& trips,
+                            double departureTime, unsigned threads) {
+    std::vector<const Road*> destinations;
+    for (const auto& trip : trips) {
+        if (graph.indexOf(trip.second) >= 0)
+            destinations.push_back(trip.second);
+    }
+    std::sort(destinations.begin(), destinations.end());
+    destinations.erase(std::unique(destinations.begin(), destinations.end()), destinations.end());
+
+    if (threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    threads = std::min<unsigned>(threads, static_cast<unsigned>(destinations.size()));
+
+    std::atomic<std::size_t> next(0);
+    auto work = [&]() {
+        for (std::size_t i = next++; i < destinations.size(); i = next++)
+            graph.precompute(destinations[i]);
+    };
+    std::vector<std::thread> workers;
+    for (unsigned i = 1; i < threads; i++)
+        workers.emplace_back(work);
+    work();
+    for (auto& worker : workers)
+        worker.join();
+
+    for (const auto& trip : trips)
+        get(trip.first, trip.second, departureTime);
+}
+
+/**
+ * @brief Removes all cached routes.
+ */
+void RouteCache::clear() {
+    std::lock_guard<std::mutex> lock(mutex);
+    entries.clear();
+    index.clear();
+    ENSURE(entries.empty() && index.empty(), "Cache must be empty after clear");
+}
+
+/**
+ * @brief Returns the number of cached routes.
+ * @return Cache size.
+ */
+std::size_t RouteCache::size() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return entries.size();
+}
+
+/**
+ * @brief Returns the hit count.
+ * @return Hits.
+ */
+std::uint64_t RouteCache::getHits() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return hits;
+}
+
+/**
+ * @brief Returns the miss count.
+ * @return Misses.
+ */
+std::uint64_t RouteCache::getMisses() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return misses;
+}
+
+/**
+ * @brief Stores a route as most recently used.
+ *
+ * Another thread may have inserted the same key while the route was computed;
+ * then the existing entry is kept.
+ *
+ * @param key Trip key.
+ * @param route The route, or nullptr for an unreachable trip.
+ */
+void RouteCache::insert(const Key& key, std::shared_ptr<const Route> route) {
+    if (index.count(key) != 0)
+        return;
+
+    entries.emplace_front(key, std::move(route));
+    index[key] = entries.begin();
+    if (entries.size() > capacity) {
+        index.erase(entries.back().first);
+        entries.pop_back();
+    }
+    ENSURE(entries.size() <= capacity, "Cache must not exceed its capacity");
+}
@@ -0,0 +1,110 @@
+#ifndef ROUTECACHE_H
+#define ROUTECACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+class Road;
+class RoadGraph;
+
+/// A route: the roads from origin to destination, inclusive.
+using Route = std::vector<Road*>;
+
+/**
+ * @class RouteCache
+ * @brief Least-recently-used cache of complete routes.
+ *
+ * Routes are keyed by origin, destination and departure time bucket, so a time
+ * dependent cost model can give different routes at different times of day while
+ * every repeated trip in the same bucket reuses one immutable Route. Lookups are
+ * thread-safe.
+ */
+class RouteCache {
+public:
+    /**
+     * @brief Creates a cache on top of a road graph.
+     * @param graph Graph that computes missing routes; must outlive the cache.
+     * @param capacity Maximum number of cached routes.
+     * @param bucketSeconds Width of a departure time bucket in seconds.
+     * @pre capacity > 0
+     * @pre bucketSeconds > 0
+     */
+    RouteCache(const RoadGraph& graph, std::size_t capacity = 4096, double bucketSeconds = 900);
+
+    RouteCache(const RouteCache&) = delete;
+    RouteCache& operator=(const RouteCache&) = delete;
+
+    /**
+     * @brief Returns the route for a trip, computing it on a miss.
+     * @param origin Road the trip starts on.
+     * @param destination Road the trip ends on.
+     * @param departureTime Simulation time of departure in seconds.
+     * @return The shared route, or nullptr if the destination cannot be reached.
+     */
+    std::shared_ptr<const Route> get(const Road* origin, const Road* destination, double departureTime);
+
+    /**
+     * @brief Computes and caches the routes of many trips using several threads.
+     * The shortest-path trees of the distinct destinations are built in parallel.
+     * @param trips Origin/destination pairs, most important first.
+     * @param departureTime Departure time used for the bucket.
+     * @param threads Number of worker threads; 0 uses the hardware concurrency.
+     */
+    void precompute(const std::vector<std::pair<const Road*, const Road*>>& trips,
+                    double departureTime, unsigned threads = 0);
+
+    /**
+     * @brief Forgets every route, e.g. after the road graph was recompiled.
+     * @post size() == 0
+     */
+    void clear();
+
+    /** @brief Returns the number of cached routes. */
+    std::size_t size() const;
+
+    /** @brief Returns the number of lookups answered from the cache. */
+    std::uint64_t getHits() const;
+
+    /** @brief Returns the number of lookups that had to compute a route. */
+    std::uint64_t getMisses() const;
+
+private:
+    struct Key {
+        const Road* origin;
+        const Road* destination;
+        std::int64_t bucket;
+
+        bool operator==(const Key& other) const {
+            return origin == other.origin && destination == other.destination && bucket == other.bucket;
+        }
+    };
+
+    struct KeyHash {
+        std::size_t operator()(const Key& key) const;
+    };
+
+    using Entry = std::pair<Key, std::shared_ptr<const Route>>;
+
+    Key makeKey(const Road* origin, const Road* destination, double departureTime) const;
+
+    /** @brief Inserts a route as most recently used, evicting the oldest if full. Caller holds mutex. */
+    void insert(const Key& key, std::shared_ptr<const Route> route);
+
+    const RoadGraph& graph;
+    std::size_t capacity;
+    double bucketSeconds;
+
+    mutable std::mutex mutex;
+    std::list<Entry> entries;  ///< Most recently used first.
+    std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> index;
+    std::uint64_t hits;
+    std::uint64_t misses;
+};
+
+#endif // ROUTECACHE_H
@@ -0,0 +1,251 @@
+#include "SignalOptimizer.h"
+#include "Simulation.h"
+#include "Road.h"
+#include "Vehicle.h"
+#include "TrafficLight.h"
+#include "WorkerPool.h"
+#include "DesignByContract.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <iomanip>
+#include <ostream>
+#include <random>
+#include <stdexcept>
+
+namespace {
+
+/**
+ * @brief Returns the number of steps that cover a duration.
+ */
+int stepsFor(double seconds, double timeStep) {
+    return static_cast<int>(std::ceil(seconds / timeStep - 1e-9));
+}
+
+/**
+ * @brief Returns a value wrapped into [0, 1).
+ */
+double wrap(double fraction) {
+    return fraction - std::floor(fraction);
+}
+
+} // namespace
+
+/**
+ * @brief Validates the settings and runs the warm-up on a clone of the base.
+ *
+ * @param base Simulation to optimize.
+ * @param settings Search settings.
+ */
+SignalOptimizer::SignalOptimizer(const Simulation& base, Settings settings)
+    : settings(settings)
+{
+    if (lightsOf(base).empty()) {
+        throw std::runtime_error("Signal optimization needs at least one traffic light with a fixed cycle");
+    }
+    if (settings.population < 2 || settings.generations < 0 || settings.elite < 0
+        || settings.elite >= settings.population) {
+        throw std::runtime_error("Signal optimization needs a population of at least 2 and fewer elites");
+    }
+    if (settings.minCycle < 1 || settings.maxCycle < settings.minCycle) {
+        throw std::runtime_error("Signal optimization needs 1 <= minimum cycle <= maximum cycle");
+    }
+    if (settings.warmup < 0 || settings.horizon <= 0 || settings.threads < 1) {
+        throw std::runtime_error("Signal optimization needs a positive horizon and at least one thread");
+    }
+
+    warm = base.clone();
+    for (int step = stepsFor(settings.warmup, warm->getTimeStep()); step > 0; step--)
+        warm->runStep();
+}
+
+SignalOptimizer::~SignalOptimizer() = default;
+
+/**
+ * @brief Returns the number of lights in the warmed-up state.
+ * @return Number of lights.
+ */
+int SignalOptimizer::getLightCount() const {
+    return static_cast<int>(lightsOf(*warm).size());
+}
+
+/**
+ * @brief Reads the cycle and offset of every light after the warm-up.
+ * @return The timing plan, with cycles clamped to the searched range.
+ */
+std::vector<double> SignalOptimizer::currentGenes() const {
+    std::vector<double> genes;
+    for (const TrafficLight* light : lightsOf(*warm)) {
+        genes.push_back(std::min(settings.maxCycle, std::max(settings.minCycle, static_cast<double>(light->getCycle()))));
+        genes.push_back(wrap(light->getOffset(warm->currentTime) / (2.0 * light->getCycle())));
+    }
+    return genes;
+}
+
+/**
+ * @brief Writes a timing plan into the lights of a simulation.
+ * @param simulation Simulation whose lights are changed.
+ * @param genes Cycle and offset fraction per light.
+ */
+void SignalOptimizer::apply(Simulation& simulation, const std::vector<double>& genes) const {
+    std::vector<TrafficLight*> lights = lightsOf(simulation);
+    REQUIRE(genes.size() == 2 * lights.size(), "A plan needs a cycle and an offset per light");
+
+    for (std::size_t i = 0; i < lights.size(); i++) {
+        int cycle = std::max(1, static_cast<int>(std::lround(genes[2 * i])));
+        lights[i]->setCycle(cycle);
+        lights[i]->setOffset(wrap(genes[2 * i + 1]) * 2.0 * cycle, simulation.currentTime);
+    }
+}
+
+/**
+ * @brief Runs each plan over the horizon on a clone; workers take the next unscored plan.
+ *
+ * @param plans Timing plans.
+ * @return The scored candidates, in plan order.
+ */
+std::vector<SignalOptimizer::Candidate> SignalOptimizer::evaluate(const std::vector<std::vector<double>>& plans) const {
+    std::vector<Candidate> candidates(plans.size());
+    std::atomic<std::size_t> next(0);
+    WorkerPool pool(std::max(1, std::min(settings.threads, static_cast<int>(plans.size()))));
+    pool.run([&](int) {
+        for (std::size_t index = next++; index < plans.size(); index = next++) {
+            std::unique_ptr<Simulation> sim = warm->clone();
+            apply(*sim, plans[index]);
+
+            Candidate& candidate = candidates[index];
+            candidate.genes = plans[index];
+            long long exitsBefore = sim->getStats().vehiclesExited;
+            double dt = sim->getTimeStep();
+            for (int step = stepsFor(settings.horizon, dt); step > 0; step--) {
+                for (const Road* road : sim->getRoads()) {
+                    for (const Vehicle* vehicle : road->getVehicles())
+                        candidate.delay += dt * std::max(0.0, 1.0 - vehicle->getSpeed() / vehicle->getMaxSpeed());
+                }
+                sim->runStep();
+            }
+            candidate.exits = static_cast<long long>(sim->getStats().vehiclesExited) - exitsBefore;
+            candidate.cost = settings.objective == Objective::DELAY ? candidate.delay
+                                                                    : -static_cast<double>(candidate.exits);
+        }
+    });
+
+    ENSURE(candidates.size() == plans.size(), "Every plan must be scored");
+    return candidates;
+}
+
+/**
+ * @brief Evolves the population for the configured number of generations.
+ *
+ * The first generation is the current plan and random plans. Elites are not
+ * scored again, so every generation simulates population - elite candidates.
+ *
+ * @return The best candidate.
+ */
+SignalOptimizer::Candidate SignalOptimizer::optimize() {
+    std::mt19937 random(settings.seed);
+    std::uniform_real_distribution<double> unit(0, 1);
+    std::normal_distribution<double> normal(0, 1);
+    std::uniform_int_distribution<int> pick(0, settings.population - 1);
+    int lightCount = getLightCount();
+    double cycleRange = settings.maxCycle - settings.minCycle;
+
+    std::vector<std::vector<double>> plans{currentGenes()};
+    while (static_cast<int>(plans.size()) < settings.population) {
+        std::vector<double> genes;
+        for (int light = 0; light < lightCount; light++) {
+            genes.push_back(settings.minCycle + unit(random) * cycleRange);
+            genes.push_back(unit(random));
+        }
+        plans.push_back(genes);
+    }
+    std::vector<Candidate> population = evaluate(plans);
+    auto byCost = [](const Candidate& a, const Candidate& b) { return a.cost < b.cost; };
+    std::stable_sort(population.begin(), population.end(), byCost);
+    history.assign(1, population.front().cost);
+
+    for (int generation = 0; generation < settings.generations; generation++) {
+        auto tournament = [&]() -> const Candidate& {
+            const Candidate& a = population[pick(random)];
+            const Candidate& b = population[pick(random)];
+            return a.cost <= b.cost ? a : b;
+        };
+        plans.clear();
+        for (int child = settings.elite; child < settings.population; child++) {
+            const Candidate& mother = tournament();
+            const Candidate& father = tournament();
+            std::vector<double> genes(2 * lightCount);
+            for (int light = 0; light < lightCount; light++) {
+                const Candidate& parent = unit(random) < 0.5 ? mother : father;
+                genes[2 * light] = parent.genes[2 * light];
+                genes[2 * light + 1] = parent.genes[2 * light + 1];
+                if (unit(random) < settings.mutation)
+                    genes[2 * light] += 0.1 * cycleRange * normal(random);
+                if (unit(random) < settings.mutation)
+                    genes[2 * light + 1] += 0.1 * normal(random);
+                genes[2 * light] = std::min(settings.maxCycle, std::max(settings.minCycle, genes[2 * light]));
+                genes[2 * light + 1] = wrap(genes[2 * light + 1]);
+            }
+            plans.push_back(genes);
+        }
+
+        std::vector<Candidate> children = evaluate(plans);
+        population.resize(settings.elite);
+        population.insert(population.end(), children.begin(), children.end());
+        std::stable_sort(population.begin(), population.end(), byCost);
+        history.push_back(population.front().cost);
+    }
+
+    ENSURE(history.size() == static_cast<std::size_t>(settings.generations) + 1, "Every generation must be recorded");
+    return population.front();
+}
+
+/**
+ * @brief Returns the best cost per generation.
+ * @return Costs of the last optimize().
+ */
+const std::vector<double>& SignalOptimizer::getHistory() const {
+    return history;
+}
+
+/**
+ * @brief Prints the cycle and offset of every light, then the score.
+ *
+ * @param out Output stream.
+ * @param candidate The plan to print.
+ */
+void SignalOptimizer::write(std::ostream& out, const Candidate& candidate) const {
+    REQUIRE(candidate.genes.size() == 2 * static_cast<std::size_t>(getLightCount()), "A plan needs a cycle and an offset per light");
+
+    out << std::fixed << std::setprecision(1);
+    std::size_t i = 0;
+    for (const Road* road : warm->getRoads()) {
+        for (const TrafficLight* light : road->getTrafficLights()) {
+            if (light->isActuated())
+                continue;
+            int cycle = std::max(1, static_cast<int>(std::lround(candidate.genes[2 * i])));
+            out << "Verkeerslicht " << road->getName() << " @ " << light->getPosition() << "\n"
+                << "-> cyclus: " << cycle << " s\n"
+                << "-> offset: " << wrap(candidate.genes[2 * i + 1]) * 2.0 * cycle << " s\n";
+            i++;
+        }
+    }
+    out << "Vertraging: " << candidate.delay << " voertuigseconden\n"
+        << "Uitgereden: " << candidate.exits << "\n";
+}
+
+/**
+ * @brief Collects the lights of every road that are not actuated, in road order.
+ * @param simulation Simulation to read.
+ * @return The lights.
+ */
+std::vector<TrafficLight*> SignalOptimizer::lightsOf(const Simulation& simulation) {
+    std::vector<TrafficLight*> lights;
+    for (const Road* road : simulation.getRoads()) {
+        for (TrafficLight* light : road->getTrafficLights()) {
+            if (!light->isActuated())
+                lights.push_back(light);
+        }
+    }
+    return lights;
+}
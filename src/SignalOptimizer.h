@@ -0,0 +1,129 @@
+#ifndef SIGNALOPTIMIZER_H
+#define SIGNALOPTIMIZER_H
+
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+#include <vector>
+
+class Simulation;
+class TrafficLight;
+
+/**
+ * @class SignalOptimizer
+ * @brief Searches the cycle and offset of every traffic light with a genetic algorithm.
+ *
+ * The base simulation is cloned once and warmed up, so every candidate starts
+ * from the same traffic instead of an empty network. A candidate assigns each
+ * light, in road order, a cycle in [minCycle, maxCycle] and an offset given as
+ * a fraction of its green-red period (see TrafficLight::setOffset()). It is
+ * scored on a clone of the warmed-up state over a fixed horizon, by the total
+ * delay of the vehicles or by the number of vehicles that leave the network.
+ * Actuated lights end green on demand, so they have no fixed period to offset;
+ * they keep their settings and are not part of a plan.
+ *
+ * Each generation keeps its best candidates, breeds the rest by tournament
+ * selection, uniform crossover per light and Gaussian mutation, and scores the
+ * new candidates concurrently on a WorkerPool. All random draws happen on the
+ * calling thread, so the result does not depend on the thread count.
+ */
+class SignalOptimizer {
+public:
+    /**
+     * @brief What a candidate is scored on; the cost is minimized.
+     */
+    enum class Objective {
+        DELAY,       ///< Cost is the delay against driving at maximum speed, in vehicle-seconds.
+        THROUGHPUT   ///< Cost is minus the vehicles that left the network.
+    };
+
+    /**
+     * @brief Search and evaluation settings.
+     */
+    struct Settings {
+        int population = 16;        ///< Candidates per generation.
+        int generations = 10;       ///< Generations after the initial one.
+        int elite = 2;              ///< Best candidates copied unchanged into the next generation.
+        double warmup = 60;         ///< Simulated seconds before the candidates split off.
+        double horizon = 300;       ///< Simulated seconds every candidate is scored over.
+        double minCycle = 5;        ///< Shortest cycle in seconds.
+        double maxCycle = 60;       ///< Longest cycle in seconds.
+        double mutation = 0.2;      ///< Probability that a gene is mutated.
+        Objective objective = Objective::DELAY;
+        std::uint32_t seed = 1;     ///< Seed of the search.
+        int threads = 1;            ///< Candidates scored at the same time.
+    };
+
+    /**
+     * @brief A timing plan and its score.
+     */
+    struct Candidate {
+        std::vector<double> genes;  ///< Cycle and offset fraction per light.
+        double delay = 0;           ///< Delay over the horizon in vehicle-seconds.
+        long long exits = 0;        ///< Vehicles that left the network over the horizon.
+        double cost = 0;            ///< Value of the objective.
+    };
+
+    /**
+     * @brief Warms up a clone of the base simulation.
+     * @param base Loaded simulation; it is cloned, not stepped.
+     * @param settings Search settings.
+     * @throws std::runtime_error if the simulation has no fixed-cycle traffic lights or a setting is invalid.
+     */
+    SignalOptimizer(const Simulation& base, Settings settings);
+
+    ~SignalOptimizer();
+
+    /** @brief Returns the number of optimized lights: the lights that are not actuated. */
+    int getLightCount() const;
+
+    /**
+     * @brief Returns the timing plan of the lights as they are in the base simulation.
+     * @return Two genes per light.
+     */
+    std::vector<double> currentGenes() const;
+
+    /**
+     * @brief Sets the cycles and offsets of a simulation's lights to a timing plan.
+     * @param simulation Clone of the base simulation.
+     * @param genes Two genes per light.
+     * @pre genes.size() == 2 * getLightCount()
+     */
+    void apply(Simulation& simulation, const std::vector<double>& genes) const;
+
+    /**
+     * @brief Scores timing plans concurrently, each on its own clone of the warmed-up state.
+     * @param plans Timing plans.
+     * @return One scored candidate per plan, in order.
+     */
+    std::vector<Candidate> evaluate(const std::vector<std::vector<double>>& plans) const;
+
+    /**
+     * @brief Runs the search; the current timing plan is part of the first generation.
+     * @return The best candidate found.
+     */
+    Candidate optimize();
+
+    /**
+     * @brief Returns the best cost after each generation of the last optimize().
+     * @return One cost per generation, starting with the initial one; never increasing.
+     */
+    const std::vector<double>& getHistory() const;
+
+    /**
+     * @brief Writes a timing plan as one line per light.
+     * @param out Stream to write to.
+     * @param candidate The plan and its score.
+     */
+    void write(std::ostream& out, const Candidate& candidate) const;
+
+private:
+    /** @brief Returns the fixed-cycle lights of a simulation in road order. */
+    static std::vector<TrafficLight*> lightsOf(const Simulation& simulation);
+
+    Settings settings;
+    std::unique_ptr<Simulation> warm;
+    std::vector<double> history;
+};
+
+#endif // SIGNALOPTIMIZER_H
@@ -3,58 +3,227 @@
 #include "Road.h"
 #include "Vehicle.h"
 #include "TrafficLight.h"
+#include "Detector.h"
 #include "VehicleGenerator.h"
 #include "BusStop.h"
 #include "Intersection.h"
+#include "OdDemand.h"
+#include "BoundaryExchange.h"
+#include "RoadScheduler.h"
 #include "DesignByContract.h"
+#include "Trace.h"
+#include "CloneMap.h"
+#include "RoadMetrics.h"
+#include "RenderThread.h"
+#include "TelemetryServer.h"
+#include "RewindBuffer.h"
+#include "Journal.h"
 #include <iostream>
 #include <cmath>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <cerrno>
+#include <cstdio>
+#include <sstream>
+#include <stdexcept>
+#include <unistd.h>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double secondsBetween(Clock::time_point start, Clock::time_point end) {
+    return std::chrono::duration<double>(end - start).count();
+}
+
+} // namespace
 
 /**
  * @brief Constructor initializes the simulation state.
  * Sets current time, step counter, and vehicle counter to initial values.
  */
 Simulation::Simulation()
-    : currentTime(0), stepCounter(0), vehicleCounter(1) {
+    : currentTime(0), graphDirty(false), routeCache(graph), exchange(nullptr), timeStep(0.0166), metricsOut(nullptr), renderer(nullptr), telemetry(nullptr), rewind(nullptr), journal(nullptr),
+      frameInterval(1), nextFrameTime(0), stepCounter(0), vehicleCounter(1) {
     ENSURE(currentTime == 0, "Current time should be initialized to 0");
     ENSURE(stepCounter == 0, "Step counter should be initialized to 0");
     ENSURE(vehicleCounter == 1, "Vehicle counter should be initialized to 1");
 }
 
+/**
+ * @brief Destructor; the slot maps delete every entity the simulation owns.
+ */
+Simulation::~Simulation() {}
+
 /**
  * @brief Runs one simulation step.
  * Updates all roads, traffic lights, and vehicle generators.
+ * Road tails are captured before any road is updated, and vehicles that reach
+ * the end of a road only move to its successor after all roads are updated, so
+ * the result does not depend on the order of the roads.
+ * External commands are applied first: the queued ones, or the journal's while replaying.
  * Advances simulation time and increments step counter.
  */
 void Simulation::runStep() {
-    double oldTime = currentTime;
-    int oldStepCounter = stepCounter;
+    TRACE_SCOPE("Simulation::runStep");
+    StatsCollector::Scope statsScope(stats);
+    SimulationStats& counters = SimulationStats::current();
+
+    contracts::beginStep(stepCounter);
+    CONTRACT_OLD(double, oldTime, currentTime);
+    CONTRACT_OLD(int, oldStepCounter, stepCounter);
+
+    if (journal != nullptr && journal->isReplaying()) {
+        std::string command;
+        while (journal->nextCommand(command))
+            applyCommand(command, false);
+    } else {
+        for (const std::string& command : commands) {
+            if (journal != nullptr)
+                journal->command(command);
+            applyCommand(command, false);
+        }
+    }
+    commands.clear();
+
+    if (graphDirty)
+        getRoadGraph();
+
+    Clock::time_point roadsStart = Clock::now();
+    double lightSeconds = 0;
+
+    for (auto* road : roads.values()) {
+        if (isLocal(road))
+            road->captureTail();
+    }
+    if (exchange != nullptr) {
+        TRACE_SCOPE("exchange tails");
+        exchange->exchangeTails(roads.values());
+    }
 
     // Update each road's vehicles and states
-    for (auto* road : roads) {
-        road->update();
+    if (scheduler) {
+        // Workers count their light time in their own counters
+        scheduler->updateRoads(stats, [this](Road* road) {
+            if (isLocal(road))
+                SimulationStats::current().phaseSeconds[SimulationStats::PHASE_LIGHTS] += updateRoad(road);
+        });
+    } else {
+        for (auto* road : roads.values()) {
+            if (isLocal(road))
+                lightSeconds += updateRoad(road);
+        }
+    }
 
-        // Update traffic lights on the road
-        for (auto* light : road->getTrafficLights()) {
-            light->update(currentTime);
+    // Hand vehicles that reached the end of a road to the next one
+    {
+        TRACE_SCOPE("transfers");
+        for (auto* road : roads.values()) {
+            if (isLocal(road))
+                transferExitedVehicles(road);
         }
     }
+    if (exchange != nullptr) {
+        TRACE_SCOPE("exchange vehicles");
+        for (Vehicle* vehicle : exchange->receiveVehicles())
+            addVehicle(vehicle);
+    }
+
+    Clock::time_point generatorsStart = Clock::now();
+    counters.phaseSeconds[SimulationStats::PHASE_ROADS] += secondsBetween(roadsStart, generatorsStart) - lightSeconds;
+    counters.phaseSeconds[SimulationStats::PHASE_LIGHTS] += lightSeconds;
 
     // Update all vehicle generators
-    for (auto* generator : generators) {
-        generator->update(currentTime);
+    {
+        TRACE_SCOPE("generators");
+        std::vector<int> spawned;
+        std::vector<Vehicle*> spawns;
+        for (std::size_t i = 0; i < generators.size(); i++) {
+            VehicleGenerator* generator = generators.values()[i];
+            if (!isLocal(generator->getRoad()))
+                continue;
+            if (Vehicle* vehicle = generator->update(currentTime)) {
+                if (journal != nullptr)
+                    journal->spawn(static_cast<int>(i));
+                if (exchange == nullptr) {
+                    addVehicle(vehicle);
+                    continue;
+                }
+                spawned.push_back(static_cast<int>(i));
+                spawns.push_back(vehicle);
+            }
+        }
+        if (exchange != nullptr) {
+            // Skip the ids that other partitions give their spawns, in generator order
+            std::size_t next = 0;
+            for (int generator : exchange->exchangeSpawns(spawned)) {
+                if (next < spawned.size() && spawned[next] == generator)
+                    addVehicle(spawns[next++]);
+                else
+                    vehicleCounter++;
+            }
+        }
+        for (auto* demand : demands.values()) {
+            for (Vehicle* vehicle : demand->update(currentTime, routeCache))
+                addVehicle(vehicle);
+        }
     }
+    counters.phaseSeconds[SimulationStats::PHASE_GENERATORS] += secondsBetween(generatorsStart, Clock::now());
 
     stepCounter++;
-    currentTime += 0.0166;  // Approximate timestep (~60 FPS)
+    currentTime += timeStep;
+
+    // Close the detector intervals that ended with this step
+    for (auto* detector : detectors.values()) {
+        if (isLocal(detector->getRoad()))
+            detector->advance(currentTime);
+    }
+    if (metrics && metrics->advance(currentTime, roads.values()) && metricsOut != nullptr) {
+        std::vector<RoadMetrics::Aggregate> local;
+        for (const RoadMetrics::Aggregate& aggregate : metrics->getLatest()) {
+            if (isLocal(aggregate.road))
+                local.push_back(aggregate);
+        }
+        RoadMetrics::writeCsv(*metricsOut, local);
+    }
+    if (telemetry != nullptr)
+        telemetry->publish(roads.values(), currentTime);
+    if (rewind != nullptr)
+        rewind->record(*this);
+    if (journal != nullptr)
+        journal->endStep();
 
     ENSURE(stepCounter == oldStepCounter + 1, "Step counter should be incremented");
     ENSURE(currentTime > oldTime, "Current time should be increased");
+
+    if (contracts::auditing())
+        checkInvariants();
+}
+
+/**
+ * @brief Checks the consistency of the whole simulation state.
+ * Only runs on audited steps, since it visits every vehicle.
+ */
+void Simulation::checkInvariants() const {
+    for (const Road* road : roads.values()) {
+        ENSURE(road != nullptr, "Simulation must not contain null roads");
+        for (const Vehicle* vehicle : road->getVehicles()) {
+            ENSURE(vehicle != nullptr, "Road must not contain null vehicles");
+            ENSURE(vehicle->getRoad() == road, "Vehicle must reference the road it is on");
+            ENSURE(vehicles.get(vehicle->getHandle()) == vehicle, "Vehicle on a road must be registered");
+            ENSURE(vehicle->getPosition() >= 0, "Vehicle position must be non-negative");
+            ENSURE(vehicle->getSpeed() >= 0, "Vehicle speed must be non-negative");
+        }
+        for (const TrafficLight* light : road->getTrafficLights()) {
+            ENSURE(light != nullptr, "Road must not contain null traffic lights");
+        }
+    }
 }
 
 /**
  * @brief Runs the entire simulation until all vehicles have left the roads.
- * Stops when no vehicles remain.
+ * Stops when no vehicles remain and no demand is left to depart.
  * Outputs simulation state at each step.
  */
 void Simulation::run() {
@@ -63,12 +232,16 @@ void Simulation::run() {
 
         // Check if all roads have no vehicles
         bool allRoadsEmpty = true;
-        for (auto* road : roads) {
+        for (auto* road : roads.values()) {
             if (!road->getVehicles().empty()) {
                 allRoadsEmpty = false;
                 break;
             }
         }
+        for (const auto* demand : demands.values()) {
+            if (!demand->isFinished())
+                allRoadsEmpty = false;
+        }
 
         if (allRoadsEmpty) {
             std::cout << "Simulation ended, no vehicles on roads" << std::endl;
@@ -76,7 +249,15 @@ void Simulation::run() {
             break;
         }
 
+        TRACE_SCOPE("output");
+        StatsCollector::Scope statsScope(stats);
+        Clock::time_point outputStart = Clock::now();
         outputState();
+        if (renderer != nullptr && currentTime >= nextFrameTime - 1e-9) {
+            renderer->publish(roads.values(), currentTime);
+            nextFrameTime += frameInterval;
+        }
+        SimulationStats::current().phaseSeconds[SimulationStats::PHASE_OUTPUT] += secondsBetween(outputStart, Clock::now());
     }
 }
 
@@ -88,9 +269,7 @@ void Simulation::outputState() const {
     std::cout << "Increment: " << stepCounter << std::endl;
     std::cout << "Tijd: " << currentTime << std::endl << "\n";
 
-    for (const Road* road : roads) {
-        int vehicleCounter = 1;
-
+    for (const Road* road : roads.values()) {
         // Only print road info if vehicles are present
         if (!road->getVehicles().empty())
             std::cout << "Baan: " << road->getName() << "\n" << std::endl;
@@ -100,16 +279,18 @@ void Simulation::outputState() const {
             int roundedPosition = static_cast<int>(std::round(vehicle->getPosition()));
             double roundedSpeed = std::round(vehicle->getSpeed() * 10.0) / 10.0;
 
-            std::cout << "Voertuig " << vehicleCounter
+            std::cout << "Voertuig " << vehicle->getId()
                       << std::endl
                       << "-> type: " << vehicle->getType()
                       << std::endl
                       << "-> positie: " << roundedPosition
                       << std::endl
                       << "-> snelheid: " << roundedSpeed
-                      << "\n" << std::endl;
+                      << std::endl;
+            if (road->getLaneCount() > 1)
+                std::cout << "-> rijstrook: " << vehicle->getLane() << std::endl;
+            std::cout << std::endl;
             // output.printVehicle(vehicle);
-            vehicleCounter++;
         }
 
         // Print traffic light states
@@ -123,94 +304,483 @@ void Simulation::outputState() const {
             }
         }
     }
+    // Print the detector intervals that closed with this step
+    for (const Detector* detector : detectors.values()) {
+        if (detector->getIntervals().empty() || detector->getIntervals().back().end != currentTime)
+            continue;
+        const Detector::Interval& interval = detector->getIntervals().back();
+        std::cout << "Detector " << detector->getName()
+                  << " (" << interval.start << " - " << interval.end << " s)"
+                  << std::endl
+                  << "-> voertuigen: " << interval.crossings
+                  << std::endl
+                  << "-> debiet: " << std::round(interval.flow) << " per uur"
+                  << std::endl
+                  << "-> bezetting: " << std::round(interval.occupancy * 1000.0) / 10.0 << " %"
+                  << std::endl
+                  << "-> snelheid: " << std::round(interval.harmonicSpeed * 10.0) / 10.0
+                  << "\n" << std::endl;
+    }
     std::cout << "-----------------------------------" << std::endl;
 }
 
 /**
- * @brief Adds a road to the simulation.
+ * @brief Moves the vehicles that drove off the end of a road to its successor.
+ * Vehicles on a dead end leave the simulation: their handles become stale and
+ * their ids are no longer found.
+ * @param road Road that was updated this step.
+ */
+void Simulation::transferExitedVehicles(Road* road) {
+    SimulationStats& counters = SimulationStats::current();
+    for (Vehicle* vehicle : road->getExitedVehicles()) {
+        Road* successor = road->getSuccessor(vehicle);
+        if (successor != nullptr && isLocal(successor)) {
+            vehicle->setRoad(successor);
+            vehicle->setPosition(vehicle->getPosition() - road->getLength());
+            successor->addVehicle(vehicle);
+            counters.vehiclesTransferred++;
+            continue;
+        }
+
+        if (successor != nullptr) {
+            // Another partition steps the successor; the vehicle continues there
+            exchange->sendVehicle(vehicle, successor, vehicle->getPosition() - road->getLength());
+            counters.vehiclesTransferred++;
+        } else {
+            counters.vehiclesExited++;
+        }
+        releaseVehicle(vehicle);
+    }
+    road->clearExitedVehicles();
+
+    ENSURE(road->getExitedVehicles().empty(), "Exited vehicles were not transferred");
+}
+
+/**
+ * @brief Updates one road and its traffic lights.
+ * @param road The road.
+ * @return Seconds spent on the traffic lights.
+ */
+double Simulation::updateRoad(Road* road) {
+    TRACE_SCOPE(Trace::intern(road->getName()));
+    road->update(timeStep);
+
+    // Update traffic lights on the road
+    if (road->getTrafficLights().empty())
+        return 0;
+    TRACE_SCOPE("lights");
+    Clock::time_point lightStart = Clock::now();
+    for (auto* light : road->getTrafficLights()) {
+        light->update(currentTime);
+    }
+    return secondsBetween(lightStart, Clock::now());
+}
+
+/**
+ * @brief Checks whether a road is stepped by this simulation.
+ * @param road The road.
+ * @return true without a boundary exchange or if the exchange owns the road.
+ */
+bool Simulation::isLocal(const Road* road) const {
+    return exchange == nullptr || exchange->ownsRoad(road);
+}
+
+/**
+ * @brief Removes a vehicle from the registry and deletes it.
+ * @param vehicle The vehicle, already removed from its road.
+ */
+void Simulation::releaseVehicle(Vehicle* vehicle) {
+    vehicleIds.erase(vehicle->getId());
+    if (vehicles.get(vehicle->getHandle()) == vehicle)
+        vehicles.erase(vehicle->getHandle());
+    else
+        delete vehicle;  // never registered, but the simulation still owns it
+}
+
+/**
+ * @brief Copies every entity, then points the copies at each other.
+ *
+ * Entities are registered in the order of the original registries, so the copy
+ * updates roads and lights in the same order; vehicles keep their ids.
+ *
+ * @return The copy.
+ */
+std::unique_ptr<Simulation> Simulation::clone() const {
+    REQUIRE(demands.size() == 0, "A simulation with demand cannot be cloned");
+    REQUIRE(exchange == nullptr, "A partitioned simulation cannot be cloned");
+
+    auto copy = std::make_unique<Simulation>();
+    CloneMap map;
+    for (const Road* road : roads.values())
+        map.add(road, new Road(*road));
+    for (const TrafficLight* light : trafficLights.values())
+        map.add(light, new TrafficLight(*light));
+    for (const Detector* detector : detectors.values())
+        map.add(detector, new Detector(*detector));
+    for (const BusStop* stop : busStops.values())
+        map.add(stop, new BusStop(*stop));
+    for (const Intersection* intersection : intersections.values())
+        map.add(intersection, new Intersection(*intersection));
+    for (const Vehicle* vehicle : vehicles.values())
+        map.add(vehicle, vehicle->clone());
+
+    for (const Road* road : roads.values()) {
+        Road* road2 = map(road);
+        road2->rebind(map);
+        copy->roads.insert(road2);
+    }
+    for (const TrafficLight* light : trafficLights.values()) {
+        TrafficLight* light2 = map(light);
+        light2->rebind(map);
+        copy->lightHandles[light2] = copy->trafficLights.insert(light2);
+    }
+    for (const Detector* detector : detectors.values()) {
+        Detector* detector2 = map(detector);
+        detector2->rebind(map);
+        copy->detectorHandles[detector2] = copy->detectors.insert(detector2);
+    }
+    for (const BusStop* stop : busStops.values())
+        copy->busStops.insert(map(stop));
+    for (const Intersection* intersection : intersections.values()) {
+        Intersection* intersection2 = map(intersection);
+        intersection2->rebind(map);
+        copy->intersections.insert(intersection2);
+    }
+    for (const VehicleGenerator* generator : generators.values()) {
+        VehicleGenerator* generator2 = new VehicleGenerator(*generator);
+        generator2->rebind(map);
+        copy->generators.insert(generator2);
+    }
+    for (const Vehicle* vehicle : vehicles.values()) {
+        Vehicle* vehicle2 = map(vehicle);
+        vehicle2->rebind(map, &copy->graph);
+        Handle handle = copy->vehicles.insert(vehicle2);
+        vehicle2->setRegistration(handle, vehicle->getId());
+        copy->vehicleIds[vehicle->getId()] = handle;
+    }
+
+    copy->currentTime = currentTime;
+    copy->timeStep = timeStep;
+    copy->stepCounter = stepCounter;
+    copy->vehicleCounter = vehicleCounter;
+    copy->graphDirty = true;
+
+    ENSURE(copy->getRoads().size() == roads.size(), "Every road must be copied");
+    ENSURE(copy->getVehicles().size() == vehicles.size(), "Every vehicle must be copied");
+    ENSURE(copy->getTrafficLights().size() == trafficLights.size(), "Every light must be copied");
+    return copy;
+}
+
+/**
+ * @brief Forks the process and runs the branch on the child's copy of this simulation.
+ *
+ * Buffered output is flushed first so the child does not print it again. The
+ * child never returns: it writes the branch output, or the message of the
+ * exception the branch threw, to the pipe and exits without running destructors,
+ * because the helper threads they would join exist only in the parent. For the
+ * same reason the road scheduler is abandoned rather than destroyed.
+ *
+ * @param branch Work done in the child.
+ * @return The running branch.
+ */
+std::unique_ptr<SimulationFork> Simulation::fork(const SimulationFork::Branch& branch) {
+    REQUIRE(exchange == nullptr, "A partitioned simulation cannot be forked");
+    REQUIRE(scheduler == nullptr && renderer == nullptr && telemetry == nullptr,
+            "Only the calling thread survives a fork, so no worker, render or telemetry thread may run");
+
+    int pipeEnds[2];
+    if (::pipe(pipeEnds) != 0) {
+        throw std::runtime_error("Failed to create the pipe of a fork");
+    }
+    std::cout.flush();
+    std::cerr.flush();
+    std::fflush(nullptr);
+    pid_t pid = ::fork();
+    if (pid < 0) {
+        ::close(pipeEnds[0]);
+        ::close(pipeEnds[1]);
+        throw std::runtime_error("Failed to fork the simulation");
+    }
+    if (pid > 0) {
+        ::close(pipeEnds[1]);
+        return std::make_unique<SimulationFork>(pid, pipeEnds[0]);
+    }
+
+    ::close(pipeEnds[0]);
+    metricsOut = nullptr;
+    journal = nullptr;
+    for (Intersection* intersection : intersections.values())
+        intersection->setJournal(nullptr);
+    std::ostringstream out;
+    int status = 0;
+    try {
+        branch(*this, out);
+    } catch (const std::exception& e) {
+        out.str(e.what());
+        status = 1;
+    }
+    std::string result = out.str();
+    for (std::size_t sent = 0; sent < result.size(); ) {
+        ssize_t count = ::write(pipeEnds[1], result.data() + sent, result.size() - sent);
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count <= 0)
+            break;
+        sent += static_cast<std::size_t>(count);
+    }
+    std::cout.flush();
+    ::_exit(status);
+}
+
+/**
+ * @brief Adds a road to the simulation, together with its vehicles and traffic lights.
  * @param road Pointer to the road to add (must not be nullptr).
+ * @return Handle of the road.
  */
-void Simulation::addRoad(Road* road) {
+Handle Simulation::addRoad(Road* road) {
     REQUIRE(road != nullptr, "Road cannot be null");
     
-    size_t oldSize = roads.size();
-    roads.push_back(road);
+    CONTRACT_OLD(size_t, oldSize, roads.size());
+    Handle handle = roads.insert(road);
+    graphDirty = true;
+    for (auto* vehicle : road->getVehicles())
+        addVehicle(vehicle);
+    for (auto* light : road->getTrafficLights())
+        addTrafficLight(light);
+    for (auto* detector : road->getDetectors())
+        addDetector(detector);
     
     ENSURE(roads.size() == oldSize + 1, "Road was not added properly");
+    return handle;
 }
 
 /**
  * @brief Adds a traffic light to the simulation.
  * @param light Pointer to the traffic light to add (must not be nullptr).
+ * @return Handle of the traffic light; the existing one if it was already added.
  */
-void Simulation::addTrafficLight(TrafficLight* light) {
+Handle Simulation::addTrafficLight(TrafficLight* light) {
     REQUIRE(light != nullptr, "Traffic light cannot be null");
     
-    size_t oldSize = trafficLights.size();
-    trafficLights.push_back(light);
+    auto it = lightHandles.find(light);
+    if (it != lightHandles.end())
+        return it->second;
+
+    CONTRACT_OLD(size_t, oldSize, trafficLights.size());
+    Handle handle = trafficLights.insert(light);
+    lightHandles[light] = handle;
     
     ENSURE(trafficLights.size() == oldSize + 1, "Traffic light was not added properly");
+    return handle;
+}
+
+/**
+ * @brief Adds a loop detector to the simulation.
+ * @param detector Pointer to the detector to add (must not be nullptr).
+ * @return Handle of the detector; the existing one if it was already added.
+ */
+Handle Simulation::addDetector(Detector* detector) {
+    REQUIRE(detector != nullptr, "Detector cannot be null");
+
+    auto it = detectorHandles.find(detector);
+    if (it != detectorHandles.end())
+        return it->second;
+
+    CONTRACT_OLD(size_t, oldSize, detectors.size());
+    const std::vector<Detector*>& onRoad = detector->getRoad()->getDetectors();
+    if (std::find(onRoad.begin(), onRoad.end(), detector) == onRoad.end())
+        detector->getRoad()->addDetector(detector);
+    detector->start(currentTime);
+    Handle handle = detectors.insert(detector);
+    detectorHandles[detector] = handle;
+
+    ENSURE(detectors.size() == oldSize + 1, "Detector was not added properly");
+    return handle;
 }
 
 /**
- * @brief Adds a vehicle to the simulation manually.
- * Useful for testing purposes.
+ * @brief Adds a vehicle to the simulation and gives it a stable id.
+ * A vehicle that already carries an id that was handed out before and no
+ * registered vehicle has, such as one received from another partition, keeps it. Useful for testing purposes.
  * @param vehicle Pointer to the vehicle to add (must not be nullptr).
+ * @return Handle of the vehicle; the existing one if it was already added.
  */
-void Simulation::addVehicle(Vehicle* vehicle) {
+Handle Simulation::addVehicle(Vehicle* vehicle) {
     REQUIRE(vehicle != nullptr, "Vehicle cannot be null");
     
-    size_t oldSize = vehicles.size();
-    vehicles.push_back(vehicle);
+    if (vehicle->getHandle() != INVALID_HANDLE && vehicles.get(vehicle->getHandle()) == vehicle)
+        return vehicle->getHandle();
+
+    CONTRACT_OLD(size_t, oldSize, vehicles.size());
+    Handle handle = vehicles.insert(vehicle);
+    std::uint32_t id = vehicle->getId();
+    if (id == 0 || id >= static_cast<std::uint32_t>(vehicleCounter) || vehicleIds.count(id) != 0)
+        id = static_cast<std::uint32_t>(vehicleCounter++);
+    vehicle->setRegistration(handle, id);
+    vehicleIds[id] = handle;
+    if (vehicle->getDestination() != nullptr)
+        vehicle->setRouter(&graph);
     
     ENSURE(vehicles.size() == oldSize + 1, "Vehicle was not added properly");
-}
-
-/**
- * @brief Returns a constant reference to the vector of roads.
- * @return Vector of Road pointers.
- */
-const std::vector<Road*>& Simulation::getRoads() const {
-    return roads;
+    ENSURE(vehicle->getId() != 0, "Vehicle must have an id");
+    return handle;
 }
 
 /**
  * @brief Adds a vehicle generator to the simulation.
  * @param generator Pointer to the generator to add (must not be nullptr).
+ * @return Handle of the generator.
  */
-void Simulation::addGenerator(VehicleGenerator* generator) {
+Handle Simulation::addGenerator(VehicleGenerator* generator) {
     REQUIRE(generator != nullptr, "Generator cannot be null");
     
-    size_t oldSize = generators.size();
-    generators.push_back(generator);
+    CONTRACT_OLD(size_t, oldSize, generators.size());
+    Handle handle = generators.insert(generator);
     
     ENSURE(generators.size() == oldSize + 1, "Generator was not added properly");
+    return handle;
+}
+
+/**
+ * @brief Adds an origin-destination demand to the simulation.
+ * @param demand Pointer to the demand to add (must not be nullptr).
+ * @return Handle of the demand.
+ */
+Handle Simulation::addDemand(OdDemand* demand) {
+    REQUIRE(demand != nullptr, "Demand cannot be null");
+    REQUIRE(exchange == nullptr, "Demand cannot be used in a partitioned simulation");
+
+    CONTRACT_OLD(size_t, oldSize, demands.size());
+    Handle handle = demands.insert(demand);
+    getRoadGraph();
+    routeCache.precompute(demand->getHeaviestPairs(), currentTime);
+
+    ENSURE(demands.size() == oldSize + 1, "Demand was not added properly");
+    return handle;
 }
 
 /**
  * @brief Adds a bus stop to the simulation.
  * @param stop Pointer to the bus stop to add (must not be nullptr).
+ * @return Handle of the bus stop.
  */
-void Simulation::addBusStop(BusStop* stop) {
+Handle Simulation::addBusStop(BusStop* stop) {
     REQUIRE(stop != nullptr, "Bus stop cannot be null");
     
-    size_t oldSize = busStops.size();
-    busStops.push_back(stop);
+    CONTRACT_OLD(size_t, oldSize, busStops.size());
+    Handle handle = busStops.insert(stop);
     
     ENSURE(busStops.size() == oldSize + 1, "Bus stop was not added properly");
+    return handle;
 }
 
 /**
  * @brief Adds an intersection to the simulation.
  * @param intersection Pointer to the intersection to add (must not be nullptr).
+ * @return Handle of the intersection.
  */
-void Simulation::addIntersection(Intersection* intersection) {
+Handle Simulation::addIntersection(Intersection* intersection) {
     REQUIRE(intersection != nullptr, "Intersection cannot be null");
     
-    size_t oldSize = intersections.size();
-    intersections.push_back(intersection);
+    CONTRACT_OLD(size_t, oldSize, intersections.size());
+    Handle handle = intersections.insert(intersection);
+    intersection->setJournal(journal);
+    graphDirty = true;
     
     ENSURE(intersections.size() == oldSize + 1, "Intersection was not added properly");
+    return handle;
+}
+
+/**
+ * @brief Adds the roads first, so the other elements find their roads registered.
+ * @param roads Parsed roads.
+ * @param generators Parsed vehicle generators.
+ * @param busStops Parsed bus stops.
+ * @param intersections Parsed intersections.
+ */
+void Simulation::addScenario(const std::vector<Road*>& roads, const std::vector<VehicleGenerator*>& generators,
+                             const std::vector<BusStop*>& busStops,
+                             const std::vector<Intersection*>& intersections) {
+    for (auto* road : roads)
+        addRoad(road);
+    for (auto* gen : generators)
+        addGenerator(gen);
+    for (auto* bs : busStops)
+        addBusStop(bs);
+    for (auto* isec : intersections)
+        addIntersection(isec);
+}
+
+/**
+ * @brief Looks up a road by handle.
+ * @param handle Handle returned by addRoad().
+ * @return The road, or nullptr for an invalid handle.
+ */
+Road* Simulation::getRoad(Handle handle) const {
+    return roads.get(handle);
+}
+
+/**
+ * @brief Looks up a vehicle by handle.
+ * @param handle Handle returned by addVehicle().
+ * @return The vehicle, or nullptr if it has left the simulation.
+ */
+Vehicle* Simulation::getVehicle(Handle handle) const {
+    return vehicles.get(handle);
+}
+
+/**
+ * @brief Looks up a vehicle by its stable id.
+ * @param id Id assigned when the vehicle was added.
+ * @return The vehicle, or nullptr if it has left the simulation.
+ */
+Vehicle* Simulation::findVehicleById(std::uint32_t id) const {
+    auto it = vehicleIds.find(id);
+    return it == vehicleIds.end() ? nullptr : vehicles.get(it->second);
+}
+
+/**
+ * @brief Looks up a traffic light by handle.
+ * @param handle Handle returned by addTrafficLight().
+ * @return The traffic light, or nullptr for an invalid handle.
+ */
+TrafficLight* Simulation::getTrafficLight(Handle handle) const {
+    return trafficLights.get(handle);
+}
+
+/**
+ * @brief Looks up a vehicle generator by handle.
+ * @param handle Handle returned by addGenerator().
+ * @return The generator, or nullptr for an invalid handle.
+ */
+VehicleGenerator* Simulation::getGenerator(Handle handle) const {
+    return generators.get(handle);
+}
+
+/**
+ * @brief Looks up a bus stop by handle.
+ * @param handle Handle returned by addBusStop().
+ * @return The bus stop, or nullptr for an invalid handle.
+ */
+BusStop* Simulation::getBusStop(Handle handle) const {
+    return busStops.get(handle);
+}
+
+/**
+ * @brief Looks up an intersection by handle.
+ * @param handle Handle returned by addIntersection().
+ * @return The intersection, or nullptr for an invalid handle.
+ */
+Intersection* Simulation::getIntersection(Handle handle) const {
+    return intersections.get(handle);
+}
+
+/**
+ * @brief Returns a constant reference to the vector of roads.
+ * @return Vector of Road pointers.
+ */
+const std::vector<Road*>& Simulation::getRoads() const {
+    return roads.values();
 }
 
 /**
@@ -218,7 +788,7 @@ void Simulation::addIntersection(Intersection* intersection) {
  * @return Vector of Vehicle pointers.
  */
 const std::vector<Vehicle*>& Simulation::getVehicles() const {
-    return vehicles;
+    return vehicles.values();
 }
 
 /**
@@ -226,7 +796,15 @@ const std::vector<Vehicle*>& Simulation::getVehicles() const {
  * @return Vector of TrafficLight pointers.
  */
 const std::vector<TrafficLight*>& Simulation::getTrafficLights() const {
-    return trafficLights;
+    return trafficLights.values();
+}
+
+/**
+ * @brief Returns a constant reference to the vector of loop detectors.
+ * @return Vector of Detector pointers.
+ */
+const std::vector<Detector*>& Simulation::getDetectors() const {
+    return detectors.values();
 }
 
 /**
@@ -234,7 +812,356 @@ const std::vector<TrafficLight*>& Simulation::getTrafficLights() const {
  * @return Vector of Intersection pointers.
  */
 const std::vector<Intersection*>& Simulation::getIntersections() const {
-    return intersections;
+    return intersections.values();
+}
+
+/**
+ * @brief Returns a constant reference to the vector of vehicle generators.
+ * @return Vector of VehicleGenerator pointers.
+ */
+const std::vector<VehicleGenerator*>& Simulation::getGenerators() const {
+    return generators.values();
+}
+
+/**
+ * @brief Returns the routing graph, compiling it first if the network changed.
+ * The routes to the generators' destinations are built right away, so spawning
+ * routed vehicles never waits for a shortest-path search during a step.
+ * @return The compiled graph.
+ */
+const RoadGraph& Simulation::getRoadGraph() {
+    if (graphDirty) {
+        graph.build(roads.values(), intersections.values());
+        graphDirty = false;
+        routeCache.clear();
+        if (scheduler)
+            scheduler->build(roads.values(), intersections.values());
+        for (const VehicleGenerator* generator : generators.values()) {
+            if (generator->getDestination() != nullptr && graph.indexOf(generator->getDestination()) >= 0)
+                graph.precompute(generator->getDestination());
+        }
+    }
+    ENSURE(graph.getRoadCount() == static_cast<int>(roads.size()), "Graph must contain every road");
+    return graph;
+}
+
+/**
+ * @brief Replaces the road scheduler; one thread steps the roads serially.
+ * @param threads Number of worker threads.
+ * @param rebalanceInterval Steps between load checks.
+ * @param imbalanceThreshold Imbalance that triggers a rebalance.
+ */
+void Simulation::setThreadCount(int threads, int rebalanceInterval, double imbalanceThreshold) {
+    REQUIRE(threads >= 1, "threads must be at least 1");
+    REQUIRE(journal == nullptr || threads == 1, "A journaled simulation must update its roads on one thread");
+
+    scheduler.reset();
+    if (threads > 1) {
+        scheduler.reset(new RoadScheduler(threads, rebalanceInterval, imbalanceThreshold));
+        scheduler->build(roads.values(), intersections.values());
+    }
+
+    ENSURE(getThreadCount() == threads, "Thread count was not set");
+}
+
+/**
+ * @brief Returns the number of threads that update roads.
+ * @return Worker count, 1 when serial.
+ */
+int Simulation::getThreadCount() const {
+    return scheduler ? scheduler->getThreadCount() : 1;
+}
+
+/**
+ * @brief Returns the road scheduler.
+ * @return The scheduler, or nullptr when serial.
+ */
+const RoadScheduler* Simulation::getScheduler() const {
+    return scheduler.get();
+}
+
+/**
+ * @brief Restricts the simulation to the roads owned by a boundary exchange.
+ * @param boundary The exchange (must not be nullptr).
+ */
+void Simulation::setBoundaryExchange(BoundaryExchange* boundary) {
+    REQUIRE(boundary != nullptr, "Boundary exchange cannot be null");
+    REQUIRE(demands.size() == 0, "Demand cannot be used in a partitioned simulation");
+
+    exchange = boundary;
+    for (auto* road : roads.values()) {
+        if (isLocal(road))
+            continue;
+        std::vector<Vehicle*> foreign = road->getVehicles();
+        for (Vehicle* vehicle : foreign) {
+            road->removeVehicle(vehicle);
+            releaseVehicle(vehicle);
+        }
+    }
+
+    ENSURE(exchange == boundary, "Boundary exchange was not set");
+}
+
+/**
+ * @brief Returns the route cache.
+ * @return The cache shared by all demands.
+ */
+RouteCache& Simulation::getRouteCache() {
+    return routeCache;
+}
+
+/**
+ * @brief Sets the length of every following step.
+ * @param dt Step length in seconds.
+ */
+void Simulation::setTimeStep(double dt) {
+    REQUIRE(dt > 0, "The time step must be positive");
+    timeStep = dt;
+    ENSURE(getTimeStep() == dt, "Time step was not set");
+}
+
+/**
+ * @brief Returns the step length.
+ * @return Seconds per step.
+ */
+double Simulation::getTimeStep() const {
+    return timeStep;
+}
+
+/**
+ * @brief Starts aggregating the running sums of the roads every period.
+ * @param period Seconds per interval.
+ * @param out Stream that receives the CSV header and every closed interval, or nullptr.
+ */
+void Simulation::setRoadMetrics(double period, std::ostream* out) {
+    REQUIRE(period > 0, "The aggregation period must be positive");
+
+    metrics = std::make_unique<RoadMetrics>(period);
+    metrics->start(currentTime, roads.values());
+    metricsOut = out;
+    if (metricsOut != nullptr)
+        RoadMetrics::writeCsvHeader(*metricsOut);
+}
+
+/**
+ * @brief Sets the render thread that run() publishes snapshots to.
+ * @param renderer Render thread, or nullptr.
+ * @param interval Simulated seconds between two snapshots; the first follows the next step.
+ */
+void Simulation::setFrameOutput(RenderThread* renderer, double interval) {
+    REQUIRE(interval > 0, "The frame interval must be positive");
+
+    this->renderer = renderer;
+    frameInterval = interval;
+    nextFrameTime = currentTime;
+}
+
+/**
+ * @brief Sets the telemetry server that every step is published to.
+ * @param server The server, or nullptr.
+ */
+void Simulation::setTelemetry(TelemetryServer* server) {
+    telemetry = server;
+}
+
+/**
+ * @brief Sets the buffer that records every step and records the current state as its first keyframe.
+ * @param buffer The buffer, or nullptr.
+ */
+void Simulation::setRewind(RewindBuffer* buffer) {
+    REQUIRE(demands.size() == 0 && exchange == nullptr, "Only a simulation that can be cloned can be rewound");
+
+    rewind = buffer;
+    if (rewind != nullptr && rewind->getLastStep() != stepCounter)
+        rewind->record(*this);
+}
+
+/**
+ * @brief Restores the keyframe before the step if the step lies in the past, then steps up to it.
+ * @param step Step count to reach.
+ */
+void Simulation::seek(int step) {
+    REQUIRE(step >= stepCounter || (rewind != nullptr && step >= rewind->getFirstStep()),
+            "Only steps in the rewind buffer or in the future can be reached");
+    REQUIRE(journal == nullptr || step >= stepCounter, "A journaled simulation cannot go back");
+
+    if (step < stepCounter) {
+        std::unique_ptr<Simulation> state = rewind->keyframeAt(step).clone();
+        rewind->truncate(state->getStepCount());
+        adoptState(*state);
+    }
+    while (stepCounter < step)
+        runStep();
+
+    ENSURE(getStepCount() == step, "The simulation must be at the step");
+}
+
+/**
+ * @brief Returns the step counter.
+ * @return Steps run.
+ */
+int Simulation::getStepCount() const {
+    return stepCounter;
+}
+
+/**
+ * @brief Starts the journal at the current state and hands it to the intersections.
+ * @param journal The journal, or nullptr.
+ */
+void Simulation::setJournal(Journal* journal) {
+    REQUIRE(journal == nullptr || getThreadCount() == 1, "A journaled simulation must update its roads on one thread");
+
+    if (journal != nullptr)
+        journal->begin(*this);
+    this->journal = journal;
+    for (Intersection* intersection : intersections.values())
+        intersection->setJournal(journal);
+}
+
+/**
+ * @brief Validates a command and queues it for the next step.
+ * @param command The command.
+ */
+void Simulation::execute(const std::string& command) {
+    REQUIRE(journal == nullptr || !journal->isReplaying(), "A replayed simulation takes its commands from the journal");
+
+    applyCommand(command, true);
+    commands.push_back(command);
+}
+
+/**
+ * @brief Steps until the journal has no steps left.
+ * @return Steps run.
+ */
+int Simulation::replay() {
+    REQUIRE(journal != nullptr && journal->isReplaying(), "Only a simulation with a replaying journal can replay");
+
+    int steps = 0;
+    while (!journal->atEnd()) {
+        runStep();
+        steps++;
+    }
+    return steps;
+}
+
+/**
+ * @brief Parses a command and applies it unless it is only checked.
+ * @param command The command.
+ * @param check true to only validate it.
+ */
+void Simulation::applyCommand(const std::string& command, bool check) {
+    std::istringstream in(command);
+    std::string verb;
+    std::string roadName;
+    std::string rest;
+    in >> verb >> roadName;
+    if (verb != "cyclus" && verb != "voertuig") {
+        throw std::runtime_error("Unknown command: " + command);
+    }
+    Road* road = roadName.empty() ? nullptr : Road::getRoadByName(roadName, roads.values());
+    if (road == nullptr) {
+        throw std::runtime_error("Unknown road in command: " + command);
+    }
+
+    if (verb == "cyclus") {
+        int cycle = 0;
+        if (!(in >> cycle) || cycle <= 0 || (in >> rest) || road->getTrafficLights().empty()) {
+            throw std::runtime_error("Invalid cycle command: " + command);
+        }
+        if (!check) {
+            for (TrafficLight* light : road->getTrafficLights())
+                light->setCycle(cycle);
+        }
+        return;
+    }
+
+    std::string type;
+    double position = -1;
+    if (!(in >> type >> position) || !(position >= 0 && position <= road->getLength()) || (in >> rest)) {
+        throw std::runtime_error("Invalid vehicle command: " + command);
+    }
+    if (!Vehicle::isKnownType(type)) {
+        throw std::runtime_error("Invalid vehicle type in command: " + command);
+    }
+    if (check)
+        return;
+    Vehicle* vehicle = Vehicle::create(type, road, position);
+    road->addVehicle(vehicle);
+    addVehicle(vehicle);
+}
+
+/**
+ * @brief Swaps the registries with another simulation and copies its clock.
+ *
+ * Vehicles of the other simulation route on its graph, so routed vehicles are
+ * pointed at this simulation's graph, which is rebuilt on the next step.
+ *
+ * @param other The simulation whose state is taken over.
+ */
+void Simulation::adoptState(Simulation& other) {
+    REQUIRE(other.demands.size() == 0 && demands.size() == 0, "Demand cannot be moved between simulations");
+
+    roads.swap(other.roads);
+    vehicles.swap(other.vehicles);
+    trafficLights.swap(other.trafficLights);
+    detectors.swap(other.detectors);
+    generators.swap(other.generators);
+    busStops.swap(other.busStops);
+    intersections.swap(other.intersections);
+    vehicleIds.swap(other.vehicleIds);
+    lightHandles.swap(other.lightHandles);
+    detectorHandles.swap(other.detectorHandles);
+
+    currentTime = other.currentTime;
+    timeStep = other.timeStep;
+    stepCounter = other.stepCounter;
+    vehicleCounter = other.vehicleCounter;
+    graphDirty = true;
+    routeCache.clear();
+    for (Vehicle* vehicle : vehicles.values()) {
+        if (vehicle->getDestination() != nullptr)
+            vehicle->setRouter(&graph);
+    }
+    if (metrics)
+        metrics->start(currentTime, roads.values());
+    nextFrameTime = currentTime;
+
+    ENSURE(getStepCount() == other.getStepCount(), "The step count must be taken over");
+}
+
+/**
+ * @brief Returns the per-road aggregation.
+ * @return The aggregation, or nullptr.
+ */
+const RoadMetrics* Simulation::getRoadMetrics() const {
+    return metrics.get();
+}
+
+/**
+ * @brief Derives one seed per intersection from the given seed and restarts their generators.
+ * @param seed The seed.
+ */
+void Simulation::seed(std::uint32_t seed) {
+    std::seed_seq sequence{seed};
+    std::vector<std::uint32_t> seeds(intersections.size());
+    sequence.generate(seeds.begin(), seeds.end());
+    for (std::size_t i = 0; i < seeds.size(); i++)
+        intersections.values()[i]->seed(seeds[i]);
+}
+
+/**
+ * @brief Returns the merged statistics counters of all threads.
+ * @return Snapshot of the cumulative counters.
+ */
+SimulationStats Simulation::getStats() const {
+    return stats.merged();
+}
+
+/**
+ * @brief Clears the statistics counters, e.g. after a warmup period.
+ */
+void Simulation::resetStats() {
+    stats.reset();
 }
 
 /**
@@ -242,5 +1169,5 @@ const std::vector<Intersection*>& Simulation::getIntersections() const {
  * @return Vector of BusStop pointers.
  */
 const std::vector<BusStop*>& Simulation::getBusStops() const {
-    return busStops;
+    return busStops.values();
 }
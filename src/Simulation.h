@@ -3,19 +3,39 @@
 
 #include <vector>
 #include <string>
+#include <iosfwd>
+#include <memory>
+#include <unordered_map>
+#include "SimulationStats.h"
+#include "SlotMap.h"
+#include "RoadGraph.h"
+#include "RouteCache.h"
+#include "SimulationFork.h"
 
 class Road;
 class Vehicle;
 class TrafficLight;
+class Detector;
+class RoadMetrics;
+class RenderThread;
+class TelemetryServer;
+class RewindBuffer;
+class Journal;
 class VehicleGenerator;
 class BusStop;
 class Intersection;
+class OdDemand;
+class BoundaryExchange;
+class RoadScheduler;
 
 /**
  * @class Simulation
  * @brief Simulates the traffic system by managing roads, vehicles, traffic lights, and related entities.
  * 
  * Handles the simulation time, step updates, and contains methods to add and access simulation components.
+ * The simulation owns every entity added to it: each one is kept in a generational
+ * registry and addressed by a 32-bit Handle, and vehicles additionally get an id
+ * that stays the same for the whole run.
  */
 class Simulation {
 public:
@@ -27,6 +47,44 @@ public:
      */
     Simulation();
 
+    /**
+     * @brief Deletes all entities owned by the simulation.
+     */
+    ~Simulation();
+
+    Simulation(const Simulation&) = delete;
+    Simulation& operator=(const Simulation&) = delete;
+
+    /**
+     * @brief Copies the simulation with all of its entities and their state.
+     * The copy has the same time, vehicle ids, step length and random generator
+     * states, so stepping both gives the same results. It updates its roads on
+     * one thread and starts with zero statistics. Only reads this simulation, so
+     * several threads may clone it at once while it is not stepped.
+     * @return The copy.
+     * @pre no demand has been added
+     * @pre no boundary exchange is set
+     * @post the copy has as many roads, vehicles, lights, generators, stops and intersections
+     */
+    std::unique_ptr<Simulation> clone() const;
+
+    /**
+     * @brief Branches the simulation into a child process that runs a what-if.
+     * The child shares this simulation's memory copy-on-write, so forking does
+     * not copy the vehicles (see SimulationFork). Only the calling thread exists
+     * in the child, so the simulation may not use worker, render or telemetry
+     * threads; no other thread of the process may hold a lock the branch needs.
+     * In the child the metrics stream and journal are detached, so the branch
+     * cannot disturb the outputs of the original. The branch only returns the
+     * text it writes: the forked simulation cannot be queried from this process.
+     * @param branch Changes and steps the simulation in the child and writes its results.
+     * @return The running branch.
+     * @pre no boundary exchange is set
+     * @pre getThreadCount() == 1 and no frame output or telemetry is set
+     * @throws std::runtime_error if the pipe or the process cannot be created.
+     */
+    std::unique_ptr<SimulationFork> fork(const SimulationFork::Branch& branch);
+
     /**
      * @brief Executes one step of the simulation.
      * Updates all roads, vehicles, traffic lights, and generators.
@@ -35,7 +93,7 @@ public:
     void runStep();
 
     /**
-     * @brief Runs the simulation until all vehicles have left the roads.
+     * @brief Runs the simulation until all vehicles have left the roads and all demand has departed.
      * @post simulation ends when no vehicles remain on roads
      */
     void run();
@@ -47,52 +105,139 @@ public:
     void outputState() const;
 
     /**
-     * @brief Adds a road to the simulation.
+     * @brief Adds a road to the simulation and takes ownership of it.
+     * The vehicles and traffic lights already on the road are registered as well.
      * @param road Pointer to the road to add.
+     * @return Handle of the road.
      * @pre road != nullptr
      * @post road is included in getRoads()
      */
-    void addRoad(Road* road);
+    Handle addRoad(Road* road);
 
     /**
-     * @brief Adds a traffic light to the simulation.
+     * @brief Adds a traffic light to the simulation and takes ownership of it.
+     * Adding a light that is already registered returns its existing handle.
      * @param light Pointer to the traffic light to add.
+     * @return Handle of the traffic light.
      * @pre light != nullptr
      * @post light is included in getTrafficLights()
      */
-    void addTrafficLight(TrafficLight* light);
+    Handle addTrafficLight(TrafficLight* light);
+
+    /**
+     * @brief Adds a loop detector to the simulation and takes ownership of it.
+     * The detector is placed on its road if it is not there yet, and its first
+     * interval starts at the current time. Adding a detector that is already
+     * registered returns its existing handle.
+     * @param detector Pointer to the detector to add.
+     * @return Handle of the detector.
+     * @pre detector != nullptr
+     * @post detector is included in getDetectors()
+     */
+    Handle addDetector(Detector* detector);
 
     /**
-     * @brief Adds a vehicle manually to the simulation (useful for testing).
+     * @brief Adds a vehicle manually to the simulation (useful for testing) and takes ownership of it.
+     * Adding a vehicle that is already registered returns its existing handle.
+     * A vehicle with a destination is routed through getRoadGraph(). A vehicle
+     * that carries a free id below the next one to hand out, such as one
+     * received from another partition, keeps that id.
      * @param vehicle Pointer to the vehicle to add.
+     * @return Handle of the vehicle.
      * @pre vehicle != nullptr
      * @post vehicle is included in getVehicles()
+     * @post vehicle->getId() != 0
      */
-    void addVehicle(Vehicle* vehicle);
+    Handle addVehicle(Vehicle* vehicle);
 
     /**
-     * @brief Adds a vehicle generator to the simulation.
+     * @brief Adds a vehicle generator to the simulation and takes ownership of it.
      * @param generator Pointer to the vehicle generator to add.
+     * @return Handle of the generator.
      * @pre generator != nullptr
      * @post generator is included in generators list
      */
-    void addGenerator(VehicleGenerator* generator);
+    Handle addGenerator(VehicleGenerator* generator);
+
+    /**
+     * @brief Adds an origin-destination demand to the simulation and takes ownership of it.
+     * The routes of the demand's heaviest pairs are computed right away, in parallel.
+     * @param demand Pointer to the demand to add.
+     * @return Handle of the demand.
+     * @pre demand != nullptr
+     * @pre no boundary exchange is set
+     */
+    Handle addDemand(OdDemand* demand);
 
     /**
-     * @brief Adds a bus stop to the simulation.
+     * @brief Adds a bus stop to the simulation and takes ownership of it.
      * @param stop Pointer to the bus stop to add.
+     * @return Handle of the bus stop.
      * @pre stop != nullptr
      * @post stop is included in getBusStops()
      */
-    void addBusStop(BusStop* stop);
+    Handle addBusStop(BusStop* stop);
 
     /**
-     * @brief Adds an intersection to the simulation.
+     * @brief Adds an intersection to the simulation and takes ownership of it.
      * @param intersection Pointer to the intersection to add.
+     * @return Handle of the intersection.
      * @pre intersection != nullptr
      * @post intersection is included in getIntersections()
      */
-    void addIntersection(Intersection* intersection);
+    Handle addIntersection(Intersection* intersection);
+
+    /**
+     * @brief Adds everything Parser read from a scenario, in scenario order, and takes ownership of it.
+     * @param roads Parsed roads.
+     * @param generators Parsed vehicle generators.
+     * @param busStops Parsed bus stops.
+     * @param intersections Parsed intersections.
+     */
+    void addScenario(const std::vector<Road*>& roads, const std::vector<VehicleGenerator*>& generators,
+                     const std::vector<BusStop*>& busStops, const std::vector<Intersection*>& intersections);
+
+    /**
+     * @brief Looks up a road by handle in O(1).
+     * @return The road, or nullptr if the handle is invalid.
+     */
+    Road* getRoad(Handle handle) const;
+
+    /**
+     * @brief Looks up a vehicle by handle in O(1).
+     * @return The vehicle, or nullptr if the handle is invalid or the vehicle has left.
+     */
+    Vehicle* getVehicle(Handle handle) const;
+
+    /**
+     * @brief Looks up a vehicle by its stable id in O(1).
+     * @return The vehicle, or nullptr if no vehicle with that id is in the simulation.
+     */
+    Vehicle* findVehicleById(std::uint32_t id) const;
+
+    /**
+     * @brief Looks up a traffic light by handle in O(1).
+     * @return The traffic light, or nullptr if the handle is invalid.
+     */
+    TrafficLight* getTrafficLight(Handle handle) const;
+
+    /**
+     * @brief Looks up a vehicle generator by handle in O(1).
+     * @return The generator, or nullptr if the handle is invalid.
+     */
+    VehicleGenerator* getGenerator(Handle handle) const;
+
+    /**
+     * @brief Looks up a bus stop by handle in O(1).
+     * @return The bus stop, or nullptr if the handle is invalid.
+     */
+    BusStop* getBusStop(Handle handle) const;
+
+    /**
+     * @brief Looks up an intersection by handle in O(1).
+     * @return The intersection, or nullptr if the handle is invalid.
+     */
+    Intersection* getIntersection(Handle handle) const;
 
     /**
      * @brief Returns the list of roads in the simulation.
@@ -103,8 +248,9 @@ public:
 
     /**
      * @brief Returns the list of vehicles in the simulation.
+     * Vehicles are removed when they leave the last road, so the order is not stable.
      * @return Vector of pointers to Vehicle objects.
-     * @post returned vector reflects all added vehicles
+     * @post returned vector reflects all vehicles currently in the simulation
      */
     const std::vector<Vehicle*>& getVehicles() const;
 
@@ -115,6 +261,12 @@ public:
      */
     const std::vector<TrafficLight*>& getTrafficLights() const;
 
+    /**
+     * @brief Returns the loop detectors in the simulation.
+     * @return Vector of pointers to Detector objects.
+     */
+    const std::vector<Detector*>& getDetectors() const;
+
     /**
      * @brief Returns the list of intersections in the simulation.
      * @return Vector of pointers to Intersection objects.
@@ -122,6 +274,13 @@ public:
      */
     const std::vector<Intersection*>& getIntersections() const;
 
+    /**
+     * @brief Returns the list of vehicle generators in the simulation.
+     * @return Vector of pointers to VehicleGenerator objects.
+     * @post returned vector reflects all added generators
+     */
+    const std::vector<VehicleGenerator*>& getGenerators() const;
+
     /**
      * @brief Returns the list of bus stops in the simulation.
      * @return Vector of pointers to BusStop objects.
@@ -129,19 +288,252 @@ public:
      */
     const std::vector<BusStop*>& getBusStops() const;
 
+    /**
+     * @brief Returns the road network compiled for routing.
+     * The graph is recompiled after roads or intersections were added.
+     * @return The compiled graph; its address stays the same for the simulation's lifetime.
+     * @post getRoadGraph().getRoadCount() == getRoads().size()
+     */
+    const RoadGraph& getRoadGraph();
+
+    /**
+     * @brief Returns the cache of complete routes used by demand-spawned vehicles.
+     * The cache is cleared whenever the road graph is recompiled.
+     * @return The route cache.
+     */
+    RouteCache& getRouteCache();
+
+    /**
+     * @brief Restarts every random choice of the simulation from one seed.
+     * Two copies of a scenario seeded alike evolve identically.
+     * @param seed The seed.
+     */
+    void seed(std::uint32_t seed);
+
+    /**
+     * @brief Sets the simulated time of one step; the default is 0.0166 s (about 60 steps per second).
+     * @param dt Step length in seconds.
+     * @pre dt > 0
+     * @post getTimeStep() == dt
+     */
+    void setTimeStep(double dt);
+
+    /** @brief Returns the simulated time of one step in seconds. */
+    double getTimeStep() const;
+
+    /**
+     * @brief Aggregates flow, density and speed per road over fixed periods from now on.
+     * Every closed interval is written as CSV lines to out, if given, and is
+     * available from getRoadMetrics(). Clones do not aggregate.
+     * @param period Seconds per interval.
+     * @param out Stream for the aggregates, or nullptr; must outlive the simulation's use of it.
+     * @pre period > 0
+     */
+    void setRoadMetrics(double period, std::ostream* out = nullptr);
+
+    /**
+     * @brief Returns the per-road aggregation.
+     * @return The aggregation, or nullptr if setRoadMetrics() was not called.
+     */
+    const RoadMetrics* getRoadMetrics() const;
+
+    /**
+     * @brief Lets run() publish a snapshot of the roads every interval seconds.
+     * The renderer draws the snapshots on its own thread, so run() never waits for it.
+     * @param renderer Render thread; must outlive the simulation's use of it, or
+     *                 nullptr to stop publishing.
+     * @param interval Simulated seconds between two snapshots.
+     * @pre interval > 0
+     */
+    void setFrameOutput(RenderThread* renderer, double interval);
+
+    /**
+     * @brief Publishes a snapshot of the roads to a telemetry server after every step.
+     * @param server The server; must outlive the simulation's use of it, or nullptr to stop.
+     */
+    void setTelemetry(TelemetryServer* server);
+
+    /**
+     * @brief Records the state after every step into a rewind buffer, starting with the current state.
+     * @param buffer The buffer; must outlive the simulation's use of it, or nullptr to stop recording.
+     * @pre no demand has been added and no boundary exchange is set, since keyframes are clones
+     */
+    void setRewind(RewindBuffer* buffer);
+
+    /**
+     * @brief Moves the simulation to a step, backwards through the rewind buffer or forwards by stepping.
+     * Going back restores the nearest keyframe at or before the step and steps
+     * forward from it, so it takes at most one keyframe interval of steps. The
+     * buffer forgets the steps after that keyframe and records the replayed ones
+     * again. Attached outputs stay attached and see the replayed steps; the road
+     * metrics restart their period at the restored time.
+     * @param step Step count to reach.
+     * @pre step >= getStepCount() or a rewind buffer is set and step >= its first step
+     * @pre step >= getStepCount() while a journal is set, since a journal cannot go back
+     * @post getStepCount() == step
+     */
+    void seek(int step);
+
+    /** @brief Returns the number of steps run since the simulation started. */
+    int getStepCount() const;
+
+    /**
+     * @brief Records the nondeterministic decisions of every following step into a journal, or replays them from it.
+     * The journal gets the turning draws of the intersections, the spawns of the
+     * generators and the commands given to execute(). A replaying journal must
+     * be set on the same scenario at the same step as it was recorded; it then
+     * supplies the draws and commands, so the run is the recorded one whatever
+     * the seed. Clones and forks do not use the journal.
+     * @param journal The journal; must outlive the simulation's use of it, or nullptr to stop.
+     * @pre getThreadCount() == 1, since the draws of parallel roads have no fixed order
+     * @throws std::runtime_error if a replaying journal was recorded on another scenario or step.
+     */
+    void setJournal(Journal* journal);
+
+    /**
+     * @brief Queues an external command, applied at the start of the next step.
+     * Commands:
+     * - "cyclus <baan> <seconden>": sets the cycle of every light on the road
+     * - "voertuig <baan> <type> <positie>": adds a vehicle on the road's rightmost lane
+     * With a journal set the command is recorded when it is applied.
+     * @param command The command.
+     * @pre no replaying journal is set; its commands come from the journal
+     * @throws std::runtime_error if the command is unknown or its road, type or values are invalid.
+     */
+    void execute(const std::string& command);
+
+    /**
+     * @brief Runs the steps of the replaying journal without any output.
+     * @return The number of steps run.
+     * @pre a replaying journal is set
+     * @throws std::runtime_error if the run leaves the journal.
+     */
+    int replay();
+
+    /**
+     * @brief Updates the roads on several threads from now on.
+     * Roads joined by intersections are updated by the same thread, and the
+     * threads' measured road costs are rebalanced periodically. The results are
+     * the same as with one thread.
+     * @param threads Number of threads; 1 updates the roads serially again.
+     * @param rebalanceInterval Steps between two load checks.
+     * @param imbalanceThreshold Busiest thread cost over the average that triggers a rebalance.
+     * @pre threads >= 1
+     * @pre threads == 1 while a journal is set
+     * @post getThreadCount() == threads
+     */
+    void setThreadCount(int threads, int rebalanceInterval = 300, double imbalanceThreshold = 1.2);
+
+    /** @brief Returns the number of threads that update roads. */
+    int getThreadCount() const;
+
+    /**
+     * @brief Returns the scheduler of the road threads.
+     * @return The scheduler, or nullptr when roads are updated serially.
+     */
+    const RoadScheduler* getScheduler() const;
+
+    /**
+     * @brief Restricts the simulation to the roads a boundary exchange owns.
+     * Only owned roads, their lights and the generators on them are updated; the
+     * vehicles on foreign roads are removed. Vehicles leaving an owned road for a
+     * foreign one are sent through the exchange, which also supplies the tails of
+     * foreign successors and the vehicles arriving from other partitions.
+     * @param boundary The exchange; must outlive the simulation's use of it.
+     * @pre boundary != nullptr
+     * @pre no demand has been added
+     */
+    void setBoundaryExchange(BoundaryExchange* boundary);
+
+    /**
+     * @brief Returns the statistics counters accumulated since construction.
+     * Counters are kept per thread and merged here, so reading them is the only
+     * operation that synchronizes.
+     * @return Merged counters.
+     */
+    SimulationStats getStats() const;
+
+    /**
+     * @brief Resets all statistics counters to zero.
+     * @post getStats() returns all-zero counters
+     */
+    void resetStats();
+
     /// Current simulation time in seconds
     double currentTime;
 
 private:
-    std::vector<Road*> roads;
-    std::vector<Vehicle*> vehicles;
-    std::vector<TrafficLight*> trafficLights;
-    std::vector<VehicleGenerator*> generators;
-    std::vector<BusStop*> busStops;
-    std::vector<Intersection*> intersections;
+    /**
+     * @brief Moves the vehicles that drove off the end of a road to its successor,
+     * or deletes them if the road has none.
+     * @param road Road whose exited vehicles are handled.
+     * @post road->getExitedVehicles().empty()
+     */
+    void transferExitedVehicles(Road* road);
+
+    /**
+     * @brief Updates one road and its traffic lights.
+     * @return Seconds spent updating the lights.
+     */
+    double updateRoad(Road* road);
+
+    /** @brief Checks whether this simulation steps a road; always true without a boundary exchange. */
+    bool isLocal(const Road* road) const;
+
+    /** @brief Unregisters and deletes a vehicle that left this simulation. */
+    void releaseVehicle(Vehicle* vehicle);
+
+    /**
+     * @brief Applies an external command; see execute().
+     * @param check Only validate the command.
+     */
+    void applyCommand(const std::string& command, bool check);
+
+    /**
+     * @brief Takes over the entities, time and counters of another simulation.
+     * The other simulation gets this one's entities and deletes them with itself.
+     */
+    void adoptState(Simulation& other);
+
+    SlotMap<Road> roads;
+    SlotMap<Vehicle> vehicles;
+    SlotMap<TrafficLight> trafficLights;
+    SlotMap<Detector> detectors;
+    SlotMap<VehicleGenerator> generators;
+    SlotMap<BusStop> busStops;
+    SlotMap<Intersection> intersections;
+    SlotMap<OdDemand> demands;
+
+    RoadGraph graph;
+    bool graphDirty;
+    RouteCache routeCache;
+    BoundaryExchange* exchange;
+    std::unique_ptr<RoadScheduler> scheduler;
+    double timeStep;   ///< Simulated seconds per step.
+    std::unique_ptr<RoadMetrics> metrics;
+    std::ostream* metricsOut;
+    RenderThread* renderer;
+    TelemetryServer* telemetry;
+    RewindBuffer* rewind;
+    Journal* journal;
+    std::vector<std::string> commands; ///< Commands queued for the next step.
+    double frameInterval;
+    double nextFrameTime;
+
+    std::unordered_map<std::uint32_t, Handle> vehicleIds;
+    std::unordered_map<const TrafficLight*, Handle> lightHandles;
+    std::unordered_map<const Detector*, Handle> detectorHandles;
+
+    /**
+     * @brief Verifies global invariants (road membership, vehicle kinematics).
+     * Runs every step at contract level full and on sampled steps at level cheap.
+     */
+    void checkInvariants() const;
 
     int stepCounter;
     int vehicleCounter;
+
+    StatsCollector stats;
 };
 
 #endif // SIMULATION_H
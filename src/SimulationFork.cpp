@@ -0,0 +1,77 @@
+#include "SimulationFork.h"
+#include "DesignByContract.h"
+#include <cerrno>
+#include <csignal>
+#include <stdexcept>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/**
+ * @brief Stores the child and its pipe.
+ * @param pid Process id of the child.
+ * @param output Read end of the result pipe.
+ */
+SimulationFork::SimulationFork(int pid, int output)
+    : pid(pid), output(output)
+{
+    REQUIRE(pid > 0 && output >= 0, "A fork needs a child and its pipe");
+}
+
+/**
+ * @brief Ends an abandoned branch so it does not linger as a process or zombie.
+ */
+SimulationFork::~SimulationFork() {
+    if (pid <= 0)
+        return;
+    ::kill(pid, SIGKILL);
+    ::close(output);
+    ::waitpid(pid, nullptr, 0);
+}
+
+/**
+ * @brief Returns the child's process id.
+ * @return The pid, or -1 after wait().
+ */
+int SimulationFork::getPid() const {
+    return pid;
+}
+
+/**
+ * @brief Reads the pipe until the child closes it, then reaps the child.
+ *
+ * The pipe is drained before waiting, so a child with more output than the
+ * pipe holds does not block.
+ *
+ * @return The output of the branch.
+ */
+std::string SimulationFork::wait() {
+    if (pid <= 0) {
+        throw std::runtime_error("Fork was already waited for");
+    }
+
+    std::string result;
+    char buffer[65536];
+    while (true) {
+        ssize_t count = ::read(output, buffer, sizeof(buffer));
+        if (count > 0)
+            result.append(buffer, static_cast<std::size_t>(count));
+        else if (count == 0 || errno != EINTR)
+            break;
+    }
+    ::close(output);
+
+    int status = 0;
+    while (::waitpid(pid, &status, 0) < 0 && errno == EINTR) {
+    }
+    int child = pid;
+    pid = -1;
+
+    if (WIFSIGNALED(status)) {
+        throw std::runtime_error("Fork " + std::to_string(child) + " was killed by signal "
+                                 + std::to_string(WTERMSIG(status)));
+    }
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        throw std::runtime_error("Fork " + std::to_string(child) + " failed: " + result);
+    }
+    return result;
+}
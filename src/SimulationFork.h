@@ -0,0 +1,61 @@
+#ifndef SIMULATIONFORK_H
+#define SIMULATIONFORK_H
+
+#include <functional>
+#include <iosfwd>
+#include <string>
+
+class Simulation;
+
+/**
+ * @class SimulationFork
+ * @brief A what-if branch of a simulation, running in a forked child process.
+ *
+ * Simulation::fork() forks the process, so the branch starts with the exact
+ * state of the simulation without copying it: the kernel shares the memory
+ * page-wise and copies a page only when the branch or the original writes to
+ * it. Forking therefore takes milliseconds regardless of the number of
+ * vehicles, and a branch only uses memory for the pages it changes.
+ *
+ * The branch function gets the simulation and a stream; whatever it writes is
+ * sent back through a pipe and returned by wait() as serialized text, which is
+ * all a branch returns: its Simulation lives in the child and cannot be queried
+ * from the parent. Branches run concurrently with each other and with the original.
+ */
+class SimulationFork {
+public:
+    /**
+     * @brief Work done in the child: change and step the simulation, write the results.
+     */
+    using Branch = std::function<void(Simulation&, std::ostream&)>;
+
+    /**
+     * @brief Takes over a forked child; made by Simulation::fork().
+     * @param pid Process id of the child.
+     * @param output Read end of the pipe the child writes its results to.
+     */
+    SimulationFork(int pid, int output);
+
+    /** @brief Kills and reaps the child if wait() was not called. */
+    ~SimulationFork();
+
+    SimulationFork(const SimulationFork&) = delete;
+    SimulationFork& operator=(const SimulationFork&) = delete;
+
+    /** @brief Returns the process id of the child. */
+    int getPid() const;
+
+    /**
+     * @brief Waits for the branch to finish and returns what it wrote.
+     * @return The output of the branch.
+     * @throws std::runtime_error with the message of the exception if the branch
+     *         threw, or if the child was killed or already waited for.
+     */
+    std::string wait();
+
+private:
+    int pid;
+    int output;
+};
+
+#endif // SIMULATIONFORK_H
@@ -0,0 +1,139 @@
+#include "SimulationStats.h"
+#include "DesignByContract.h"
+#include <atomic>
+
+thread_local SimulationStats* SimulationStats::active = nullptr;
+
+namespace {
+
+std::atomic<std::uint64_t> nextCollectorId{1};
+
+/**
+ * @brief Last block handed out on this thread, keyed by collector id so that a
+ * collector allocated at the address of a destroyed one never reuses a stale block.
+ */
+struct CachedBlock {
+    std::uint64_t collectorId = 0;
+    SimulationStats* block = nullptr;
+};
+
+thread_local CachedBlock cachedBlock;
+
+} // namespace
+
+/**
+ * @brief Adds another counter block to this one.
+ *
+ * @param other Counters to add.
+ */
+void SimulationStats::merge(const SimulationStats& other) {
+    vehiclesSpawned += other.vehiclesSpawned;
+    vehiclesExited += other.vehiclesExited;
+    vehiclesTransferred += other.vehiclesTransferred;
+    leaderLookups += other.leaderLookups;
+    lightSwitches += other.lightSwitches;
+    spawnsBlocked += other.spawnsBlocked;
+    laneChanges += other.laneChanges;
+    busDwellSeconds += other.busDwellSeconds;
+    for (int phase = 0; phase < PHASE_COUNT; phase++)
+        phaseSeconds[phase] += other.phaseSeconds[phase];
+}
+
+/**
+ * @brief Returns the name used for a phase in reports.
+ *
+ * @param phase The phase (must be a valid phase).
+ * @return Phase name.
+ */
+const char* SimulationStats::phaseName(Phase phase) {
+    REQUIRE(phase >= 0 && phase < PHASE_COUNT, "phase must be valid");
+    static const char* const names[PHASE_COUNT] = {"roads", "lights", "generators", "output"};
+    return names[phase];
+}
+
+/**
+ * @brief Returns the counters the calling thread should increment.
+ *
+ * @return The bound collector block, or a thread-local scratch block.
+ */
+SimulationStats& SimulationStats::current() {
+    thread_local SimulationStats scratch;
+    return active != nullptr ? *active : scratch;
+}
+
+/**
+ * @brief Binds this thread's counters to the given collector.
+ *
+ * @param collector Collector that receives the increments.
+ */
+StatsCollector::Scope::Scope(StatsCollector& collector)
+    : previous(SimulationStats::active)
+{
+    SimulationStats::active = &collector.acquire();
+}
+
+/**
+ * @brief Restores the binding that was active before this scope.
+ */
+StatsCollector::Scope::~Scope() {
+    SimulationStats::active = previous;
+}
+
+/**
+ * @brief Creates a collector without any thread blocks.
+ */
+StatsCollector::StatsCollector()
+    : id(nextCollectorId++)
+{
+}
+
+/**
+ * @brief Returns this thread's block, creating it on first use.
+ *
+ * The per-thread cache makes repeated acquisition lock-free.
+ *
+ * @return The calling thread's counter block.
+ */
+SimulationStats& StatsCollector::acquire() {
+    if (cachedBlock.collectorId == id)
+        return *cachedBlock.block;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    std::thread::id self = std::this_thread::get_id();
+    SimulationStats* block = nullptr;
+    for (auto& entry : blocks) {
+        if (entry.first == self) {
+            block = entry.second.get();
+            break;
+        }
+    }
+    if (block == nullptr) {
+        blocks.emplace_back(self, std::make_unique<SimulationStats>());
+        block = blocks.back().second.get();
+    }
+
+    cachedBlock = {id, block};
+    return *block;
+}
+
+/**
+ * @brief Merges the counters of all threads.
+ *
+ * @return Sum of all thread blocks.
+ */
+SimulationStats StatsCollector::merged() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    SimulationStats total;
+    for (const auto& entry : blocks)
+        total.merge(*entry.second);
+    return total;
+}
+
+/**
+ * @brief Clears every thread block.
+ */
+void StatsCollector::reset() {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto& entry : blocks)
+        *entry.second = SimulationStats();
+}
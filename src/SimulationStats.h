@@ -0,0 +1,117 @@
+#ifndef SIMULATIONSTATS_H
+#define SIMULATIONSTATS_H
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/**
+ * @struct SimulationStats
+ * @brief Cumulative counters describing what a simulation has done so far.
+ *
+ * Entities increment the counters of the calling thread through current(), which
+ * never locks; a StatsCollector merges the per-thread blocks when they are read.
+ */
+struct SimulationStats {
+    /**
+     * @brief Parts of a simulation step whose wall time is accumulated.
+     */
+    enum Phase {
+        PHASE_ROADS,       ///< Vehicle updates, including intersection switches.
+        PHASE_LIGHTS,      ///< Traffic light updates.
+        PHASE_GENERATORS,  ///< Vehicle generator updates.
+        PHASE_OUTPUT,      ///< Console output in Simulation::run.
+        PHASE_COUNT
+    };
+
+    std::uint64_t vehiclesSpawned = 0;      ///< Vehicles created by generators.
+    std::uint64_t vehiclesExited = 0;       ///< Vehicles that left the simulation at a dead end.
+    std::uint64_t vehiclesTransferred = 0;  ///< Vehicles moved to another road.
+    std::uint64_t leaderLookups = 0;        ///< Searches for a leading vehicle.
+    std::uint64_t lightSwitches = 0;        ///< Traffic light state changes.
+    std::uint64_t spawnsBlocked = 0;        ///< Generator spawns blocked by an occupied road entry.
+    std::uint64_t laneChanges = 0;          ///< Vehicles that moved to an adjacent lane.
+    double busDwellSeconds = 0;             ///< Time buses spent waiting at bus stops.
+    double phaseSeconds[PHASE_COUNT] = {};  ///< Wall time per step phase.
+
+    /**
+     * @brief Adds the counters of other to this block.
+     * @param other Counters to add.
+     */
+    void merge(const SimulationStats& other);
+
+    /**
+     * @brief Returns the printable name of a phase.
+     * @pre phase < PHASE_COUNT
+     */
+    static const char* phaseName(Phase phase);
+
+    /**
+     * @brief Returns the counter block of the calling thread.
+     *
+     * Inside a StatsCollector::Scope this is the collector's block for this thread;
+     * outside any scope the increments go to a thread-local scratch block.
+     */
+    static SimulationStats& current();
+
+private:
+    friend class StatsCollector;
+    static thread_local SimulationStats* active;
+};
+
+/**
+ * @class StatsCollector
+ * @brief Owns one SimulationStats block per thread and merges them on read.
+ */
+class StatsCollector {
+public:
+    /**
+     * @brief Binds the calling thread's counters to a collector for the lifetime of the scope.
+     * Scopes may be nested; the previous binding is restored on destruction.
+     */
+    class Scope {
+    public:
+        /** @brief Routes SimulationStats::current() on this thread to collector. */
+        explicit Scope(StatsCollector& collector);
+
+        /** @brief Restores the previous binding. */
+        ~Scope();
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        SimulationStats* previous;
+    };
+
+    /** @brief Creates an empty collector. */
+    StatsCollector();
+
+    StatsCollector(const StatsCollector&) = delete;
+    StatsCollector& operator=(const StatsCollector&) = delete;
+
+    /**
+     * @brief Sums the blocks of all threads.
+     * Exact when no thread is updating counters concurrently.
+     * @return The merged counters.
+     */
+    SimulationStats merged() const;
+
+    /**
+     * @brief Resets all counters to zero.
+     * @post merged() returns an all-zero block
+     */
+    void reset();
+
+private:
+    SimulationStats& acquire();
+
+    std::uint64_t id;
+    mutable std::mutex mutex;
+    std::vector<std::pair<std::thread::id, std::unique_ptr<SimulationStats>>> blocks;
+};
+
+#endif // SIMULATIONSTATS_H
@@ -0,0 +1,150 @@
+#ifndef SLOTMAP_H
+#define SLOTMAP_H
+
+#include <cstdint>
+#include <vector>
+#include "DesignByContract.h"
+
+/// 32-bit handle to an entity in a SlotMap; 0 is never a valid handle.
+using Handle = std::uint32_t;
+
+/// Handle value that never refers to an entity.
+constexpr Handle INVALID_HANDLE = 0;
+
+/**
+ * @class SlotMap
+ * @brief Generational slot map that owns heap-allocated entities.
+ *
+ * Entities are stored densely (so iteration visits only live entities) and are
+ * addressed through 32-bit handles made of a slot index and a generation. When an
+ * entity is erased its slot's generation is bumped, so stale handles are detected
+ * instead of aliasing a newer entity. Insertion, lookup and erasure are O(1);
+ * erasure moves the last dense entry into the hole, so dense order is not stable.
+ *
+ * @tparam T Entity type; the map deletes entities on erase() and destruction.
+ */
+template <typename T>
+class SlotMap {
+public:
+    static constexpr unsigned INDEX_BITS = 22;
+    static constexpr std::uint32_t INDEX_MASK = (1u << INDEX_BITS) - 1;
+    static constexpr std::uint32_t GENERATION_MASK = (1u << (32 - INDEX_BITS)) - 1;
+
+    SlotMap() = default;
+    SlotMap(const SlotMap&) = delete;
+    SlotMap& operator=(const SlotMap&) = delete;
+
+    /** @brief Deletes all owned entities. */
+    ~SlotMap() {
+        for (T* value : dense)
+            delete value;
+    }
+
+    /**
+     * @brief Takes ownership of an entity.
+     * @param value Entity to store.
+     * @return Handle of the stored entity.
+     * @pre value != nullptr
+     * @post get(returned handle) == value
+     */
+    Handle insert(T* value) {
+        REQUIRE(value != nullptr, "SlotMap cannot store null");
+
+        std::uint32_t index;
+        if (!freeSlots.empty()) {
+            index = freeSlots.back();
+            freeSlots.pop_back();
+        } else {
+            REQUIRE(slots.size() <= INDEX_MASK, "SlotMap is full");
+            index = static_cast<std::uint32_t>(slots.size());
+            slots.push_back({0, 1});
+        }
+
+        slots[index].denseIndex = static_cast<std::uint32_t>(dense.size());
+        dense.push_back(value);
+        denseToSlot.push_back(index);
+
+        Handle handle = (slots[index].generation << INDEX_BITS) | index;
+        ENSURE(get(handle) == value, "stored entity must be reachable through its handle");
+        return handle;
+    }
+
+    /**
+     * @brief Looks up an entity.
+     * @param handle Handle returned by insert().
+     * @return The entity, or nullptr if the handle is invalid or stale.
+     */
+    T* get(Handle handle) const {
+        std::uint32_t index = handle & INDEX_MASK;
+        if (handle == INVALID_HANDLE || index >= slots.size()
+            || slots[index].generation != (handle >> INDEX_BITS))
+            return nullptr;
+        return dense[slots[index].denseIndex];
+    }
+
+    /** @return true if handle refers to a live entity. */
+    bool contains(Handle handle) const {
+        return get(handle) != nullptr;
+    }
+
+    /**
+     * @brief Deletes an entity and invalidates its handle.
+     * @param handle Handle of the entity to remove.
+     * @pre contains(handle)
+     * @post !contains(handle)
+     */
+    void erase(Handle handle) {
+        REQUIRE(contains(handle), "handle must refer to a live entity");
+
+        std::uint32_t index = handle & INDEX_MASK;
+        std::uint32_t hole = slots[index].denseIndex;
+        delete dense[hole];
+
+        // Move the last dense entry into the hole
+        dense[hole] = dense.back();
+        denseToSlot[hole] = denseToSlot.back();
+        slots[denseToSlot[hole]].denseIndex = hole;
+        dense.pop_back();
+        denseToSlot.pop_back();
+
+        std::uint32_t generation = (slots[index].generation + 1) & GENERATION_MASK;
+        slots[index].generation = generation == 0 ? 1 : generation;
+        freeSlots.push_back(index);
+
+        ENSURE(!contains(handle), "erased handle must be invalid");
+    }
+
+    /** @return Dense array of all live entities. */
+    const std::vector<T*>& values() const {
+        return dense;
+    }
+
+    /** @return Number of live entities. */
+    std::size_t size() const {
+        return dense.size();
+    }
+
+    /**
+     * @brief Exchanges the entities and handles of two maps.
+     * @param other The other map.
+     */
+    void swap(SlotMap& other) {
+        slots.swap(other.slots);
+        freeSlots.swap(other.freeSlots);
+        dense.swap(other.dense);
+        denseToSlot.swap(other.denseToSlot);
+    }
+
+private:
+    struct Slot {
+        std::uint32_t denseIndex;
+        std::uint32_t generation;
+    };
+
+    std::vector<Slot> slots;
+    std::vector<std::uint32_t> freeSlots;
+    std::vector<T*> dense;
+    std::vector<std::uint32_t> denseToSlot;
+};
+
+#endif // SLOTMAP_H
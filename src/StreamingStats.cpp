@@ -0,0 +1,190 @@
+#include "StreamingStats.h"
+#include "DesignByContract.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+/**
+ * @brief Creates statistics without samples.
+ */
+RunningStats::RunningStats()
+    : count(0), mean(0), squares(0), min(0), max(0)
+{
+}
+
+/**
+ * @brief Adds a sample with Welford's update.
+ * @param x The sample.
+ */
+void RunningStats::add(double x) {
+    count++;
+    double delta = x - mean;
+    mean += delta / count;
+    squares += delta * (x - mean);
+    min = count == 1 ? x : std::min(min, x);
+    max = count == 1 ? x : std::max(max, x);
+}
+
+/**
+ * @brief Returns the number of samples.
+ * @return Sample count.
+ */
+long RunningStats::getCount() const {
+    return count;
+}
+
+/**
+ * @brief Returns the mean.
+ * @return Mean of the samples.
+ */
+double RunningStats::getMean() const {
+    return mean;
+}
+
+/**
+ * @brief Returns the sample variance.
+ * @return Variance with Bessel's correction.
+ */
+double RunningStats::getVariance() const {
+    return count < 2 ? 0 : squares / (count - 1);
+}
+
+/**
+ * @brief Returns the sample standard deviation.
+ * @return Square root of the variance.
+ */
+double RunningStats::getStandardDeviation() const {
+    return std::sqrt(getVariance());
+}
+
+/**
+ * @brief Returns the smallest sample.
+ * @return Minimum.
+ */
+double RunningStats::getMin() const {
+    return min;
+}
+
+/**
+ * @brief Returns the largest sample.
+ * @return Maximum.
+ */
+double RunningStats::getMax() const {
+    return max;
+}
+
+/**
+ * @brief Returns the half-width of the confidence interval of the mean.
+ * @param z Standard normal quantile of the confidence level.
+ * @return Half-width.
+ */
+double RunningStats::getHalfWidth(double z) const {
+    if (count < 2)
+        return std::numeric_limits<double>::infinity();
+    return z * getStandardDeviation() / std::sqrt(static_cast<double>(count));
+}
+
+/**
+ * @brief Creates an estimator and the desired marker positions for quantile p.
+ * @param p The quantile.
+ */
+QuantileEstimator::QuantileEstimator(double p)
+    : p(p), count(0), heights{}, positions{1, 2, 3, 4, 5},
+      desired{1, 1 + 2 * p, 1 + 4 * p, 3 + 2 * p, 5},
+      increments{0, p / 2, p, (1 + p) / 2, 1}
+{
+    REQUIRE(p > 0 && p < 1, "The quantile must lie strictly between 0 and 1");
+}
+
+/**
+ * @brief Adds a sample and moves the markers towards their desired positions.
+ * @param x The sample.
+ */
+void QuantileEstimator::add(double x) {
+    if (count < 5) {
+        heights[count++] = x;
+        if (count == 5)
+            std::sort(heights.begin(), heights.end());
+        return;
+    }
+    count++;
+
+    // Find the cell of the sample, extending the extremes if needed
+    int cell;
+    if (x < heights[0]) {
+        heights[0] = x;
+        cell = 0;
+    } else if (x >= heights[4]) {
+        heights[4] = x;
+        cell = 3;
+    } else {
+        cell = 0;
+        while (x >= heights[cell + 1])
+            cell++;
+    }
+    for (int i = cell + 1; i < 5; i++)
+        positions[i]++;
+    for (int i = 0; i < 5; i++)
+        desired[i] += increments[i];
+
+    for (int i = 1; i < 4; i++) {
+        double offset = desired[i] - positions[i];
+        if ((offset >= 1 && positions[i + 1] - positions[i] > 1) ||
+            (offset <= -1 && positions[i - 1] - positions[i] < -1)) {
+            int d = offset > 0 ? 1 : -1;
+            double height = parabolic(i, d);
+            if (heights[i - 1] < height && height < heights[i + 1])
+                heights[i] = height;
+            else
+                heights[i] = linear(i, d);
+            positions[i] += d;
+        }
+    }
+}
+
+/**
+ * @brief Returns the number of samples.
+ * @return Sample count.
+ */
+long QuantileEstimator::getCount() const {
+    return count;
+}
+
+/**
+ * @brief Returns the estimated quantile.
+ * With fewer than five samples the nearest-rank quantile of the samples is returned.
+ * @return Estimate.
+ */
+double QuantileEstimator::getValue() const {
+    if (count == 0)
+        return 0;
+    if (count < 5) {
+        std::vector<double> sorted(heights.begin(), heights.begin() + count);
+        std::sort(sorted.begin(), sorted.end());
+        return sorted[static_cast<std::size_t>(std::lround(p * (count - 1)))];
+    }
+    return heights[2];
+}
+
+/**
+ * @brief Piecewise-parabolic prediction of a marker height.
+ * @param i Marker index.
+ * @param d Direction of the move, -1 or 1.
+ * @return Predicted height.
+ */
+double QuantileEstimator::parabolic(int i, int d) const {
+    return heights[i] + d / (positions[i + 1] - positions[i - 1]) *
+        ((positions[i] - positions[i - 1] + d) * (heights[i + 1] - heights[i]) / (positions[i + 1] - positions[i]) +
+         (positions[i + 1] - positions[i] - d) * (heights[i] - heights[i - 1]) / (positions[i] - positions[i - 1]));
+}
+
+/**
+ * @brief Linear prediction of a marker height, used when the parabola leaves its neighbours.
+ * @param i Marker index.
+ * @param d Direction of the move, -1 or 1.
+ * @return Predicted height.
+ */
+double QuantileEstimator::linear(int i, int d) const {
+    return heights[i] + d * (heights[i + d] - heights[i]) / (positions[i + d] - positions[i]);
+}
@@ -0,0 +1,104 @@
+#ifndef STREAMINGSTATS_H
+#define STREAMINGSTATS_H
+
+#include <array>
+
+/**
+ * @class RunningStats
+ * @brief Mean and variance of a stream of samples in constant memory.
+ *
+ * Uses Welford's update, which stays accurate when the samples are large
+ * compared to their spread.
+ */
+class RunningStats {
+public:
+    /** @brief Creates empty statistics. */
+    RunningStats();
+
+    /**
+     * @brief Adds a sample.
+     * @param x The sample.
+     * @post getCount() increased by 1
+     */
+    void add(double x);
+
+    /** @brief Returns the number of samples. */
+    long getCount() const;
+
+    /** @brief Returns the mean, or 0 without samples. */
+    double getMean() const;
+
+    /** @brief Returns the sample variance, or 0 with fewer than two samples. */
+    double getVariance() const;
+
+    /** @brief Returns the sample standard deviation. */
+    double getStandardDeviation() const;
+
+    /** @brief Returns the smallest sample, or 0 without samples. */
+    double getMin() const;
+
+    /** @brief Returns the largest sample, or 0 without samples. */
+    double getMax() const;
+
+    /**
+     * @brief Returns the half-width of the normal confidence interval of the mean.
+     * @param z Standard normal quantile of the confidence level, e.g. 1.96 for 95%.
+     * @return z * s / sqrt(n), or infinity with fewer than two samples.
+     */
+    double getHalfWidth(double z) const;
+
+private:
+    long count;
+    double mean;
+    double squares;   ///< Sum of squared deviations from the mean.
+    double min;
+    double max;
+};
+
+/**
+ * @class QuantileEstimator
+ * @brief Estimates one quantile of a stream of samples with the P-square algorithm.
+ *
+ * Five markers track the minimum, the quantile, the maximum and two points in
+ * between; their heights are adjusted with piecewise-parabolic interpolation as
+ * samples arrive, so no sample is stored. The first five samples are kept and
+ * the quantile is exact until then.
+ */
+class QuantileEstimator {
+public:
+    /**
+     * @brief Creates an estimator for one quantile.
+     * @param p The quantile, e.g. 0.5 for the median.
+     * @pre 0 < p < 1
+     */
+    explicit QuantileEstimator(double p);
+
+    /**
+     * @brief Adds a sample.
+     * @param x The sample.
+     * @post getCount() increased by 1
+     */
+    void add(double x);
+
+    /** @brief Returns the number of samples. */
+    long getCount() const;
+
+    /** @brief Returns the estimated quantile, or 0 without samples. */
+    double getValue() const;
+
+private:
+    /** @brief Parabolic prediction of marker i moved by d positions. */
+    double parabolic(int i, int d) const;
+
+    /** @brief Linear prediction of marker i moved by d positions. */
+    double linear(int i, int d) const;
+
+    double p;
+    long count;
+    std::array<double, 5> heights;     ///< Marker heights; the first samples until there are five.
+    std::array<double, 5> positions;   ///< Actual marker positions.
+    std::array<double, 5> desired;     ///< Desired marker positions.
+    std::array<double, 5> increments;  ///< Growth of the desired positions per sample.
+};
+
+#endif // STREAMINGSTATS_H
@@ -0,0 +1,515 @@
+#include "TelemetryServer.h"
+#include "DeltaEncoder.h"
+#include "Road.h"
+#include "DesignByContract.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+const char* WEBSOCKET_GUID = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+
+std::uint32_t rotate(std::uint32_t value, int bits) {
+    return (value << bits) | (value >> (32 - bits));
+}
+
+/**
+ * @brief Escapes quotes and backslashes for a JSON string.
+ */
+std::string jsonEscape(const std::string& text) {
+    std::string escaped;
+    for (char c : text) {
+        if (c == '"' || c == '\\')
+            escaped += '\\';
+        escaped += c;
+    }
+    return escaped;
+}
+
+/**
+ * @brief Returns the SHA-1 digest of a message (FIPS 180-4).
+ */
+std::string sha1(const std::string& message) {
+    std::uint32_t h[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+    std::string data = message;
+    std::uint64_t bits = static_cast<std::uint64_t>(message.size()) * 8;
+    data.push_back(static_cast<char>(0x80));
+    while (data.size() % 64 != 56)
+        data.push_back(0);
+    for (int shift = 56; shift >= 0; shift -= 8)
+        data.push_back(static_cast<char>(bits >> shift));
+
+    for (std::size_t chunk = 0; chunk < data.size(); chunk += 64) {
+        std::uint32_t w[80];
+        for (int i = 0; i < 16; i++) {
+            w[i] = 0;
+            for (int j = 0; j < 4; j++)
+                w[i] = (w[i] << 8) | static_cast<std::uint8_t>(data[chunk + i * 4 + j]);
+        }
+        for (int i = 16; i < 80; i++)
+            w[i] = rotate(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+
+        std::uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+        for (int i = 0; i < 80; i++) {
+            std::uint32_t f, k;
+            if (i < 20) {
+                f = (b & c) | (~b & d);
+                k = 0x5A827999;
+            } else if (i < 40) {
+                f = b ^ c ^ d;
+                k = 0x6ED9EBA1;
+            } else if (i < 60) {
+                f = (b & c) | (b & d) | (c & d);
+                k = 0x8F1BBCDC;
+            } else {
+                f = b ^ c ^ d;
+                k = 0xCA62C1D6;
+            }
+            std::uint32_t temp = rotate(a, 5) + f + e + k + w[i];
+            e = d;
+            d = c;
+            c = rotate(b, 30);
+            b = a;
+            a = temp;
+        }
+        h[0] += a;
+        h[1] += b;
+        h[2] += c;
+        h[3] += d;
+        h[4] += e;
+    }
+
+    std::string digest;
+    for (std::uint32_t word : h) {
+        for (int shift = 24; shift >= 0; shift -= 8)
+            digest.push_back(static_cast<char>(word >> shift));
+    }
+    return digest;
+}
+
+std::string base64(const std::string& bytes) {
+    static const char* alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string out;
+    for (std::size_t i = 0; i < bytes.size(); i += 3) {
+        std::uint32_t group = static_cast<std::uint8_t>(bytes[i]) << 16;
+        if (i + 1 < bytes.size())
+            group |= static_cast<std::uint8_t>(bytes[i + 1]) << 8;
+        if (i + 2 < bytes.size())
+            group |= static_cast<std::uint8_t>(bytes[i + 2]);
+        out.push_back(alphabet[(group >> 18) & 63]);
+        out.push_back(alphabet[(group >> 12) & 63]);
+        out.push_back(i + 1 < bytes.size() ? alphabet[(group >> 6) & 63] : '=');
+        out.push_back(i + 2 < bytes.size() ? alphabet[group & 63] : '=');
+    }
+    return out;
+}
+
+/**
+ * @brief Appends an unmasked server frame with the given opcode.
+ */
+void appendFrame(std::string& out, std::uint8_t opcode, const std::uint8_t* payload, std::size_t size) {
+    out.push_back(static_cast<char>(0x80 | opcode));
+    if (size < 126) {
+        out.push_back(static_cast<char>(size));
+    } else if (size <= 0xFFFF) {
+        out.push_back(126);
+        out.push_back(static_cast<char>(size >> 8));
+        out.push_back(static_cast<char>(size));
+    } else {
+        out.push_back(127);
+        for (int shift = 56; shift >= 0; shift -= 8)
+            out.push_back(static_cast<char>(static_cast<std::uint64_t>(size) >> shift));
+    }
+    out.append(reinterpret_cast<const char*>(payload), size);
+}
+
+/**
+ * @brief Returns the value of an HTTP header, or an empty string.
+ */
+std::string header(const std::string& request, const std::string& name) {
+    std::istringstream lines(request);
+    std::string line;
+    while (std::getline(lines, line)) {
+        std::size_t colon = line.find(':');
+        if (colon == std::string::npos)
+            continue;
+        std::string key = line.substr(0, colon);
+        std::transform(key.begin(), key.end(), key.begin(), ::tolower);
+        if (key != name)
+            continue;
+        std::size_t start = line.find_first_not_of(' ', colon + 1);
+        std::size_t end = line.find_last_not_of("\r ");
+        return start == std::string::npos ? "" : line.substr(start, end - start + 1);
+    }
+    return "";
+}
+
+} // namespace
+
+/**
+ * @brief Connection state of one client.
+ */
+struct TelemetryServer::Client {
+    int fd = -1;
+    bool upgraded = false;     ///< Whether the WebSocket handshake is done.
+    bool closing = false;      ///< Close once the output is sent.
+    std::string input;
+    std::string output;
+    std::unique_ptr<DeltaEncoder> encoder;
+    std::uint32_t frame = 0;
+};
+
+/**
+ * @brief Opens the listening socket and starts the server thread.
+ *
+ * @param address Port number or "unix:" path.
+ * @param positionStep Position quantization of the clients' encoders.
+ * @param speedStep Speed quantization of the clients' encoders.
+ */
+TelemetryServer::TelemetryServer(const std::string& address, double positionStep, double speedStep)
+    : listener(-1), port(0), positionStep(positionStep), speedStep(speedStep),
+      allWatchers(0), watchVersion(0), capturedVersion(0), running(true), clientCount(0), messagesSent(0)
+{
+    if (address.compare(0, 5, "unix:") == 0) {
+        socketPath = address.substr(5);
+        sockaddr_un local{};
+        if (socketPath.empty() || socketPath.size() >= sizeof(local.sun_path))
+            throw std::runtime_error("Invalid telemetry socket path: " + socketPath);
+        local.sun_family = AF_UNIX;
+        std::strcpy(local.sun_path, socketPath.c_str());
+        listener = socket(AF_UNIX, SOCK_STREAM, 0);
+        ::unlink(socketPath.c_str());
+        if (listener < 0 || bind(listener, reinterpret_cast<sockaddr*>(&local), sizeof(local)) != 0) {
+            if (listener >= 0)
+                ::close(listener);
+            throw std::runtime_error("Failed to bind telemetry socket: " + socketPath);
+        }
+    } else {
+        char* end = nullptr;
+        long number = std::strtol(address.c_str(), &end, 10);
+        if (address.empty() || *end != '\0' || number < 0 || number > 65535)
+            throw std::runtime_error("Invalid telemetry port: " + address);
+        sockaddr_in local{};
+        local.sin_family = AF_INET;
+        local.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        local.sin_port = htons(static_cast<std::uint16_t>(number));
+        listener = socket(AF_INET, SOCK_STREAM, 0);
+        int reuse = 1;
+        if (listener >= 0)
+            setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+        if (listener < 0 || bind(listener, reinterpret_cast<sockaddr*>(&local), sizeof(local)) != 0) {
+            if (listener >= 0)
+                ::close(listener);
+            throw std::runtime_error("Failed to bind telemetry port: " + address);
+        }
+        socklen_t length = sizeof(local);
+        getsockname(listener, reinterpret_cast<sockaddr*>(&local), &length);
+        port = ntohs(local.sin_port);
+    }
+    if (listen(listener, 16) != 0) {
+        ::close(listener);
+        throw std::runtime_error("Failed to listen for telemetry clients on " + address);
+    }
+    thread = std::thread(&TelemetryServer::loop, this);
+}
+
+/**
+ * @brief Stops the server.
+ */
+TelemetryServer::~TelemetryServer() {
+    stop();
+}
+
+/**
+ * @brief Returns the TCP port.
+ * @return Port number, or 0 for a Unix socket.
+ */
+int TelemetryServer::getPort() const {
+    return port;
+}
+
+/**
+ * @brief Captures the watched roads into the back slot and publishes it.
+ *
+ * The watched roads are only rebuilt when a client connected, left or
+ * subscribed. A road a client just subscribed to fills in from the next
+ * snapshot on.
+ * @param roads Roads in numbering order.
+ * @param time Simulation time.
+ */
+void TelemetryServer::publish(const std::vector<Road*>& roads, double time) {
+    // Only this thread changes roadNames, so reading its size needs no lock
+    if (roadNames.size() != roads.size()) {
+        std::lock_guard<std::mutex> lock(namesMutex);
+        roadNames.clear();
+        for (const Road* road : roads)
+            roadNames.push_back(road->getName());
+    }
+    if (clientCount == 0)
+        return;
+
+    unsigned version = watchVersion.load();
+    if (version != capturedVersion || captured.size() != roads.size()) {
+        std::lock_guard<std::mutex> lock(watchMutex);
+        captured.assign(roads.size(), allWatchers > 0);
+        for (std::size_t i = 0; i < roads.size() && i < roadWatchers.size(); i++) {
+            if (roadWatchers[i] > 0)
+                captured[i] = true;
+        }
+        capturedVersion = version;
+    }
+    snapshots.back().capture(roads, time, captured);
+    snapshots.publish();
+}
+
+/**
+ * @brief Returns the number of WebSocket clients.
+ * @return Clients that completed the handshake.
+ */
+int TelemetryServer::getClientCount() const {
+    return clientCount;
+}
+
+/**
+ * @brief Returns the number of sent messages.
+ * @return Messages since construction.
+ */
+long long TelemetryServer::getMessagesSent() const {
+    return messagesSent;
+}
+
+/**
+ * @brief Ends the server thread, which closes every socket.
+ */
+void TelemetryServer::stop() {
+    if (!thread.joinable())
+        return;
+    running = false;
+    thread.join();
+    ::close(listener);
+    if (!socketPath.empty())
+        ::unlink(socketPath.c_str());
+}
+
+/**
+ * @brief Computes the handshake answer.
+ * @param key The client's key.
+ * @return The accept value.
+ */
+std::string TelemetryServer::acceptKey(const std::string& key) {
+    return base64(sha1(key + WEBSOCKET_GUID));
+}
+
+/**
+ * @brief Polls the sockets, serves requests and sends each new snapshot to every idle client.
+ *
+ * A client is idle when its previous message was written completely, so the
+ * encoder's idea of what the client has matches what was actually queued.
+ */
+void TelemetryServer::loop() {
+    std::vector<std::unique_ptr<Client>> clients;
+    std::vector<pollfd> fds;
+    while (running) {
+        fds.assign(1, pollfd{listener, POLLIN, 0});
+        for (const auto& client : clients)
+            fds.push_back(pollfd{client->fd, static_cast<short>(POLLIN | (client->output.empty() ? 0 : POLLOUT)), 0});
+        poll(fds.data(), fds.size(), 10);
+
+        if (fds[0].revents & POLLIN) {
+            int fd = accept(listener, nullptr, nullptr);
+            if (fd >= 0) {
+                clients.push_back(std::make_unique<Client>());
+                clients.back()->fd = fd;
+            }
+        }
+
+        bool fresh = snapshots.acquire();
+        for (std::size_t i = 0; i < clients.size(); i++) {
+            Client& client = *clients[i];
+            bool open = true;
+            short events = i + 1 < fds.size() ? fds[i + 1].revents : 0;
+            if (events & (POLLERR | POLLHUP))
+                open = false;
+            if (open && (events & POLLIN))
+                open = receive(client);
+
+            if (open && fresh && client.upgraded && client.output.empty() && !client.closing) {
+                std::vector<std::uint8_t> message = client.encoder->encode(snapshots.front(), client.frame++);
+                appendFrame(client.output, 0x2, message.data(), message.size());
+                messagesSent++;
+            }
+            if (open && !client.output.empty()) {
+                ssize_t sent = send(client.fd, client.output.data(), client.output.size(), MSG_DONTWAIT | MSG_NOSIGNAL);
+                if (sent > 0)
+                    client.output.erase(0, static_cast<std::size_t>(sent));
+                else if (sent < 0 && errno != EAGAIN && errno != EWOULDBLOCK)
+                    open = false;
+            }
+            if (!open || (client.closing && client.output.empty())) {
+                ::close(client.fd);
+                if (client.upgraded) {
+                    watch(client.encoder->getSubscription(), -1);
+                    clientCount--;
+                }
+                clients.erase(clients.begin() + i);
+                fds.erase(fds.begin() + i + 1);
+                i--;
+            }
+        }
+    }
+    for (const auto& client : clients)
+        ::close(client->fd);
+    clientCount = 0;
+}
+
+/**
+ * @brief Reads from a client and handles its request or WebSocket frames.
+ * @param client The client.
+ * @return false if the connection is closed or broken.
+ */
+bool TelemetryServer::receive(Client& client) {
+    char buffer[4096];
+    ssize_t received = recv(client.fd, buffer, sizeof(buffer), MSG_DONTWAIT);
+    if (received <= 0)
+        return received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+    client.input.append(buffer, static_cast<std::size_t>(received));
+
+    if (!client.upgraded)
+        return handshake(client);
+
+    // Client frames are always masked
+    while (client.input.size() >= 2) {
+        const std::uint8_t* bytes = reinterpret_cast<const std::uint8_t*>(client.input.data());
+        std::uint8_t opcode = bytes[0] & 0x0F;
+        std::uint64_t length = bytes[1] & 0x7F;
+        std::size_t offset = 2;
+        if (length == 126) {
+            if (client.input.size() < 4)
+                return true;
+            length = (bytes[2] << 8) | bytes[3];
+            offset = 4;
+        } else if (length == 127) {
+            if (client.input.size() < 10)
+                return true;
+            length = 0;
+            for (int i = 0; i < 8; i++)
+                length = (length << 8) | bytes[2 + i];
+            offset = 10;
+        }
+        if (length > MAX_FRAME_SIZE)
+            return false;
+        if (client.input.size() < offset + 4 + length)
+            return true;
+        std::string payload = client.input.substr(offset + 4, length);
+        for (std::size_t i = 0; i < payload.size(); i++)
+            payload[i] = static_cast<char>(payload[i] ^ bytes[offset + i % 4]);
+        client.input.erase(0, offset + 4 + length);
+
+        if (opcode == 0x1) {
+            watch(client.encoder->getSubscription(), -1);
+            client.encoder->subscribe(roadNumbers(payload));
+            watch(client.encoder->getSubscription(), 1);
+        } else if (opcode == 0x8) {
+            appendFrame(client.output, 0x8, nullptr, 0);
+            client.closing = true;
+        } else if (opcode == 0x9) {
+            appendFrame(client.output, 0xA, reinterpret_cast<const std::uint8_t*>(payload.data()), payload.size());
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Upgrades a WebSocket request, or answers /banen and closes.
+ * @param client The client.
+ * @return false if the request headers grew too large without ending.
+ */
+bool TelemetryServer::handshake(Client& client) {
+    std::size_t end = client.input.find("\r\n\r\n");
+    if (end == std::string::npos)
+        return client.input.size() < 8192;
+    std::string request = client.input.substr(0, end + 4);
+    client.input.erase(0, end + 4);
+
+    std::string key = header(request, "sec-websocket-key");
+    if (request.compare(0, 4, "GET ") == 0 && !key.empty()) {
+        client.output += "HTTP/1.1 101 Switching Protocols\r\n"
+                         "Upgrade: websocket\r\n"
+                         "Connection: Upgrade\r\n"
+                         "Sec-WebSocket-Accept: " + acceptKey(key) + "\r\n\r\n";
+        client.upgraded = true;
+        client.encoder = std::make_unique<DeltaEncoder>(positionStep, speedStep);
+        watch(client.encoder->getSubscription(), 1);
+        clientCount++;
+        return true;
+    }
+
+    if (request.compare(0, 11, "GET /banen ") == 0) {
+        std::string body = "[";
+        {
+            std::lock_guard<std::mutex> lock(namesMutex);
+            for (std::size_t i = 0; i < roadNames.size(); i++)
+                body += (i > 0 ? ",\"" : "\"") + jsonEscape(roadNames[i]) + "\"";
+        }
+        body += "]";
+        client.output += "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nContent-Length: "
+                         + std::to_string(body.size()) + "\r\nConnection: close\r\n\r\n" + body;
+    } else {
+        client.output += "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+    }
+    client.closing = true;
+    return true;
+}
+
+/**
+ * @brief Looks up road names; unknown names are ignored.
+ * @param names Comma-separated names, or "*" for every road.
+ * @return Road numbers; empty for every road.
+ */
+std::vector<int> TelemetryServer::roadNumbers(const std::string& names) {
+    std::vector<int> numbers;
+    if (names == "*" || names.empty())
+        return numbers;
+    std::lock_guard<std::mutex> lock(namesMutex);
+    std::istringstream list(names);
+    std::string name;
+    while (std::getline(list, name, ',')) {
+        auto it = std::find(roadNames.begin(), roadNames.end(), name);
+        if (it != roadNames.end())
+            numbers.push_back(static_cast<int>(it - roadNames.begin()));
+    }
+    // A list without known roads subscribes to none rather than to all
+    if (numbers.empty())
+        numbers.push_back(-1);
+    return numbers;
+}
+
+/**
+ * @brief Counts how many clients watch each road.
+ * @param roads A subscription as kept by DeltaEncoder; empty for every road.
+ * @param delta 1 when the subscription starts, -1 when it ends.
+ */
+void TelemetryServer::watch(const std::vector<int>& roads, int delta) {
+    std::lock_guard<std::mutex> lock(watchMutex);
+    if (roads.empty())
+        allWatchers += delta;
+    for (int road : roads) {
+        if (road < 0)
+            continue;
+        if (roadWatchers.size() <= static_cast<std::size_t>(road))
+            roadWatchers.resize(road + 1, 0);
+        roadWatchers[road] += delta;
+    }
+    watchVersion++;
+}
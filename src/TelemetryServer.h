@@ -0,0 +1,125 @@
+#ifndef TELEMETRYSERVER_H
+#define TELEMETRYSERVER_H
+
+#include "FrameSnapshot.h"
+#include "TripleBuffer.h"
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class Road;
+
+/**
+ * @class TelemetryServer
+ * @brief Streams the simulation to WebSocket clients on the local machine.
+ *
+ * The server listens on 127.0.0.1 or on a Unix socket and runs on its own
+ * thread. The simulation publishes a FrameSnapshot after every step through a
+ * TripleBuffer, so it never waits for the network; the server encodes the
+ * newest snapshot per client with a DeltaEncoder and sends it as a binary
+ * WebSocket message (see DeltaEncoder for the layout). A client that has not
+ * received its previous message yet skips snapshots, so a slow client only
+ * lowers its own update rate. Without clients nothing is captured, and only the
+ * vehicles of roads some client subscribed to are copied into a snapshot.
+ *
+ * Clients send a text message with comma-separated road names to subscribe to
+ * those roads, or "*" for every road; they start subscribed to every road. A
+ * plain HTTP request for /banen returns the road names as a JSON array, in the
+ * order of the road numbers in the messages. A client frame larger than
+ * MAX_FRAME_SIZE closes the connection.
+ */
+class TelemetryServer {
+public:
+    /** @brief Largest payload of a client frame, in bytes. */
+    static constexpr std::size_t MAX_FRAME_SIZE = 64 * 1024;
+
+    /**
+     * @brief Starts listening and starts the server thread.
+     * @param address A TCP port on 127.0.0.1 (0 picks a free one) or "unix:" followed by a socket path.
+     * @param positionStep Change in position, in metres, that is sent to clients.
+     * @param speedStep Change in speed, in m/s, that is sent to clients.
+     * @throws std::runtime_error if the socket cannot be created, bound or listened on.
+     */
+    explicit TelemetryServer(const std::string& address, double positionStep = 0.5, double speedStep = 0.5);
+
+    /** @brief Stops the server; see stop(). */
+    ~TelemetryServer();
+
+    TelemetryServer(const TelemetryServer&) = delete;
+    TelemetryServer& operator=(const TelemetryServer&) = delete;
+
+    /**
+     * @brief Returns the TCP port the server listens on.
+     * @return The port, or 0 for a Unix socket.
+     */
+    int getPort() const;
+
+    /**
+     * @brief Captures the subscribed roads and makes them the newest snapshot.
+     * Does nothing while no client is connected. Only one thread, the one that
+     * steps the simulation, may publish.
+     * @param roads Roads; their order numbers the roads in the messages.
+     * @param time Simulation time.
+     */
+    void publish(const std::vector<Road*>& roads, double time);
+
+    /** @brief Returns the number of connected WebSocket clients. */
+    int getClientCount() const;
+
+    /** @brief Returns the number of messages sent to clients. */
+    long long getMessagesSent() const;
+
+    /**
+     * @brief Closes every connection and the listening socket, and joins the thread.
+     */
+    void stop();
+
+    /**
+     * @brief Computes the Sec-WebSocket-Accept value of a handshake key (RFC 6455).
+     * @param key The client's Sec-WebSocket-Key.
+     * @return Base64 of the SHA-1 of the key and the WebSocket GUID.
+     */
+    static std::string acceptKey(const std::string& key);
+
+private:
+    struct Client;
+
+    /** @brief Accepts, reads, writes and sends snapshots until stop() is called. */
+    void loop();
+
+    /** @brief Handles the bytes a client sent; returns false if it must be closed. */
+    bool receive(Client& client);
+
+    /** @brief Answers the HTTP request of a client that did not upgrade yet. */
+    bool handshake(Client& client);
+
+    /** @brief Maps a comma-separated list of road names to road numbers. */
+    std::vector<int> roadNumbers(const std::string& names);
+
+    /** @brief Adds (delta 1) or removes (delta -1) a client's subscription from the watched roads. */
+    void watch(const std::vector<int>& roads, int delta);
+
+    int listener;
+    int port;
+    std::string socketPath;
+    double positionStep;
+    double speedStep;
+    TripleBuffer<FrameSnapshot> snapshots;
+    std::mutex namesMutex;                 ///< Guards roadNames; publish() only locks it when the roads change.
+    std::vector<std::string> roadNames;
+    std::mutex watchMutex;                 ///< Guards the watcher counts.
+    int allWatchers;                       ///< Clients subscribed to every road.
+    std::vector<int> roadWatchers;         ///< Clients subscribed to each road.
+    std::atomic<unsigned> watchVersion;    ///< Changes whenever the watcher counts do.
+    unsigned capturedVersion;              ///< watchVersion that captured was built for; publisher only.
+    std::vector<bool> captured;            ///< Roads whose vehicles are captured; publisher only.
+    std::atomic<bool> running;
+    std::atomic<int> clientCount;
+    std::atomic<long long> messagesSent;
+    std::thread thread;
+};
+
+#endif // TELEMETRYSERVER_H
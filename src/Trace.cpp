@@ -0,0 +1,191 @@
+#include "Trace.h"
+#include "DesignByContract.h"
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace {
+
+/**
+ * @brief One completed span.
+ */
+struct Event {
+    const char* name;
+    std::uint64_t start;  ///< Nanoseconds since the trace epoch.
+    std::uint64_t duration;
+};
+
+/**
+ * @brief Ring buffer owned by one recording thread.
+ */
+struct ThreadBuffer {
+    std::vector<Event> events;
+    std::size_t next = 0;
+    bool wrapped = false;
+    int threadId = 0;
+};
+
+std::atomic<bool> enabled{false};
+std::atomic<std::size_t> bufferCapacity{1 << 16};
+
+// Buffers are kept here (not in thread_local storage) so that spans recorded by
+// worker threads survive the threads themselves.
+std::mutex registryMutex;
+std::vector<std::unique_ptr<ThreadBuffer>> registry;
+
+std::mutex internMutex;
+std::unordered_set<std::string> internedNames;
+
+const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+
+std::uint64_t nowNs() {
+    return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - epoch).count());
+}
+
+ThreadBuffer& localBuffer() {
+    thread_local ThreadBuffer* buffer = nullptr;
+    if (buffer == nullptr) {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        registry.push_back(std::make_unique<ThreadBuffer>());
+        buffer = registry.back().get();
+        buffer->events.resize(bufferCapacity.load());
+        buffer->threadId = static_cast<int>(registry.size());
+    }
+    return *buffer;
+}
+
+void writeJsonString(std::ostream& out, const char* text) {
+    out << '"';
+    for (const char* c = text; *c != '\0'; c++) {
+        if (*c == '"' || *c == '\\')
+            out << '\\';
+        out << *c;
+    }
+    out << '"';
+}
+
+} // namespace
+
+/**
+ * @brief Opens a span and remembers its start time.
+ *
+ * @param name Span name; must outlive the trace dump.
+ */
+Trace::Span::Span(const char* name)
+    : name(name), start(enabled.load(std::memory_order_relaxed) ? nowNs() : 0)
+{
+    REQUIRE(name != nullptr, "span name must not be null");
+}
+
+/**
+ * @brief Records the span into this thread's ring buffer.
+ */
+Trace::Span::~Span() {
+    if (start == 0 || !enabled.load(std::memory_order_relaxed))
+        return;
+
+    ThreadBuffer& buffer = localBuffer();
+    buffer.events[buffer.next] = {name, start, nowNs() - start};
+    if (++buffer.next == buffer.events.size()) {
+        buffer.next = 0;
+        buffer.wrapped = true;
+    }
+}
+
+/**
+ * @brief Interns a runtime span name.
+ *
+ * Lookups go through a per-thread cache first, so the shared table is only
+ * locked the first time a thread sees a name.
+ *
+ * @param name Name to intern.
+ * @return Stable pointer to the interned copy.
+ */
+const char* Trace::intern(const std::string& name) {
+    thread_local std::unordered_map<std::string, const char*> cache;
+    auto cached = cache.find(name);
+    if (cached != cache.end())
+        return cached->second;
+
+    std::lock_guard<std::mutex> lock(internMutex);
+    const char* interned = internedNames.insert(name).first->c_str();
+    cache.emplace(name, interned);
+    return interned;
+}
+
+/**
+ * @brief Turns span recording on or off.
+ *
+ * @param on New recording state.
+ */
+void Trace::setEnabled(bool on) {
+    enabled.store(on);
+    ENSURE(isEnabled() == on, "tracing state must be updated");
+}
+
+/**
+ * @brief Returns whether spans are being recorded.
+ *
+ * @return true if recording is enabled.
+ */
+bool Trace::isEnabled() {
+    return enabled.load();
+}
+
+/**
+ * @brief Sets the per-thread ring buffer size for threads that start recording later.
+ *
+ * @param capacity Number of spans per thread (must be positive).
+ */
+void Trace::setBufferCapacity(std::size_t capacity) {
+    REQUIRE(capacity > 0, "buffer capacity must be positive");
+    bufferCapacity.store(capacity);
+}
+
+/**
+ * @brief Writes the recorded spans of all threads in Chrome trace-event format.
+ *
+ * Spans are emitted as complete ("X") events with microsecond timestamps.
+ *
+ * @param out Output stream.
+ */
+void Trace::writeChromeJson(std::ostream& out) {
+    std::lock_guard<std::mutex> lock(registryMutex);
+
+    out << std::fixed << std::setprecision(3);
+    out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    bool first = true;
+    for (const auto& buffer : registry) {
+        std::size_t count = buffer->wrapped ? buffer->events.size() : buffer->next;
+        std::size_t begin = buffer->wrapped ? buffer->next : 0;
+        for (std::size_t i = 0; i < count; i++) {
+            const Event& event = buffer->events[(begin + i) % buffer->events.size()];
+            out << (first ? "\n" : ",\n") << "{\"name\":";
+            writeJsonString(out, event.name);
+            out << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->threadId
+                << ",\"ts\":" << event.start / 1000.0
+                << ",\"dur\":" << event.duration / 1000.0 << "}";
+            first = false;
+        }
+    }
+    out << "\n]}\n";
+    out << std::defaultfloat;
+}
+
+/**
+ * @brief Empties all ring buffers.
+ */
+void Trace::clear() {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    for (auto& buffer : registry) {
+        buffer->next = 0;
+        buffer->wrapped = false;
+    }
+}
@@ -0,0 +1,95 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+
+/**
+ * @class Trace
+ * @brief Low-overhead scoped profiling spans, dumped as Chrome trace-event JSON.
+ *
+ * Every thread records completed spans into its own fixed-size ring buffer, so
+ * recording never takes a lock; when a buffer is full the oldest spans are
+ * overwritten. The dump can be opened in Perfetto or chrome://tracing.
+ *
+ * Instrumentation points use the TRACE_SCOPE macro, which compiles to nothing
+ * unless TRAFFICSIM_TRACING is defined. Recording can additionally be switched
+ * on and off at runtime with setEnabled().
+ */
+class Trace {
+public:
+    /**
+     * @brief RAII span: records [construction, destruction) under the given name.
+     *
+     * The name is stored by pointer, so it must stay valid until the trace is written.
+     */
+    class Span {
+    public:
+        /**
+         * @brief Opens a span.
+         * @param name Name shown in the trace viewer.
+         * @pre name != nullptr
+         */
+        explicit Span(const char* name);
+
+        /** @brief Closes the span and records it if tracing is enabled. */
+        ~Span();
+
+        Span(const Span&) = delete;
+        Span& operator=(const Span&) = delete;
+
+    private:
+        const char* name;
+        std::uint64_t start;
+    };
+
+    /**
+     * @brief Returns a copy of name that stays valid for the lifetime of the program.
+     * Use this for span names built at runtime, such as road names.
+     * @param name Name to intern.
+     * @return Pointer to a null-terminated string equal to name.
+     */
+    static const char* intern(const std::string& name);
+
+    /**
+     * @brief Enables or disables recording at runtime.
+     * @post isEnabled() == enabled
+     */
+    static void setEnabled(bool enabled);
+
+    /** @return true if spans are currently being recorded. */
+    static bool isEnabled();
+
+    /**
+     * @brief Sets the number of spans kept per thread.
+     * Only affects buffers of threads that have not recorded anything yet.
+     * @pre capacity > 0
+     */
+    static void setBufferCapacity(std::size_t capacity);
+
+    /**
+     * @brief Writes all recorded spans as Chrome trace-event JSON.
+     * Must not be called while other threads are still recording.
+     * @param out Stream to write to.
+     */
+    static void writeChromeJson(std::ostream& out);
+
+    /**
+     * @brief Discards all recorded spans.
+     * Must not be called while other threads are still recording.
+     */
+    static void clear();
+};
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+
+#ifdef TRAFFICSIM_TRACING
+#define TRACE_SCOPE(name) Trace::Span TRACE_CONCAT(traceSpan_, __LINE__)(name)
+#else
+#define TRACE_SCOPE(name) ((void)0)
+#endif
+
+#endif // TRACE_H
@@ -1,5 +1,9 @@
 #include "TrafficLight.h"
 #include "DesignByContract.h"
+#include "SimulationStats.h"
+#include "CloneMap.h"
+#include <algorithm>
+#include <cmath>
 
 /**
  * @brief Constructs a TrafficLight object.
@@ -12,7 +16,8 @@
  * @param cycle Duration of one green/red cycle (must be > 0).
  */
 TrafficLight::TrafficLight(Road* road, double position, int cycle)
-    : road(road), position(position), cycle(cycle), green(true), lastSwitchTime(0) 
+    : road(road), position(position), cycle(cycle), green(true), lastSwitchTime(0),
+      actuated(false), lastDetection(0)
 {
     REQUIRE(road != nullptr, "road must not be null");
     REQUIRE(position >= 0.0, "position must be non-negative");
@@ -28,7 +33,8 @@ TrafficLight::TrafficLight(Road* road, double position, int cycle)
 /**
  * @brief Updates the traffic light state based on the current simulation time.
  * 
- * Toggles the traffic light between green and red if the cycle duration has elapsed since the last switch.
+ * Toggles the traffic light between green and red if the cycle duration has elapsed since the last switch;
+ * an actuated green phase ends when gapOut() says so instead.
  * Ensures time does not go backwards and that state changes are consistent with cycle timing.
  * 
  * @param time The current simulation time (must be >= lastSwitchTime).
@@ -37,12 +43,15 @@ void TrafficLight::update(double time) {
     REQUIRE(time >= 0.0, "time must be non-negative");
     REQUIRE(time >= lastSwitchTime, "time must not go backwards");
     
-    bool oldGreen = green;
-    double oldLastSwitchTime = lastSwitchTime;
+    CONTRACT_OLD(bool, oldGreen, green);
+    CONTRACT_OLD(double, oldLastSwitchTime, lastSwitchTime);
     
-    if (time - lastSwitchTime >= cycle) {
+    bool ended = actuated && green ? gapOut(time) : time - lastSwitchTime >= cycle;
+    if (ended) {
         green = !green;
         lastSwitchTime = time;
+        lastDetection = time;
+        SimulationStats::current().lightSwitches++;
         
         ENSURE(green != oldGreen, "light state must have changed");
         ENSURE(lastSwitchTime == time, "last switch time must be updated to current time");
@@ -52,6 +61,84 @@ void TrafficLight::update(double time) {
     }
 }
 
+/**
+ * @brief Checks whether an actuated green phase ends.
+ * 
+ * The detection zone is counted first; the queue is only measured when the zone
+ * is empty and the gap has expired, so a busy approach costs one count per step.
+ * 
+ * @param time The current simulation time.
+ * @return true if the phase reached maxGreen, or passed minGreen without demand.
+ */
+bool TrafficLight::gapOut(double time) {
+    double elapsed = time - lastSwitchTime;
+    if (elapsed >= actuation.maxGreen)
+        return true;
+    if (road->countVehicles(std::max(0.0, position - actuation.zone), position) > 0)
+        lastDetection = time;
+    if (elapsed < actuation.minGreen || time - lastDetection < actuation.gap)
+        return false;
+    return road->getQueue(position).vehicles == 0;
+}
+
+/**
+ * @brief Places the light offset seconds into its period at the given time.
+ * @param offset Seconds since the start of green; wraps at twice the cycle.
+ * @param time Current simulation time.
+ */
+void TrafficLight::setOffset(double offset, double time) {
+    REQUIRE(offset >= 0.0, "offset must be non-negative");
+    REQUIRE(!actuated, "an actuated light has no fixed green-red period");
+    
+    double phase = std::fmod(offset, 2.0 * cycle);
+    green = phase < cycle;
+    lastSwitchTime = time - (green ? phase : phase - cycle);
+    lastDetection = lastSwitchTime;
+    ENSURE(time >= lastSwitchTime, "the current phase must have started");
+}
+
+/**
+ * @brief Returns the time since the last switch to green.
+ * @param time Current simulation time.
+ * @return Seconds into the green-red period.
+ */
+double TrafficLight::getOffset(double time) const {
+    REQUIRE(time >= lastSwitchTime, "time must not be before the last switch");
+    REQUIRE(!actuated, "an actuated light has no fixed green-red period");
+    return time - lastSwitchTime + (green ? 0.0 : cycle);
+}
+
+/**
+ * @brief Switches the light to actuated green times.
+ * @param settings Green times, gap and detection zone.
+ */
+void TrafficLight::setActuation(const Actuation& settings) {
+    REQUIRE(settings.minGreen > 0, "minimum green must be positive");
+    REQUIRE(settings.maxGreen >= settings.minGreen, "maximum green must not be below the minimum");
+    REQUIRE(settings.gap > 0, "gap must be positive");
+    REQUIRE(settings.zone > 0, "detection zone must be positive");
+    
+    actuation = settings;
+    actuated = true;
+    ENSURE(isActuated(), "light must be actuated");
+}
+
+/**
+ * @brief Returns whether green ends on demand.
+ * @return true if setActuation() was called.
+ */
+bool TrafficLight::isActuated() const {
+    return actuated;
+}
+
+/**
+ * @brief Returns the actuation settings.
+ * @return The settings passed to setActuation(), or the defaults.
+ */
+const TrafficLight::Actuation& TrafficLight::getActuation() const {
+    return actuation;
+}
+
 /**
  * @brief Returns whether the traffic light is currently green.
  * @return true if green, false otherwise.
@@ -81,3 +168,39 @@ std::string TrafficLight::getStatus() const {
     
     return result;
 }
+
+/**
+ * @brief Returns the cycle time.
+ * @return Seconds between two switches.
+ */
+int TrafficLight::getCycle() const {
+    return cycle;
+}
+
+/**
+ * @brief Changes the cycle time; the current phase keeps its start time.
+ * @param newCycle Seconds between two switches.
+ */
+void TrafficLight::setCycle(int newCycle) {
+    REQUIRE(newCycle > 0, "Cycle must be positive");
+    cycle = newCycle;
+    ENSURE(getCycle() == newCycle, "Cycle was not set");
+}
+
+/**
+ * @brief Returns the queue of slow vehicles up to the light's position.
+ * @param maxSpeed Speed from which a vehicle is not queued.
+ * @param maxGap Largest gap within the queue.
+ * @return Road::Queue The queue.
+ */
+Road::Queue TrafficLight::getQueue(double maxSpeed, double maxGap) const {
+    return road->getQueue(position, maxSpeed, maxGap);
+}
+
+/**
+ * @brief Replaces the road of a copied light by its copy.
+ * @param map Originals to copies.
+ */
+void TrafficLight::rebind(const CloneMap& map) {
+    road = map(road);
+}
@@ -1,9 +1,10 @@
 #ifndef TRAFFICLIGHT_H
 #define TRAFFICLIGHT_H
 
+#include "Road.h"
 #include <string>
 
-class Road;
+class CloneMap;
 
 /**
  * @class TrafficLight
@@ -11,9 +12,26 @@ class Road;
  * 
  * The traffic light switches state (green/red) cyclically based on a fixed cycle time.
  * It is positioned on a specific road at a given location.
+ *
+ * An actuated light (setActuation) keeps the fixed red time but ends green on
+ * demand: green lasts at least minGreen and at most maxGreen seconds, and in
+ * between it is extended while a vehicle was in the detection zone before the
+ * light less than gap seconds ago, or while vehicles queue at the light. The
+ * zone and the queue are looked up in the road's position-ordered lanes, so an
+ * actuated light costs a few binary searches per step.
  */
 class TrafficLight {
 public:
+    /**
+     * @brief Settings of an actuated light.
+     */
+    struct Actuation {
+        double minGreen = 5;   ///< Shortest green time in seconds.
+        double maxGreen = 60;  ///< Longest green time in seconds.
+        double gap = 3;        ///< Green ends this many seconds after the zone was last occupied.
+        double zone = 30;      ///< Length of the detection zone before the light in metres.
+    };
+
     /**
      * @brief Constructs a TrafficLight at a given position on a road with a cycle duration.
      * @param road Pointer to the Road (must not be nullptr).
@@ -28,10 +46,11 @@ public:
 
     /**
      * @brief Updates the light state depending on elapsed time.
-     * Switches state if cycle time has elapsed since last switch.
+     * Switches state if cycle time has elapsed since last switch, or, for an
+     * actuated green, when the phase gaps out or reaches its maximum.
      * @param time Current simulation time (monotonically increasing).
      * @pre time >= lastSwitchTime
-     * @post toggles green/red if cycle time elapsed since lastSwitchTime
+     * @post toggles green/red if the current phase ended
      */
     void update(double time);
 
@@ -44,12 +63,78 @@ public:
     /** @return The position of the traffic light on its road (>= 0). */
     double getPosition() const;
 
+    /** @return The time between two switches in seconds. */
+    int getCycle() const;
+
+    /**
+     * @brief Changes the time between two switches.
+     * @param newCycle Cycle time in seconds.
+     * @pre newCycle > 0
+     * @post getCycle() == newCycle
+     */
+    void setCycle(int newCycle);
+
+    /**
+     * @brief Shifts the light's schedule to a point of its green-red period.
+     * At time the light is offset seconds past the start of a green phase: green
+     * for the first getCycle() seconds of every 2 * getCycle(), red after that.
+     * @param offset Seconds since the start of green.
+     * @param time Current simulation time.
+     * @pre offset >= 0
+     * @pre !isActuated(), since an actuated green has no fixed length
+     * @post isGreen() == (fmod(offset, 2 * getCycle()) < getCycle())
+     */
+    void setOffset(double offset, double time);
+
+    /**
+     * @brief Returns how far the light is into its green-red period; the inverse of setOffset().
+     * @param time Current simulation time.
+     * @return Seconds since the start of the current green phase, below 2 * getCycle().
+     * @pre !isActuated()
+     */
+    double getOffset(double time) const;
+
+    /**
+     * @brief Makes the light actuated; the cycle remains the red time.
+     * @param settings Green times, gap and detection zone.
+     * @pre 0 < settings.minGreen <= settings.maxGreen
+     * @pre settings.gap > 0 && settings.zone > 0
+     * @post isActuated()
+     */
+    void setActuation(const Actuation& settings);
+
+    /** @return true if green ends on demand, false for a fixed cycle. */
+    bool isActuated() const;
+
+    /** @return The actuation settings; only meaningful if isActuated(). */
+    const Actuation& getActuation() const;
+
+    /**
+     * @brief Measures the queue standing before the light; see Road::getQueue().
+     * @param maxSpeed Vehicles at this speed or faster are not queued, in m/s.
+     * @param maxGap Largest gap within the queue, in metres.
+     * @return Road::Queue The queue on the light's road.
+     */
+    Road::Queue getQueue(double maxSpeed = 2.0, double maxGap = 10.0) const;
+
+    /**
+     * @brief Points a copied light at the copy of its road.
+     * @param map Originals to copies.
+     */
+    void rebind(const CloneMap& map);
+
 private:
+    /** @brief Decides whether an actuated green phase ends at the given time. */
+    bool gapOut(double time);
+
     Road* road;
     double position;
     int cycle;
     bool green;
     double lastSwitchTime;
+    bool actuated;
+    Actuation actuation;
+    double lastDetection;   ///< Last time the detection zone was occupied during green.
 };
 
 #endif // TRAFFICLIGHT_H
@@ -0,0 +1,70 @@
+#ifndef TRIPLEBUFFER_H
+#define TRIPLEBUFFER_H
+
+#include <atomic>
+
+/**
+ * @class TripleBuffer
+ * @brief Hands the newest value from one writer thread to one reader thread without waiting.
+ *
+ * The writer fills back() and publishes it; the reader takes the newest
+ * published value with acquire() and reads it in front(). The third slot sits
+ * between them, so neither side ever waits for the other and values the
+ * reader was too slow for are overwritten. Slots are reused, so a value whose
+ * storage is kept between writes (like a vector that is cleared) stops
+ * allocating once it has grown.
+ */
+template <class T>
+class TripleBuffer {
+public:
+    TripleBuffer() : middle(1), backIndex(0), frontIndex(2) {}
+
+    TripleBuffer(const TripleBuffer&) = delete;
+    TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+    /**
+     * @brief Returns the slot the writer fills; only the writer may call this.
+     * @return The slot; it may still hold an older value.
+     */
+    T& back() {
+        return slots[backIndex];
+    }
+
+    /**
+     * @brief Makes the filled back slot the newest value; only the writer may call this.
+     */
+    void publish() {
+        backIndex = middle.exchange(backIndex | FRESH, std::memory_order_acq_rel) & INDEX;
+    }
+
+    /**
+     * @brief Takes the newest published value, if there is one the reader has not taken yet.
+     * Only the reader may call this.
+     * @return Whether front() changed.
+     */
+    bool acquire() {
+        if ((middle.load(std::memory_order_acquire) & FRESH) == 0)
+            return false;
+        frontIndex = middle.exchange(frontIndex, std::memory_order_acq_rel) & INDEX;
+        return true;
+    }
+
+    /**
+     * @brief Returns the value taken by the last acquire(); only the reader may call this.
+     * @return The value.
+     */
+    const T& front() const {
+        return slots[frontIndex];
+    }
+
+private:
+    static constexpr unsigned INDEX = 3;
+    static constexpr unsigned FRESH = 4;
+
+    T slots[3];
+    std::atomic<unsigned> middle;   ///< Index of the middle slot, with FRESH if it was published after the last acquire().
+    unsigned backIndex;
+    unsigned frontIndex;
+};
+
+#endif // TRIPLEBUFFER_H
@@ -2,10 +2,13 @@
 #include "Road.h"
 #include "TrafficLight.h"
 #include "BusStop.h"
+#include "RoadGraph.h"
 #include "DesignByContract.h"
+#include "SimulationStats.h"
+#include "CloneMap.h"
 #include <cmath>
 #include <algorithm>
-#include <unordered_map>
+#include <utility>
 
 // Constants for vehicle behavior
 const double l    = 4;          ///< Vehicle length (meters)
@@ -14,6 +17,8 @@ const double amax = 1.44;       ///< Maximum acceleration (m/s^2)
 const double bmax = 4.61;       ///< Maximum braking deceleration (m/s^2)
 const double F_MIN = 4;         ///< Minimum following distance (meters)
 const double xs0  = 15;         ///< Minimum stopping distance before traffic light (meters)
+const double politeness = 0.2;  ///< MOBIL weight of the followers' gain
+const double a_thr = 0.1;       ///< MOBIL minimal gain for a lane change (m/s^2)
 
 /**
  * @brief Constructs a Vehicle with initial road and position.
@@ -23,7 +28,7 @@ const double xs0  = 15;         ///< Minimum stopping distance before traffic li
  * Ensures speed and acceleration start at zero, and vmax is set.
  */
 Vehicle::Vehicle(Road* road, double position)
-    : road(road), position(position), speed(0), acceleration(0), vmax(Vmax) {
+    : bus(nullptr), road(road), position(position), speed(0), acceleration(0), vmax(Vmax), lane(0), destination(nullptr), router(nullptr), routeIndex(0), handle(0), id(0), waitStop(-1), waitTimer(0) {
     REQUIRE(road != nullptr, "Road cannot be null");
     REQUIRE(position >= 0, "Position must be non-negative");
 
@@ -34,6 +39,40 @@ Vehicle::Vehicle(Road* road, double position)
     ENSURE(this->vmax == Vmax, "Max speed should be set to Vmax");
 }
 
+/**
+ * @brief Creates a vehicle subclass from its type name.
+ * @param type Vehicle type.
+ * @param road Pointer to Road.
+ * @param position Initial position.
+ * @return New vehicle, or nullptr if the type is unknown.
+ */
+Vehicle* Vehicle::create(const std::string& type, Road* road, double position) {
+    REQUIRE(road != nullptr, "Road cannot be null");
+    REQUIRE(position >= 0, "Position must be non-negative");
+
+    if (type == "auto")
+        return new Auto(road, position);
+    if (type == "bus")
+        return new Bus(road, position);
+    if (type == "politiecombi")
+        return new Combi(road, position);
+    if (type == "ziekenwagen")
+        return new Ziek(road, position);
+    if (type == "brandweerwagen")
+        return new Brand(road, position);
+    return nullptr;
+}
+
+/**
+ * @brief Checks a type name against the subclasses create() makes.
+ * @param type Vehicle type.
+ * @return true if create() accepts the type.
+ */
+bool Vehicle::isKnownType(const std::string& type) {
+    return type == "auto" || type == "bus" || type == "politiecombi" || type == "ziekenwagen"
+           || type == "brandweerwagen";
+}
+
 /**
  * @brief Constructs an Auto vehicle.
  * @param road Pointer to Road.
@@ -104,41 +143,188 @@ Brand::Brand(Road* road, double position) : Vehicle(road, position) {
     ENSURE(type == "brandweerwagen", "Type should be set to brandweerwagen");
 }
 
+/**
+ * @brief Copies a vehicle of the base type.
+ * @return The copy.
+ */
+Vehicle* Vehicle::clone() const {
+    return new Vehicle(*this);
+}
+
+/** @brief Copies an Auto. */
+Vehicle* Auto::clone() const {
+    return new Auto(*this);
+}
+
+/** @brief Copies a Bus. */
+Vehicle* Bus::clone() const {
+    return new Bus(*this);
+}
+
+/** @brief Copies a Combi. */
+Vehicle* Combi::clone() const {
+    return new Combi(*this);
+}
+
+/** @brief Copies a Ziek. */
+Vehicle* Ziek::clone() const {
+    return new Ziek(*this);
+}
+
+/** @brief Copies a Brand. */
+Vehicle* Brand::clone() const {
+    return new Brand(*this);
+}
+
+/**
+ * @brief Replaces every pointer of a copied vehicle by its copy.
+ * @param map Originals to copies.
+ * @param graph Road graph of the copied simulation.
+ */
+void Vehicle::rebind(const CloneMap& map, const RoadGraph* graph) {
+    bus = map(bus);
+    road = map(road);
+    destination = map(destination);
+    route = map.route(route);
+    router = router != nullptr ? graph : nullptr;
+}
+
 /**
  * @brief Calculates acceleration based on leading vehicle and max acceleration.
  * 
- * If a leading vehicle exists, computes safe gap and adjusts acceleration accordingly.
- * Otherwise, accelerates towards vmax.
+ * Looks up the leading vehicle on the road and delegates to calculateAcceleration(const Vehicle*).
  */
 void Vehicle::calculateAcceleration() {
     REQUIRE(road != nullptr, "Road cannot be null");
     REQUIRE(speed >= 0, "Speed must be non-negative");
 
-    if (road->hasLeadingVehicle(this)) {
-        Vehicle* lead = road->getLeadingVehicle(this);
-        double delta_x = lead->getPosition() - position - l;
-        double delta_v = speed - lead->getSpeed();
+    calculateAcceleration(road->getLeadingVehicle(this));
+}
 
-        double safe_gap = F_MIN + std::max(0.0, (speed + delta_v) / (2 * std::sqrt(amax * bmax))) * delta_x;
-        acceleration = amax * (1 - std::pow(speed / vmax, 4) - std::pow(safe_gap / delta_x, 2));
-    } else {
-        acceleration = amax * (1 - std::pow(speed / vmax, 4));
-    }
+/**
+ * @brief Calculates acceleration behind the given leader.
+ * @param leader Vehicle ahead, or nullptr.
+ */
+void Vehicle::calculateAcceleration(const Vehicle* leader) {
+    REQUIRE(speed >= 0, "Speed must be non-negative");
+    REQUIRE(leader == nullptr || leader->getPosition() > position, "Leader must be ahead");
+
+    acceleration = followingAcceleration(leader);
 }
 
 /**
- * @brief Applies traffic light rules to slow down when approaching a red light.
+ * @brief Calculates acceleration behind a leader given by position and speed.
+ * @param leaderPosition Leader position, in this road's coordinates.
+ * @param leaderSpeed Leader speed.
  */
-void Vehicle::applyTrafficLightRules() {
-    REQUIRE(road != nullptr, "Road cannot be null");
+void Vehicle::calculateAcceleration(double leaderPosition, double leaderSpeed) {
+    REQUIRE(speed >= 0, "Speed must be non-negative");
+    REQUIRE(leaderPosition > position, "Leader must be ahead");
+
+    acceleration = followingAcceleration(leaderPosition, leaderSpeed);
+}
+
+/**
+ * @brief Computes the acceleration behind a hypothetical leader without changing the vehicle.
+ * @param leader Vehicle ahead, or nullptr.
+ * @return Acceleration after traffic light rules.
+ */
+double Vehicle::accelerationBehind(const Vehicle* leader) const {
+    return limitForTrafficLights(followingAcceleration(leader));
+}
+
+/**
+ * @brief Car-following acceleration.
+ * 
+ * If a leading vehicle exists, computes safe gap and adjusts acceleration accordingly.
+ * Otherwise, accelerates towards vmax.
+ *
+ * @param leader Vehicle ahead, or nullptr.
+ * @return Acceleration in m/s^2.
+ */
+double Vehicle::followingAcceleration(const Vehicle* leader) const {
+    if (leader != nullptr)
+        return followingAcceleration(leader->getPosition(), leader->getSpeed());
+    return freeAcceleration();
+}
 
+/**
+ * @brief Car-following acceleration behind a leader at a given position and speed.
+ * @param leaderPosition Leader position, in this road's coordinates.
+ * @param leaderSpeed Leader speed.
+ * @return Acceleration in m/s^2.
+ */
+double Vehicle::followingAcceleration(double leaderPosition, double leaderSpeed) const {
+    double delta_x = leaderPosition - position - l;
+    double delta_v = speed - leaderSpeed;
+
+    double safe_gap = F_MIN + std::max(0.0, (speed + delta_v) / (2 * std::sqrt(amax * bmax))) * delta_x;
+    return amax * (1 - std::pow(speed / vmax, 4) - std::pow(safe_gap / delta_x, 2));
+}
+
+/**
+ * @brief Acceleration towards vmax when nothing is ahead.
+ * @return Acceleration in m/s^2.
+ */
+double Vehicle::freeAcceleration() const {
+    return amax * (1 - std::pow(speed / vmax, 4));
+}
+
+/**
+ * @brief Lowers an acceleration when approaching a red light.
+ * @param proposed Acceleration before the traffic light rules.
+ * @return Acceleration after the traffic light rules.
+ */
+double Vehicle::limitForTrafficLights(double proposed) const {
     for (auto* light : road->getTrafficLights()) {
         int lightPos = light->getPosition();
         if (!light->isGreen() && lightPos > position && lightPos - position < xs0) {
             double distanceToLight = lightPos - position;
-            acceleration = std::min(-bmax, -std::pow(distanceToLight / xs0, 2) * amax);
+            proposed = std::min(-bmax, -std::pow(distanceToLight / xs0, 2) * amax);
         }
     }
+    return proposed;
+}
+
+/**
+ * @brief MOBIL lane change decision.
+ * @param newLeader Leader in the target lane, or nullptr.
+ * @param newFollower Follower in the target lane, or nullptr.
+ * @param oldLeader Leader in the current lane, or nullptr.
+ * @param oldFollower Follower in the current lane, or nullptr.
+ * @return True if changing lanes is safe and worthwhile.
+ */
+bool Vehicle::shouldChangeLane(const Vehicle* newLeader, const Vehicle* newFollower,
+                               const Vehicle* oldLeader, const Vehicle* oldFollower) const {
+    // Safety: keep a minimal gap on both sides and don't make the new follower brake hard
+    if (newLeader != nullptr && newLeader->getPosition() - position - l < F_MIN)
+        return false;
+    if (newFollower != nullptr && position - newFollower->getPosition() - l < F_MIN)
+        return false;
+
+    double newFollowerAfter = 0;
+    if (newFollower != nullptr) {
+        newFollowerAfter = newFollower->accelerationBehind(this);
+        if (newFollowerAfter < -bmax)
+            return false;
+    }
+
+    // Incentive: own gain plus the politeness-weighted gain of both followers
+    double gain = accelerationBehind(newLeader) - acceleration;
+    if (newFollower != nullptr)
+        gain += politeness * (newFollowerAfter - newFollower->getAcceleration());
+    if (oldFollower != nullptr)
+        gain += politeness * (oldFollower->accelerationBehind(oldLeader) - oldFollower->getAcceleration());
+    return gain > a_thr;
+}
+
+/**
+ * @brief Applies traffic light rules to slow down when approaching a red light.
+ */
+void Vehicle::applyTrafficLightRules() {
+    REQUIRE(road != nullptr, "Road cannot be null");
+
+    acceleration = limitForTrafficLights(acceleration);
 }
 
 /**
@@ -149,9 +335,6 @@ void Vehicle::update(double deltaTime) {
     REQUIRE(deltaTime > 0, "Delta time must be positive");
     REQUIRE(position >= 0, "Position must be non-negative");
 
-    double oldPosition = position;
-    double oldSpeed = speed;
-
     if (speed + acceleration * deltaTime < 0) {
         position -= (speed * speed) / (2 * acceleration);
         speed = 0;
@@ -168,25 +351,68 @@ void Vehicle::update(double deltaTime) {
  * @brief Determines if vehicle should wait at a bus stop.
  * @param stopPos Position of the bus stop.
  * @param waitDuration Duration to wait.
+ * @param dt Length of the step in seconds.
  * @return True if waiting, false otherwise.
  */
-bool Vehicle::shouldWaitAt(double stopPos, double waitDuration) {
+bool Vehicle::shouldWaitAt(double stopPos, double waitDuration, double dt) {
     REQUIRE(waitDuration >= 0, "Wait duration must be non-negative");
 
-    static std::unordered_map<double, double> waitTimers;
+    // The timer belongs to the vehicle, so concurrently running simulations do not share it
     double distance = std::fabs(this->getPosition() - stopPos);
     if (distance < 0.5) {
-        if (waitTimers[stopPos] < waitDuration) {
-            waitTimers[stopPos] += 0.0166;  // Increment timer (e.g. frame time)
+        if (waitStop != stopPos) {
+            waitStop = stopPos;
+            waitTimer = 0;
+        }
+        if (waitTimer < waitDuration) {
+            waitTimer += dt;
+            SimulationStats::current().busDwellSeconds += dt;
             this->speed = 0;
             return true;
         }
-    } else {
-        waitTimers[stopPos] = 0;
+    } else if (waitStop == stopPos) {
+        waitStop = -1;
+        waitTimer = 0;
     }
     return false;
 }
 
+/**
+ * @brief Returns the stop position of the current dwell.
+ * @return Position, or -1.
+ */
+double Vehicle::getWaitStop() const {
+    return waitStop;
+}
+
+/**
+ * @brief Returns the time spent at the current stop.
+ * @return Seconds waited.
+ */
+double Vehicle::getWaitTime() const {
+    return waitTimer;
+}
+
+/**
+ * @brief Sets the dwell state.
+ * @param stop Stop position, or -1.
+ * @param waited Seconds waited.
+ */
+void Vehicle::setWait(double stop, double waited) {
+    REQUIRE(waited >= 0, "Waited time must be non-negative");
+    waitStop = stop;
+    waitTimer = waited;
+    ENSURE(waitStop == stop && waitTimer == waited, "Wait state was not set properly");
+}
+
+/**
+ * @brief Returns the vehicle length.
+ * @return Length in metres.
+ */
+double Vehicle::getLength() const {
+    return l;
+}
+
 /**
  * @brief Returns the vehicle type string.
  * @return Type string.
@@ -215,6 +441,14 @@ double Vehicle::getSpeed() const {
     return speed;
 }
 
+/**
+ * @brief Returns the maximum speed.
+ * @return Maximum speed in m/s.
+ */
+double Vehicle::getMaxSpeed() const {
+    return vmax;
+}
+
 /**
  * @brief Returns current acceleration.
  * @return Acceleration value.
@@ -233,12 +467,19 @@ const Road* Vehicle::getRoad() const {
 }
 
 /**
- * @brief Sets the vehicle's road.
+ * @brief Sets the vehicle's road and advances its place on the route.
+ * Following the route is O(1); only a vehicle that left its route searches it.
  * @param r Pointer to new road.
  */
 void Vehicle::setRoad(Road* r) {
     REQUIRE(r != nullptr, "Road cannot be null");
     road = r;
+    if (route) {
+        if (routeIndex + 1 < route->size() && (*route)[routeIndex + 1] == r)
+            routeIndex++;
+        else
+            routeIndex = std::find(route->begin(), route->end(), r) - route->begin();
+    }
     ENSURE(road == r, "Road was not set properly");
 }
 
@@ -262,3 +503,107 @@ void Vehicle::setSpeed(double newSpeed) {
     speed = newSpeed;
     ENSURE(speed == newSpeed, "Speed was not set properly");
 }
+
+/**
+ * @brief Returns the lane index.
+ * @return Lane, 0 being the rightmost.
+ */
+int Vehicle::getLane() const {
+    return lane;
+}
+
+/**
+ * @brief Sets the lane index.
+ * @param newLane New lane.
+ */
+void Vehicle::setLane(int newLane) {
+    REQUIRE(newLane >= 0, "Lane must be non-negative");
+    lane = newLane;
+    ENSURE(lane == newLane, "Lane was not set properly");
+}
+
+/**
+ * @brief Returns the destination road.
+ * @return Destination, or nullptr.
+ */
+const Road* Vehicle::getDestination() const {
+    return destination;
+}
+
+/**
+ * @brief Sets the destination road.
+ * @param newDestination Destination, or nullptr.
+ */
+void Vehicle::setDestination(const Road* newDestination) {
+    destination = newDestination;
+    ENSURE(destination == newDestination, "Destination was not set properly");
+}
+
+/**
+ * @brief Sets a shared precomputed route.
+ * @param newRoute The route.
+ */
+void Vehicle::setRoute(std::shared_ptr<const std::vector<Road*>> newRoute) {
+    REQUIRE(newRoute && !newRoute->empty(), "Route must not be empty");
+    route = std::move(newRoute);
+    routeIndex = std::find(route->begin(), route->end(), road) - route->begin();
+    destination = route->back();
+    ENSURE(destination == route->back(), "Destination must be the end of the route");
+}
+
+/**
+ * @brief Returns the shared precomputed route.
+ * @return The route, or nullptr.
+ */
+const std::shared_ptr<const std::vector<Road*>>& Vehicle::getRoute() const {
+    return route;
+}
+
+/**
+ * @brief Sets the road graph used for routing.
+ * @param newRouter The graph.
+ */
+void Vehicle::setRouter(const RoadGraph* newRouter) {
+    router = newRouter;
+}
+
+/**
+ * @brief Returns the road after the current one on the route, or looks it up in the destination's shortest-path tree.
+ * @return Next road, or nullptr.
+ */
+Road* Vehicle::getNextRoad() const {
+    if (destination == nullptr)
+        return nullptr;
+    if (route && routeIndex < route->size() && (*route)[routeIndex] == road)
+        return routeIndex + 1 < route->size() ? (*route)[routeIndex + 1] : nullptr;
+    if (router == nullptr)
+        return nullptr;
+    return router->nextRoad(road, destination);
+}
+
+/**
+ * @brief Returns the registry handle.
+ * @return Handle, or 0 when unregistered.
+ */
+std::uint32_t Vehicle::getHandle() const {
+    return handle;
+}
+
+/**
+ * @brief Returns the stable vehicle id.
+ * @return Id, or 0 when unregistered.
+ */
+std::uint32_t Vehicle::getId() const {
+    return id;
+}
+
+/**
+ * @brief Stores the handle and id assigned when the vehicle is registered.
+ * @param newHandle Registry handle.
+ * @param newId Stable id.
+ */
+void Vehicle::setRegistration(std::uint32_t newHandle, std::uint32_t newId) {
+    handle = newHandle;
+    id = newId;
+    ENSURE(handle == newHandle && id == newId, "Registration was not set properly");
+}
@@ -2,9 +2,14 @@
 #define VEHICLE_H
 
 #include <string>
+#include <cstdint>
+#include <memory>
+#include <vector>
 
 class Road;
 class BusStop;
+class RoadGraph;
+class CloneMap;
 
 /**
  * @class Vehicle
@@ -27,6 +32,41 @@ public:
      */
     Vehicle(Road* road, double position);
 
+    /**
+     * @brief Creates a vehicle of the given type.
+     * @param type One of "auto", "bus", "politiecombi", "ziekenwagen" or "brandweerwagen".
+     * @param road Road the vehicle starts on.
+     * @param position Initial position on the road.
+     * @return The new vehicle, or nullptr for an unknown type.
+     * @pre road != nullptr
+     * @pre position >= 0
+     */
+    static Vehicle* create(const std::string& type, Road* road, double position);
+
+    /**
+     * @brief Checks whether create() knows a vehicle type.
+     * @param type Vehicle type.
+     * @return true for auto, bus, politiecombi, ziekenwagen and brandweerwagen.
+     */
+    static bool isKnownType(const std::string& type);
+
+    /** @brief Vehicles are owned and deleted through Vehicle pointers. */
+    virtual ~Vehicle() = default;
+
+    /**
+     * @brief Copies the vehicle, including its type and state.
+     * The copy still refers to the roads of the original until rebind().
+     * @return New vehicle owned by the caller.
+     */
+    virtual Vehicle* clone() const;
+
+    /**
+     * @brief Points a copied vehicle at the copies of its road, stop, destination and route.
+     * @param map Originals to copies.
+     * @param graph Road graph of the copy, used if the vehicle was routed.
+     */
+    void rebind(const CloneMap& map, const RoadGraph* graph);
+
     /** @brief Returns a pointer to the Road the vehicle is on. */
     const Road* getRoad() const;
 
@@ -36,6 +76,9 @@ public:
     /** @brief Returns the current speed of the vehicle. */
     double getSpeed() const;
 
+    /** @brief Returns the highest speed the vehicle drives at. */
+    double getMaxSpeed() const;
+
     /** @brief Returns the current acceleration of the vehicle. */
     double getAcceleration() const;
 
@@ -52,6 +95,51 @@ public:
      */
     void calculateAcceleration();
 
+    /**
+     * @brief Calculates the vehicle's acceleration behind a known leader.
+     * Used by Road::update, which already knows the leader from the sorted lane.
+     * @param leader The vehicle ahead in the same lane, or nullptr if the lane ahead is free.
+     * @pre leader == nullptr || leader->getPosition() > getPosition()
+     * @post acceleration updated based on the given leader
+     */
+    void calculateAcceleration(const Vehicle* leader);
+
+    /**
+     * @brief Calculates the vehicle's acceleration behind a leader that is not on this road.
+     * Used for the rearmost vehicle of the next road, seen across the road boundary.
+     * @param leaderPosition Position of the leader in this road's coordinates.
+     * @param leaderSpeed Speed of the leader.
+     * @pre leaderPosition > getPosition()
+     * @post acceleration updated based on the given leader
+     */
+    void calculateAcceleration(double leaderPosition, double leaderSpeed);
+
+    /**
+     * @brief Returns the acceleration the vehicle would have behind a given leader.
+     * Includes the traffic light rules, but does not change the vehicle.
+     * @param leader Hypothetical leader, or nullptr for a free lane.
+     * @return Acceleration in m/s^2.
+     */
+    double accelerationBehind(const Vehicle* leader) const;
+
+    /**
+     * @brief Decides whether a lane change passes the MOBIL safety and incentive criteria.
+     *
+     * The change must leave a minimal gap to both neighbours in the target lane and not
+     * force the new follower to brake harder than the maximum braking deceleration. It is
+     * taken when the vehicle's own gain plus a politeness-weighted share of the gain of
+     * the old and new followers exceeds a threshold.
+     *
+     * @param newLeader Vehicle ahead in the target lane, or nullptr.
+     * @param newFollower Vehicle behind in the target lane, or nullptr.
+     * @param oldLeader Vehicle ahead in the current lane, or nullptr.
+     * @param oldFollower Vehicle behind in the current lane, or nullptr.
+     * @return true if the vehicle should change to the target lane.
+     * @pre the accelerations of this vehicle and both followers are up to date
+     */
+    bool shouldChangeLane(const Vehicle* newLeader, const Vehicle* newFollower,
+                          const Vehicle* oldLeader, const Vehicle* oldFollower) const;
+
     /**
      * @brief Updates the vehicle's position and speed using acceleration and elapsed time.
      * @param deltaTime Time step for the update (must be positive).
@@ -91,26 +179,130 @@ public:
      */
     void setSpeed(double newSpeed);
 
+    /** @brief Returns the lane the vehicle drives in; 0 is the rightmost lane. */
+    int getLane() const;
+
+    /**
+     * @brief Moves the vehicle to another lane.
+     * Does not update the road's lane order; use Road for that.
+     * @param newLane Lane index.
+     * @pre newLane >= 0
+     * @post getLane() == newLane
+     */
+    void setLane(int newLane);
+
+    /** @brief Returns the road the vehicle is heading to, or nullptr if it drives without a route. */
+    const Road* getDestination() const;
+
+    /**
+     * @brief Gives the vehicle a destination; it then follows a shortest route to it.
+     * @param newDestination Road to drive to, or nullptr to drive without a route.
+     * @post getDestination() == newDestination
+     */
+    void setDestination(const Road* newDestination);
+
+    /**
+     * @brief Gives the vehicle a precomputed route, shared with other vehicles.
+     * The destination becomes the last road of the route.
+     * @param newRoute Roads to drive along; must not be empty.
+     * @pre newRoute && !newRoute->empty()
+     * @post getDestination() == newRoute->back()
+     */
+    void setRoute(std::shared_ptr<const std::vector<Road*>> newRoute);
+
+    /** @brief Returns the precomputed route, or nullptr if the vehicle has none. */
+    const std::shared_ptr<const std::vector<Road*>>& getRoute() const;
+
+    /**
+     * @brief Sets the graph used to look up the route; done by the Simulation.
+     * @param newRouter Compiled road graph, or nullptr.
+     */
+    void setRouter(const RoadGraph* newRouter);
+
+    /**
+     * @brief Returns the next road on the route to the destination.
+     * A vehicle with a precomputed route follows it; otherwise, or once it is off
+     * that route, the next road comes from the road graph.
+     * @return The next road, or nullptr if the vehicle has no route, is on its
+     *         destination or cannot reach it.
+     */
+    Road* getNextRoad() const;
+
     /**
      * @brief Determines if the vehicle should wait at a bus stop.
      * @param stopPos Position of the bus stop.
      * @param waitDuration Duration to wait at the stop.
+     * @param dt Length of the step in seconds.
      * @return True if the vehicle is waiting, false otherwise.
      * @pre stopPos >= 0
      * @pre waitDuration >= 0
      */
-    bool shouldWaitAt(double stopPos, double waitDuration);
+    bool shouldWaitAt(double stopPos, double waitDuration, double dt);
+
+    /** @brief Returns the position of the bus stop being served, or -1 if none. */
+    double getWaitStop() const;
+
+    /** @brief Returns the seconds waited at getWaitStop(). */
+    double getWaitTime() const;
+
+    /**
+     * @brief Restores the bus stop being served, e.g. for a vehicle handed over by another process.
+     * @param stop Position of the stop, or -1 for none.
+     * @param waited Seconds already waited there.
+     * @pre waited >= 0
+     * @post getWaitStop() == stop && getWaitTime() == waited
+     */
+    void setWait(double stop, double waited);
+
+    /** @brief Returns the length of the vehicle in metres. */
+    double getLength() const;
+
+    /** @brief Returns the registry handle of the vehicle, or 0 if it is not registered. */
+    std::uint32_t getHandle() const;
+
+    /** @brief Returns the stable id of the vehicle, or 0 if it is not registered. */
+    std::uint32_t getId() const;
+
+    /**
+     * @brief Records the registry handle and stable id assigned by the Simulation.
+     * @param newHandle Handle in the simulation's vehicle registry.
+     * @param newId Id that stays the same for the whole run.
+     * @post getHandle() == newHandle
+     * @post getId() == newId
+     */
+    void setRegistration(std::uint32_t newHandle, std::uint32_t newId);
 
 protected:
     std::string type;
 
 private:
+    /** @brief Car-following acceleration behind leader (nullptr for a free lane), without traffic lights. */
+    double followingAcceleration(const Vehicle* leader) const;
+
+    /** @brief Car-following acceleration behind a leader at the given position and speed. */
+    double followingAcceleration(double leaderPosition, double leaderSpeed) const;
+
+    /** @brief Acceleration on a free lane. */
+    double freeAcceleration() const;
+
+    /** @brief Applies the red-light braking rule to a proposed acceleration. */
+    double limitForTrafficLights(double proposed) const;
+
     BusStop* bus;
     Road* road;
     double position;
     double speed;
     double acceleration;
     const double vmax;
+    int lane;
+    const Road* destination;
+    const RoadGraph* router;
+    std::shared_ptr<const std::vector<Road*>> route;
+    std::size_t routeIndex;   ///< Index of road in route, or route->size() once off the route.
+    std::uint32_t handle;
+    std::uint32_t id;
+    double waitStop;    ///< Position of the bus stop being served, or -1.
+    double waitTimer;   ///< Seconds waited at waitStop.
 };
 
 /**
@@ -120,6 +312,7 @@ private:
 class Auto : public Vehicle {
 public:
     Auto(Road* road, double position);
+    Vehicle* clone() const override;
 };
 
 /**
@@ -129,6 +322,7 @@ public:
 class Bus : public Vehicle {
 public:
     Bus(Road* road, double position);
+    Vehicle* clone() const override;
 };
 
 /**
@@ -138,6 +332,7 @@ public:
 class Combi : public Vehicle {
 public:
     Combi(Road* road, double position);
+    Vehicle* clone() const override;
 };
 
 /**
@@ -147,6 +342,7 @@ public:
 class Ziek : public Vehicle {
 public:
     Ziek(Road* road, double position);
+    Vehicle* clone() const override;
 };
 
 /**
@@ -156,6 +352,7 @@ public:
 class Brand : public Vehicle {
 public:
     Brand(Road* road, double position);
+    Vehicle* clone() const override;
 };
 
 #endif // VEHICLE_H
@@ -2,6 +2,8 @@
 #include "Road.h"
 #include "Vehicle.h"
 #include "DesignByContract.h"
+#include "SimulationStats.h"
+#include "CloneMap.h"
 
 /**
  * @brief Constructs a VehicleGenerator object.
@@ -14,7 +16,7 @@
  * @param vehicleType String representing the type of vehicle to generate (must be valid).
  */
 VehicleGenerator::VehicleGenerator(Road* road, int frequency, const std::string& vehicleType)
-    : road(road), frequency(frequency), lastGenerated(0), type(vehicleType) 
+    : road(road), destination(nullptr), frequency(frequency), lastGenerated(0), type(vehicleType) 
 {
     REQUIRE(road != nullptr, "road must not be null");
     REQUIRE(frequency > 0, "frequency must be positive");
@@ -34,58 +36,47 @@ VehicleGenerator::VehicleGenerator(Road* road, int frequency, const std::string&
  * 
  * Checks if enough time has passed since the last vehicle generation according to frequency.
  * Also verifies that the start of the road is clear to avoid overlapping vehicles.
- * If conditions are met, creates a new vehicle of the specified type at position zero and adds it to the road.
+ * If conditions are met, creates a new vehicle of the specified type at position zero in the
+ * rightmost free lane and adds it to the road.
  * 
  * @param currentTime The current simulation time (must be >= lastGenerated).
+ * @return Vehicle* The newly created vehicle, or nullptr if none was generated.
  */
-void VehicleGenerator::update(double currentTime) {
+Vehicle* VehicleGenerator::update(double currentTime) {
     REQUIRE(currentTime >= 0.0, "currentTime must be non-negative");
     REQUIRE(currentTime >= lastGenerated, "time must not go backwards");
     REQUIRE(road != nullptr, "road must still be valid");
     
-    size_t initialVehicleCount = road->getVehicles().size();
-    double oldLastGenerated = lastGenerated;
+    CONTRACT_OLD(size_t, initialVehicleCount, road->getVehicles().size());
+    CONTRACT_OLD(double, oldLastGenerated, lastGenerated);
     
     if (currentTime - lastGenerated >= frequency) {
-        bool canGenerate = true;
         double vehicleLength = 4.0;
 
-        // Check if the first ~2 vehicle lengths of the road are clear
-        for (auto* vehicle : road->getVehicles()) {
-            REQUIRE(vehicle != nullptr, "all vehicles in road must be valid");
-            double vehiclePosition = vehicle->getPosition();
-            if (vehiclePosition > 0 && vehiclePosition < 2 * vehicleLength) {
-                canGenerate = false;
-                break;
-            }
-        }
+        // Use the rightmost lane whose first ~2 vehicle lengths are clear
+        int freeLane = road->findFreeEntryLane(2 * vehicleLength);
+        bool canGenerate = freeLane >= 0;
         
         if (canGenerate) {
-            Vehicle* v = nullptr;
-
-            if (type == "auto") {
-                v = new Auto(road, 0);
-            } else if (type == "bus") {
-                v = new Bus(road, 0);
-            } else if (type == "politiecombi") {
-                v = new Combi(road, 0);
-            } else if (type == "ziekenwagen") {
-                v = new Ziek(road, 0);
-            } else if (type == "brandweerwagen") {
-                v = new Brand(road, 0);
-            }
+            Vehicle* v = Vehicle::create(type, road, 0);
             
             REQUIRE(v != nullptr, "vehicle creation must succeed for valid types");
             REQUIRE(v->getRoad() == road, "new vehicle must be on the correct road");
             REQUIRE(v->getPosition() == 0, "new vehicle must start at position 0");
             
+            v->setLane(freeLane);
+            v->setDestination(destination);
             road->addVehicle(v);
             lastGenerated = currentTime;
+            SimulationStats::current().vehiclesSpawned++;
             
             ENSURE(road->getVehicles().size() == initialVehicleCount + 1, 
                    "exactly one vehicle must be added");
             ENSURE(lastGenerated == currentTime, "last generated time must be updated");
+            return v;
         } else {
+            SimulationStats::current().spawnsBlocked++;
+
             ENSURE(road->getVehicles().size() == initialVehicleCount, 
                    "no vehicles should be added when generation blocked");
             ENSURE(lastGenerated == oldLastGenerated, 
@@ -97,4 +88,61 @@ void VehicleGenerator::update(double currentTime) {
         ENSURE(lastGenerated == oldLastGenerated, 
                "last generated time should not change when frequency not met");
     }
+    return nullptr;
+}
+
+/**
+ * @brief Sets the destination of generated vehicles.
+ * 
+ * @param newDestination Destination road, or nullptr.
+ */
+void VehicleGenerator::setDestination(const Road* newDestination) {
+    destination = newDestination;
+    ENSURE(destination == newDestination, "destination must be properly set");
+}
+
+/**
+ * @brief Returns the destination of generated vehicles.
+ * 
+ * @return Destination road, or nullptr.
+ */
+const Road* VehicleGenerator::getDestination() const {
+    return destination;
+}
+
+/**
+ * @brief Returns the road the vehicles are generated on.
+ * 
+ * @return The road.
+ */
+Road* VehicleGenerator::getRoad() const {
+    return road;
+}
+
+/**
+ * @brief Returns the generation interval.
+ * 
+ * @return Seconds between two generated vehicles.
+ */
+int VehicleGenerator::getFrequency() const {
+    return frequency;
+}
+
+/**
+ * @brief Changes the generation interval.
+ * @param newFrequency Seconds between two vehicles.
+ */
+void VehicleGenerator::setFrequency(int newFrequency) {
+    REQUIRE(newFrequency > 0, "Frequency must be positive");
+    frequency = newFrequency;
+    ENSURE(getFrequency() == newFrequency, "Frequency was not set");
+}
+
+/**
+ * @brief Replaces the road and destination of a copied generator by their copies.
+ * @param map Originals to copies.
+ */
+void VehicleGenerator::rebind(const CloneMap& map) {
+    road = map(road);
+    destination = map(destination);
 }
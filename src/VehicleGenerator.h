@@ -4,6 +4,8 @@
 #include <string>
 
 class Road;
+class Vehicle;
+class CloneMap;
 
 /**
  * @class VehicleGenerator
@@ -29,13 +31,46 @@ public:
     /**
      * @brief Updates the generator state; may spawn a vehicle if conditions allow.
      * @param currentTime Current simulation time (monotonically increasing).
+     * @return The vehicle that was created and added to the road, or nullptr.
+     *         The caller takes ownership of the new vehicle.
      * @pre currentTime >= lastGenerated
      * @post possibly creates a new vehicle if frequency interval elapsed and road start is free
      */
-    void update(double currentTime);
+    Vehicle* update(double currentTime);
+
+    /**
+     * @brief Gives every vehicle generated from now on a destination.
+     * @param newDestination Road the vehicles drive to, or nullptr for unrouted vehicles.
+     * @post getDestination() == newDestination
+     */
+    void setDestination(const Road* newDestination);
+
+    /** @brief Returns the destination of generated vehicles, or nullptr. */
+    const Road* getDestination() const;
+
+    /** @brief Returns the road the vehicles are generated on. */
+    Road* getRoad() const;
+
+    /** @brief Returns the time between two generated vehicles in seconds. */
+    int getFrequency() const;
+
+    /**
+     * @brief Changes the time between two generated vehicles.
+     * @param newFrequency Interval in seconds.
+     * @pre newFrequency > 0
+     * @post getFrequency() == newFrequency
+     */
+    void setFrequency(int newFrequency);
+
+    /**
+     * @brief Points a copied generator at the copies of its road and destination.
+     * @param map Originals to copies.
+     */
+    void rebind(const CloneMap& map);
 
 private:
     Road* road;
+    const Road* destination;
     int frequency;
     double lastGenerated;
     std::string type;
@@ -0,0 +1,101 @@
+#include "WorkerPool.h"
+#include "DesignByContract.h"
+
+/**
+ * @brief Starts the helper threads, which wait for the first run().
+ *
+ * @param threads Total number of workers.
+ */
+WorkerPool::WorkerPool(int threads)
+    : task(nullptr), generation(0), running(0), stopping(false)
+{
+    REQUIRE(threads >= 1, "A pool needs at least one worker");
+    for (int worker = 1; worker < threads; worker++)
+        helpers.emplace_back(&WorkerPool::work, this, worker);
+    ENSURE(getThreadCount() == threads, "Pool must have the requested workers");
+}
+
+/**
+ * @brief Wakes the helpers so they exit, and joins them.
+ */
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    started.notify_all();
+    for (auto& helper : helpers)
+        helper.join();
+}
+
+/**
+ * @brief Returns the number of workers.
+ * @return Helper threads plus the calling thread.
+ */
+int WorkerPool::getThreadCount() const {
+    return static_cast<int>(helpers.size()) + 1;
+}
+
+/**
+ * @brief Publishes a task, runs worker 0 on the calling thread and waits for the helpers.
+ *
+ * @param job The task.
+ */
+void WorkerPool::run(const std::function<void(int)>& job) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        task = &job;
+        running = static_cast<int>(helpers.size());
+        error = nullptr;
+        generation++;
+    }
+    started.notify_all();
+
+    std::exception_ptr own;
+    try {
+        job(0);
+    } catch (...) {
+        own = std::current_exception();
+    }
+
+    std::unique_lock<std::mutex> lock(mutex);
+    finished.wait(lock, [this]() { return running == 0; });
+    task = nullptr;
+    if (own)
+        std::rethrow_exception(own);
+    if (error)
+        std::rethrow_exception(error);
+}
+
+/**
+ * @brief Waits for each new generation and runs its task.
+ *
+ * @param worker Index of this helper.
+ */
+void WorkerPool::work(int worker) {
+    unsigned long seen = 0;
+    while (true) {
+        const std::function<void(int)>* current;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            started.wait(lock, [this, seen]() { return stopping || generation != seen; });
+            if (stopping)
+                return;
+            seen = generation;
+            current = task;
+        }
+
+        std::exception_ptr failure;
+        try {
+            (*current)(worker);
+        } catch (...) {
+            failure = std::current_exception();
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (failure && !error)
+            error = failure;
+        if (--running == 0)
+            finished.notify_one();
+    }
+}
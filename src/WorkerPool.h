@@ -0,0 +1,59 @@
+#ifndef WORKERPOOL_H
+#define WORKERPOOL_H
+
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @class WorkerPool
+ * @brief Fixed set of threads that run one fork-join task at a time.
+ *
+ * run() hands the same task to every worker and returns once all of them have
+ * finished it. The calling thread takes part as worker 0, so a pool of one
+ * thread starts no threads at all.
+ */
+class WorkerPool {
+public:
+    /**
+     * @brief Starts threads - 1 helper threads.
+     * @param threads Number of workers, including the caller of run().
+     * @pre threads >= 1
+     */
+    explicit WorkerPool(int threads);
+
+    /** @brief Stops and joins the helper threads. */
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    /** @brief Returns the number of workers. */
+    int getThreadCount() const;
+
+    /**
+     * @brief Runs task(worker) on every worker and waits for all of them.
+     * @param task Function called once per worker index, concurrently.
+     * @throws The first exception thrown by any worker, after all have finished.
+     */
+    void run(const std::function<void(int)>& task);
+
+private:
+    /** @brief Loop of helper thread worker. */
+    void work(int worker);
+
+    std::vector<std::thread> helpers;
+    std::mutex mutex;
+    std::condition_variable started;
+    std::condition_variable finished;
+    const std::function<void(int)>* task;
+    unsigned long generation;  ///< Incremented for every run().
+    int running;               ///< Helpers still busy with the current run().
+    bool stopping;
+    std::exception_ptr error;
+};
+
+#endif // WORKERPOOL_H
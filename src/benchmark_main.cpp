@@ -0,0 +1,134 @@
+#include "Benchmark.h"
+#include "Trace.h"
+#include "DesignByContract.h"
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Prints the command line usage of the benchmark driver.
+ */
+static void printUsage() {
+    std::cerr << "Usage: TrafficSimulatorBench [--steps N] [--warmup N] [--out results.json]\n"
+              << "                             [--baseline baseline.json] [--threshold 0.10]\n"
+              << "                             [--trace trace.json] [--threads N] [--audit 0.01]\n"
+              << "                             scenario.xml...\n";
+}
+
+/**
+ * @brief Entry point of the macro benchmark driver.
+ *
+ * Runs every scenario given on the command line with output disabled, writes the
+ * results as JSON (to --out or standard output) and, when a baseline is given,
+ * compares the throughput against it. With --trace the profiling spans recorded
+ * during the runs are written as Chrome trace-event JSON (requires a build with
+ * TRAFFICSIM_TRACING). With --audit the given fraction of the steps checks every
+ * contract in a build with cheap contracts (see contracts::setAuditRate()).
+ *
+ * @return int 0 on success, 1 if a scenario regressed past the threshold, 2 on usage, scenario or output errors.
+ */
+int main(int argc, char** argv) {
+    int steps = 10000;
+    int warmup = 100;
+    double threshold = 0.10;
+    int threads = 1;
+    double auditRate = 0;
+    std::string outFile;
+    std::string baselineFile;
+    std::string traceFile;
+    std::vector<std::string> scenarios;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--steps" && hasValue) {
+            steps = std::atoi(argv[++i]);
+        } else if (arg == "--warmup" && hasValue) {
+            warmup = std::atoi(argv[++i]);
+        } else if (arg == "--out" && hasValue) {
+            outFile = argv[++i];
+        } else if (arg == "--baseline" && hasValue) {
+            baselineFile = argv[++i];
+        } else if (arg == "--trace" && hasValue) {
+            traceFile = argv[++i];
+        } else if (arg == "--threads" && hasValue) {
+            threads = std::atoi(argv[++i]);
+        } else if (arg == "--audit" && hasValue) {
+            auditRate = std::atof(argv[++i]);
+        } else if (arg == "--threshold" && hasValue) {
+            threshold = std::atof(argv[++i]);
+        } else if (arg == "--help" || arg.rfind("--", 0) == 0) {
+            printUsage();
+            return 2;
+        } else {
+            scenarios.push_back(arg);
+        }
+    }
+
+    if (scenarios.empty())
+        scenarios.push_back("../tests/test_files/test_input.xml");
+    if (steps <= 0 || warmup < 0 || threshold < 0 || threads < 1 || auditRate < 0 || auditRate > 1) {
+        printUsage();
+        return 2;
+    }
+
+    contracts::setAuditRate(auditRate);
+
+    Trace::setEnabled(!traceFile.empty());
+
+    Benchmark benchmark(steps, warmup, threads);
+    std::vector<Benchmark::Result> results;
+    try {
+        for (const auto& scenario : scenarios)
+            results.push_back(benchmark.runScenario(scenario));
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 2;
+    }
+
+    if (!traceFile.empty()) {
+        Trace::setEnabled(false);
+        std::ofstream trace(traceFile);
+        if (!trace) {
+            std::cerr << "Failed to open trace file: " << traceFile << std::endl;
+            return 2;
+        }
+        Trace::writeChromeJson(trace);
+        trace.close();
+        if (!trace) {
+            std::cerr << "Failed to write trace file: " << traceFile << std::endl;
+            return 2;
+        }
+    }
+
+    if (outFile.empty()) {
+        Benchmark::writeJson(std::cout, results);
+    } else {
+        std::ofstream out(outFile);
+        if (!out) {
+            std::cerr << "Failed to open results file: " << outFile << std::endl;
+            return 2;
+        }
+        Benchmark::writeJson(out, results);
+        out.close();
+        if (!out) {
+            std::cerr << "Failed to write results file: " << outFile << std::endl;
+            return 2;
+        }
+    }
+
+    if (!baselineFile.empty()) {
+        try {
+            bool ok = Benchmark::compareToBaseline(results, Benchmark::readBaseline(baselineFile),
+                                                   threshold, std::cerr);
+            return ok ? 0 : 1;
+        } catch (const std::exception& e) {
+            std::cerr << e.what() << std::endl;
+            return 2;
+        }
+    }
+    return 0;
+}
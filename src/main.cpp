@@ -6,6 +6,26 @@
 #include "VehicleGenerator.h"
 #include "BusStop.h"
 #include "Intersection.h"
+#include "OdDemand.h"
+#include "RoadPartitioner.h"
+#include "PartitionedRun.h"
+#include "Ensemble.h"
+#include "ParameterSweep.h"
+#include "SignalOptimizer.h"
+#include "GraphicsEngine.h"
+#include "RenderThread.h"
+#include "TelemetryServer.h"
+#include "Journal.h"
+#include "DesignByContract.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <thread>
 
 /**
  * @brief Entry point of the traffic simulation program.
@@ -14,13 +34,156 @@
  * - Loading a scenario XML file
  * - Parsing and constructing roads, vehicle generators, bus stops, and intersections
  * - Adding all components to the Simulation object
+ * - Optionally streaming an origin-destination demand file
  * - Running the main simulation loop
+ *
+ * With --partition k the roads are split into k partitions instead, and the
+ * assignment is saved next to the scenario (see RoadPartitioner::assignmentFile()).
+ * With --partitioned k the scenario runs for --steps steps (default 10000) in
+ * worker processes that each step part of the roads, and the final state of
+ * every vehicle is printed (see PartitionedRun); it cannot stream a demand. The
+ * assignment saved by --partition is used if there is one, otherwise the roads
+ * are split into k partitions.
+ * With --ensemble n up to n seeded replicas of --steps steps each (default 3600) run
+ * on all cores until their per-road estimates converge, and a JSON summary is printed
+ * instead of the simulation output. The replicas are clones without output, so
+ * every other option except --steps is refused.
+ * With --sweep file the parameter ranges in the file are run for --steps steps of the
+ * scenario's time step each (default 600 simulated seconds), as a Cartesian design or,
+ * with --lhs n, a Latin hypercube of n points drawn with --seed s (default 1), and the
+ * results are printed as CSV (see ParameterSweep::load()). The points run on clones,
+ * which cannot stream a demand, so --demand is refused.
+ * With --optimize n the cycle and offset of every traffic light are searched for
+ * n generations on all cores, starting after a minute of warm-up, and the timing
+ * plan with the least delay over five minutes is printed (see SignalOptimizer); the
+ * candidates are clones, which cannot stream a demand, so --demand is refused.
+ * With --metrics file the flow, density and speed of every road are written to
+ * the CSV file for every --period seconds (default 60) of simulated time.
+ * With --frames prefix a PNG of the whole network is saved every simulated second;
+ * the frames are drawn on a separate thread, which skips frames it cannot keep up with.
+ * With --telemetry port (or unix:path) every step is streamed to WebSocket clients on
+ * this machine (see TelemetryServer).
+ * With --record file every turning draw, spawn and command of the run is written to
+ * a binary journal; with --replay file that run is repeated exactly, without output,
+ * and only the number of steps is printed (see Journal).
+ * With --audit f a fraction f of the steps checks every contract in a build with
+ * cheap contracts (see contracts::setAuditRate()); other builds ignore it.
+ *
+ * Usage: TrafficSimulator [scenario.xml] [--demand demand.csv] [--partition k]
+ *                         [--partitioned k [--steps n]] [--ensemble n [--steps n]]
+ *                         [--sweep sweep.txt [--steps n] [--lhs n [--seed s]]]
+ *                         [--optimize n] [--metrics metrics.csv [--period s]]
+ *                         [--frames prefix] [--telemetry port|unix:path] [--record journal | --replay journal]
+ *                         [--audit f]
  * 
- * @return int Returns 0 upon successful execution.
+ * @return int Returns 0 upon successful execution, 1 on invalid arguments.
  */
-int main() {
+int main(int argc, char* argv[]) {
     /// Path to the XML input file describing the simulation scenario.
     std::string filename = "../tests/test_files/test_input.xml";
+    /// Optional origin-destination demand file.
+    std::string demandFile;
+    /// Number of partitions to compute, or 0 to run the simulation.
+    int partitionCount = 0;
+    /// Number of worker processes of a partitioned run, or 0.
+    int workers = 0;
+    /// Steps of a partitioned run, of every ensemble replica or of every sweep point, or 0 for the mode's default.
+    int steps = 0;
+    /// Maximum number of ensemble replicas, or 0 to run a single simulation.
+    int replicas = 0;
+    /// Sweep file, the number of Latin hypercube points or 0 for a Cartesian design, and the seed of the draw.
+    std::string sweepFile;
+    int samples = 0;
+    std::uint32_t sweepSeed = 1;
+    /// Generations of signal optimization, or 0 to run the simulation.
+    int generations = 0;
+    /// Per-road metrics file, or empty, and its aggregation period in seconds.
+    std::string metricsFile;
+    double period = 60;
+    /// Path prefix of the rendered frames, or empty.
+    std::string framePrefix;
+    /// Telemetry port or Unix socket, or empty.
+    std::string telemetryAddress;
+    /// Journal to record the run into or to replay, or empty.
+    std::string recordFile;
+    std::string replayFile;
+    /// Fraction of the steps that checks every contract in a cheap contract build.
+    double auditRate = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--demand") == 0 && i + 1 < argc) {
+            demandFile = argv[++i];
+        } else if (std::strcmp(argv[i], "--partition") == 0 && i + 1 < argc && std::atoi(argv[i + 1]) > 0) {
+            partitionCount = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "--partitioned") == 0 && i + 1 < argc && std::atoi(argv[i + 1]) > 0) {
+            workers = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "--steps") == 0 && i + 1 < argc && std::atoi(argv[i + 1]) > 0) {
+            steps = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "--ensemble") == 0 && i + 1 < argc && std::atoi(argv[i + 1]) >= 2) {
+            replicas = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "--sweep") == 0 && i + 1 < argc) {
+            sweepFile = argv[++i];
+        } else if (std::strcmp(argv[i], "--lhs") == 0 && i + 1 < argc && std::atoi(argv[i + 1]) > 0) {
+            samples = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            sweepSeed = static_cast<std::uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        } else if (std::strcmp(argv[i], "--optimize") == 0 && i + 1 < argc && std::atoi(argv[i + 1]) > 0) {
+            generations = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "--metrics") == 0 && i + 1 < argc) {
+            metricsFile = argv[++i];
+        } else if (std::strcmp(argv[i], "--period") == 0 && i + 1 < argc && std::atof(argv[i + 1]) > 0) {
+            period = std::atof(argv[++i]);
+        } else if (std::strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            framePrefix = argv[++i];
+        } else if (std::strcmp(argv[i], "--telemetry") == 0 && i + 1 < argc) {
+            telemetryAddress = argv[++i];
+        } else if (std::strcmp(argv[i], "--record") == 0 && i + 1 < argc && replayFile.empty()) {
+            recordFile = argv[++i];
+        } else if (std::strcmp(argv[i], "--replay") == 0 && i + 1 < argc && recordFile.empty()) {
+            replayFile = argv[++i];
+        } else if (std::strcmp(argv[i], "--audit") == 0 && i + 1 < argc && std::atof(argv[i + 1]) >= 0
+                   && std::atof(argv[i + 1]) <= 1) {
+            auditRate = std::atof(argv[++i]);
+        } else if (argv[i][0] != '-') {
+            filename = argv[i];
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [scenario.xml] [--demand demand.csv] [--partition k]"
+                      << " [--partitioned k [--steps n]] [--ensemble n [--steps n]]"
+                      << " [--sweep sweep.txt [--steps n] [--lhs n [--seed s]]]"
+                      << " [--optimize n] [--metrics metrics.csv [--period s]]"
+                      << " [--frames prefix] [--telemetry port|unix:path] [--record journal | --replay journal]"
+                      << " [--audit f]" << std::endl;
+            return 1;
+        }
+    }
+    contracts::setAuditRate(auditRate);
+
+    /// Run an ensemble of replicas instead of one simulation.
+    if (replicas > 0) {
+        const char* refused = !demandFile.empty() ? "--demand"
+                              : partitionCount > 0 ? "--partition"
+                              : workers > 0 ? "--partitioned"
+                              : !sweepFile.empty() ? "--sweep"
+                              : generations > 0 ? "--optimize"
+                              : !metricsFile.empty() ? "--metrics"
+                              : !framePrefix.empty() ? "--frames"
+                              : !telemetryAddress.empty() ? "--telemetry"
+                              : !recordFile.empty() ? "--record"
+                              : !replayFile.empty() ? "--replay"
+                              : nullptr;
+        if (refused != nullptr) {
+            std::cerr << refused << " cannot be combined with --ensemble" << std::endl;
+            return 1;
+        }
+        Ensemble::Options options;
+        if (steps > 0)
+            options.steps = steps;
+        options.maxReplicas = replicas;
+        options.minReplicas = std::min(options.minReplicas, replicas);
+        options.threads = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+        Ensemble::writeJson(std::cout, Ensemble(filename, options).run());
+        return 0;
+    }
 
     /// Containers for the parsed simulation elements.
     std::vector<Road*> roads;
@@ -31,24 +194,139 @@ int main() {
     /// Parse all simulation elements from the scenario file.
     Parser::parseFile(filename, roads, generators, busStops, intersections);
 
-    /// Create the simulation instance.
+    /// Create the simulation instance and add all parsed elements to it.
     Simulation sim;
+    sim.addScenario(roads, generators, busStops, intersections);
+
+    /// Save a partition assignment instead of running.
+    if (partitionCount > 0) {
+        RoadPartitioner partitioner(sim);
+        std::vector<int> owners = partitioner.partition(partitionCount);
+        std::string assignment = RoadPartitioner::assignmentFile(filename);
+        RoadPartitioner::save(assignment, sim.getRoads(), owners);
+        std::cout << "Partition assignment written to " << assignment
+                  << " (cut weight " << partitioner.cutWeight(owners) << ")" << std::endl;
+        return 0;
+    }
+
+    /// Step the roads in worker processes and print where every vehicle ends up.
+    if (workers > 0) {
+        if (!demandFile.empty()) {
+            std::cerr << "--demand cannot be combined with --partitioned" << std::endl;
+            return 1;
+        }
+        if (steps == 0)
+            steps = 10000;
+        PartitionedRun run(sim, PartitionedRun::loadRoads(sim, filename, workers));
+        std::vector<VehicleState> states = run.run(steps);
+        std::cout << "Na " << steps << " stappen in " << run.getPartitionCount() << " partities" << std::endl;
+        for (const VehicleState& state : states) {
+            std::cout << "Voertuig " << state.id
+                      << std::endl
+                      << "-> baan: " << sim.getRoads()[state.road]->getName()
+                      << std::endl
+                      << "-> type: " << state.type
+                      << std::endl
+                      << "-> positie: " << static_cast<int>(std::round(state.position))
+                      << std::endl
+                      << "-> snelheid: " << std::round(state.speed * 10.0) / 10.0
+                      << std::endl
+                      << "-> rijstrook: " << state.lane
+                      << "\n" << std::endl;
+        }
+        return 0;
+    }
+
+    /// Run every point of a parameter sweep on a clone of the loaded scenario.
+    if (!sweepFile.empty()) {
+        if (!demandFile.empty()) {
+            std::cerr << "--demand cannot be combined with --sweep" << std::endl;
+            return 1;
+        }
+        ParameterSweep sweep(sim, ParameterSweep::load(sweepFile));
+        auto points = samples > 0 ? sweep.latinHypercube(samples, sweepSeed) : sweep.cartesian();
+        double seconds = steps > 0 ? steps * sim.getTimeStep() : 600;
+        int threads = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+        ParameterSweep::writeCsv(std::cout, sweep.getParameters(), sweep.run(points, seconds, threads));
+        return 0;
+    }
+
+    /// Search the signal timings on clones of the warmed-up scenario.
+    if (generations > 0) {
+        if (!demandFile.empty()) {
+            std::cerr << "--demand cannot be combined with --optimize" << std::endl;
+            return 1;
+        }
+        SignalOptimizer::Settings settings;
+        settings.generations = generations;
+        settings.threads = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+        SignalOptimizer optimizer(sim, settings);
+        optimizer.write(std::cout, optimizer.optimize());
+        return 0;
+    }
+
+    /// Stream the demand, if any, once the network is complete.
+    if (!demandFile.empty())
+        sim.addDemand(new OdDemand(demandFile, sim.getRoads()));
+
+    /// Repeat a recorded run as fast as possible, without output.
+    if (!replayFile.empty()) {
+        std::ifstream journalIn(replayFile, std::ios::binary);
+        if (!journalIn) {
+            std::cerr << "Failed to open journal: " << replayFile << std::endl;
+            return 1;
+        }
+        Journal journal(journalIn);
+        sim.setJournal(&journal);
+        int steps = sim.replay();
+        std::cout << "Herhaald: " << steps << " stappen tot t = " << sim.currentTime << " s" << std::endl;
+        return 0;
+    }
 
-    /// Add all parsed roads to the simulation.
-    for (auto* road : roads)
-        sim.addRoad(road);
+    /// Record the decisions of the run.
+    std::ofstream journalOut;
+    std::unique_ptr<Journal> journal;
+    if (!recordFile.empty()) {
+        journalOut.open(recordFile, std::ios::binary);
+        if (!journalOut) {
+            std::cerr << "Failed to open journal: " << recordFile << std::endl;
+            return 1;
+        }
+        journal = std::make_unique<Journal>(journalOut);
+        sim.setJournal(journal.get());
+    }
 
-    /// Add all vehicle generators to the simulation.
-    for (auto* gen : generators)
-        sim.addGenerator(gen);
+    /// Write per-road aggregates while the simulation runs.
+    std::ofstream metricsOut;
+    if (!metricsFile.empty()) {
+        metricsOut.open(metricsFile);
+        if (!metricsOut) {
+            std::cerr << "Failed to open metrics file: " << metricsFile << std::endl;
+            return 1;
+        }
+        sim.setRoadMetrics(period, &metricsOut);
+    }
 
-    /// Add all bus stops to the simulation.
-    for (auto* bs : busStops)
-        sim.addBusStop(bs);
+    /// Save frames of the whole network while the simulation runs.
+    GraphicsEngine engine;
+    std::unique_ptr<RenderThread> renderer;
+    if (!framePrefix.empty()) {
+        engine.fitViewport(sim.getRoads());
+        renderer = std::make_unique<RenderThread>(engine, [&framePrefix](const GraphicsEngine& frame, const FrameSnapshot&, int number) {
+            std::string digits = std::to_string(number);
+            frame.writePng(framePrefix + std::string(digits.size() < 5 ? 5 - digits.size() : 0, '0') + digits + ".png");
+        });
+        sim.setFrameOutput(renderer.get(), 1.0);
+    }
 
-    /// Add all intersections to the simulation.
-    for (auto* isec : intersections)
-        sim.addIntersection(isec);
+    /// Stream every step to local telemetry clients.
+    std::unique_ptr<TelemetryServer> telemetry;
+    if (!telemetryAddress.empty()) {
+        telemetry = std::make_unique<TelemetryServer>(telemetryAddress);
+        sim.setTelemetry(telemetry.get());
+        std::cout << "Telemetry on " << (telemetry->getPort() > 0 ? "port " + std::to_string(telemetry->getPort())
+                                                                   : telemetryAddress) << std::endl;
+    }
 
     /// Run the simulation loop.
     sim.run();
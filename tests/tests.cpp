@@ -7,13 +7,48 @@
 #include "BusStop.h"
 #include "Intersection.h"
 #include "Parser.h"
+#include "Benchmark.h"
+#include "RoadGraph.h"
+#include "RouteCache.h"
+#include "OdDemand.h"
+#include "PartitionedRun.h"
+#include "RoadPartitioner.h"
+#include "RoadScheduler.h"
+#include "StreamingStats.h"
+#include "Ensemble.h"
+#include "ParameterSweep.h"
+#include "SimulationFork.h"
+#include "RewindBuffer.h"
+#include "Journal.h"
+#include "SignalOptimizer.h"
+#include "Detector.h"
+#include "RoadMetrics.h"
+#include "GraphicsEngine.h"
+#include "RenderThread.h"
+#include "TripleBuffer.h"
+#include "DeltaEncoder.h"
+#include "TelemetryServer.h"
+#include "Trace.h"
+#include "DesignByContract.h"
 #include <filesystem>
 #include <memory>
+#include <map>
 #include <fstream>
 #include <sstream>
+#include <iomanip>
 #include <iostream>
 #include <algorithm>
+#include <cmath>
 #include <functional>
+#include <random>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
 
 namespace fs = std::filesystem;
 const fs::path RES = fs::path("..") / "tests" / "test_files";
@@ -465,7 +500,7 @@ TEST_F(TrafficSimulationTest, ShouldSimulateValidBusStops) {
     auto bus = new Bus (road, 0);
     road->addVehicle(bus);
     sim->addVehicle(bus);
-    EXPECT_NO_THROW(bus->shouldWaitAt(250, 30));
+    EXPECT_NO_THROW(bus->shouldWaitAt(250, 30, sim->getTimeStep()));
 }
 
 TEST_F(TrafficSimulationTest, ShouldFailOnInvalidBusStopSimulation) {
@@ -497,6 +532,1713 @@ TEST_F(TrafficSimulationTest, ShouldFailOnInvalidIntersectionSimulation) {
     }
 }
 
+// BENCHMARK HARNESS
+
+TEST_F(TrafficSimulationTest, BenchmarkShouldMeasureScenarioSteps) {
+    Benchmark benchmark(50, 5);
+    Benchmark::Result result = benchmark.runScenario((RES / "05_vehicle_ok.xml").string());
+    EXPECT_EQ(result.steps, 50);
+    EXPECT_EQ(result.vehicleUpdates, 50);
+    EXPECT_GT(result.stepsPerSecond, 0);
+    EXPECT_FALSE(result.phases.empty());
+}
+
+TEST_F(TrafficSimulationTest, BenchmarkShouldDetectRegressionAgainstBaseline) {
+    Benchmark::Result result;
+    result.scenario = "scenario.xml";
+    result.stepsPerSecond = 800;
+
+    const std::string baselineFile = "benchmark_baseline_test.json";
+    {
+        Benchmark::Result baselineResult = result;
+        baselineResult.stepsPerSecond = 1000;
+        std::ofstream out(baselineFile);
+        Benchmark::writeJson(out, {baselineResult});
+    }
+    auto baseline = Benchmark::readBaseline(baselineFile);
+    fs::remove(baselineFile);
+    ASSERT_EQ(baseline.count("scenario.xml"), 1u);
+    EXPECT_DOUBLE_EQ(baseline["scenario.xml"], 1000);
+
+    std::ostringstream report;
+    EXPECT_FALSE(Benchmark::compareToBaseline({result}, baseline, 0.10, report));
+    EXPECT_TRUE(Benchmark::compareToBaseline({result}, baseline, 0.25, report));
+}
+
+// PROFILING SPANS
+
+TEST_F(TrafficSimulationTest, TraceShouldWriteChromeTraceEvents) {
+    Trace::clear();
+    Trace::setEnabled(true);
+    {
+        Trace::Span span("test-span");
+    }
+    Trace::setEnabled(false);
+    {
+        Trace::Span span("disabled-span");
+    }
+
+    std::ostringstream out;
+    Trace::writeChromeJson(out);
+    Trace::clear();
+    EXPECT_NE(out.str().find("\"traceEvents\""), std::string::npos);
+    EXPECT_NE(out.str().find("\"name\":\"test-span\",\"ph\":\"X\""), std::string::npos);
+    EXPECT_EQ(out.str().find("disabled-span"), std::string::npos);
+}
+
+// STATISTICS COUNTERS
+
+TEST_F(TrafficSimulationTest, StatsShouldCountSpawnsAndLightSwitches) {
+    sim = loadFromFile("07_vgenerator_ok.xml");
+    for (int i = 0; i < 700; i++)
+        sim->runStep();
+    SimulationStats stats = sim->getStats();
+    EXPECT_GE(stats.vehiclesSpawned, 1u);
+    EXPECT_GT(stats.leaderLookups, 0u);
+    EXPECT_GT(stats.phaseSeconds[SimulationStats::PHASE_ROADS], 0);
+
+    sim = loadFromFile("03_tlight_ok.xml");
+    for (int i = 0; i < 1875; i++)
+        sim->runStep();
+    EXPECT_EQ(sim->getStats().lightSwitches, 1u);
+    EXPECT_EQ(sim->getStats().vehiclesSpawned, 0u);
+
+    sim->resetStats();
+    EXPECT_EQ(sim->getStats().lightSwitches, 0u);
+}
+
+TEST_F(TrafficSimulationTest, StatsShouldMergeCountersOfAllThreads) {
+    StatsCollector collector;
+    auto work = [&collector]() {
+        StatsCollector::Scope scope(collector);
+        for (int i = 0; i < 1000; i++)
+            SimulationStats::current().leaderLookups++;
+    };
+    std::thread first(work);
+    std::thread second(work);
+    first.join();
+    second.join();
+    work();
+    EXPECT_EQ(collector.merged().leaderLookups, 3000u);
+}
+
+// CONTRACT LEVELS
+
+TEST_F(TrafficSimulationTest, ContractAuditShouldSampleRequestedFractionOfSteps) {
+    contracts::setAuditRate(0.25);
+    int audited = 0;
+    for (long step = 0; step < 100; step++) {
+        contracts::beginStep(step);
+        if (contracts::auditStep)
+            audited++;
+    }
+    EXPECT_EQ(audited, 25);
+
+    contracts::setAuditRate(0);
+    contracts::beginStep(7);
+    EXPECT_FALSE(contracts::auditStep);
+}
+
+TEST_F(TrafficSimulationTest, ContractAuditShouldBeDecidedPerThread) {
+    contracts::setAuditRate(0.5);
+    contracts::beginStep(1);
+    ASSERT_TRUE(contracts::auditStep);
+
+    bool otherStep = true;
+    bool helping = false;
+    std::thread other([&]() {
+        contracts::beginStep(0);  // another simulation's step that is not audited
+        otherStep = contracts::auditStep;
+        contracts::AuditScope scope(true);
+        helping = contracts::auditStep;
+    });
+    other.join();
+    EXPECT_FALSE(otherStep);
+    EXPECT_TRUE(helping);
+    EXPECT_TRUE(contracts::auditStep);
+
+    {
+        contracts::AuditScope scope(false);
+        EXPECT_FALSE(contracts::auditStep);
+    }
+    EXPECT_TRUE(contracts::auditStep);
+    contracts::setAuditRate(0);
+    contracts::beginStep(0);
+}
+
+// ENTITY REGISTRY
+
+TEST_F(TrafficSimulationTest, SlotMapShouldRejectStaleHandles) {
+    SlotMap<int> map;
+    Handle first = map.insert(new int(1));
+    Handle second = map.insert(new int(2));
+    map.erase(first);
+    EXPECT_EQ(map.get(first), nullptr);
+    EXPECT_EQ(*map.get(second), 2);
+
+    Handle reused = map.insert(new int(3));
+    EXPECT_NE(reused, first);
+    EXPECT_EQ(map.get(first), nullptr);
+    EXPECT_EQ(*map.get(reused), 3);
+    EXPECT_EQ(map.get(INVALID_HANDLE), nullptr);
+    EXPECT_EQ(map.size(), 2u);
+}
+
+TEST_F(TrafficSimulationTest, VehiclesShouldKeepTheirIdUntilTheyLeave) {
+    sim = loadFromFile("05_vehicle_ok.xml");
+    ASSERT_EQ(sim->getVehicles().size(), 1u);
+    Vehicle* vehicle = sim->getVehicles()[0];
+    std::uint32_t id = vehicle->getId();
+    Handle handle = vehicle->getHandle();
+    EXPECT_NE(id, 0u);
+    EXPECT_EQ(sim->findVehicleById(id), vehicle);
+    EXPECT_EQ(sim->addVehicle(vehicle), handle);
+
+    for (int i = 0; i < 100000 && !sim->getRoads()[0]->getVehicles().empty(); i++)
+        sim->runStep();
+
+    EXPECT_TRUE(sim->getVehicles().empty());
+    EXPECT_EQ(sim->getVehicle(handle), nullptr);
+    EXPECT_EQ(sim->findVehicleById(id), nullptr);
+}
+
+// MULTI-LANE ROADS
+
+TEST_F(TrafficSimulationTest, LanesShouldBeOrderedAndLeadersStayInLane) {
+    sim = loadFromFile("11_lanes_ok.xml");
+    Road* road = sim->getRoads()[0];
+    ASSERT_EQ(road->getLaneCount(), 3);
+    ASSERT_EQ(road->getLaneVehicles(0).size(), 2u);
+    EXPECT_TRUE(road->getLaneVehicles(1).empty());
+    ASSERT_EQ(road->getLaneVehicles(2).size(), 1u);
+
+    Vehicle* car = road->getLaneVehicles(0)[0];
+    Vehicle* bus = road->getLaneVehicles(0)[1];
+    Vehicle* leftCar = road->getLaneVehicles(2)[0];
+    EXPECT_EQ(car->getPosition(), 90);
+    EXPECT_EQ(bus->getType(), "bus");
+    EXPECT_EQ(road->getLeadingVehicle(car), bus);
+    EXPECT_EQ(road->getLeadingVehicle(leftCar), nullptr);
+
+    EXPECT_THROW(loadFromFile("11_lanes_bad.xml"), std::runtime_error);
+}
+
+TEST_F(TrafficSimulationTest, CarBehindSlowVehicleShouldChangeToFreeLane) {
+    sim = loadFromFile("11_lanes_ok.xml");
+    Road* road = sim->getRoads()[0];
+    Vehicle* car = road->getLaneVehicles(0)[0];
+    Vehicle* bus = road->getLaneVehicles(0)[1];
+    Vehicle* leftCar = road->getLaneVehicles(2)[0];
+
+    sim->runStep();
+    EXPECT_EQ(car->getLane(), 1);
+    EXPECT_EQ(bus->getLane(), 0);
+    EXPECT_EQ(leftCar->getLane(), 2);
+    EXPECT_EQ(sim->getStats().laneChanges, 1u);
+    ASSERT_EQ(road->getLaneVehicles(1).size(), 1u);
+    EXPECT_EQ(road->getLaneVehicles(1)[0], car);
+    EXPECT_EQ(road->getLeadingVehicle(car), nullptr);
+}
+
+TEST_F(TrafficSimulationTest, RoadShouldAccelerateFromStartOfStepPositions) {
+    // Before multi-lane roads each vehicle moved right after its acceleration, so
+    // a follower saw where its leader had already moved to in the same step and
+    // the result depended on the order the vehicles were added in.
+    Road* forward = new Road("Voorwaarts", 500, 1);
+    Road* backward = new Road("Achterwaarts", 500, 1);
+    Vehicle* follower = new Auto(forward, 10);
+    Vehicle* leader = new Auto(forward, 18);
+    forward->addVehicle(follower);
+    forward->addVehicle(leader);
+    Vehicle* leader2 = new Auto(backward, 18);
+    Vehicle* follower2 = new Auto(backward, 10);
+    backward->addVehicle(leader2);
+    backward->addVehicle(follower2);
+    sim->addRoad(forward);
+    sim->addRoad(backward);
+
+    for (int step = 0; step < 300; step++) {
+        sim->runStep();
+        ASSERT_EQ(follower->getPosition(), follower2->getPosition());
+        ASSERT_EQ(leader->getPosition(), leader2->getPosition());
+    }
+    EXPECT_GT(follower->getPosition(), 10);
+}
+
+TEST_F(TrafficSimulationTest, RoadShouldRemoveVehicleWhoseLaneWasSetDirectly) {
+    Road* road = new Road("A", 500, 2);
+    Vehicle* vehicle = new Auto(road, 50);
+    road->addVehicle(vehicle);
+    sim->addRoad(road);
+
+    vehicle->setLane(1);
+    road->removeVehicle(vehicle);
+    EXPECT_TRUE(road->getVehicles().empty());
+    EXPECT_TRUE(road->getLaneVehicles(0).empty());
+    EXPECT_TRUE(road->getLaneVehicles(1).empty());
+    road->addVehicle(vehicle);
+    EXPECT_EQ(road->getLaneVehicles(1).size(), 1u);
+}
+
+// ROAD CHAINING
+
+TEST_F(TrafficSimulationTest, LastVehicleShouldSeeQueueOnNextRoad) {
+    sim = loadFromFile("12_chain_ok.xml");
+    Road* ramp = sim->getRoads()[0];
+    ASSERT_EQ(ramp->getSuccessor(), sim->getRoads()[1]);
+    Vehicle* vehicle = ramp->getVehicles()[0];
+
+    sim->runStep();
+    EXPECT_LT(vehicle->getAcceleration(), 0);
+
+    EXPECT_THROW(loadFromFile("12_chain_bad.xml"), std::runtime_error);
+}
+
+TEST_F(TrafficSimulationTest, VehicleShouldContinueOnSuccessorRoad) {
+    Road* first = new Road("A", 100);
+    Road* second = new Road("B", 100);
+    first->addRoad(second);
+    Vehicle* vehicle = new Auto(first, 99);
+    first->addVehicle(vehicle);
+    sim->addRoad(first);
+    sim->addRoad(second);
+    std::uint32_t id = vehicle->getId();
+
+    for (int i = 0; i < 1000 && vehicle->getRoad() == first; i++)
+        sim->runStep();
+
+    ASSERT_EQ(vehicle->getRoad(), second);
+    EXPECT_LT(vehicle->getPosition(), 1);
+    EXPECT_TRUE(first->getVehicles().empty());
+    EXPECT_EQ(second->getVehicles().size(), 1u);
+    EXPECT_EQ(sim->findVehicleById(id), vehicle);
+    EXPECT_EQ(sim->getStats().vehiclesTransferred, 1u);
+    EXPECT_EQ(sim->getStats().vehiclesExited, 0u);
+}
+
+// ROUTING
+
+TEST_F(TrafficSimulationTest, RoadGraphShouldFindShortestRoute) {
+    sim = loadFromFile("13_routing_ok.xml");
+    const RoadGraph& graph = sim->getRoadGraph();
+    Road* a = sim->getRoads()[0];
+    Road* b = sim->getRoads()[1];
+    Road* c = sim->getRoads()[2];
+    Road* d = sim->getRoads()[3];
+    EXPECT_EQ(graph.getRoadCount(), 4);
+    EXPECT_EQ(graph.getEdgeCount(), 4);
+
+    EXPECT_EQ(graph.route(a, c), (std::vector<Road*>{a, d, c}));
+    EXPECT_DOUBLE_EQ(graph.distance(a, c), 200);
+    EXPECT_EQ(graph.nextRoad(a, b), b);
+    EXPECT_EQ(graph.nextRoad(c, c), nullptr);
+    EXPECT_EQ(graph.nextRoad(b, a), nullptr);
+    EXPECT_EQ(graph.distance(b, a), RoadGraph::UNREACHABLE);
+    EXPECT_TRUE(graph.route(b, a).empty());
+}
+
+TEST_F(TrafficSimulationTest, RoutedVehicleShouldFollowItsRoute) {
+    sim = loadFromFile("13_routing_ok.xml");
+    Vehicle* vehicle = sim->getVehicles()[0];
+    std::uint32_t id = vehicle->getId();
+    std::vector<const Road*> visited{vehicle->getRoad()};
+
+    for (int i = 0; i < 100000 && sim->findVehicleById(id) != nullptr; i++) {
+        sim->runStep();
+        if (sim->findVehicleById(id) != nullptr && vehicle->getRoad() != visited.back())
+            visited.push_back(vehicle->getRoad());
+    }
+
+    const std::vector<Road*>& roads = sim->getRoads();
+    EXPECT_EQ(visited, (std::vector<const Road*>{roads[0], roads[3], roads[2]}));
+    EXPECT_EQ(sim->getStats().vehiclesExited, 1u);
+}
+
+// OD DEMAND
+
+TEST_F(TrafficSimulationTest, RouteCacheShouldReuseAndEvictRoutes) {
+    sim = loadFromFile("13_routing_ok.xml");
+    const std::vector<Road*>& roads = sim->getRoads();
+    RouteCache cache(sim->getRoadGraph(), 2, 900);
+
+    auto first = cache.get(roads[0], roads[2], 0);
+    ASSERT_NE(first, nullptr);
+    EXPECT_EQ(*first, (Route{roads[0], roads[3], roads[2]}));
+    EXPECT_EQ(cache.get(roads[0], roads[2], 899), first);
+    EXPECT_EQ(cache.getHits(), 1u);
+    EXPECT_EQ(cache.get(roads[1], roads[0], 0), nullptr);
+
+    // A new departure bucket is a new entry and evicts the least recently used one
+    cache.get(roads[0], roads[2], 900);
+    EXPECT_EQ(cache.size(), 2u);
+    EXPECT_EQ(cache.getMisses(), 3u);
+    cache.get(roads[0], roads[2], 0);
+    EXPECT_EQ(cache.getMisses(), 4u);
+}
+
+TEST_F(TrafficSimulationTest, DemandShouldSpawnRoutedVehicles) {
+    sim = loadFromFile("13_routing_ok.xml");
+    const std::vector<Road*>& roads = sim->getRoads();
+    OdDemand* demand = new OdDemand((RES / "14_demand.csv").string(), roads);
+    ASSERT_EQ(demand->getHeaviestPairs().size(), 2u);
+    EXPECT_EQ(demand->getHeaviestPairs()[0].first, roads[0]);
+    EXPECT_EQ(demand->getHeaviestPairs()[0].second, roads[2]);
+    sim->addDemand(demand);
+    EXPECT_EQ(sim->getRouteCache().size(), 2u);
+
+    std::vector<const Road*> destinations;
+    std::uint32_t lastId = sim->getVehicles().back()->getId();
+    for (int i = 0; i < 100000 && !(demand->isFinished() && sim->getVehicles().empty()); i++) {
+        sim->runStep();
+        for (const Vehicle* vehicle : sim->getVehicles()) {
+            if (vehicle->getId() > lastId) {
+                destinations.push_back(vehicle->getDestination());
+                lastId = vehicle->getId();
+            }
+        }
+    }
+
+    EXPECT_TRUE(demand->isFinished());
+    EXPECT_EQ(std::count(destinations.begin(), destinations.end(), roads[2]), 4);
+    EXPECT_EQ(std::count(destinations.begin(), destinations.end(), roads[1]), 1);
+    EXPECT_EQ(sim->getStats().vehiclesExited, 6u);
+}
+
+TEST_F(TrafficSimulationTest, RoutedVehicleShouldTrackItsPlaceOnTheRoute) {
+    sim = loadFromFile("13_routing_ok.xml");
+    const std::vector<Road*>& roads = sim->getRoads();
+    Vehicle* vehicle = new Auto(roads[0], 0);
+    vehicle->setRoute(std::make_shared<const Route>(Route{roads[0], roads[3], roads[2]}));
+    EXPECT_EQ(vehicle->getNextRoad(), roads[3]);
+    vehicle->setRoad(roads[3]);
+    EXPECT_EQ(vehicle->getNextRoad(), roads[2]);
+    vehicle->setRoad(roads[2]);
+    EXPECT_EQ(vehicle->getNextRoad(), nullptr);
+
+    // Back on the route after a detour, the vehicle finds its place again
+    vehicle->setRoad(roads[1]);
+    vehicle->setRoad(roads[3]);
+    EXPECT_EQ(vehicle->getNextRoad(), roads[2]);
+    delete vehicle;
+
+    EXPECT_TRUE(Vehicle::isKnownType("ziekenwagen"));
+    EXPECT_FALSE(Vehicle::isKnownType("fiets"));
+}
+
+TEST_F(TrafficSimulationTest, DemandShouldRejectUnorderedRows) {
+    sim = loadFromFile("13_routing_ok.xml");
+    EXPECT_THROW(OdDemand((XML_TESTFILES / "14_demand_bad.csv").string(), sim->getRoads()), std::runtime_error);
+    EXPECT_THROW(OdDemand((RES / "missing.csv").string(), sim->getRoads()), std::runtime_error);
+}
+
+// PARTITIONED RUNS
+
+TEST_F(TrafficSimulationTest, PartitionAssignmentShouldKeepIntersectionsTogether) {
+    sim = loadFromFile("13_routing_ok.xml");
+    std::vector<int> owners = PartitionedRun::assignRoads(*sim, 3);
+    ASSERT_EQ(owners.size(), 4u);
+    EXPECT_EQ(owners[0], owners[3]);  // A and D share an intersection
+    EXPECT_NE(owners[1], owners[2]);
+    EXPECT_EQ(PartitionedRun(*sim, owners).getPartitionCount(), 3);
+}
+
+TEST_F(TrafficSimulationTest, PartitionedRunShouldMatchSingleProcess) {
+    const int steps = 3000;
+    sim = loadFromFile("15_partition_ok.xml");
+    for (int i = 0; i < steps; i++)
+        sim->runStep();
+    std::vector<VehicleState> expected = PartitionedRun::captureStates(*sim);
+    ASSERT_FALSE(expected.empty());
+
+    for (int partitions : {2, 4}) {
+        auto partitioned = loadFromFile("15_partition_ok.xml");
+        PartitionedRun run(*partitioned, PartitionedRun::assignRoads(*partitioned, partitions));
+        EXPECT_EQ(run.run(steps), expected) << partitions << " partitions";
+    }
+}
+
+TEST_F(TrafficSimulationTest, PartitionedRunShouldKeepIdsRoutesAndStopsAcrossBoundaries) {
+    // Intersections, generators on several partitions, bus stops and a precomputed route
+    const int steps = 4000;
+    const std::string file = "18_partition_intersections_ok.xml";
+    auto load = [&file]() {
+        std::srand(5);  // the same intersection seeds for every load
+        auto loaded = loadFromFile(file);
+        const std::vector<Road*>& roads = loaded->getRoads();
+        Vehicle* routed = new Auto(roads[4], 20);
+        roads[4]->addVehicle(routed);
+        loaded->addVehicle(routed);
+        routed->setRoute(std::make_shared<const std::vector<Road*>>(
+            std::vector<Road*>{roads[4], roads[2], roads[3], roads[0], roads[1]}));
+        return loaded;
+    };
+
+    sim = load();
+    for (int i = 0; i < steps; i++)
+        sim->runStep();
+    std::vector<VehicleState> expected = PartitionedRun::captureStates(*sim);
+    ASSERT_FALSE(expected.empty());
+    EXPECT_GT(sim->getStats().vehiclesTransferred, 0u);
+
+    for (int partitions : {2, 3}) {
+        auto partitioned = load();
+        std::vector<int> owners = PartitionedRun::assignRoads(*partitioned, partitions);
+        EXPECT_NE(*std::min_element(owners.begin(), owners.end()), *std::max_element(owners.begin(), owners.end()));
+        PartitionedRun run(*partitioned, owners);
+        EXPECT_EQ(run.run(steps), expected) << partitions << " partitions";
+    }
+}
+
+TEST_F(TrafficSimulationTest, PartitionerShouldCutOnlyTheBridgeBetweenTwoRings) {
+    // Two rings of ten roads, joined by one bridge road from the first to the second
+    sim = std::make_unique<Simulation>();
+    std::vector<Road*> roads;
+    for (int i = 0; i < 20; i++) {
+        roads.push_back(new Road("R" + std::to_string(i), 200));
+        roads.back()->addVehicle(new Auto(roads.back(), 50));
+    }
+    for (int i = 0; i < 20; i++)
+        roads[i]->addRoad(roads[(i % 10 == 9) ? i - 9 : i + 1]);
+    roads[4]->addRoad(roads[15]);
+    for (Road* road : roads)
+        sim->addRoad(road);
+
+    RoadPartitioner partitioner(*sim);
+    std::vector<int> owners = partitioner.partition(2);
+    for (int i = 1; i < 10; i++) {
+        EXPECT_EQ(owners[i], owners[0]);
+        EXPECT_EQ(owners[10 + i], owners[10]);
+    }
+    EXPECT_NE(owners[0], owners[10]);
+
+    std::vector<double> loads = partitioner.partitionLoads(owners, 2);
+    EXPECT_DOUBLE_EQ(loads[0], loads[1]);
+
+    // Heavy profiled load on one road moves the balance point
+    std::vector<double> profiled(20, 1.0);
+    profiled[0] = 9.0;
+    partitioner.setLoads(profiled);
+    owners = partitioner.partition(2, 0.1);
+    loads = partitioner.partitionLoads(owners, 2);
+    EXPECT_LE(std::max(loads[0], loads[1]), 1.1 * 14);
+    EXPECT_GT(partitioner.cutWeight(owners), 0);
+}
+
+TEST_F(TrafficSimulationTest, PartitionAssignmentShouldRoundTripThroughItsFile) {
+    sim = loadFromFile("13_routing_ok.xml");
+    std::vector<int> owners = RoadPartitioner(*sim).partition(2);
+    std::string file = RoadPartitioner::assignmentFile("partition_roundtrip.xml");
+    EXPECT_EQ(file, "partition_roundtrip.xml.partities");
+
+    RoadPartitioner::save(file, sim->getRoads(), owners);
+    EXPECT_EQ(RoadPartitioner::load(file, sim->getRoads()), owners);
+
+    std::vector<Road*> fewer(sim->getRoads().begin(), sim->getRoads().end() - 1);
+    EXPECT_THROW(RoadPartitioner::load(file, fewer), std::runtime_error);
+    std::remove(file.c_str());
+}
+
+TEST_F(TrafficSimulationTest, PartitionedRunShouldUseTheSavedAssignment) {
+    sim = loadFromFile("13_routing_ok.xml");
+    const std::string scenario = "partition_saved.xml";
+    std::string file = RoadPartitioner::assignmentFile(scenario);
+    std::remove(file.c_str());
+    EXPECT_EQ(PartitionedRun::loadRoads(*sim, scenario, 3), PartitionedRun::assignRoads(*sim, 3));
+
+    std::vector<int> saved = {1, 0, 2, 1};
+    RoadPartitioner::save(file, sim->getRoads(), saved);
+    EXPECT_EQ(PartitionedRun::loadRoads(*sim, scenario, 2), saved);
+
+    RoadPartitioner::save(file, sim->getRoads(), {0, 1, 1, 1});  // splits the intersection of A and D
+    EXPECT_THROW(PartitionedRun::loadRoads(*sim, scenario, 2), std::runtime_error);
+    std::remove(file.c_str());
+}
+
+// PARALLEL STEP
+
+TEST_F(TrafficSimulationTest, ThreadedStepShouldMatchSerialStep) {
+    for (const std::string file : {"15_partition_ok.xml", "test_input.xml"}) {
+        loadFromFile(file);  // seeds the global generator, so both loads below draw the same intersection seeds
+        std::srand(11);
+        auto serial = loadFromFile(file);
+        std::srand(11);
+        auto threaded = loadFromFile(file);
+        threaded->setThreadCount(3, 50, 1.0);
+        ASSERT_EQ(threaded->getThreadCount(), 3);
+
+        for (int i = 0; i < 2000; i++) {
+            serial->runStep();
+            threaded->runStep();
+        }
+        EXPECT_EQ(PartitionedRun::captureStates(*threaded), PartitionedRun::captureStates(*serial)) << file;
+        EXPECT_EQ(threaded->getStats().vehiclesExited, serial->getStats().vehiclesExited) << file;
+        EXPECT_EQ(threaded->getStats().laneChanges, serial->getStats().laneChanges) << file;
+    }
+}
+
+TEST_F(TrafficSimulationTest, RoadSchedulerShouldRebalanceMeasuredCosts) {
+    sim = loadFromFile("15_partition_ok.xml");
+    RoadScheduler scheduler(2);
+    scheduler.build(sim->getRoads(), sim->getIntersections());
+    ASSERT_EQ(scheduler.getGroupCount(), 4);
+
+    // One group became much more expensive than the others
+    std::vector<double> costs{1, 1, 8, 1};
+    scheduler.rebalance({1, 1, 1, 1});
+    std::vector<double> before = scheduler.getWorkerCosts(costs);
+    EXPECT_DOUBLE_EQ(std::max(before[0], before[1]), 9);
+
+    int migrations = scheduler.getMigrations();
+    scheduler.rebalance(costs);
+    std::vector<double> after = scheduler.getWorkerCosts(costs);
+    EXPECT_DOUBLE_EQ(std::max(after[0], after[1]), 8);
+    EXPECT_GT(scheduler.getMigrations(), migrations);
+    EXPECT_NE(scheduler.getWorkerOf(2), scheduler.getWorkerOf(0));
+}
+
+// ENSEMBLE
+
+TEST_F(TrafficSimulationTest, StreamingEstimatorsShouldTrackMomentsAndQuantiles) {
+    std::vector<double> samples;
+    for (int i = 1; i <= 1001; i++)
+        samples.push_back(i);
+    std::shuffle(samples.begin(), samples.end(), std::minstd_rand(7));
+
+    RunningStats stats;
+    QuantileEstimator median(0.5);
+    QuantileEstimator p90(0.9);
+    for (double x : samples) {
+        stats.add(x);
+        median.add(x);
+        p90.add(x);
+    }
+    EXPECT_EQ(stats.getCount(), 1001);
+    EXPECT_DOUBLE_EQ(stats.getMean(), 501);
+    EXPECT_NEAR(stats.getVariance(), 1001.0 * 1002 / 12, 1e-6);
+    EXPECT_DOUBLE_EQ(stats.getMin(), 1);
+    EXPECT_DOUBLE_EQ(stats.getMax(), 1001);
+    EXPECT_NEAR(median.getValue(), 501, 20);
+    EXPECT_NEAR(p90.getValue(), 901, 20);
+
+    QuantileEstimator few(0.5);
+    few.add(3);
+    few.add(1);
+    few.add(2);
+    EXPECT_DOUBLE_EQ(few.getValue(), 2);
+}
+
+TEST_F(TrafficSimulationTest, EnsembleShouldNotDependOnThreadCount) {
+    Ensemble::Options options;
+    options.steps = 3000;
+    options.minReplicas = 4;
+    options.maxReplicas = 6;
+    options.relativeTolerance = 0;  // never converges, so all replicas run
+    Ensemble serial((RES / "test_input.xml").string(), options);
+    options.threads = 3;
+    Ensemble parallel((RES / "test_input.xml").string(), options);
+
+    Ensemble::Summary a = serial.run();
+    Ensemble::Summary b = parallel.run();
+    EXPECT_EQ(a.replicas, 6);
+    EXPECT_FALSE(a.converged);
+    ASSERT_EQ(a.roads.size(), b.roads.size());
+    double spread = 0;
+    for (std::size_t i = 0; i < a.roads.size(); i++) {
+        EXPECT_EQ(a.roads[i].road, b.roads[i].road);
+        EXPECT_EQ(a.roads[i].throughput.stats.getMean(), b.roads[i].throughput.stats.getMean());
+        EXPECT_EQ(a.roads[i].vehicles.stats.getVariance(), b.roads[i].vehicles.stats.getVariance());
+        EXPECT_EQ(a.roads[i].speed.median.getValue(), b.roads[i].speed.median.getValue());
+        spread += a.roads[i].vehicles.stats.getStandardDeviation();
+    }
+    EXPECT_GT(spread, 0) << "Replicas must differ in their turning choices";
+
+    std::vector<Ensemble::RoadSample> first = serial.runReplica(2);
+    std::vector<Ensemble::RoadSample> again = parallel.runReplica(2);
+    for (std::size_t i = 0; i < first.size(); i++)
+        EXPECT_EQ(first[i].vehicles, again[i].vehicles);
+}
+
+TEST_F(TrafficSimulationTest, EnsembleShouldStopOnceIntervalsConverge) {
+    Ensemble::Options options;
+    options.steps = 600;
+    options.minReplicas = 3;
+    options.maxReplicas = 50;
+    options.threads = 2;
+    options.relativeTolerance = 10;
+    Ensemble::Summary summary = Ensemble((RES / "test_input.xml").string(), options).run();
+    EXPECT_TRUE(summary.converged);
+    EXPECT_EQ(summary.replicas, 3);
+
+    std::ostringstream json;
+    Ensemble::writeJson(json, summary);
+    EXPECT_NE(json.str().find("\"converged\": true"), std::string::npos);
+    EXPECT_NE(json.str().find("\"name\": \"Middelheimlaan\""), std::string::npos);
+
+    EXPECT_THROW(Ensemble("missing.xml", options), std::runtime_error);
+}
+
+// PARAMETER SWEEP
+
+TEST_F(TrafficSimulationTest, CloneShouldEvolveLikeTheOriginal) {
+    sim = loadFromFile("test_input.xml");
+    for (int i = 0; i < 300; i++)
+        sim->runStep();
+    std::unique_ptr<Simulation> copy = sim->clone();
+    EXPECT_DOUBLE_EQ(copy->currentTime, sim->currentTime);
+    ASSERT_EQ(copy->getVehicles().size(), sim->getVehicles().size());
+    for (const Vehicle* vehicle : sim->getVehicles()) {
+        const Vehicle* twin = copy->findVehicleById(vehicle->getId());
+        ASSERT_NE(twin, nullptr);
+        EXPECT_NE(twin, vehicle);
+        EXPECT_EQ(twin->getType(), vehicle->getType());
+        EXPECT_EQ(twin->getRoad()->getName(), vehicle->getRoad()->getName());
+        EXPECT_NE(twin->getRoad(), vehicle->getRoad());
+    }
+
+    for (int i = 0; i < 1500; i++) {
+        sim->runStep();
+        copy->runStep();
+    }
+    EXPECT_EQ(PartitionedRun::captureStates(*copy), PartitionedRun::captureStates(*sim));
+}
+
+TEST_F(TrafficSimulationTest, DetectorShouldAggregateCrossingsPerInterval) {
+    sim = loadFromFile("17_detector_ok.xml");
+    ASSERT_EQ(sim->getDetectors().size(), 2u);
+    const Detector* loop = sim->getDetectors()[0];
+    EXPECT_EQ(loop->getName(), "lus1");
+    EXPECT_EQ(sim->getDetectors()[1]->getName(), "Meetbaan@900");
+
+    double length = sim->getVehicles()[0]->getLength();
+
+    // Record the speed of each vehicle in the step its front passes the loop
+    std::vector<double> speeds;
+    while (loop->getIntervals().size() < 2) {
+        ASSERT_LT(sim->currentTime, 61);
+        std::vector<std::pair<const Vehicle*, double>> before;
+        for (const Vehicle* vehicle : sim->getVehicles())
+            before.emplace_back(vehicle, vehicle->getPosition());
+        sim->runStep();
+        for (const auto& entry : before) {
+            double after = entry.first->getPosition();
+            if (entry.second < 300 && after >= 300)
+                speeds.push_back((after - entry.second) / sim->getTimeStep());
+        }
+    }
+
+    const Detector::Interval& first = loop->getIntervals()[0];
+    EXPECT_DOUBLE_EQ(first.start, 0);
+    EXPECT_NEAR(first.end, 30, sim->getTimeStep());
+    EXPECT_DOUBLE_EQ(loop->getIntervals()[1].start, first.end);
+
+    int crossings = first.crossings + loop->getIntervals()[1].crossings;
+    ASSERT_EQ(crossings, 2);
+    ASSERT_EQ(speeds.size(), 2u);
+    const Detector::Interval& measured = first.crossings == 2 ? first : loop->getIntervals()[1];
+    EXPECT_NEAR(measured.harmonicSpeed, 2 / (1 / speeds[0] + 1 / speeds[1]), 1e-9);
+    EXPECT_NEAR(measured.flow, 2 * 3600 / (measured.end - measured.start), 1e-9);
+
+    // Each vehicle covers one of the two lanes for about its length over its speed
+    double expected = 0;
+    for (double speed : speeds)
+        expected += length / speed;
+    double occupancy = (first.occupancy * (first.end - first.start)
+                        + loop->getIntervals()[1].occupancy * (loop->getIntervals()[1].end - first.end)) * 2;
+    EXPECT_NEAR(occupancy, expected, 0.05);
+}
+
+TEST_F(TrafficSimulationTest, DetectorShouldBeClonedAndReportedInTheOutput) {
+    sim = loadFromFile("17_detector_ok.xml");
+    while (sim->currentTime < 20)
+        sim->runStep();
+    std::unique_ptr<Simulation> copy = sim->clone();
+    ASSERT_EQ(copy->getDetectors().size(), 2u);
+    EXPECT_EQ(copy->getDetectors()[0]->getRoad(), copy->getRoads()[0]);
+    EXPECT_EQ(copy->getRoads()[0]->getDetectors().size(), 2u);
+
+    std::string output;
+    while (sim->getDetectors()[0]->getIntervals().empty()) {
+        sim->runStep();
+        copy->runStep();
+        testing::internal::CaptureStdout();
+        sim->outputState();
+        output = testing::internal::GetCapturedStdout();
+    }
+    EXPECT_NE(output.find("Detector lus1"), std::string::npos);
+    EXPECT_NE(output.find("Detector Meetbaan@900"), std::string::npos);
+    ASSERT_EQ(copy->getDetectors()[0]->getIntervals().size(), 1u);
+    EXPECT_EQ(copy->getDetectors()[0]->getIntervals()[0].crossings, sim->getDetectors()[0]->getIntervals()[0].crossings);
+    EXPECT_DOUBLE_EQ(copy->getDetectors()[0]->getIntervals()[0].occupancy, sim->getDetectors()[0]->getIntervals()[0].occupancy);
+}
+
+TEST_F(TrafficSimulationTest, DetectorShouldRejectInvalidPlacement) {
+    std::vector<Road*> roads;
+    std::vector<VehicleGenerator*> generators;
+    std::vector<BusStop*> busStops;
+    std::vector<Intersection*> intersections;
+    const std::string road = "<BAAN><naam>A</naam><lengte>100</lengte></BAAN>";
+    EXPECT_THROW(Parser::parseString(road + "<DETECTOR><baan>B</baan><positie>50</positie><interval>60</interval></DETECTOR>",
+                                     roads, generators, busStops, intersections), std::runtime_error);
+    EXPECT_THROW(Parser::parseString(road + "<DETECTOR><baan>A</baan><positie>150</positie><interval>60</interval></DETECTOR>",
+                                     roads, generators, busStops, intersections), std::runtime_error);
+    EXPECT_THROW(Parser::parseString(road + "<DETECTOR><baan>A</baan><positie>50</positie><interval>0</interval></DETECTOR>",
+                                     roads, generators, busStops, intersections), std::runtime_error);
+}
+
+TEST_F(TrafficSimulationTest, RoadMetricsShouldMatchPerVehicleSums) {
+    sim = loadFromFile("test_input.xml");
+    std::ostringstream csv;
+    sim->setRoadMetrics(20, &csv);
+    const std::vector<Road*>& roads = sim->getRoads();
+
+    // Sum the same quantities per vehicle, as post-processing a full dump would
+    std::vector<double> vehicleSeconds(roads.size(), 0);
+    std::vector<long long> countsBefore;
+    for (const Road* road : roads)
+        countsBefore.push_back(static_cast<long long>(road->getVehicles().size()));
+    int intervals = 0;
+    while (intervals == 0) {
+        for (std::size_t i = 0; i < roads.size(); i++)
+            vehicleSeconds[i] += roads[i]->getVehicles().size() * sim->getTimeStep();
+        sim->runStep();
+        intervals = sim->getRoadMetrics()->getLatest().empty() ? 0 : 1;
+    }
+
+    const std::vector<RoadMetrics::Aggregate>& latest = sim->getRoadMetrics()->getLatest();
+    ASSERT_EQ(latest.size(), roads.size());
+    for (std::size_t i = 0; i < roads.size(); i++) {
+        const RoadMetrics::Aggregate& aggregate = latest[i];
+        EXPECT_EQ(aggregate.road, roads[i]);
+        EXPECT_DOUBLE_EQ(aggregate.start, 0);
+        EXPECT_NEAR(aggregate.end, 20, sim->getTimeStep());
+        double seconds = aggregate.end - aggregate.start;
+        EXPECT_NEAR(aggregate.density, vehicleSeconds[i] / (seconds * roads[i]->getLength()) * 1000, 1e-9);
+        EXPECT_NEAR(aggregate.flow, aggregate.density * aggregate.speed * 3.6, 1e-6);
+        EXPECT_EQ(aggregate.entries - aggregate.exits,
+                  static_cast<long long>(roads[i]->getVehicles().size()) - countsBefore[i]);
+    }
+
+    // A header and one line per road
+    std::string text = csv.str();
+    EXPECT_EQ(text.rfind("begin,einde,baan", 0), 0u);
+    EXPECT_EQ(static_cast<std::size_t>(std::count(text.begin(), text.end(), '\n')), roads.size() + 1);
+}
+
+TEST_F(TrafficSimulationTest, RoadMetricsShouldCountVehiclesThroughAChain) {
+    sim = loadFromFile("12_chain_ok.xml");
+    sim->setRoadMetrics(1000);
+    long long vehicles = static_cast<long long>(sim->getVehicles().size());
+    while (!sim->getVehicles().empty() && sim->currentTime < 999)
+        sim->runStep();
+    ASSERT_TRUE(sim->getVehicles().empty());
+
+    // Every vehicle that entered a road left it again
+    long long exits = 0;
+    for (const Road* road : sim->getRoads()) {
+        EXPECT_EQ(road->getTotals().entries, road->getTotals().exits) << road->getName();
+        EXPECT_GT(road->getTotals().vehicleMetres, 0) << road->getName();
+        EXPECT_LE(road->getTotals().vehicleMetres,
+                  road->getTotals().entries * static_cast<double>(road->getLength()) + 1e-6) << road->getName();
+        exits += road->getTotals().exits;
+    }
+    EXPECT_EQ(exits, vehicles + 1);
+
+    // The vehicle on the on-ramp drove its last 5 metres there
+    EXPECT_NEAR(Road::getRoadByName("Oprit", sim->getRoads())->getTotals().vehicleMetres, 5, 1e-9);
+}
+
+TEST_F(TrafficSimulationTest, GraphicsEngineShouldDrawOnlyWhatIsInTheViewport) {
+    Road* a = new Road("A", 300, 2);
+    Road* b = new Road("B", 200);
+    Vehicle* car = new Auto(a, 100);
+    Vehicle* bus = new Bus(a, 150);
+    bus->setLane(1);
+    a->addVehicle(car);
+    a->addVehicle(bus);
+    a->addVehicle(new Auto(a, 250));
+    b->addVehicle(new Auto(b, 50));
+    TrafficLight* light = new TrafficLight(a, 200, 30);
+    a->addTrafficLight(light);
+    sim->addRoad(a);
+    sim->addRoad(b);
+
+    // One pixel per metre: road A covers rows 3.5 to 10.5, lane 1 starts at 7
+    GraphicsEngine engine(400, 100);
+    engine.render(sim->getRoads());
+    EXPECT_EQ(engine.getFrameStats().roads, 2);
+    EXPECT_EQ(engine.getFrameStats().vehicles, 4);
+    EXPECT_EQ(engine.getFrameStats().lights, 1);
+    EXPECT_EQ(engine.getPixel(97, 5), GraphicsEngine::vehicleColor(car));
+    EXPECT_EQ(engine.getPixel(147, 8), GraphicsEngine::vehicleColor(bus));
+    EXPECT_FALSE(GraphicsEngine::vehicleColor(car) == GraphicsEngine::vehicleColor(bus));
+    EXPECT_FALSE(engine.getPixel(20, 5) == engine.getPixel(20, 1));
+    GraphicsEngine::Color lightPixel = engine.getPixel(200, 5);
+    EXPECT_GT(light->isGreen() ? lightPixel.g : lightPixel.r, 200);
+
+    // Zoomed in around the bus, only the bus and road A are drawn
+    engine.setViewport(GraphicsEngine::Viewport{140, 0, 50, 12});
+    engine.render(sim->getRoads());
+    EXPECT_EQ(engine.getFrameStats().roads, 1);
+    EXPECT_EQ(engine.getFrameStats().vehicles, 1);
+    EXPECT_EQ(engine.getFrameStats().lights, 0);
+    EXPECT_EQ(engine.getPixel(60, 70), GraphicsEngine::vehicleColor(bus));
+}
+
+TEST_F(TrafficSimulationTest, GraphicsEngineShouldWritePpmAndPngFrames) {
+    sim = loadFromFile("test_input.xml");
+    GraphicsEngine engine(320, 240);
+    engine.fitViewport(sim->getRoads());
+    engine.render(sim->getRoads());
+    EXPECT_EQ(engine.getFrameStats().vehicles, static_cast<int>(sim->getVehicles().size()));
+
+    fs::path ppm = fs::temp_directory_path() / "traffic_frame.ppm";
+    fs::path png = fs::temp_directory_path() / "traffic_frame.png";
+    engine.writePpm(ppm.string());
+    engine.writePng(png.string());
+    EXPECT_EQ(fs::file_size(ppm), std::string("P6\n320 240\n255\n").size() + 320 * 240 * 3);
+
+    std::ifstream in(png, std::ios::binary);
+    std::vector<unsigned char> bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    ASSERT_GT(bytes.size(), 33u);
+    EXPECT_EQ(std::vector<unsigned char>(bytes.begin(), bytes.begin() + 8),
+              (std::vector<unsigned char>{0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'}));
+    EXPECT_EQ(bytes[18], 320 >> 8);
+    EXPECT_EQ(bytes[19], 320 & 0xFF);
+    // Raw rows with a filter byte each, in stored blocks of at most 65535 bytes
+    std::size_t raw = 240 * (320 * 3 + 1);
+    std::size_t blocks = (raw + 65534) / 65535;
+    EXPECT_EQ(bytes.size(), 8 + 25 + 12 + 2 + blocks * 5 + raw + 4 + 12);
+    // The IEND chunk has a fixed checksum
+    EXPECT_EQ(std::vector<unsigned char>(bytes.end() - 4, bytes.end()),
+              (std::vector<unsigned char>{0xAE, 0x42, 0x60, 0x82}));
+    fs::remove(ppm);
+    fs::remove(png);
+}
+
+TEST_F(TrafficSimulationTest, TripleBufferShouldHandOverOnlyTheNewestValue) {
+    TripleBuffer<std::pair<int, int>> buffer;
+    EXPECT_FALSE(buffer.acquire());
+    for (int i = 1; i <= 3; i++) {
+        buffer.back() = std::make_pair(i, -i);
+        buffer.publish();
+    }
+    ASSERT_TRUE(buffer.acquire());
+    EXPECT_EQ(buffer.front().first, 3);
+    EXPECT_FALSE(buffer.acquire());
+
+    // The reader never sees a torn value or one older than the last it took
+    TripleBuffer<std::pair<int, int>> shared;
+    const int count = 200000;
+    std::thread writer([&shared] {
+        for (int i = 1; i <= count; i++) {
+            shared.back().first = i;
+            shared.back().second = -i;
+            shared.publish();
+        }
+    });
+    int last = 0;
+    bool consistent = true;
+    while (last < count) {
+        if (shared.acquire()) {
+            consistent = consistent && shared.front().first == -shared.front().second && shared.front().first > last;
+            last = shared.front().first;
+        }
+    }
+    writer.join();
+    EXPECT_TRUE(consistent);
+}
+
+TEST_F(TrafficSimulationTest, RenderThreadShouldDrawPublishedSnapshots) {
+    sim = loadFromFile("test_input.xml");
+    GraphicsEngine engine(200, 100);
+    engine.fitViewport(sim->getRoads());
+
+    std::thread::id mainThread = std::this_thread::get_id();
+    std::atomic<bool> offThread(true);
+    std::atomic<int> lastVehicles(-1);
+    std::atomic<int> lastNumber(-1);
+    RenderThread renderer(engine, [&](const GraphicsEngine& frame, const FrameSnapshot& snapshot, int number) {
+        offThread = offThread && std::this_thread::get_id() != mainThread;
+        EXPECT_EQ(frame.getFrameStats().vehicles, static_cast<int>(snapshot.getVehicles().size()));
+        lastVehicles = static_cast<int>(snapshot.getVehicles().size());
+        lastNumber = number;
+    });
+    for (int i = 0; i < 600; i++) {
+        sim->runStep();
+        if (i % 10 == 0)
+            renderer.publish(sim->getRoads(), sim->currentTime);
+    }
+    int vehicles = static_cast<int>(sim->getVehicles().size());
+    renderer.publish(sim->getRoads(), sim->currentTime);
+    renderer.stop();
+
+    EXPECT_TRUE(offThread);
+    EXPECT_EQ(renderer.getPublished(), 61);
+    EXPECT_GE(renderer.getRendered(), 1);
+    EXPECT_LE(renderer.getRendered(), renderer.getPublished());
+    EXPECT_EQ(lastNumber, renderer.getRendered() - 1);
+    // The newest snapshot is always drawn before the thread ends
+    EXPECT_EQ(lastVehicles, vehicles);
+}
+
+TEST_F(TrafficSimulationTest, DeltaEncoderShouldSendOnlyChangedVehiclesOfSubscribedRoads) {
+    Road* a = new Road("A", 300);
+    Road* b = new Road("B", 200);
+    Vehicle* slow = new Auto(a, 100);
+    Vehicle* fast = new Auto(a, 150);
+    Vehicle* other = new Bus(b, 50);
+    a->addVehicle(slow);
+    a->addVehicle(fast);
+    b->addVehicle(other);
+    a->addTrafficLight(new TrafficLight(a, 250, 30));
+    sim->addRoad(a);
+    sim->addRoad(b);
+
+    auto count = [](const std::vector<std::uint8_t>& message, std::size_t offset) {
+        return message[offset] | (message[offset + 1] << 8) | (message[offset + 2] << 16) | (message[offset + 3] << 24);
+    };
+    FrameSnapshot snapshot;
+    snapshot.capture(sim->getRoads(), 0);
+    DeltaEncoder encoder(0.5, 0.5);
+    std::vector<std::uint8_t> first = encoder.encode(snapshot, 0);
+    EXPECT_EQ(first[12], 1);
+    EXPECT_EQ(count(first, 13), 3);
+    EXPECT_EQ(count(first, 21), 1);
+    EXPECT_EQ(first.size(), DeltaEncoder::HEADER_SIZE + 3 * DeltaEncoder::VEHICLE_SIZE + DeltaEncoder::LIGHT_SIZE);
+
+    // Below the quantization step nothing is sent
+    slow->setPosition(100.3);
+    snapshot.capture(sim->getRoads(), 1);
+    EXPECT_EQ(encoder.encode(snapshot, 1).size(), DeltaEncoder::HEADER_SIZE);
+
+    fast->setPosition(151);
+    slow->setSpeed(1);
+    snapshot.capture(sim->getRoads(), 2);
+    std::vector<std::uint8_t> delta = encoder.encode(snapshot, 2);
+    EXPECT_EQ(delta[12], 0);
+    EXPECT_EQ(count(delta, 13), 2);
+    EXPECT_EQ(count(delta, 17), 0);
+
+    // A subscription to B starts with B's full state, then reports the bus leaving
+    encoder.subscribe({1});
+    snapshot.capture(sim->getRoads(), 3);
+    std::vector<std::uint8_t> full = encoder.encode(snapshot, 3);
+    EXPECT_EQ(full[12], 1);
+    EXPECT_EQ(count(full, 13), 1);
+    EXPECT_EQ(count(full, 21), 0);
+    EXPECT_EQ(count(full, DeltaEncoder::HEADER_SIZE), static_cast<int>(other->getId()));
+    b->removeVehicle(other);
+    snapshot.capture(sim->getRoads(), 4);
+    std::vector<std::uint8_t> removal = encoder.encode(snapshot, 4);
+    EXPECT_EQ(count(removal, 13), 0);
+    ASSERT_EQ(count(removal, 17), 1);
+    EXPECT_EQ(count(removal, DeltaEncoder::HEADER_SIZE), static_cast<int>(other->getId()));
+    b->addVehicle(other);
+
+    // A vehicle keeping its speed is predicted by an extrapolating encoder, not by a plain one
+    DeltaEncoder plain(0.01, 0.01);
+    DeltaEncoder extrapolating(0.01, 0.01, true);
+    slow->setSpeed(0);
+    other->setSpeed(0);
+    fast->setSpeed(10);
+    snapshot.capture(sim->getRoads(), 5);
+    EXPECT_EQ(plain.encode(snapshot, 5)[12], 1);
+    EXPECT_EQ(extrapolating.encode(snapshot, 5)[12], 3);
+    fast->setPosition(fast->getPosition() + 10 * 0.5);
+    snapshot.capture(sim->getRoads(), 5.5);
+    EXPECT_EQ(count(plain.encode(snapshot, 6), 13), 1);
+    EXPECT_EQ(extrapolating.encode(snapshot, 6).size(), DeltaEncoder::HEADER_SIZE);
+    fast->setSpeed(8);
+    snapshot.capture(sim->getRoads(), 6);
+    EXPECT_EQ(count(extrapolating.encode(snapshot, 7), 13), 1);
+}
+
+TEST_F(TrafficSimulationTest, FrameSnapshotShouldCopyOnlyTheVehiclesOfSelectedRoads) {
+    Road* a = new Road("A", 300, 2);
+    Road* b = new Road("B", 200);
+    a->addVehicle(new Auto(a, 100));
+    b->addVehicle(new Auto(b, 50));
+    b->addTrafficLight(new TrafficLight(b, 150, 20));
+    sim->addRoad(a);
+    sim->addRoad(b);
+    const std::vector<Road*>& roads = sim->getRoads();
+
+    FrameSnapshot snapshot;
+    snapshot.capture(roads, 1.0, {false, true});
+    ASSERT_EQ(snapshot.getRoads().size(), 2u);
+    EXPECT_EQ(snapshot.getRoads()[0].laneCount, 2u);
+    ASSERT_EQ(snapshot.getVehicles().size(), 1u);
+    EXPECT_EQ(snapshot.getVehicles()[0].position, 50.0f);
+    EXPECT_EQ(snapshot.getLanes()[snapshot.getRoads()[1].firstLane], 0u);
+    EXPECT_EQ(snapshot.getLights().size(), 1u);
+
+    snapshot.capture(roads, 1.0);
+    EXPECT_EQ(snapshot.getVehicles().size(), 2u);
+}
+
+TEST_F(TrafficSimulationTest, TelemetryServerShouldStreamDeltasOverWebSocket) {
+    // The example handshake of RFC 6455
+    EXPECT_EQ(TelemetryServer::acceptKey("dGhlIHNhbXBsZSBub25jZQ=="), "s3pPLMBiTxaQ9kYGzzhZRbK+xOo=");
+
+    Road* a = new Road("A", 300);
+    Road* b = new Road("B", 200);
+    a->addVehicle(new Auto(a, 100));
+    a->addVehicle(new Auto(a, 150));
+    b->addVehicle(new Auto(b, 50));
+    sim->addRoad(a);
+    sim->addRoad(b);
+    sim->addRoad(new Road("C \"oost\\", 100));
+    TelemetryServer server("0");
+    ASSERT_GT(server.getPort(), 0);
+    sim->setTelemetry(&server);
+
+    auto connectClient = [&server]() {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        address.sin_port = htons(static_cast<std::uint16_t>(server.getPort()));
+        timeval timeout{5, 0};
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        EXPECT_EQ(connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)), 0);
+        return fd;
+    };
+    auto readExactly = [](int fd, std::size_t size) {
+        std::string data;
+        char buffer[4096];
+        while (data.size() < size) {
+            ssize_t n = recv(fd, buffer, std::min(sizeof(buffer), size - data.size()), 0);
+            if (n <= 0)
+                break;
+            data.append(buffer, static_cast<std::size_t>(n));
+        }
+        return data;
+    };
+    auto readUntil = [](int fd, const std::string& end) {
+        std::string data;
+        char c;
+        while (data.find(end) == std::string::npos && recv(fd, &c, 1, 0) == 1)
+            data.push_back(c);
+        return data;
+    };
+
+    // The road list over plain HTTP
+    sim->runStep();
+    int http = connectClient();
+    std::string get = "GET /banen HTTP/1.1\r\nHost: localhost\r\n\r\n";
+    send(http, get.data(), get.size(), 0);
+    std::string listing = readUntil(http, "]");
+    EXPECT_NE(listing.find("200 OK"), std::string::npos);
+    // Quotes and backslashes in road names are escaped
+    EXPECT_NE(listing.find(R"(["A","B","C \"oost\\"])"), std::string::npos);
+    close(http);
+
+    int ws = connectClient();
+    std::string upgrade = "GET / HTTP/1.1\r\nHost: localhost\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+                          "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nSec-WebSocket-Version: 13\r\n\r\n";
+    send(ws, upgrade.data(), upgrade.size(), 0);
+    std::string response = readUntil(ws, "\r\n\r\n");
+    EXPECT_NE(response.find("101 Switching Protocols"), std::string::npos);
+    EXPECT_NE(response.find("s3pPLMBiTxaQ9kYGzzhZRbK+xOo="), std::string::npos);
+
+    // Reads one binary message; every step publishes until one arrives
+    auto readMessage = [&]() {
+        for (int i = 0; i < 500 && server.getClientCount() == 0; i++)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        sim->runStep();
+        std::string head = readExactly(ws, 2);
+        if (head.size() < 2)
+            return std::string();
+        EXPECT_EQ(static_cast<unsigned char>(head[0]), 0x82);
+        std::size_t size = static_cast<unsigned char>(head[1]);
+        if (size == 126) {
+            std::string extended = readExactly(ws, 2);
+            size = (static_cast<unsigned char>(extended[0]) << 8) | static_cast<unsigned char>(extended[1]);
+        }
+        return readExactly(ws, size);
+    };
+    auto vehicles = [](const std::string& message) { return static_cast<int>(static_cast<unsigned char>(message[13])); };
+
+    std::string first = readMessage();
+    ASSERT_GE(first.size(), DeltaEncoder::HEADER_SIZE);
+    EXPECT_EQ(first[12], 1);
+    EXPECT_EQ(vehicles(first), 3);
+
+    // Subscribe to road B with a masked text frame
+    std::string frame = {static_cast<char>(0x81), static_cast<char>(0x80 | 1), 1, 2, 3, 4, static_cast<char>('B' ^ 1)};
+    send(ws, frame.data(), frame.size(), 0);
+    bool subscribed = false;
+    for (int i = 0; i < 200 && !subscribed; i++) {
+        std::string message = readMessage();
+        ASSERT_GE(message.size(), DeltaEncoder::HEADER_SIZE);
+        subscribed = message[12] == 1 && vehicles(message) == 1;
+    }
+    EXPECT_TRUE(subscribed);
+    EXPECT_GT(server.getMessagesSent(), 1);
+
+    // A frame above the size cap closes the connection before its payload arrives
+    std::string oversized = {static_cast<char>(0x81), static_cast<char>(0x80 | 127), 0, 0, 0, 0, 0, 0x10, 0, 0};
+    send(ws, oversized.data(), oversized.size(), 0);
+    readUntil(ws, "never sent");
+    char rest;
+    EXPECT_EQ(recv(ws, &rest, 1, 0), 0);
+    close(ws);
+    server.stop();
+    sim->setTelemetry(nullptr);
+}
+
+TEST_F(TrafficSimulationTest, RoadShouldAnswerRangeQueriesLikeAScan) {
+    Road* road = new Road("A", 1000, 3);
+    std::mt19937 rng(45);
+    std::uniform_real_distribution<double> position(0, 1000);
+    for (int i = 0; i < 60; i++) {
+        Vehicle* vehicle = new Auto(road, position(rng));
+        vehicle->setLane(i % 3);
+        road->addVehicle(vehicle);
+    }
+    sim->addRoad(road);
+    for (int step = 0; step < 20; step++)
+        sim->runStep();
+
+    for (int query = 0; query < 50; query++) {
+        double from = position(rng);
+        double to = from + position(rng) / 4;
+        int lane = query % 4 - 1;
+        std::vector<Vehicle*> expected;
+        Vehicle* nearest = nullptr;
+        for (Vehicle* vehicle : road->getVehicles()) {
+            if (lane >= 0 && vehicle->getLane() != lane)
+                continue;
+            if (vehicle->getPosition() >= from && vehicle->getPosition() <= to)
+                expected.push_back(vehicle);
+            if (nearest == nullptr
+                || std::abs(vehicle->getPosition() - from) < std::abs(nearest->getPosition() - from))
+                nearest = vehicle;
+        }
+        std::vector<Vehicle*> found;
+        road->findVehicles(from, to, found, lane);
+        EXPECT_EQ(road->countVehicles(from, to, lane), static_cast<int>(found.size()));
+        std::sort(found.begin(), found.end());
+        std::sort(expected.begin(), expected.end());
+        EXPECT_EQ(found, expected);
+        ASSERT_NE(road->findNearestVehicle(from, lane), nullptr);
+        EXPECT_DOUBLE_EQ(std::abs(road->findNearestVehicle(from, lane)->getPosition() - from),
+                         std::abs(nearest->getPosition() - from));
+    }
+    Road empty("Leeg", 100);
+    EXPECT_EQ(empty.countVehicles(0, 100), 0);
+    EXPECT_EQ(empty.findNearestVehicle(50), nullptr);
+}
+
+TEST_F(TrafficSimulationTest, TrafficLightShouldMeasureItsQueue) {
+    Road* road = new Road("A", 500, 2);
+    TrafficLight* light = new TrafficLight(road, 400, 30);
+    road->addTrafficLight(light);
+    // Lane 0: three standing vehicles 2 m apart, then a gap of 20 m
+    for (double position : {398.0, 392.0, 386.0, 362.0}) {
+        Vehicle* vehicle = new Auto(road, position);
+        road->addVehicle(vehicle);
+    }
+    // Lane 1: a moving vehicle does not queue, nor do those behind it
+    Vehicle* moving = new Auto(road, 395);
+    moving->setLane(1);
+    moving->setSpeed(10);
+    road->addVehicle(moving);
+    Vehicle* behind = new Auto(road, 390);
+    behind->setLane(1);
+    road->addVehicle(behind);
+    // Past the stop line does not count
+    road->addVehicle(new Auto(road, 450));
+    sim->addRoad(road);
+
+    Road::Queue queue = light->getQueue();
+    EXPECT_EQ(queue.vehicles, 3);
+    EXPECT_DOUBLE_EQ(queue.length, 400 - (386 - sim->getVehicles()[0]->getLength()));
+    EXPECT_EQ(light->getQueue(2.0, 1.0).vehicles, 0);
+    EXPECT_EQ(road->getQueue(500).vehicles, 0);
+}
+
+TEST_F(TrafficSimulationTest, ActuatedTrafficLightShouldGapOutOrExtendGreen) {
+    Road* road = new Road("A", 500);
+    TrafficLight* light = new TrafficLight(road, 400, 10);
+    TrafficLight::Actuation actuation;
+    actuation.minGreen = 5;
+    actuation.maxGreen = 20;
+    actuation.gap = 3;
+    actuation.zone = 40;
+    light->setActuation(actuation);
+    road->addTrafficLight(light);
+    sim->addRoad(road);
+
+    // Without demand green ends at its minimum, red keeps the cycle time
+    light->update(4.9);
+    EXPECT_TRUE(light->isGreen());
+    light->update(5);
+    EXPECT_FALSE(light->isGreen());
+    light->update(14.9);
+    EXPECT_FALSE(light->isGreen());
+    light->update(15);
+    EXPECT_TRUE(light->isGreen());
+
+    // A vehicle in the detection zone extends green up to its maximum
+    Vehicle* waiting = new Auto(road, 370);
+    road->addVehicle(waiting);
+    sim->addVehicle(waiting);
+    light->update(20);
+    EXPECT_TRUE(light->isGreen());
+    light->update(34.9);
+    EXPECT_TRUE(light->isGreen());
+    light->update(35);
+    EXPECT_FALSE(light->isGreen());
+
+    // A queue reaching the stop line extends green even if the zone misses it
+    Road* other = new Road("B", 500);
+    TrafficLight* queued = new TrafficLight(other, 400, 10);
+    actuation.zone = 1;
+    queued->setActuation(actuation);
+    other->addTrafficLight(queued);
+    other->addVehicle(new Auto(other, 398));
+    sim->addRoad(other);
+    queued->update(10);
+    EXPECT_TRUE(queued->isGreen());
+    other->removeVehicle(other->getVehicles()[0]);
+    queued->update(10.1);
+    EXPECT_FALSE(queued->isGreen());
+}
+
+TEST_F(TrafficSimulationTest, ActuatedTrafficLightShouldBeParsedAndValidated) {
+    std::vector<Road*> roads;
+    std::vector<VehicleGenerator*> generators;
+    std::vector<BusStop*> busStops;
+    std::vector<Intersection*> intersections;
+    const std::string road = "<BAAN><naam>A</naam><lengte>500</lengte></BAAN>";
+    Parser::parseString(road + "<VERKEERSLICHT><baan>A</baan><positie>400</positie><cyclus>20</cyclus>"
+                               "<mingroen>6</mingroen><maxgroen>45</maxgroen><hiaat>2.5</hiaat></VERKEERSLICHT>"
+                               "<VERKEERSLICHT><baan>A</baan><positie>100</positie><cyclus>20</cyclus></VERKEERSLICHT>",
+                        roads, generators, busStops, intersections);
+    ASSERT_EQ(roads.size(), 1u);
+    ASSERT_EQ(roads[0]->getTrafficLights().size(), 2u);
+    const TrafficLight* actuated = roads[0]->getTrafficLights()[0];
+    EXPECT_TRUE(actuated->isActuated());
+    EXPECT_DOUBLE_EQ(actuated->getActuation().minGreen, 6);
+    EXPECT_DOUBLE_EQ(actuated->getActuation().maxGreen, 45);
+    EXPECT_DOUBLE_EQ(actuated->getActuation().gap, 2.5);
+    EXPECT_DOUBLE_EQ(actuated->getActuation().zone, TrafficLight::Actuation().zone);
+    EXPECT_FALSE(roads[0]->getTrafficLights()[1]->isActuated());
+    sim->addRoad(roads[0]);
+
+    const std::string light = "<VERKEERSLICHT><baan>A</baan><positie>400</positie><cyclus>20</cyclus>";
+    roads.clear();
+    EXPECT_THROW(Parser::parseString(road + light + "<mingroen>6</mingroen></VERKEERSLICHT>",
+                                     roads, generators, busStops, intersections), std::runtime_error);
+    EXPECT_THROW(Parser::parseString(road + light + "<mingroen>30</mingroen><maxgroen>20</maxgroen></VERKEERSLICHT>",
+                                     roads, generators, busStops, intersections), std::runtime_error);
+    EXPECT_THROW(Parser::parseString(road + light + "<mingroen>5</mingroen><maxgroen>20</maxgroen><hiaat>0</hiaat></VERKEERSLICHT>",
+                                     roads, generators, busStops, intersections), std::runtime_error);
+}
+
+TEST_F(TrafficSimulationTest, SweepShouldExpandCartesianAndLatinHypercubeDesigns) {
+    sim = loadFromFile("test_input.xml");
+    std::vector<SweepParameter> parameters = ParameterSweep::load((RES / "16_sweep.txt").string());
+    ASSERT_EQ(parameters.size(), 3u);
+    EXPECT_EQ(parameters[0].name, "cyclus:Middelheimlaan");
+    EXPECT_EQ(parameters[2].levels, 1);
+    ParameterSweep sweep(*sim, parameters);
+
+    std::vector<std::vector<double>> grid = sweep.cartesian();
+    ASSERT_EQ(grid.size(), 6u);
+    EXPECT_DOUBLE_EQ(grid[0][0], 20);
+    EXPECT_DOUBLE_EQ(grid[1][1], 15);
+    EXPECT_DOUBLE_EQ(grid[2][0], 30);
+    EXPECT_DOUBLE_EQ(grid[5][0], 40);
+    EXPECT_DOUBLE_EQ(grid[5][2], 0.0166);
+
+    // Every parameter uses every one of the 8 strata exactly once
+    std::vector<std::vector<double>> design = sweep.latinHypercube(8, 3);
+    ASSERT_EQ(design.size(), 8u);
+    for (std::size_t i = 0; i < parameters.size(); i++) {
+        std::vector<bool> used(8, false);
+        double width = (parameters[i].maximum - parameters[i].minimum) / 8;
+        for (const auto& point : design) {
+            if (width == 0)
+                continue;
+            int stratum = static_cast<int>((point[i] - parameters[i].minimum) / width);
+            ASSERT_GE(stratum, 0);
+            ASSERT_LT(stratum, 8);
+            EXPECT_FALSE(used[stratum]);
+            used[stratum] = true;
+        }
+    }
+
+    EXPECT_THROW(ParameterSweep(*sim, {{"cyclus:Onbekend", 10, 20, 2}}), std::runtime_error);
+    EXPECT_THROW(ParameterSweep(*sim, {{"snelheid", 10, 20, 2}}), std::runtime_error);
+    EXPECT_THROW(ParameterSweep(*sim, {{"dt", 0, 0.1, 2}}), std::runtime_error);
+}
+
+TEST_F(TrafficSimulationTest, SweepShouldRunPointsOnClonesOfTheBase) {
+    sim = loadFromFile("test_input.xml");
+    ParameterSweep sweep(*sim, {{"cyclus:Middelheimlaan", 5, 40, 2}, {"dt", 0.0166, 0.0332, 2}});
+    std::vector<std::vector<double>> points = sweep.cartesian();
+
+    std::vector<ParameterSweep::Result> serial = sweep.run(points, 20, 1);
+    std::vector<ParameterSweep::Result> parallel = sweep.run(points, 20, 3);
+    ASSERT_EQ(serial.size(), 4u);
+    EXPECT_EQ(serial[0].steps, 1205);
+    EXPECT_EQ(serial[1].steps, 603);
+    for (std::size_t i = 0; i < serial.size(); i++) {
+        EXPECT_EQ(serial[i].values, points[i]);
+        EXPECT_EQ(serial[i].meanSpeed, parallel[i].meanSpeed);
+        EXPECT_EQ(serial[i].counters.lightSwitches, parallel[i].counters.lightSwitches);
+    }
+    // A shorter cycle switches the lights more often
+    EXPECT_GT(serial[0].counters.lightSwitches, serial[2].counters.lightSwitches);
+    EXPECT_EQ(sim->currentTime, 0);
+
+    std::ostringstream csv;
+    ParameterSweep::writeCsv(csv, sweep.getParameters(), serial);
+    EXPECT_EQ(csv.str().substr(0, csv.str().find('\n')),
+              "cyclus:Middelheimlaan,dt,stappen,gem_voertuigen,gem_snelheid,gegenereerd,verlaten,geblokkeerd");
+}
+
+TEST_F(TrafficSimulationTest, SignalOptimizerShouldApplyCyclesAndOffsets) {
+    Road* road = new Road("A", 500);
+    TrafficLight* light = new TrafficLight(road, 400, 20);
+    road->addTrafficLight(light);
+    // An actuated light has no fixed period, so it is left out of the plan
+    TrafficLight* actuated = new TrafficLight(road, 450, 30);
+    actuated->setActuation(TrafficLight::Actuation());
+    road->addTrafficLight(actuated);
+    sim->addRoad(road);
+
+    // 25 s into a 40 s period is 5 s into red
+    light->setOffset(25, 100);
+    EXPECT_FALSE(light->isGreen());
+    EXPECT_DOUBLE_EQ(light->getOffset(100), 25);
+    light->update(114.9);
+    EXPECT_FALSE(light->isGreen());
+    light->update(115);
+    EXPECT_TRUE(light->isGreen());
+    EXPECT_DOUBLE_EQ(light->getOffset(120), 5);
+    light->setOffset(0, 0);
+
+    SignalOptimizer::Settings settings;
+    settings.warmup = 0;
+    SignalOptimizer optimizer(*sim, settings);
+    ASSERT_EQ(optimizer.getLightCount(), 1);
+    EXPECT_EQ(optimizer.currentGenes(), std::vector<double>({20, 0}));
+    std::unique_ptr<Simulation> copy = sim->clone();
+    optimizer.apply(*copy, {12.4, 0.75});
+    const TrafficLight* copied = copy->getRoads()[0]->getTrafficLights()[0];
+    EXPECT_EQ(copied->getCycle(), 12);
+    EXPECT_FALSE(copied->isGreen());
+    EXPECT_DOUBLE_EQ(copied->getOffset(copy->currentTime), 18);
+    EXPECT_EQ(light->getCycle(), 20);
+    for (const TrafficLight* other : copy->getRoads()[0]->getTrafficLights()) {
+        if (other->isActuated()) {
+            EXPECT_EQ(other->getCycle(), 30);
+        }
+    }
+
+    Simulation empty;
+    EXPECT_THROW(SignalOptimizer(empty, settings), std::runtime_error);
+    Simulation onlyActuated;
+    Road* other = new Road("B", 500);
+    TrafficLight* demanded = new TrafficLight(other, 400, 20);
+    demanded->setActuation(TrafficLight::Actuation());
+    other->addTrafficLight(demanded);
+    onlyActuated.addRoad(other);
+    EXPECT_THROW(SignalOptimizer(onlyActuated, settings), std::runtime_error);
+    settings.maxCycle = 2;
+    EXPECT_THROW(SignalOptimizer(*sim, settings), std::runtime_error);
+}
+
+TEST_F(TrafficSimulationTest, SignalOptimizerShouldNotDependOnTheThreadCount) {
+    sim = loadFromFile("test_input.xml");
+    SignalOptimizer::Settings settings;
+    settings.population = 6;
+    settings.generations = 2;
+    settings.warmup = 10;
+    settings.horizon = 20;
+    settings.seed = 47;
+
+    SignalOptimizer serial(*sim, settings);
+    SignalOptimizer::Candidate best = serial.optimize();
+    settings.threads = 3;
+    SignalOptimizer parallel(*sim, settings);
+    SignalOptimizer::Candidate other = parallel.optimize();
+    EXPECT_EQ(best.genes, other.genes);
+    EXPECT_EQ(best.cost, other.cost);
+    EXPECT_EQ(serial.getHistory(), parallel.getHistory());
+    EXPECT_EQ(sim->currentTime, 0);
+
+    // The current plan is in the first generation, so the search never does worse
+    ASSERT_EQ(serial.getHistory().size(), 3u);
+    EXPECT_LE(serial.getHistory()[2], serial.getHistory()[0]);
+    EXPECT_LE(best.cost, serial.evaluate({serial.currentGenes()})[0].cost);
+    EXPECT_GT(best.delay, 0);
+
+    std::ostringstream out;
+    serial.write(out, best);
+    EXPECT_EQ(out.str().rfind("Verkeerslicht ", 0), 0u);
+    EXPECT_NE(out.str().find("-> cyclus: "), std::string::npos);
+}
+
+TEST_F(TrafficSimulationTest, SimulationForkShouldRunWhatIfBranchesBesideTheOriginal) {
+    Road* road = new Road("A", 2000, 2);
+    for (int i = 0; i < 20; i++) {
+        Vehicle* vehicle = new Auto(road, 40.0 * i);
+        vehicle->setLane(i % 2);
+        road->addVehicle(vehicle);
+    }
+    TrafficLight* light = new TrafficLight(road, 300, 20);
+    road->addTrafficLight(light);
+    sim->addRoad(road);
+    for (int step = 0; step < 100; step++)
+        sim->runStep();
+
+    auto positions = [](const Simulation& simulation, std::ostream& out) {
+        out << std::setprecision(17);
+        for (const Vehicle* vehicle : simulation.getVehicles())
+            out << vehicle->getId() << ":" << vehicle->getPosition() << ",";
+    };
+    auto run = [positions](Simulation& simulation, std::ostream& out) {
+        for (int step = 0; step < 1500; step++)
+            simulation.runStep();
+        positions(simulation, out);
+    };
+    std::unique_ptr<Simulation> reference = sim->clone();
+
+    // What if the light stayed green?
+    std::unique_ptr<SimulationFork> green = sim->fork([run](Simulation& simulation, std::ostream& out) {
+        for (TrafficLight* l : simulation.getTrafficLights()) {
+            l->setCycle(10000);
+            l->setOffset(0, simulation.currentTime);
+        }
+        run(simulation, out);
+    });
+    std::unique_ptr<SimulationFork> unchanged = sim->fork(run);
+    EXPECT_GT(green->getPid(), 0);
+
+    std::ostringstream original;
+    run(*sim, original);
+    std::ostringstream expected;
+    run(*reference, expected);
+    EXPECT_EQ(original.str(), expected.str());
+    EXPECT_EQ(light->getCycle(), 20);
+
+    EXPECT_EQ(unchanged->wait(), original.str());
+    EXPECT_NE(green->wait(), original.str());
+    EXPECT_THROW(green->wait(), std::runtime_error);
+}
+
+TEST_F(TrafficSimulationTest, SimulationForkShouldReturnLargeOutputAndReportFailures) {
+    Road* road = new Road("A", 500);
+    road->addVehicle(new Auto(road, 10));
+    sim->addRoad(road);
+
+    std::unique_ptr<SimulationFork> large = sim->fork([](Simulation&, std::ostream& out) {
+        out << std::string(300000, 'x') << "einde";
+    });
+    std::string output = large->wait();
+    EXPECT_EQ(output.size(), 300005u);
+    EXPECT_EQ(output.substr(300000), "einde");
+
+    std::unique_ptr<SimulationFork> failing = sim->fork([](Simulation&, std::ostream&) {
+        throw std::runtime_error("baan afgesloten");
+    });
+    try {
+        failing->wait();
+        FAIL() << "A failing branch must throw";
+    } catch (const std::runtime_error& e) {
+        EXPECT_NE(std::string(e.what()).find("baan afgesloten"), std::string::npos);
+    }
+
+    // An abandoned branch is killed when its handle goes away
+    int pid = 0;
+    {
+        std::unique_ptr<SimulationFork> endless = sim->fork([](Simulation& simulation, std::ostream&) {
+            while (true)
+                simulation.runStep();
+        });
+        pid = endless->getPid();
+    }
+    EXPECT_EQ(::kill(pid, 0), -1);
+    EXPECT_EQ(sim->currentTime, 0);
+}
+
+TEST_F(TrafficSimulationTest, RewindShouldSeekBackToTheExactState) {
+    sim = loadFromFile("test_input.xml");
+    RewindBuffer rewind(50, std::size_t(1) << 30);
+    sim->setRewind(&rewind);
+
+    auto state = [](const Simulation& simulation) {
+        std::ostringstream out;
+        out << std::setprecision(17) << simulation.currentTime << ";";
+        for (const Road* road : simulation.getRoads()) {
+            for (const Vehicle* vehicle : road->getVehicles())
+                out << vehicle->getId() << ":" << vehicle->getPosition() << ":" << vehicle->getSpeed() << ",";
+            for (const TrafficLight* light : road->getTrafficLights())
+                out << light->isGreen();
+        }
+        return out.str();
+    };
+    std::map<int, std::string> states;
+    for (int step = 1; step <= 230; step++) {
+        sim->runStep();
+        states[step] = state(*sim);
+    }
+    EXPECT_EQ(rewind.getFirstStep(), 0);
+    EXPECT_EQ(rewind.getLastStep(), 230);
+    EXPECT_EQ(rewind.getKeyframeCount(), 5);
+
+    sim->seek(170);
+    EXPECT_EQ(sim->getStepCount(), 170);
+    EXPECT_EQ(state(*sim), states[170]);
+    EXPECT_EQ(rewind.getLastStep(), 170);
+    sim->seek(130);
+    EXPECT_EQ(state(*sim), states[130]);
+    sim->seek(230);
+    EXPECT_EQ(state(*sim), states[230]);
+    EXPECT_EQ(rewind.getKeyframeCount(), 5);
+    sim->seek(0);
+    EXPECT_DOUBLE_EQ(sim->currentTime, 0);
+}
+
+TEST_F(TrafficSimulationTest, RewindShouldDecodeFramesWithinItsBudget) {
+    sim = loadFromFile("test_input.xml");
+    RewindBuffer unbounded(100, std::size_t(1) << 30);
+    sim->setRewind(&unbounded);
+    std::map<std::uint32_t, std::pair<double, double>> kinematics;
+    std::vector<bool> greens;
+    for (int step = 1; step <= 300; step++) {
+        sim->runStep();
+        if (step != 240)
+            continue;
+        for (const Vehicle* vehicle : sim->getVehicles())
+            kinematics[vehicle->getId()] = {vehicle->getPosition(), vehicle->getSpeed()};
+        for (const Road* road : sim->getRoads()) {
+            for (const TrafficLight* light : road->getTrafficLights())
+                greens.push_back(light->isGreen());
+        }
+    }
+
+    RewindBuffer::Frame frame = unbounded.frameAt(240);
+    EXPECT_EQ(frame.step, 240);
+    ASSERT_EQ(frame.vehicles.size(), kinematics.size());
+    for (const RewindBuffer::VehicleState& vehicle : frame.vehicles) {
+        ASSERT_EQ(kinematics.count(vehicle.id), 1u);
+        EXPECT_NEAR(vehicle.position, kinematics[vehicle.id].first, 0.011);
+        EXPECT_NEAR(vehicle.speed, kinematics[vehicle.id].second, 0.011);
+    }
+    ASSERT_EQ(frame.lights.size(), greens.size());
+    for (std::size_t i = 0; i < greens.size(); i++)
+        EXPECT_EQ(frame.lights[i].green, greens[i]);
+
+    // A budget of about two segments keeps only the newest keyframes
+    std::size_t segment = unbounded.getMemoryUsage() / 3;
+    std::unique_ptr<Simulation> copy = sim->clone();
+    RewindBuffer bounded(100, 2 * segment);
+    copy->setRewind(&bounded);
+    for (int step = 0; step < 500; step++)
+        copy->runStep();
+    EXPECT_LE(bounded.getMemoryUsage(), 2 * segment);
+    EXPECT_GT(bounded.getFirstStep(), 300);
+    EXPECT_EQ(bounded.getLastStep(), 800);
+    EXPECT_EQ(bounded.getFirstStep() % 100, 0);
+}
+
+TEST_F(TrafficSimulationTest, JournalShouldReplayARunExactly) {
+    auto state = [](const Simulation& simulation) {
+        std::ostringstream out;
+        out << std::setprecision(17) << simulation.currentTime << ";";
+        for (const Road* road : simulation.getRoads()) {
+            for (const Vehicle* vehicle : road->getVehicles())
+                out << vehicle->getId() << ":" << vehicle->getPosition() << ":" << vehicle->getSpeed() << ",";
+            for (const TrafficLight* light : road->getTrafficLights())
+                out << light->getCycle() << light->isGreen();
+        }
+        return out.str();
+    };
+
+    sim = loadFromFile("test_input.xml");
+    sim->seed(1);
+    sim->setTimeStep(0.1);
+    std::ostringstream recorded;
+    Journal recorder(recorded);
+    sim->setJournal(&recorder);
+    for (int step = 1; step <= 1500; step++) {
+        if (step == 100)
+            sim->execute("cyclus Middelheimlaan 10");
+        if (step == 300)
+            sim->execute("voertuig Floralienlaan auto 100");
+        sim->runStep();
+    }
+    recorder.finish();
+    std::string bytes = recorded.str();
+    std::string expected = state(*sim);
+    EXPECT_GT(recorder.getDecisions(), 30u);
+    EXPECT_LT(bytes.size(), 5 * recorder.getDecisions() + 100);
+
+    // The draws come from the journal, so another seed replays the same run
+    std::unique_ptr<Simulation> replayed = loadFromFile("test_input.xml");
+    replayed->seed(2);
+    replayed->setTimeStep(0.1);
+    std::istringstream in(bytes);
+    Journal player(in);
+    replayed->setJournal(&player);
+    EXPECT_EQ(replayed->replay(), 1500);
+    EXPECT_EQ(state(*replayed), expected);
+    EXPECT_EQ(player.getDecisions(), recorder.getDecisions());
+
+    // A cut-off journal replays the steps it holds
+    std::unique_ptr<Simulation> partial = loadFromFile("test_input.xml");
+    partial->setTimeStep(0.1);
+    std::istringstream half(bytes.substr(0, bytes.size() / 2));
+    Journal halfPlayer(half);
+    partial->setJournal(&halfPlayer);
+    int steps = partial->replay();
+    EXPECT_GT(steps, 0);
+    EXPECT_LT(steps, 1500);
+}
+
+TEST_F(TrafficSimulationTest, JournalShouldRejectInvalidCommandsAndOtherRuns) {
+    sim = loadFromFile("test_input.xml");
+    EXPECT_THROW(sim->execute("vliegen Middelheimlaan"), std::runtime_error);
+    EXPECT_THROW(sim->execute("cyclus Onbekendelaan 10"), std::runtime_error);
+    EXPECT_THROW(sim->execute("cyclus Middelheimlaan -3"), std::runtime_error);
+    EXPECT_THROW(sim->execute("cyclus Middelheimlaan 10 20"), std::runtime_error);
+    EXPECT_THROW(sim->execute("voertuig Middelheimlaan fiets 10"), std::runtime_error);
+    EXPECT_THROW(sim->execute("voertuig Middelheimlaan auto 5000"), std::runtime_error);
+    std::size_t vehicleCount = sim->getVehicles().size();
+    sim->execute("voertuig Beukenlaan bus 10");
+    EXPECT_EQ(sim->getVehicles().size(), vehicleCount);
+    sim->runStep();
+    EXPECT_EQ(sim->getVehicles().size(), vehicleCount + 1);
+
+    std::ostringstream recorded;
+    {
+        std::unique_ptr<Simulation> recording = loadFromFile("test_input.xml");
+        Journal recorder(recorded);
+        recording->setJournal(&recorder);
+        for (int step = 0; step < 800; step++)
+            recording->runStep();
+    }
+
+    // Another scenario is refused by the header
+    std::unique_ptr<Simulation> other = loadFromFile("10_intersection_ok.xml");
+    std::istringstream otherIn(recorded.str());
+    Journal otherPlayer(otherIn);
+    EXPECT_THROW(other->setJournal(&otherPlayer), std::runtime_error);
+
+    // Another step length spawns at other steps, which the replay detects
+    std::unique_ptr<Simulation> diverging = loadFromFile("test_input.xml");
+    diverging->setTimeStep(0.05);
+    std::istringstream in(recorded.str());
+    Journal player(in);
+    diverging->setJournal(&player);
+    EXPECT_THROW(diverging->replay(), std::runtime_error);
+}
+
 // NEW ERROR COMPARISON TESTS
 
 // Test for basic invalid XML